@@ -0,0 +1,225 @@
+#ifndef LXMLFORMATTER_BENCH_CORPUS_H
+#define LXMLFORMATTER_BENCH_CORPUS_H
+
+/*
+    Synthetic benchmark corpora.
+    Every generator is a pure function of (bytes, seed): it draws from a
+    std::mt19937 (whose sequence the standard fixes) with plain modulo, never a
+    distribution, so the same arguments give byte-identical documents on every
+    platform and compiler. Documents are well-formed UTF-8 and end up a little
+    over 'bytes' long (the last element is always completed).
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace LXMLFormatter {
+namespace Bench {
+
+namespace detail {
+    inline const char* const kWords[] = {
+        "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+        "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+        "magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+        "exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo"
+    };
+    // 2-, 3- and 4-byte UTF-8 (Cyrillic, Greek, CJK, emoji).
+    inline const char* const kWideWords[] = {
+        "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82",           // привет
+        "\xCE\xBA\xCF\x8C\xCF\x83\xCE\xBC\xCE\xBF\xCF\x82",           // κόσμος
+        "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E",                       // 日本語
+        "\xE4\xB8\xAD\xE6\x96\x87\xE6\x96\x87\xE6\x9C\xAC",           // 中文文本
+        "\xF0\x9F\x98\x80\xF0\x9F\x9A\x80",                           // emoji
+        "caf\xC3\xA9", "na\xC3\xAFve", "\xC3\xBC" "ber"
+    };
+    inline const char* const kNames[] = {
+        "item", "entry", "record", "value", "node", "field", "row", "cell", "data", "x"
+    };
+
+    template<std::size_t N>
+    inline const char* pick(std::mt19937& rng, const char* const (&list)[N]) {
+        return list[rng() % N];
+    }
+
+    inline void words(std::string& out, std::mt19937& rng, unsigned count, bool wide = false) {
+        for (unsigned i = 0; i < count; ++i) {
+            if (i) out += ' ';
+            out += (wide && rng() % 2) ? pick(rng, kWideWords) : pick(rng, kWords);
+        }
+    }
+
+    // No XML declaration, so every corpus starts the same way.
+    inline std::string open() { return "<corpus>\n"; }
+    inline void close(std::string& s) { s += "</corpus>\n"; }
+}
+
+// Long character data runs: the text scanner and readWhile() dominate.
+inline std::string textHeavy(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        s += "  <p>";
+        detail::words(s, rng, 80 + rng() % 120);
+        s += "</p>\n";
+    }
+    detail::close(s);
+    return s;
+}
+
+// Many attributes per element with short values: name/attribute parsing.
+inline std::string attributeHeavy(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        s += "  <";
+        s += detail::pick(rng, detail::kNames);
+        const unsigned attrs = 4 + rng() % 12;
+        for (unsigned a = 0; a < attrs; ++a) {
+            s += " a" + std::to_string(a) + "=\"";
+            detail::words(s, rng, 1 + rng() % 2);
+            s += '"';
+        }
+        s += "/>\n";
+    }
+    detail::close(s);
+    return s;
+}
+
+// Deep element chains (up to 200 levels): tag stack and indentation.
+inline std::string deeplyNested(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 64 * 1024);
+    while (s.size() < bytes) {
+        const unsigned depth = 50 + rng() % 150;
+        for (unsigned d = 0; d < depth; ++d) s += "<n" + std::to_string(d % 16) + ">";
+        detail::words(s, rng, 3);
+        for (unsigned d = depth; d-- > 0;) s += "</n" + std::to_string(d % 16) + ">";
+        s += '\n';
+    }
+    detail::close(s);
+    return s;
+}
+
+// Tiny elements, one short text each: per-token overhead.
+inline std::string manySmallElements(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        const char* name = detail::pick(rng, detail::kNames);
+        switch (rng() % 3) {
+            case 0:  s += "<"; s += name; s += "/>"; break;
+            case 1:  s += "<"; s += name; s += ">"; s += std::to_string(rng() % 1000); s += "</"; s += name; s += ">"; break;
+            default: s += "<"; s += name; s += " k=\"v\">"; s += detail::pick(rng, detail::kWords); s += "</"; s += name; s += ">"; break;
+        }
+        if (rng() % 8 == 0) s += '\n';
+    }
+    detail::close(s);
+    return s;
+}
+
+// Text and attribute values about half non-ASCII: the UTF-8 slow paths.
+inline std::string nonAsciiHeavy(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        s += "  <t lang=\"";
+        s += detail::pick(rng, detail::kWideWords);
+        s += "\">";
+        detail::words(s, rng, 10 + rng() % 40, true);
+        s += "</t>\n";
+    }
+    detail::close(s);
+    return s;
+}
+
+// Indented records with CRLF line ends: line/column tracking and normalisation.
+inline std::string crlfLines(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = "<corpus>\r\n";
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        s += "  <rec id=\"" + std::to_string(rng() % 100000) + "\">\r\n    <v>";
+        detail::words(s, rng, 2 + rng() % 6);
+        s += "</v>\r\n  </rec>\r\n";
+    }
+    s += "</corpus>\r\n";
+    return s;
+}
+
+// Text and attribute values with builtin and character references: the
+// ExpandInternalEntities copy path.
+inline std::string entityHeavy(std::size_t bytes, uint32_t seed) {
+    static const char* const kRefs[] = { "&amp;", "&lt;", "&gt;", "&quot;", "&apos;", "&#233;", "&#x20AC;", "&#x1F600;" };
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        s += "  <e title=\"";
+        detail::words(s, rng, 1);
+        s += detail::pick(rng, kRefs);
+        detail::words(s, rng, 1);
+        s += "\">";
+        const unsigned n = 5 + rng() % 20;
+        for (unsigned i = 0; i < n; ++i) {
+            detail::words(s, rng, 1 + rng() % 4);
+            s += ' ';
+            s += detail::pick(rng, kRefs);
+            s += ' ';
+        }
+        s += "</e>\n";
+    }
+    detail::close(s);
+    return s;
+}
+
+// CDATA payloads (markup-like bytes with ']' and '>' inside), comments and PIs:
+// the terminator search of scanMarkup().
+inline std::string markupHeavy(std::size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s = detail::open();
+    s.reserve(bytes + 4096);
+    while (s.size() < bytes) {
+        s += "  <!-- ";
+        detail::words(s, rng, 3 + rng() % 10);
+        s += " -->\n  <doc><![CDATA[";
+        const unsigned n = 10 + rng() % 60;
+        for (unsigned i = 0; i < n; ++i) {
+            s += (rng() % 8) ? " " : "<b>a[i]</b> -> ";
+            detail::words(s, rng, 1 + rng() % 3);
+        }
+        s += "]]></doc>\n  <?proc ";
+        detail::words(s, rng, 2);
+        s += "?>\n";
+    }
+    detail::close(s);
+    return s;
+}
+
+struct Corpus {
+    const char* name;
+    const char* description;
+    std::string (*make)(std::size_t bytes, uint32_t seed);
+};
+
+inline const Corpus kCorpora[] = {
+    {"text",       "long character data runs",                   textHeavy},
+    {"attributes", "4-15 short attributes per empty element",    attributeHeavy},
+    {"nested",     "element chains 50-200 levels deep",          deeplyNested},
+    {"small",      "many tiny elements",                         manySmallElements},
+    {"unicode",    "about half of the words non-ASCII",          nonAsciiHeavy},
+    {"crlf",       "indented records with CRLF line ends",       crlfLines},
+    {"entities",   "text and values full of references",         entityHeavy},
+    {"markup",     "CDATA payloads, comments and PIs",           markupHeavy},
+};
+
+} // namespace Bench
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_BENCH_CORPUS_H
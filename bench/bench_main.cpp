@@ -0,0 +1,318 @@
+/*
+    * Throughput benchmarks
+    * License: MIT
+    *
+    * Runs each synthetic corpus (Corpus.h) through the hot layers bottom-up:
+    *   utf8-decode  UTF8Handler::decode over the whole buffer
+    *   getChar      BufferedInputStream::getChar until EOF
+    *   readWhile    readWhile(text up to '<') + getChar, as the tokenizer reads
+    *   nextToken    XMLTokenizer::nextToken end to end
+    *   nextTokens   XMLTokenizer::nextTokens in batches of 256
+    *   sax          SaxParser with a handler that sums element, attribute and text sizes
+    *   format       XMLTokenizer + XMLFormatter into /dev/null
+    *   skip         XMLTokenizer::skipCurrentElement over the root element
+    * Input comes from a CreateView over the generated bytes, so no I/O is timed.
+    * Each row reports the best of --reps runs: MB/s, million tokens/s (tokenizer
+    * rows), TSC cycles per byte (x86 only) and the process peak RSS so far.
+*/
+
+#include "Corpus.h"
+#include "BufferedInputStream.h"
+#include "BufferedOutputStream.h"
+#include "UTF8Handler.h"
+#include "SaxParser.h"
+#include "XMLFormatter.h"
+#include "XMLTokenizer.h"
+
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  include <x86intrin.h>
+#  define LXML_BENCH_TSC 1
+#endif
+
+using namespace LXMLFormatter;
+
+namespace {
+    struct Config {
+        std::size_t bytes = 32u * 1024u * 1024u;
+        unsigned    reps = 3;
+        uint32_t    seed = 20250730;
+        std::string corpora;    // comma list; empty = all
+        std::string benches;    // comma list; empty = all
+        std::string dumpDir;    // write the corpora here and exit
+    };
+
+    struct Sample {
+        double   seconds = 0;
+        uint64_t cycles = 0;
+        uint64_t tokens = 0;    // 0 for non-tokenizer rows
+        bool     ok = true;
+    };
+
+    // Keeps results observable so the measured loops are not optimised away.
+    volatile uint64_t gSink = 0;
+
+    inline uint64_t readCycles() noexcept {
+#if defined(LXML_BENCH_TSC)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    bool selected(const std::string& list, const char* name) {
+        if (list.empty()) return true;
+        const std::string needle = std::string(",") + name + ",";
+        return ("," + list + ",").find(needle) != std::string::npos;
+    }
+
+    double peakRssMB() {
+        struct rusage ru{};
+        ::getrusage(RUSAGE_SELF, &ru);
+        return static_cast<double>(ru.ru_maxrss) / 1024.0; // KiB on Linux
+    }
+
+    std::unique_ptr<BufferedInputStream> view(const std::string& doc) {
+        return BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(doc.data()), doc.size());
+    }
+
+    TokenizerOptions quietOptions() {
+        TokenizerOptions o;
+        o.flags |= TokenizerOptions::QuietErrors;
+        return o;
+    }
+
+    // ---- the measured bodies; each returns its token count (0 if n/a) ----
+
+    uint64_t benchUtf8Decode(const std::string& doc, bool& ok) {
+        const auto* p = reinterpret_cast<const uint8_t*>(doc.data());
+        const std::size_t n = doc.size();
+        uint64_t sum = 0;
+        for (std::size_t i = 0; i < n;) {
+            const auto r = UTF8Handler::decode(p + i, n - i);
+            if (r.status != UTF8Handler::DecodeStatus::Ok) { ok = false; break; }
+            sum += r.cp;
+            i += r.width;
+        }
+        gSink = sum;
+        return 0;
+    }
+
+    uint64_t benchGetChar(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        uint64_t sum = 0;
+        for (int32_t cp; (cp = in->getChar()) >= 0;) sum += static_cast<uint32_t>(cp);
+        ok = in->getTotalBytesRead() == doc.size();
+        gSink = sum;
+        return 0;
+    }
+
+    uint64_t benchReadWhile(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        std::string text;
+        uint64_t sum = 0;
+        for (;;) {
+            text.clear();
+            in->readWhile(text, [](int32_t cp) { return cp != '<'; });
+            sum += text.size();
+            if (in->getChar() < 0) break;
+        }
+        ok = in->getTotalBytesRead() == doc.size();
+        gSink = sum;
+        return 0;
+    }
+
+    uint64_t benchNextToken(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        XMLTokenizer tz(*in, quietOptions());
+        XMLToken t;
+        uint64_t count = 0;
+        while (tz.nextToken(t)) ++count;
+        ok = tz.errors().empty();
+        return count;
+    }
+
+    uint64_t benchNextTokens(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        XMLTokenizer tz(*in, quietOptions());
+        std::vector<XMLToken> batch(256);
+        uint64_t count = 0;
+        for (std::size_t got; (got = tz.nextTokens(batch.data(), batch.size())) != 0;) count += got;
+        ok = tz.errors().empty();
+        return count;
+    }
+
+    struct SumHandler : SaxHandler {
+        uint64_t sum = 0;
+        void onStartElement(const SaxName& name, const SaxAttributes& attrs) {
+            sum += name.text.size();
+            for (const SaxAttribute& a : attrs) sum += a.name.text.size() + a.value.size();
+        }
+        void onText(std::string_view text, bool) { sum += text.size(); }
+    };
+
+    uint64_t benchSax(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        XMLTokenizer tz(*in, quietOptions());
+        SumHandler h;
+        ok = SaxParser<SumHandler>(tz, h).run();
+        gSink = h.sum;
+        return 0;
+    }
+
+    uint64_t benchFormat(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        TokenizerOptions opts = quietOptions();
+        opts.flags &= ~TokenizerOptions::ExpandInternalEntities; // as the formatter CLI runs it
+        XMLTokenizer tz(*in, opts);
+        auto out = BufferedOutputStream::CreateFile("/dev/null");
+        if (!out) { ok = false; return 0; }
+        XMLFormatter fmt(*out);
+        ok = fmt.run(tz) && out->flush();
+        return 0;
+    }
+
+    uint64_t benchSkip(const std::string& doc, bool& ok) {
+        auto in = view(doc);
+        XMLTokenizer tz(*in, quietOptions());
+        XMLToken t;
+        ok = tz.nextToken(t) && tz.nextToken(t) && t.type == XMLTokenType::StartTag &&
+             tz.skipCurrentElement() && tz.nextToken(t);
+        // Only the trailing newline is left after the root element.
+        while (ok && t.type == XMLTokenType::Text) ok = tz.nextToken(t);
+        ok = ok && t.type == XMLTokenType::DocumentEnd;
+        return 0;
+    }
+
+    struct Benchmark {
+        const char* name;
+        uint64_t (*run)(const std::string& doc, bool& ok);
+        bool countsTokens;
+    };
+
+    const Benchmark kBenchmarks[] = {
+        {"utf8-decode", benchUtf8Decode, false},
+        {"getChar",     benchGetChar,    false},
+        {"readWhile",   benchReadWhile,  false},
+        {"nextToken",   benchNextToken,  true},
+        {"nextTokens",  benchNextTokens, true},
+        {"sax",         benchSax,        false},
+        {"format",      benchFormat,     false},
+        {"skip",        benchSkip,       false},
+    };
+
+    Sample measure(const Benchmark& b, const std::string& doc, unsigned reps) {
+        Sample best;
+        for (unsigned r = 0; r < reps; ++r) {
+            Sample s;
+            const auto t0 = std::chrono::steady_clock::now();
+            const uint64_t c0 = readCycles();
+            s.tokens = b.run(doc, s.ok);
+            s.cycles = readCycles() - c0;
+            s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (r == 0 || s.seconds < best.seconds) best = s;
+            if (!s.ok) return s;
+        }
+        return best;
+    }
+
+    void usage(const char* argv0) {
+        std::cerr << "usage: " << argv0 << " [--size=MB] [--reps=N] [--seed=N] [--corpus=a,b] [--bench=a,b] [--dump=DIR] [--list]\n"
+                  << "  --size=MB    bytes per corpus (default 32)\n"
+                  << "  --reps=N     runs per row; the fastest is reported (default 3)\n"
+                  << "  --seed=N     generator seed; same seed and size = same bytes\n"
+                  << "  --dump=DIR   write the corpora as DIR/<name>.xml and exit\n"
+                  << "  --list       show corpora and benchmarks\n";
+    }
+
+    int list() {
+        std::cout << "corpora:\n";
+        for (const auto& c : Bench::kCorpora) std::printf("  %-11s %s\n", c.name, c.description);
+        std::cout << "benchmarks:\n";
+        for (const auto& b : kBenchmarks) std::printf("  %s\n", b.name);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--size=", 0) == 0) {
+            const double mb = std::atof(arg.c_str() + 7);
+            if (mb <= 0 || mb > 4096) { usage(argv[0]); return 2; }
+            cfg.bytes = static_cast<std::size_t>(mb * 1024 * 1024);
+        } else if (arg.rfind("--reps=", 0) == 0) {
+            const int n = std::atoi(arg.c_str() + 7);
+            if (n < 1 || n > 1000) { usage(argv[0]); return 2; }
+            cfg.reps = static_cast<unsigned>(n);
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            cfg.seed = static_cast<uint32_t>(std::strtoul(arg.c_str() + 7, nullptr, 10));
+        } else if (arg.rfind("--corpus=", 0) == 0) {
+            cfg.corpora = arg.substr(9);
+        } else if (arg.rfind("--bench=", 0) == 0) {
+            cfg.benches = arg.substr(8);
+        } else if (arg.rfind("--dump=", 0) == 0) {
+            cfg.dumpDir = arg.substr(7);
+        } else if (arg == "--list") {
+            return list();
+        } else {
+            usage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 2;
+        }
+    }
+
+    if (!cfg.dumpDir.empty()) {
+        for (const auto& c : Bench::kCorpora) {
+            if (!selected(cfg.corpora, c.name)) continue;
+            const std::string doc = c.make(cfg.bytes, cfg.seed);
+            const std::string path = cfg.dumpDir + "/" + c.name + ".xml";
+            std::ofstream f(path, std::ios::binary);
+            f.write(doc.data(), static_cast<std::streamsize>(doc.size()));
+            if (!f) { std::cerr << "bench: cannot write " << path << "\n"; return 1; }
+            std::cout << path << " (" << doc.size() << " bytes)\n";
+        }
+        return 0;
+    }
+
+    std::printf("size=%.1f MB  reps=%u  seed=%u%s\n\n", static_cast<double>(cfg.bytes) / (1024.0 * 1024.0),
+                cfg.reps, cfg.seed,
+#if defined(LXML_BENCH_TSC)
+                ""
+#else
+                "  (no TSC: cycles/byte not measured)"
+#endif
+                );
+    std::printf("%-11s %-12s %10s %10s %8s %10s\n", "corpus", "benchmark", "MB/s", "Mtok/s", "cyc/B", "peakRSS MB");
+
+    int failures = 0;
+    for (const auto& c : Bench::kCorpora) {
+        if (!selected(cfg.corpora, c.name)) continue;
+        const std::string doc = c.make(cfg.bytes, cfg.seed);
+        const double mb = static_cast<double>(doc.size()) / (1024.0 * 1024.0);
+        for (const auto& b : kBenchmarks) {
+            if (!selected(cfg.benches, b.name)) continue;
+            const Sample s = measure(b, doc, cfg.reps);
+            if (!s.ok) {
+                std::printf("%-11s %-12s %10s\n", c.name, b.name, "FAILED");
+                ++failures;
+                continue;
+            }
+            char tok[16] = "-";
+            if (b.countsTokens) std::snprintf(tok, sizeof(tok), "%.2f", static_cast<double>(s.tokens) / s.seconds / 1e6);
+            char cyc[16] = "-";
+            if (s.cycles) std::snprintf(cyc, sizeof(cyc), "%.2f", static_cast<double>(s.cycles) / static_cast<double>(doc.size()));
+            std::printf("%-11s %-12s %10.1f %10s %8s %10.1f\n", c.name, b.name, mb / s.seconds, tok, cyc, peakRssMB());
+        }
+    }
+    return failures ? 1 : 0;
+}
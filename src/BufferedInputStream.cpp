@@ -1,11 +1,138 @@
 #include "BufferedInputStream.h"
+#include "ByteScan.h"
+#include "DecompressingStreamBuf.h"
+#include "TranscodingStreamBuf.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 namespace LXMLFormatter {
 
-BufferedInputStream::BufferedInputStream(std::istream& stream, size_t bufferSize)
-    : stream_(stream)
+/*
+    Background reader for CreatePrefetched().
+    Two buffers of bufferSize_ bytes: the consumer owns buffer_ (front), the reader
+    fills 'back' from offset 'headroom'. The spare headroom in front of the fresh
+    data is where the consumer copies its unread tail before swapping, so split
+    UTF-8 sequences stay contiguous without a memmove of the whole window.
+    Handshake (under 'm'): the reader only writes 'back' while !full; the consumer
+    only touches 'back' while full.
+*/
+struct BufferedInputStream::Prefetcher {
+    static constexpr std::size_t kHeadroom = 64; // >= longest carry getChar/peekChar needs
+
+    std::istream* stream;
+    std::size_t   cap;
+    std::size_t   headroom;
+    std::unique_ptr<uint8_t[]> back;
+    std::size_t   backPos = 0;   // consumer view of the filled back buffer
+    std::size_t   backEnd = 0;
+
+    std::mutex              m;
+    std::condition_variable cv;
+    bool full = false;  // back holds [backPos, backEnd) ready for the consumer
+    bool done = false;  // reader saw EOF/error; no further fills
+    bool stop = false;  // owner is going away
+    std::thread worker;
+
+    Prefetcher(std::istream* s, std::size_t bufferSize)
+        : stream(s)
+        , cap(bufferSize)
+        , headroom(std::min(kHeadroom, bufferSize / 2))
+        , back(new uint8_t[bufferSize]) {} // not zero-filled: only read after the reader wrote it
+
+    ~Prefetcher() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    void start() { worker = std::thread([this] { run(); }); }
+
+    void run() {
+        for (;;) {
+            uint8_t* dst = nullptr;
+            {
+                std::unique_lock<std::mutex> lk(m);
+                cv.wait(lk, [this] { return stop || !full; });
+                if (stop || done) return;
+                dst = back.get();
+            }
+
+            // Blocking read outside the lock; the consumer never touches 'back' while !full.
+            std::size_t got = 0;
+            if (*stream) {
+                stream->read(reinterpret_cast<char*>(dst + headroom),
+                             static_cast<std::streamsize>(cap - headroom));
+                const std::streamsize n = stream->gcount();
+                if (n > 0) got = static_cast<std::size_t>(n);
+            }
+
+            {
+                std::lock_guard<std::mutex> lk(m);
+                backPos = headroom;
+                backEnd = headroom + got;
+                full    = got > 0;
+                done    = !*stream || got == 0;
+            }
+            cv.notify_all();
+        }
+    }
+};
+
+namespace {
+    // Read-only istream source over memory (a mapped UTF-16/32 file).
+    struct MemoryStreamBuf final : std::streambuf {
+        MemoryStreamBuf(const void* p, std::size_t n) {
+            char* b = static_cast<char*>(const_cast<void*>(p));
+            setg(b, b, b + n);
+        }
+    };
+}
+
+/*
+    Source layers, innermost first; each is optional:
+      map      - mapped UTF-16/32 file, read through 'mapped'
+      inflate  - gzip/zstd (CreateDecompressed), reading the caller's stream
+      transcode- UTF-16/32 to UTF-8, reading whichever of the above (or the
+                 caller's stream) was the source when the encoding was detected
+    'inner' is the istream over map/inflate, 'outer' the one over transcode.
+*/
+struct BufferedInputStream::Decoder {
+    void*       map = nullptr;
+    std::size_t mapLength = 0;
+    std::unique_ptr<MemoryStreamBuf>        mapped;
+    std::unique_ptr<DecompressingStreamBuf> inflate;
+    std::unique_ptr<TranscodingStreamBuf>   transcode;
+    std::istream inner{nullptr};
+    std::istream outer{nullptr};
+
+    ~Decoder() {
+        if (map) ::munmap(map, mapLength); // nothing reads the layers during destruction
+    }
+
+    bool failed() const noexcept {
+        return (inflate && inflate->failed()) || (transcode && transcode->failed());
+    }
+};
+
+BufferedInputStream::BufferedInputStream(std::istream& stream, size_t bufferSize, std::unique_ptr<Decoder> decoder)
+    : stream_(&stream)
     , bufferSize_(bufferSize)
-    , buffer_(std::make_unique<uint8_t[]>(bufferSize))
+    , buffer_(new uint8_t[bufferSize]) // not zero-filled: bytes are read before they are looked at
+    , window_(buffer_.get())
+    , mapBase_(nullptr)
+    , mapLength_(0)
+    , ownsMap_(false)
+    , baseOffset_(0)
     , bufferPos_(0)
     , bufferEnd_(0)
     , currentLine_(1)
@@ -17,15 +144,76 @@ BufferedInputStream::BufferedInputStream(std::istream& stream, size_t bufferSize
     , havePeek_(false)
     , cachedCp_(-1)
     , cachedWidth_(0) 
+    , decoder_(std::move(decoder))
 {
     fillInitialBuffer();
     detectEncoding();
 }
 
+BufferedInputStream::BufferedInputStream(PushTag, size_t capacity)
+    : stream_(nullptr)
+    , bufferSize_(capacity)
+    , buffer_(new uint8_t[capacity]) // not zero-filled: only fed bytes are read
+    , window_(buffer_.get())
+    , mapBase_(nullptr)
+    , mapLength_(0)
+    , ownsMap_(false)
+    , baseOffset_(0)
+    , bufferPos_(0)
+    , bufferEnd_(0)
+    , currentLine_(1)
+    , currentColumn_(1)
+    , totalBytesRead_(0)
+    , encoding_(Encoding::UTF8_NO_BOM)
+    , bomSize_(0)
+    , hasPendingCR_(false)
+    , havePeek_(false)
+    , cachedCp_(-1)
+    , cachedWidth_(0)
+    , push_(true)
+{
+}
+
+// An empty file has nothing to map; point the window at a static byte so the
+// instance stays valid and simply reports EOF.
+static const uint8_t kEmptyWindow[1] = {0};
+
+// Window for a mapped UTF-16/32 file, which is read through a transcoder.
+static constexpr size_t kMappedTranscodeBuffer = 4u * 1024u * 1024u;
+
+BufferedInputStream::BufferedInputStream(void* base, size_t length, bool ownsMap, uint64_t byteOffset)
+    : stream_(nullptr)
+    , bufferSize_(length)
+    , buffer_()
+    , window_(base ? static_cast<const uint8_t*>(base) : kEmptyWindow)
+    , mapBase_(base)
+    , mapLength_(length)
+    , ownsMap_(ownsMap)
+    , baseOffset_(byteOffset)
+    , bufferPos_(0)
+    , bufferEnd_(length)
+    , currentLine_(1)
+    , currentColumn_(1)
+    , totalBytesRead_(static_cast<size_t>(byteOffset))
+    , encoding_(Encoding::UTF8_NO_BOM)
+    , bomSize_(0)
+    , hasPendingCR_(false)
+    , havePeek_(false)
+    , cachedCp_(-1)
+    , cachedWidth_(0)
+{
+    if (ownsMap_) detectEncoding(); // a view is a slice: a BOM can only be at the file start
+}
+
 BufferedInputStream::BufferedInputStream(BufferedInputStream&& other) noexcept
     : stream_(other.stream_)
     , bufferSize_(other.bufferSize_)
     , buffer_(std::move(other.buffer_))
+    , window_(other.window_)
+    , mapBase_(other.mapBase_)
+    , mapLength_(other.mapLength_)
+    , ownsMap_(other.ownsMap_)
+    , baseOffset_(other.baseOffset_)
     , bufferPos_(other.bufferPos_)
     , bufferEnd_(other.bufferEnd_)
     , currentLine_(other.currentLine_)
@@ -37,9 +225,25 @@ BufferedInputStream::BufferedInputStream(BufferedInputStream&& other) noexcept
     , havePeek_(other.havePeek_)
     , cachedCp_(other.cachedCp_)
     , cachedWidth_(other.cachedWidth_) 
+    , prefetch_(std::move(other.prefetch_))
+    , decoder_(std::move(other.decoder_))
+    , compression_(other.compression_)
+    , ioStats_(other.ioStats_)
+    , push_(other.push_)
+    , pushFinished_(other.pushFinished_)
+    , starved_(other.starved_)
+    , hasMark_(other.hasMark_)
+    , pushHeld_(other.pushHeld_)
+    , pushSniffed_(other.pushSniffed_)
+    , mark_(other.mark_)
 {
     // Reset moved-from object
         other.buffer_.reset();
+        other.window_         = nullptr;
+        other.mapBase_        = nullptr;
+        other.mapLength_      = 0;
+        other.ownsMap_        = false;
+        other.baseOffset_     = 0;
         other.bufferSize_     = 0;
         other.bufferPos_      = 0;
         other.bufferEnd_      = 0;
@@ -51,6 +255,19 @@ BufferedInputStream::BufferedInputStream(BufferedInputStream&& other) noexcept
         other.havePeek_       = false;
         other.cachedCp_       = -1;
         other.cachedWidth_    = 0;
+        other.compression_    = Compression::None;
+        other.ioStats_        = IOStats{};
+        other.push_           = false;
+        other.hasMark_        = false;
+        other.pushHeld_       = 0;
+}
+
+BufferedInputStream::~BufferedInputStream() {
+    prefetch_.reset(); // stops and joins the reader before the stream can go away
+    decoder_.reset();
+    if (mapBase_ && ownsMap_) {
+        ::munmap(mapBase_, mapLength_);
+    }
 }
 
 int32_t BufferedInputStream::getChar() {
@@ -65,11 +282,11 @@ int32_t BufferedInputStream::getChar() {
 
     if (!ensureAtLeast(1)) return -1; // true EOF
 
-    auto r = UTF8Handler::decode(buffer_.get() + bufferPos_, available());
+    auto r = UTF8Handler::decode(window_ + bufferPos_, available());
     if (r.status == UTF8Handler::DecodeStatus::NeedMore) {
         if (!ensureAtLeast(r.width)) 
             return -1; // premature EOF
-        r = UTF8Handler::decode(buffer_.get() + bufferPos_, available());
+        r = UTF8Handler::decode(window_ + bufferPos_, available());
     }
     if (r.status != UTF8Handler::DecodeStatus::Ok) {
         // Policy: treat invalid sequences as EOF for now.
@@ -86,10 +303,10 @@ int32_t BufferedInputStream::peekChar() {
 
     if (!ensureAtLeast(1)) return -1; // true EOF
 
-    auto r = UTF8Handler::decode(buffer_.get() + bufferPos_, available());
+    auto r = UTF8Handler::decode(window_ + bufferPos_, available());
     if (r.status == UTF8Handler::DecodeStatus::NeedMore) {
         if (!ensureAtLeast(r.width)) return -1; // premature EOF
-        r = UTF8Handler::decode(buffer_.get() + bufferPos_, available());
+        r = UTF8Handler::decode(window_ + bufferPos_, available());
     }
     if (r.status != UTF8Handler::DecodeStatus::Ok) {
         // Policy: treat invalid sequences as EOF for now.
@@ -123,100 +340,479 @@ void BufferedInputStream::skipWhitespace() {
 }
 
 bool BufferedInputStream::eof() const {
-    return available()==0 && stream_.eof();
+    if (available() != 0) return false;
+    if (push_) return pushFinished_;
+    if (prefetch_) {
+        std::lock_guard<std::mutex> lk(prefetch_->m);
+        return prefetch_->done && !prefetch_->full;
+    }
+    return stream_ == nullptr || stream_->eof();
+}
+
+bool BufferedInputStream::exhausted() const {
+    if (push_) return pushFinished_;
+    if (!isValid() || isMapped()) return true;
+    if (prefetch_) {
+        std::lock_guard<std::mutex> lk(prefetch_->m);
+        return prefetch_->done && !prefetch_->full;
+    }
+    return stream_ == nullptr || !*stream_;
 }
 
 void BufferedInputStream::advance(std::size_t width) noexcept {
     // Consumes 'width' bytes while maintaining CR/LF and line/column.
-    for (std::size_t i = 0; i < width; ++i) {
-        if (bufferPos_ >= bufferEnd_) break;
-
-        const uint8_t ch = buffer_[bufferPos_++];
-        ++totalBytesRead_;
-
-        if (ch == '\r') {
-            ++currentLine_;
-            currentColumn_ = 1;
-            hasPendingCR_  = true;
-        } else if (ch == '\n') {
-            if (hasPendingCR_) {
-                // CRLF sequence: line already advanced on CR. keep column at 1.
-                hasPendingCR_ = false;
-            } else {
-                ++currentLine_;
-                currentColumn_ = 1;
-            }
-        } else {
-            ++currentColumn_;
-            hasPendingCR_ = false;
+    const std::size_t n = std::min(width, available());
+    trackPositions(window_ + bufferPos_, n);
+    bufferPos_      += n;
+    totalBytesRead_ += n;
+}
+
+/*
+    Position rules (byte columns):
+      CR      -> next line, column 1, remember the CR
+      LF      -> next line, column 1, unless it completes a CRLF (line already advanced)
+      other   -> column + 1
+    So over a range the line delta is #CR + #LF - #CRLF (a CR pending from the
+    previous range counts), and the column is 1 + bytes after the last CR/LF.
+*/
+void BufferedInputStream::trackPositions(const uint8_t* p, std::size_t n) noexcept {
+    if (n == 0) return;
+
+    // Vectorized for long ranges (ByteScan picks AVX2/SSE2/NEON/scalar).
+    const ByteScan::LineScan r = ByteScan::scanLines(p, n, hasPendingCR_);
+
+    currentLine_ += r.lines;
+    if (r.lastBreak == n) {
+        currentColumn_ += n;
+    } else {
+        currentColumn_ = 1 + (n - 1 - r.lastBreak);
+    }
+    hasPendingCR_ = (p[n - 1] == CR);
+}
+
+const uint8_t* BufferedInputStream::peekWindow(std::size_t& len, std::size_t minBytes, bool codePoint) {
+    len = 0;
+    if (!isValid()) return nullptr;
+    if (minBytes == 0) minBytes = 1;
+
+    if (available() < minBytes) {
+        ensureAtLeast(minBytes); // short window at EOF is still returned
+        // Push mode: room for one UTF-8 sequence only has to wait when the
+        // sequence at the cursor is cut off.
+        if (starved_ && codePoint && available() != 0 &&
+            UTF8Handler::decode(window_ + bufferPos_, available()).status != UTF8Handler::DecodeStatus::NeedMore) {
+            starved_ = false;
         }
     }
+    len = available();
+    return len ? window_ + bufferPos_ : nullptr;
+}
+
+void BufferedInputStream::consumeSpan(std::size_t n) noexcept {
+    if (!isValid()) return;
+    havePeek_ = false; // cached code point no longer at the cursor
+    advance(n);
 }
 
 void BufferedInputStream::fillInitialBuffer() {
     bufferPos_ = bufferEnd_ = 0;
-    if (!stream_) return;
+    if (!stream_ || !*stream_) return;
 
-    stream_.read(reinterpret_cast<char*>(buffer_.get()),
-                 static_cast<std::streamsize>(bufferSize_));
-    std::streamsize n = stream_.gcount();
+    stream_->read(reinterpret_cast<char*>(buffer_.get()),
+                  static_cast<std::streamsize>(bufferSize_));
+    std::streamsize n = stream_->gcount();
     if (n > 0) {
         bufferPos_ = 0;
         bufferEnd_ = static_cast<std::size_t>(n);
+        ioStats_.bytesRead += bufferEnd_;
     }
 }
 
 
 void BufferedInputStream::detectEncoding() {
-    // Only UTF-8/UTF-8 BOM supported; if BOM present, skip it.
-    if (bufferEnd_ - bufferPos_ >= 3) {
-        const uint8_t* p = buffer_.get() + bufferPos_;
-        if (p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
-            encoding_ = Encoding::UTF8;
-            bomSize_  = 3;
-
-            // Skip BOM WITHOUT affecting line/column or CR state.
-            bufferPos_      += 3;
-            totalBytesRead_ += 3;
-
-            // Any previously cached peek is now stale.
-            havePeek_    = false;
-            cachedCp_    = -1;
-            cachedWidth_ = 0;
-            return;
-        }   
-    } 
+    size_t bom = 0;
+    const Encoding enc = sniffEncoding(window_ + bufferPos_, bufferEnd_ - bufferPos_, bom);
+    if (enc == Encoding::UTF8) {
+        encoding_ = Encoding::UTF8;
+        bomSize_  = 3;
+
+        // Skip BOM WITHOUT affecting line/column or CR state.
+        bufferPos_      += 3;
+        totalBytesRead_ += 3;
+
+        // Any previously cached peek is now stale.
+        havePeek_    = false;
+        cachedCp_    = -1;
+        cachedWidth_ = 0;
+        return;
+    }
+    // A mapping is never UTF-16/32 here: CreateMapped() routes those through a stream.
+    if (enc != Encoding::UTF8_NO_BOM && stream_) transcodeFrom(enc, bom);
+}
+
+void BufferedInputStream::transcodeFrom(Encoding enc, size_t bom) {
+    if (!decoder_) decoder_ = std::make_unique<Decoder>();
+    decoder_->transcode = std::make_unique<TranscodingStreamBuf>(
+        *stream_, enc, window_ + bufferPos_ + bom, bufferEnd_ - bufferPos_ - bom);
+    decoder_->outer.rdbuf(decoder_->transcode.get());
+    stream_   = &decoder_->outer;
+    encoding_ = enc;
+    fillInitialBuffer(); // the BOM was dropped before transcoding, so nothing to skip
+}
+
+BufferedInputStream::Encoding BufferedInputStream::sniffEncoding(const uint8_t* p, size_t n, size_t& bomSize) noexcept {
+    bomSize = 0;
+    if (n >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) { bomSize = 3; return Encoding::UTF8; }
+    if (n >= 4) {
+        if (p[0] == 0xFF && p[1] == 0xFE && p[2] == 0x00 && p[3] == 0x00) { bomSize = 4; return Encoding::UTF32_LE; }
+        if (p[0] == 0x00 && p[1] == 0x00 && p[2] == 0xFE && p[3] == 0xFF) { bomSize = 4; return Encoding::UTF32_BE; }
+    }
+    if (n >= 2) {
+        if (p[0] == 0xFF && p[1] == 0xFE) { bomSize = 2; return Encoding::UTF16_LE; }
+        if (p[0] == 0xFE && p[1] == 0xFF) { bomSize = 2; return Encoding::UTF16_BE; }
+    }
+    // No BOM: a document starts with '<' (optionally after whitespace, which we
+    // do not chase), and its first unit gives the width and byte order away.
+    if (n >= 4) {
+        if (p[0] == 0x3C && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x00) return Encoding::UTF32_LE;
+        if (p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x3C) return Encoding::UTF32_BE;
+        if (p[0] == 0x3C && p[1] == 0x00 && p[3] == 0x00) return Encoding::UTF16_LE;
+        if (p[0] == 0x00 && p[1] == 0x3C && p[2] == 0x00) return Encoding::UTF16_BE;
+    }
+    return Encoding::UTF8_NO_BOM;
+}
+
+BufferedInputStream::Compression BufferedInputStream::detectCompression(const uint8_t* p, size_t n) noexcept {
+    if (n >= 2 && p[0] == 0x1F && p[1] == 0x8B) return Compression::Gzip;
+    if (n >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F && p[3] == 0xFD) return Compression::Zstd;
+    return Compression::None;
+}
+
+bool BufferedInputStream::sourceFailed() const noexcept {
+    return decoder_ && decoder_->failed();
+}
+
+bool BufferedInputStream::setPosition(uint64_t byteOffset, size_t line, size_t column) noexcept {
+    if (!isValid() || getTotalBytesRead() != baseOffset_) return false;
+    baseOffset_     = byteOffset;
+    totalBytesRead_ = static_cast<size_t>(byteOffset) + bomSize_;
+    currentLine_    = line;
+    currentColumn_  = column;
+    hasPendingCR_   = false;
+    return true;
+}
+
+bool BufferedInputStream::rebind(std::istream& stream, StateError* err) {
+    if (!buffer_ || isMapped() || prefetch_ || push_) {
+        if (err) *err = StateError::NotRebindable;
+        return false;
+    }
+    decoder_.reset();            // layers of the previous source (inflate, transcoder)
+    stream_         = &stream;
+    window_         = buffer_.get();
+    baseOffset_     = 0;
+    currentLine_    = 1;
+    currentColumn_  = 1;
+    totalBytesRead_ = 0;
+    encoding_       = Encoding::UTF8_NO_BOM;
+    bomSize_        = 0;
+    hasPendingCR_   = false;
+    havePeek_       = false;
+    cachedCp_       = -1;
+    cachedWidth_    = 0;
+    compression_    = Compression::None;
+    try {
+        fillInitialBuffer();
+        detectEncoding();        // may add a transcoder
+    } catch (const std::bad_alloc&) {
+        bufferPos_ = bufferEnd_ = 0; // reads as empty input
+        if (err) *err = StateError::OutOfMemory;
+        return false;
+    }
+    if (err) *err = StateError::None;
+    return true;
+}
+
+std::unique_ptr<BufferedInputStream> BufferedInputStream::CreatePush(size_t capacity, StateError* err) {
+    if (!checkBufferSize(capacity, err)) return nullptr;
+    try {
+        auto p = std::unique_ptr<BufferedInputStream>(new BufferedInputStream(PushTag{}, capacity));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+// Fed bytes are appended after bufferEnd_ (after the held ones before the BOM
+// check). Room is made by dropping what lies before both the cursor and the
+// mark, then by doubling the buffer; bytes from the mark on are kept so the
+// tokenizer can rewind to the start of the token it is retrying.
+bool BufferedInputStream::feed(const uint8_t* data, size_t len, StateError* err) {
+    if (err) *err = StateError::None;
+    if (!push_ || pushFinished_) return false;
+    if (len == 0) return true;
+
+    if (bufferSize_ - (bufferEnd_ + pushHeld_) < len) {
+        const size_t keep = hasMark_ ? std::min(mark_.pos, bufferPos_) : bufferPos_;
+        const size_t live = bufferEnd_ + pushHeld_ - keep;
+        if (bufferSize_ - live < len) {
+            const size_t need = live + len;
+            if (need > kMaxBufferSize) {
+                if (err) *err = StateError::OutOfMemory;
+                return false;
+            }
+            const size_t size = std::min(kMaxBufferSize, std::max(need, bufferSize_ * 2));
+            try {
+                std::unique_ptr<uint8_t[]> bigger(new uint8_t[size]);
+                std::memcpy(bigger.get(), buffer_.get() + keep, live);
+                buffer_ = std::move(bigger);
+            } catch (const std::bad_alloc&) {
+                if (err) *err = StateError::OutOfMemory;
+                return false;
+            }
+            bufferSize_ = size;
+            window_ = buffer_.get();
+        } else if (keep > 0) {
+            std::memmove(buffer_.get(), buffer_.get() + keep, live);
+        }
+        ioStats_.bytesMoved += live;
+        bufferPos_ -= keep;
+        bufferEnd_ -= keep;
+        mark_.pos  -= std::min(mark_.pos, keep);
+    }
+
+    std::memcpy(buffer_.get() + bufferEnd_ + pushHeld_, data, len);
+    ioStats_.bytesRead += len;
+    starved_ = false;
+    if (pushSniffed_) {
+        bufferEnd_ += len;
+        return true;
+    }
+    pushHeld_ += len;
+    // Held until the first bytes are known not to start a UTF-8 BOM (or are one).
+    static const uint8_t kBom[3] = {0xEF, 0xBB, 0xBF};
+    if (pushHeld_ >= 3 || std::memcmp(buffer_.get(), kBom, pushHeld_) != 0) releaseHeld();
+    return true;
+}
+
+void BufferedInputStream::releaseHeld() noexcept {
+    pushSniffed_ = true;
+    bufferEnd_ += pushHeld_;
+    pushHeld_ = 0;
+    const uint8_t* p = buffer_.get();
+    if (bufferEnd_ >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+        encoding_       = Encoding::UTF8;
+        bomSize_        = 3;
+        bufferPos_     += 3;
+        totalBytesRead_ += 3;
+        mark_.pos       = bufferPos_;
+        mark_.total     = totalBytesRead_;
+    }
+}
+
+void BufferedInputStream::finish() noexcept {
+    if (!push_) return;
+    if (!pushSniffed_) releaseHeld();
+    pushFinished_ = true;
+    starved_ = false;
+}
+
+void BufferedInputStream::setMark() noexcept {
+    if (!push_) return;
+    mark_ = PushMark{bufferPos_, currentLine_, currentColumn_, totalBytesRead_, hasPendingCR_};
+    hasMark_ = true;
+    starved_ = false;
+}
+
+void BufferedInputStream::rewindToMark() noexcept {
+    if (!hasMark_) return;
+    bufferPos_      = mark_.pos;
+    currentLine_    = mark_.line;
+    currentColumn_  = mark_.column;
+    totalBytesRead_ = mark_.total;
+    hasPendingCR_   = mark_.pendingCR;
+    havePeek_       = false;
+    starved_        = false;
 }
 
 bool BufferedInputStream::isValid() const noexcept 
 {
     // no need to check stream_.good() since it is not related to object validity, it is data state. 
-    return  buffer_ != nullptr && bufferSize_ > 0;
+    // window_ is buffer_.get() in stream mode and the mapping (or a static empty byte) in mapped mode.
+    return  window_ != nullptr;
 }
 
-std::unique_ptr<BufferedInputStream> BufferedInputStream::Create(std::istream& stream,
-                            size_t bufferSize,
-                            StateError* err)
+bool BufferedInputStream::checkBufferSize(size_t bufferSize, StateError* err) noexcept
 {
     if (bufferSize == 0) {
         if (err) *err = StateError::ZeroBufferSize;
-        return nullptr;
+        return false;
     }
 
     if (bufferSize < 4) { // Buffer must be at least 4 bytes so we can read a full UTF-8 character
         if (err) *err = StateError::BufferTooSmall;
-        return nullptr;
+        return false;
     }
 
     //we can't trust try/catch to catch huge allocations since ASan would catch them before any new happens
     if (bufferSize > kMaxBufferSize) {
+        if (err) *err = StateError::OutOfMemory;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<BufferedInputStream> BufferedInputStream::Create(std::istream& stream,
+                            size_t bufferSize,
+                            StateError* err)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
+
+    try {
+        auto p = std::unique_ptr<BufferedInputStream>(
+            new BufferedInputStream(stream, bufferSize));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
         if (err) *err = StateError::OutOfMemory;
         return nullptr;
     }
+}
+
+std::unique_ptr<BufferedInputStream> BufferedInputStream::CreatePrefetched(std::istream& stream,
+                            size_t bufferSize,
+                            StateError* err)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
 
     try {
+        // Initial fill and BOM detection run synchronously in the constructor;
+        // the reader starts on the following buffer.
         auto p = std::unique_ptr<BufferedInputStream>(
             new BufferedInputStream(stream, bufferSize));
+        p->prefetch_ = std::make_unique<Prefetcher>(p->stream_, bufferSize); // may be a transcoder
+        p->prefetch_->start();
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    } catch (const std::system_error&) { // std::thread could not be started
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<BufferedInputStream> BufferedInputStream::CreateDecompressed(std::istream& source,
+                            size_t bufferSize,
+                            bool prefetch,
+                            StateError* err)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
+
+    try {
+        auto dec = std::make_unique<Decoder>();
+        dec->inflate = std::make_unique<DecompressingStreamBuf>(source);
+        if (!dec->inflate->open()) {
+            if (err) *err = DecompressingStreamBuf::supports(dec->inflate->detected())
+                            ? StateError::OutOfMemory : StateError::UnsupportedCompression;
+            return nullptr;
+        }
+        dec->inner.rdbuf(dec->inflate.get());
+        const Compression detected = dec->inflate->detected();
+        // The constructor's initial fill (and BOM check) already reads decoded bytes.
+        std::istream& decoded = dec->inner;
+        auto p = std::unique_ptr<BufferedInputStream>(
+            new BufferedInputStream(decoded, bufferSize, std::move(dec)));
+        p->compression_ = detected;
+        if (prefetch) {
+            p->prefetch_ = std::make_unique<Prefetcher>(p->stream_, bufferSize);
+            p->prefetch_->start();
+        }
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    } catch (const std::system_error&) { // std::thread could not be started
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<BufferedInputStream> BufferedInputStream::CreateMapped(const std::string& path,
+                            StateError* err)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (err) *err = StateError::OpenFailed;
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        if (err) *err = StateError::OpenFailed;
+        return nullptr;
+    }
+
+    const size_t length = static_cast<size_t>(st.st_size);
+    void* base = nullptr;
+    if (length > 0) {
+        base = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            if (err) *err = StateError::MapFailed;
+            return nullptr;
+        }
+        // Advisory only; a failure here does not affect correctness.
+        (void)::madvise(base, length, MADV_SEQUENTIAL);
+    }
+    ::close(fd); // the mapping keeps its own reference to the file
+
+    size_t bom = 0;
+    const Encoding enc = sniffEncoding(static_cast<const uint8_t*>(base), length, bom);
+    if (TranscodingStreamBuf::supports(enc)) {
+        bool handedOver = false;
+        try {
+            auto dec = std::make_unique<Decoder>();
+            dec->map = base; // unmapped by the Decoder from here on
+            dec->mapLength = length;
+            handedOver = true;
+            dec->mapped = std::make_unique<MemoryStreamBuf>(base, length);
+            dec->inner.rdbuf(dec->mapped.get());
+            std::istream& raw = dec->inner;
+            auto p = std::unique_ptr<BufferedInputStream>(
+                new BufferedInputStream(raw, std::min(length * 2 + 16, kMappedTranscodeBuffer), std::move(dec)));
+            if (err) *err = StateError::None;
+            return p;
+        } catch (const std::bad_alloc&) {
+            if (!handedOver) ::munmap(base, length);
+            if (err) *err = StateError::OutOfMemory;
+            return nullptr;
+        }
+    }
+
+    try {
+        auto p = std::unique_ptr<BufferedInputStream>(new BufferedInputStream(base, length));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (base) ::munmap(base, length);
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<BufferedInputStream> BufferedInputStream::CreateView(const uint8_t* data, size_t length,
+                            uint64_t byteOffset, StateError* err)
+{
+    try {
+        // The window is read-only; mapBase_ is only non-const for munmap(), which views skip.
+        void* base = length ? const_cast<uint8_t*>(data) : nullptr;
+        auto p = std::unique_ptr<BufferedInputStream>(new BufferedInputStream(base, length, false, byteOffset));
         if (err) *err = StateError::None;
         return p;
     } catch (const std::bad_alloc&) {
@@ -229,6 +825,13 @@ bool BufferedInputStream::ensureAtLeast(std::size_t n)
 {
     if (!isValid()) return false;
     if (available() >= n) return true;
+    if (push_) {
+        starved_ = !pushFinished_; // the caller has to feed() more first
+        return false;
+    }
+    if (isMapped() || !stream_) return false; // the mapping is the whole file; nothing to refill
+    ++ioStats_.refills;
+    if (prefetch_) return refillFromPrefetcher(n);
 
     /* Compact existing unread bytes to the front if needed/possible.
        Most OS reads want a single contiguous destination. If we keep the unread 
@@ -240,6 +843,7 @@ bool BufferedInputStream::ensureAtLeast(std::size_t n)
     if (bufferPos_ > 0 && bufferPos_ < bufferEnd_) {
         const std::size_t unread = bufferEnd_ - bufferPos_;
         std::memmove(buffer_.get(), buffer_.get() + bufferPos_, unread);
+        ioStats_.bytesMoved += unread;
         bufferPos_ = 0;
         bufferEnd_ = unread;
     } else if (bufferPos_ == bufferEnd_) {
@@ -248,18 +852,74 @@ bool BufferedInputStream::ensureAtLeast(std::size_t n)
 
     // Read until either enough bytes are available or no more data arrives.
     while (available() < n) {
-        if (!stream_) break;
+        if (!*stream_) break;
         const std::size_t room = bufferSize_ - bufferEnd_;
         if (room == 0) break; // no space left; caller asked for > bufferSize_
-        stream_.read(reinterpret_cast<char*>(buffer_.get() + bufferEnd_),
-                     static_cast<std::streamsize>(room));
-        const std::streamsize got = stream_.gcount();
+        stream_->read(reinterpret_cast<char*>(buffer_.get() + bufferEnd_),
+                      static_cast<std::streamsize>(room));
+        const std::streamsize got = stream_->gcount();
         if (got <= 0) break;
         bufferEnd_ += static_cast<std::size_t>(got);
+        ioStats_.bytesRead += static_cast<uint64_t>(got);
     }
 
     return available() >= n;
 }
 
+// Swaps in the reader's buffer once it is ready. The unread tail (at most a split
+// code point for getChar/peekChar) is copied into the headroom in front of the
+// fresh data, so line/column and pending-CR state carry over untouched.
+// A tail larger than the headroom falls back to draining the back buffer into the
+// front one, which keeps the contract for any n <= bufferSize_.
+bool BufferedInputStream::refillFromPrefetcher(std::size_t n)
+{
+    Prefetcher& pf = *prefetch_;
+
+    while (available() < n) {
+        {
+            std::unique_lock<std::mutex> lk(pf.m);
+            pf.cv.wait(lk, [&pf] { return pf.full || pf.done; });
+            if (!pf.full) break; // reader finished; nothing more will arrive
+        }
+
+        const std::size_t unread = available();
+        uint8_t* back = pf.back.get();
+        bool drained = false;
+
+        if (unread <= pf.backPos) {
+            const std::size_t start = pf.backPos - unread;
+            std::memcpy(back + start, window_ + bufferPos_, unread);
+            ioStats_.bytesMoved += unread;
+            ioStats_.bytesRead  += pf.backEnd - pf.backPos;
+            std::swap(buffer_, pf.back);
+            window_    = buffer_.get();
+            bufferPos_ = start;
+            bufferEnd_ = pf.backEnd;
+            drained    = true;
+        } else {
+            std::memmove(buffer_.get(), window_ + bufferPos_, unread);
+            ioStats_.bytesMoved += unread;
+            bufferPos_ = 0;
+            bufferEnd_ = unread;
+            const std::size_t take = std::min(bufferSize_ - bufferEnd_, pf.backEnd - pf.backPos);
+            if (take == 0) break; // caller asked for > bufferSize_
+            std::memcpy(buffer_.get() + bufferEnd_, back + pf.backPos, take);
+            bufferEnd_ += take;
+            ioStats_.bytesRead += take;
+            pf.backPos += take;
+            drained     = (pf.backPos == pf.backEnd);
+        }
+
+        if (drained) {
+            {
+                std::lock_guard<std::mutex> lk(pf.m);
+                pf.full = false;
+            }
+            pf.cv.notify_all();
+        }
+    }
+
+    return available() >= n;
+}
 
 } // namespace LXMLFormatter
\ No newline at end of file
@@ -21,14 +21,34 @@ public:
         UTF16_BE,     // UTF-16 Big Endian
         UTF32_LE,     // UTF-32 Little Endian
         UTF32_BE      // UTF-32 Big Endian
-        // Note: Currently only UTF-8 variants are implemented
+        // UTF-16/32 input is transcoded to UTF-8 on the way in (TranscodingStreamBuf):
+        // the window, tokens and byte offsets are all in terms of the UTF-8 text.
+    };
+
+    // Compressed containers recognised by their magic bytes (see CreateDecompressed).
+    enum class Compression {
+        None,
+        Gzip,         // 1F 8B
+        Zstd          // 28 B5 2F FD
     };
 
     enum class StateError {
         None,
         ZeroBufferSize,
         BufferTooSmall,
-        OutOfMemory
+        OutOfMemory,
+        OpenFailed,   // CreateMapped: file could not be opened or stat'ed
+        MapFailed,    // CreateMapped: mmap() rejected the file
+        UnsupportedCompression, // CreateDecompressed: format not compiled in
+        NotRebindable // rebind(): mapped, prefetching or push instance
+    };
+
+    // Window refill counters (stream and prefetch modes; always zero when mapped).
+    // Kept on the cold refill path only, so they are always collected.
+    struct IOStats {
+        uint64_t refills    = 0; // ensureAtLeast() calls that had to pull more input
+        uint64_t bytesRead  = 0; // bytes copied into the window from the source/reader
+        uint64_t bytesMoved = 0; // unread tail bytes memmove'd/copied during compaction
     };
 
     // Character constants to avoid signed/unsigned comparison issues
@@ -39,16 +59,81 @@ public:
     static constexpr std::size_t kMaxBufferSize = (1ull << 28); //256MB buffer cap
 
     static std::unique_ptr<BufferedInputStream> Create(std::istream& stream, size_t bufferSize, StateError* err = nullptr);
+
+    // Maps the whole file read-only and exposes the mapping as the buffer itself:
+    // no istream copy, no compaction, refills are page faults (MADV_SEQUENTIAL).
+    // Same getChar()/peekChar()/readWhile() contract and line/column tracking.
+    // A UTF-16/32 file cannot be exposed as UTF-8 in place: it is still mapped,
+    // but read through a transcoder into a buffer, and isMapped() is false.
+    static std::unique_ptr<BufferedInputStream> CreateMapped(const std::string& path, StateError* err = nullptr);
+
+    // Like Create(), but a background reader fills a second buffer of the same size
+    // while the caller consumes the current one; buffers are swapped inside
+    // ensureAtLeast(), so I/O wait overlaps with parsing. Unread tail bytes
+    // (split UTF-8 sequences) are carried across the swap.
+    // The stream must not be touched by anyone else while this instance is alive.
+    static std::unique_ptr<BufferedInputStream> CreatePrefetched(std::istream& stream, size_t bufferSize, StateError* err = nullptr);
+
+    // Like CreatePrefetched() (or Create() with prefetch = false), but the source
+    // may be gzip or zstd compressed: the format is detected from its first bytes
+    // and decoded straight into the buffer, on the reader thread when prefetching.
+    // Plain input passes through unchanged. The source must outlive the instance.
+    static std::unique_ptr<BufferedInputStream> CreateDecompressed(std::istream& source, size_t bufferSize,
+                                                                   bool prefetch = true, StateError* err = nullptr);
+
+    // Mapped-mode view of caller memory, e.g. one chunk of another instance's
+    // mappedContent(). Nothing is owned or copied, and no BOM is looked for.
+    // Byte offsets start at 'byteOffset' so they stay document-absolute; line and
+    // column count from 1 at the start of the view.
+    static std::unique_ptr<BufferedInputStream> CreateView(const uint8_t* data, size_t length, uint64_t byteOffset = 0, StateError* err = nullptr);
+
+    // Push mode, for event loops that receive the input in pieces: there is no
+    // source to pull from; the caller feed()s bytes as they arrive and finish()es
+    // at the end. A read that needs bytes not fed yet stops as at EOF and sets
+    // starved(); XMLTokenizer turns that into needMoreInput() and retries the token
+    // after the next feed(). UTF-8 only (a UTF-8 BOM is skipped). 'capacity' is the
+    // initial buffer; it grows to hold the unread bytes plus the token in progress.
+    static std::unique_ptr<BufferedInputStream> CreatePush(size_t capacity = 64 * 1024, StateError* err = nullptr);
+
+    // Push mode: appends 'len' bytes. False after finish(), on a non-push instance,
+    // or if the buffer cannot grow (OutOfMemory in *err); nothing is appended then.
+    // The window may move: slices of it (InputSlice tokens) are invalidated.
+    bool feed(const uint8_t* data, size_t len, StateError* err = nullptr);
+
+    // Push mode: no more input; EOF is real from now on.
+    void finish() noexcept;
+
+    bool isPush() const noexcept { return push_; }
+    bool finished() const noexcept { return pushFinished_; }
+
+    // Push mode: the last read stopped at the end of the bytes fed so far, before finish().
+    bool starved() const noexcept { return starved_; }
+
+    // Push mode: setMark() pins the cursor (a token start) so feed() keeps the bytes
+    // from there on; rewindToMark() moves the cursor, line and column back to it.
+    void setMark() noexcept;
+    void rewindToMark() noexcept;
+
+    // Points a stream-mode instance (Create(), or CreateDecompressed() without
+    // prefetch) at a new source and starts over: position, encoding and BOM
+    // detection reset, and the buffer (its size, no reallocation) is reused.
+    // The new source is read as plain text (UTF-16/32 is still transcoded);
+    // compression is not looked for. Counters in ioStats() keep accumulating.
+    // Mapped, prefetching and push instances return false (NotRebindable) and are unchanged.
+    bool rebind(std::istream& stream, StateError* err = nullptr);
+
     // Delete copy operations
     BufferedInputStream(const BufferedInputStream&) = delete;
     BufferedInputStream& operator=(const BufferedInputStream&) = delete;
     
-    // Enable move constructor only (stream_ is a reference, can't be reseated)
+    // Enable move constructor only (ownership of buffer/mapping is transferred)
     BufferedInputStream(BufferedInputStream&& other) noexcept;
     
     // Delete move assignment (can't reassign const members or references)
     BufferedInputStream& operator=(BufferedInputStream&&) = delete;
 
+    ~BufferedInputStream();
+
     // Reads the next Unicode scalar value as int32_t.
     // Returns: Unicode codepoint (>= 0)
     //          treats any invalid sequence as EOF (-1)
@@ -59,6 +144,23 @@ public:
     // Returns -1 on EOF.
     int32_t peekChar();
 
+    // Zero-copy access to the raw bytes at the cursor.
+    // Returns the contiguous unread window and sets 'len' to its size, refilling
+    // first if fewer than 'minBytes' are available (fewer are returned only at EOF).
+    // Returns nullptr and len=0 at EOF. The pointer is valid until the next call
+    // that may refill (getChar/peekChar/readWhile/readUntil/skipWhitespace/peekSpan).
+    const uint8_t* peekSpan(std::size_t& len, std::size_t minBytes = 1) { return peekWindow(len, minBytes, false); }
+
+    // peekSpan(len, 4) for a caller about to decode: room for one full UTF-8
+    // sequence. In push mode it only sets starved() when the sequence at the cursor
+    // is cut off, not whenever fewer than 4 bytes were fed.
+    const uint8_t* peekCodePointSpan(std::size_t& len) { return peekWindow(len, 4, true); }
+
+    // Consumes 'n' bytes of the window returned by peekSpan() (clamped to what is
+    // available) with one bulk line/column update. Callers should stop on a code
+    // point boundary; bytes are not decoded or validated here.
+    void consumeSpan(std::size_t n) noexcept;
+
     // Read UTF-8 string until condition is met
     template<typename Predicate>
     void readWhile(std::string& out, Predicate pred);
@@ -71,16 +173,93 @@ public:
 
     bool eof() const;
 
+    // True when no input exists beyond the current window, i.e. peekSpan() cannot
+    // grow it any further (mapped input, or the source has hit EOF).
+    bool exhausted() const;
+
     size_t getCurrentLine() const { return currentLine_; }
     size_t getCurrentColumn() const { return currentColumn_; }
     size_t getTotalBytesRead() const { return totalBytesRead_ - bomSize_; }
+
+    // Source encoding, from the BOM or (without one) the first '<' (XML 1.0 App. F).
     Encoding getEncoding() const { return encoding_; }
+    Compression getCompression() const noexcept { return compression_; }
+
+    // True if compressed input turned out corrupt or truncated, or UTF-16/32 input
+    // held an invalid code unit; reading stopped there, so the consumer saw an early EOF.
+    bool sourceFailed() const noexcept;
 
-    // Returns true if the instance has a live buffer and positive capacity.
+    // Format of data starting with p[0..n); None if no known magic is present.
+    static Compression detectCompression(const uint8_t* p, size_t n) noexcept;
+
+    // Encoding of a document starting with p[0..n): a BOM (UTF-32 is checked before
+    // UTF-16, so FF FE 00 00 is UTF-32LE) or, without one, the byte pattern of '<'.
+    // 'bomSize' receives the BOM length (0 if none). UTF8_NO_BOM if nothing matched.
+    static Encoding sniffEncoding(const uint8_t* p, size_t n, size_t& bomSize) noexcept;
+
+    // True if the window is a read-only file mapping (see CreateMapped).
+    bool isMapped() const noexcept { return mapBase_ != nullptr; }
+
+    // Mapped mode: the whole document after any BOM (or the whole view), so
+    // data[getTotalBytesRead() - baseOffset()] (or data[token.byteOffset - baseOffset()])
+    // is the byte at that position. Lets callers copy raw input spans without going
+    // through the window. nullptr/0 when not mapped.
+    const uint8_t* mappedContent(size_t& len) const noexcept {
+        if (!mapBase_) { len = 0; return nullptr; }
+        len = mapLength_ - bomSize_;
+        return static_cast<const uint8_t*>(mapBase_) + bomSize_;
+    }
+
+    // Byte offset of the first byte of the input (non-zero for views and after setPosition()).
+    uint64_t baseOffset() const noexcept { return baseOffset_; }
+
+    // Numbers the cursor as 'byteOffset', 'line', 'column' of a larger document,
+    // for input that starts in the middle of one (a view, or a stream seeked to a
+    // TokenizerCheckpoint). Only before anything has been consumed; false otherwise.
+    bool setPosition(uint64_t byteOffset, size_t line, size_t column) noexcept;
+
+    // Refill/compaction counters since construction.
+    const IOStats& ioStats() const noexcept { return ioStats_; }
+
+    // True if a background reader feeds this instance (see CreatePrefetched).
+    bool isPrefetched() const noexcept { return prefetch_ != nullptr; }
+
+    // Returns true if the instance has a live buffer (or mapping) to read from.
     bool isValid() const noexcept;
     
 private:
-    BufferedInputStream(std::istream& stream, size_t bufferSize = 10 * 1024 * 1024);
+    const uint8_t* peekWindow(std::size_t& len, std::size_t minBytes, bool codePoint);
+
+    // Decoding layers between the caller's source and the window (compression,
+    // transcoding, a mapped UTF-16/32 file); defined in the .cpp.
+    struct Decoder;
+
+    // 'decoder' owns the layers 'stream' belongs to, if any; detectEncoding() may
+    // add a transcoding layer on top.
+    BufferedInputStream(std::istream& stream, size_t bufferSize = 10 * 1024 * 1024,
+                        std::unique_ptr<Decoder> decoder = nullptr);
+
+    // Mapped mode: 'base' of 'length' bytes is owned (munmap'ed in the dtor) unless
+    // 'ownsMap' is false (views). 'base' may be nullptr for an empty file.
+    BufferedInputStream(void* base, size_t length, bool ownsMap = true, uint64_t byteOffset = 0);
+
+    // Push mode (CreatePush): an empty buffer of 'capacity' bytes and no source.
+    struct PushTag {};
+    BufferedInputStream(PushTag, size_t capacity);
+
+    // Push mode: makes the bytes held back for the BOM check readable.
+    void releaseHeld() noexcept;
+
+    // Shared size validation for the stream-backed factories.
+    static bool checkBufferSize(size_t bufferSize, StateError* err) noexcept;
+
+    // Background reader state (defined in the .cpp). Owns the back buffer and the
+    // thread; kept behind a pointer so the move constructor stays valid while the
+    // reader runs.
+    struct Prefetcher;
+
+    // Prefetch-mode counterpart of the refill loop in ensureAtLeast().
+    bool refillFromPrefetcher(std::size_t n);
 
     // Number of bytes available from bufferPos_ to bufferEnd_.
     inline std::size_t available() const noexcept { return bufferEnd_ - bufferPos_; }
@@ -92,13 +271,25 @@ private:
     // Advances bufferPos_ by 'width' bytes; updates line/column and CR/LF.
     void advance(std::size_t width) noexcept;
 
+    // Bulk line/column/CR bookkeeping for n bytes at p (does not move bufferPos_).
+    void trackPositions(const uint8_t* p, std::size_t n) noexcept;
+
     // Initial read and BOM detection. Assumes buffer is empty on entry.
     void fillInitialBuffer();
     void detectEncoding();
 
-    std::istream& stream_;
+    // Stream mode: reroutes the source through a TranscodingStreamBuf from 'enc'
+    // (the unread window bytes after 'bom' are handed over) and refills the window.
+    void transcodeFrom(Encoding enc, size_t bom);
+
+    std::istream* stream_;        // nullptr in mapped mode
     size_t bufferSize_;
     std::unique_ptr<uint8_t[]> buffer_;
+    const uint8_t* window_;       // read window: buffer_.get() or the mapping
+    void*  mapBase_;              // mmap base (mapped mode only)
+    size_t mapLength_;
+    bool   ownsMap_;              // false for views (CreateView)
+    uint64_t baseOffset_;         // byte offset of window_[0] (views)
     size_t bufferPos_;
     size_t bufferEnd_;
     size_t currentLine_;
@@ -110,6 +301,26 @@ private:
     bool    havePeek_;
     int32_t cachedCp_;     // next code point
     size_t  cachedWidth_;  // number of bytes it spans in the buffer
+    std::unique_ptr<Prefetcher> prefetch_; // null unless CreatePrefetched
+    std::unique_ptr<Decoder>    decoder_;  // null unless decompressing or transcoding
+    Compression compression_ = Compression::None;
+    IOStats     ioStats_{};
+
+    // Push mode state (CreatePush).
+    struct PushMark {
+        size_t pos = 0;
+        size_t line = 1;
+        size_t column = 1;
+        size_t total = 0;
+        bool   pendingCR = false;
+    };
+    bool     push_ = false;
+    bool     pushFinished_ = false;
+    bool     starved_ = false;
+    bool     hasMark_ = false;
+    size_t   pushHeld_ = 0;   // bytes fed past bufferEnd_ but held until the BOM check
+    bool     pushSniffed_ = false;
+    PushMark mark_{};
 };
 
 
@@ -122,33 +333,37 @@ void BufferedInputStream::readWhile(std::string& out, Predicate pred) {
             if (!ensureAtLeast(1)) break; // true EOF
         }
 
-        // Remember start of contiguous window in the current buffer snapshot.
-        const std::size_t start = bufferPos_;
-
-        // Consume as long as predicate accepts the decoded code points,
-        // but do not cross a refill boundary inside this inner loop.
-        while (bufferPos_ < bufferEnd_) {
-            auto r = UTF8Handler::decode(buffer_.get() + bufferPos_, available());
-            if (r.status == UTF8Handler::DecodeStatus::NeedMore) break;         // refill outside
-            if (r.status != UTF8Handler::DecodeStatus::Ok) break;               // stop on invalid
-            if (!pred(r.cp)) break;                                // stop when predicate fails
-            advance(r.width);                                      // consume bytes and update position
+        // Scan the contiguous window; consumption is applied in bulk afterwards.
+        const uint8_t* base  = window_ + bufferPos_;
+        const std::size_t n  = available();
+        std::size_t i        = 0;
+        std::size_t needMore = 0;     // width of a sequence cut off by the window end
+        bool stop            = false; // predicate rejected or invalid sequence
+
+        while (i < n) {
+            const uint8_t b = base[i];
+            if (b < 0x80) {           // ASCII: no decode needed
+                if (!pred(static_cast<int32_t>(b))) { stop = true; break; }
+                ++i;
+                continue;
+            }
+            auto r = UTF8Handler::decode(base + i, n - i);
+            if (r.status == UTF8Handler::DecodeStatus::NeedMore) { needMore = r.width; break; }
+            if (r.status != UTF8Handler::DecodeStatus::Ok) { stop = true; break; } // stop on invalid
+            if (!pred(static_cast<int32_t>(r.cp))) { stop = true; break; }
+            i += r.width;
         }
 
-        // Append what was consumed in this window.
-        out.append(reinterpret_cast<const char*>(buffer_.get() + start),
-                    static_cast<std::size_t>(bufferPos_ - start));
-
-        // If we stopped because predicate failed or an invalid sequence was seen, exit.
-        if (bufferPos_ < bufferEnd_) {
-            auto r2 = UTF8Handler::decode(buffer_.get() + bufferPos_, available());
-            if (r2.status == UTF8Handler::DecodeStatus::Ok && !pred(r2.cp)) break;
-            if (r2.status == UTF8Handler::DecodeStatus::Invalid) break;
-            // Otherwise r2 == NeedMore -> outer loop will refill.
-        } else {
-            // Buffer exhausted; loop will attempt to refill.
-            continue;
+        // Append what was consumed in this window, then consume it.
+        out.append(reinterpret_cast<const char*>(base), i);
+        if (i) {
+            havePeek_ = false;
+            advance(i);
         }
+
+        if (stop) break;
+        // Split sequence: refill so it is contiguous; at EOF it is a truncated sequence.
+        if (needMore && !ensureAtLeast(needMore)) break;
     }
 }
 
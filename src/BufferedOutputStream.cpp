@@ -0,0 +1,292 @@
+#include "BufferedOutputStream.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#include <cerrno>
+#include <algorithm>
+
+namespace LXMLFormatter {
+
+namespace {
+#ifdef IOV_MAX
+    constexpr int kIovBatch = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+    constexpr int kIovBatch = 16; // _XOPEN_IOV_MAX
+#endif
+}
+
+BufferedOutputStream::BufferedOutputStream(std::ostream* stream, int fd, bool ownsFd, size_t bufferSize, bool direct,
+                                           std::string* str)
+    : stream_(stream)
+    , string_(str)
+    , fd_(fd)
+    , ownsFd_(ownsFd)
+    , buf_(new char[bufferSize + (direct ? kDirectAlign : 0)])
+    , cap_(bufferSize)
+    , refsEnabled_(fd >= 0 && !direct)
+    , direct_(direct)
+{
+    base_ = buf_.get();
+    if (direct) {
+        const auto addr = reinterpret_cast<std::uintptr_t>(base_);
+        base_ += (kDirectAlign - addr % kDirectAlign) % kDirectAlign;
+    }
+    pos_ = base_;
+    end_ = base_ + cap_;
+    if (refsEnabled_) refs_.reserve(kMaxRefs);
+}
+
+BufferedOutputStream::~BufferedOutputStream() {
+    flush();
+    if (ownsFd_ && fd_ >= 0) ::close(fd_);
+}
+
+bool BufferedOutputStream::checkBufferSize(size_t bufferSize, StateError* err) noexcept
+{
+    if (bufferSize == 0) {
+        if (err) *err = StateError::ZeroBufferSize;
+        return false;
+    }
+
+    // Same reasoning as BufferedInputStream: refuse before ASan sees a huge new[]
+    if (bufferSize > kMaxBufferSize) {
+        if (err) *err = StateError::OutOfMemory;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<BufferedOutputStream> BufferedOutputStream::Create(std::ostream& stream, size_t bufferSize,
+                            StateError* err)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
+    try {
+        auto p = std::unique_ptr<BufferedOutputStream>(new BufferedOutputStream(&stream, -1, false, bufferSize));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<BufferedOutputStream> BufferedOutputStream::CreateFd(int fd, size_t bufferSize,
+                            StateError* err)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
+    try {
+        auto p = std::unique_ptr<BufferedOutputStream>(new BufferedOutputStream(nullptr, fd, false, bufferSize));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<BufferedOutputStream> BufferedOutputStream::CreateString(std::string& sink, size_t bufferSize,
+                            StateError* err)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
+    try {
+        auto p = std::unique_ptr<BufferedOutputStream>(new BufferedOutputStream(nullptr, -1, false, bufferSize, false, &sink));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<BufferedOutputStream> BufferedOutputStream::CreateFile(const std::string& path, size_t bufferSize,
+                            StateError* err)
+{
+    return openFile(path, bufferSize, err, false);
+}
+
+std::unique_ptr<BufferedOutputStream> BufferedOutputStream::CreateFileDirect(const std::string& path, size_t bufferSize,
+                            StateError* err)
+{
+    return openFile(path, bufferSize, err, true);
+}
+
+std::unique_ptr<BufferedOutputStream> BufferedOutputStream::openFile(const std::string& path, size_t bufferSize,
+                            StateError* err, bool direct)
+{
+    if (!checkBufferSize(bufferSize, err)) return nullptr;
+
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int fd = -1;
+    if (direct) {
+        // Whole blocks only; kMaxBufferSize is block aligned, so this stays in range.
+        bufferSize = (bufferSize + kDirectAlign - 1) / kDirectAlign * kDirectAlign;
+#ifdef O_DIRECT
+        fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+#endif
+        // tmpfs and friends reject O_DIRECT: plain buffered output instead.
+        direct = fd >= 0;
+    }
+    if (fd < 0) fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        if (err) *err = StateError::OpenFailed;
+        return nullptr;
+    }
+
+    try {
+        auto p = std::unique_ptr<BufferedOutputStream>(new BufferedOutputStream(nullptr, fd, true, bufferSize, direct));
+        if (err) *err = StateError::None;
+        return p;
+    } catch (const std::bad_alloc&) {
+        ::close(fd);
+        if (err) *err = StateError::OutOfMemory;
+        return nullptr;
+    }
+}
+
+bool BufferedOutputStream::sinkWrite(const char* p, std::size_t n) {
+    if (stream_) {
+        stream_->write(p, static_cast<std::streamsize>(n));
+        return static_cast<bool>(*stream_);
+    }
+    if (string_) {
+        try {
+            string_->append(p, n);
+        } catch (const std::bad_alloc&) {
+            return false;
+        }
+        return true;
+    }
+    while (n > 0) {
+        const ssize_t w = ::write(fd_, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && direct_) {
+                dropDirect(); // filesystem accepted the open but not the I/O
+                continue;
+            }
+            return false;
+        }
+        p += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+bool BufferedOutputStream::sinkWriteVectored(std::size_t bufBytes) {
+    struct iovec iov[2 * kMaxRefs + 1];
+    int cnt = 0;
+    std::size_t off = 0;
+    for (const Ref& r : refs_) {
+        if (r.bufOff > off) {
+            iov[cnt++] = { base_ + off, r.bufOff - off };
+            off = r.bufOff;
+        }
+        iov[cnt++] = { const_cast<char*>(r.data), r.len };
+    }
+    if (bufBytes > off) iov[cnt++] = { base_ + off, bufBytes - off };
+
+    int i = 0;
+    while (i < cnt) {
+        const ssize_t w = ::writev(fd_, iov + i, std::min(cnt - i, kIovBatch));
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // Skip what was written; a short write resumes mid-entry.
+        std::size_t left = static_cast<std::size_t>(w);
+        while (i < cnt && left >= iov[i].iov_len) left -= iov[i++].iov_len;
+        if (left) {
+            iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + left;
+            iov[i].iov_len -= left;
+        }
+    }
+    return true;
+}
+
+void BufferedOutputStream::queueRef(const char* p, std::size_t n) {
+    refs_.push_back(Ref{ p, n, static_cast<std::size_t>(pos_ - base_) });
+    queuedRefBytes_ += n;
+    if (refs_.size() >= kMaxRefs || queuedRefBytes_ >= cap_) flushBuffer();
+}
+
+void BufferedOutputStream::dropDirect() noexcept {
+#ifdef O_DIRECT
+    const int fl = ::fcntl(fd_, F_GETFL);
+    if (fl >= 0) ::fcntl(fd_, F_SETFL, fl & ~O_DIRECT);
+#endif
+    direct_ = false;
+    refsEnabled_ = (fd_ >= 0);
+    if (refsEnabled_) refs_.reserve(kMaxRefs);
+}
+
+void BufferedOutputStream::flushBuffer() {
+    const std::size_t n = static_cast<std::size_t>(pos_ - base_);
+    pos_ = base_;
+    if (error_ != StateError::None) { // after an error, output is dropped
+        refs_.clear();
+        queuedRefBytes_ = 0;
+        return;
+    }
+    if (!refs_.empty()) {
+        const uint64_t total = n + queuedRefBytes_;
+        const bool ok = sinkWriteVectored(n);
+        refs_.clear();
+        queuedRefBytes_ = 0;
+        if (!ok) {
+            error_ = StateError::WriteFailed;
+            return;
+        }
+        flushed_ += total;
+        return;
+    }
+    if (n == 0) return;
+    // O_DIRECT writes whole blocks; a partial one ends direct mode (see CreateFileDirect).
+    if (direct_ && n % kDirectAlign != 0) dropDirect();
+    if (!sinkWrite(base_, n)) {
+        error_ = StateError::WriteFailed;
+        return;
+    }
+    flushed_ += n;
+}
+
+void BufferedOutputStream::writeSlow(const char* p, std::size_t n) {
+    // Top up the current buffer so output order is kept, then flush it.
+    const std::size_t room = static_cast<std::size_t>(end_ - pos_);
+    std::memcpy(pos_, p, room);
+    pos_ += room;
+    p += room;
+    n -= room;
+    flushBuffer();
+
+    // A tail of at least a full buffer goes straight to the sink (no extra copy),
+    // except in direct mode, where only the aligned buffer may be written.
+    if (n >= cap_ && !direct_) {
+        if (error_ == StateError::None) {
+            if (sinkWrite(p, n)) flushed_ += n;
+            else error_ = StateError::WriteFailed;
+        }
+        return;
+    }
+    while (n > cap_) {
+        std::memcpy(pos_, p, cap_);
+        pos_ += cap_;
+        p += cap_;
+        n -= cap_;
+        flushBuffer();
+    }
+    std::memcpy(pos_, p, n);
+    pos_ += n;
+}
+
+bool BufferedOutputStream::flush() {
+    flushBuffer();
+    if (stream_ && error_ == StateError::None) {
+        stream_->flush();
+        if (!*stream_) error_ = StateError::WriteFailed;
+    }
+    return error_ == StateError::None;
+}
+
+} // namespace LXMLFormatter
@@ -0,0 +1,157 @@
+#ifndef BUFFERED_OUTPUT_STREAM_H
+#define BUFFERED_OUTPUT_STREAM_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+namespace LXMLFormatter {
+
+// Output counterpart of BufferedInputStream: one large reusable buffer that is
+// handed to the sink only when full (or on flush()), so producers pay a memcpy
+// per write instead of a stream/syscall call.
+//
+// Descriptor sinks also accept references (writeRef): large spans of caller
+// memory that are queued in order between the buffered bytes and handed to the
+// kernel with one writev() per flush, so they are never copied in user space.
+class BufferedOutputStream {
+public:
+    enum class StateError {
+        None,
+        ZeroBufferSize,
+        OutOfMemory,
+        OpenFailed,   // CreateFile: file could not be created
+        WriteFailed   // sink rejected a flush (disk full, closed pipe, bad stream)
+    };
+
+    static constexpr std::size_t kDefaultBufferSize = 1u << 20;  // 1MB
+    static constexpr std::size_t kMaxBufferSize = (1ull << 28);  // 256MB buffer cap
+    static constexpr std::size_t kMinRefBytes = 1024;   // smaller refs are cheaper to copy
+    static constexpr std::size_t kMaxRefs = 128;        // queued refs per writev()
+    static constexpr std::size_t kDirectAlign = 4096;   // O_DIRECT block/buffer alignment
+
+    // Flushes into 'stream' with one write() per full buffer.
+    static std::unique_ptr<BufferedOutputStream> Create(std::ostream& stream, size_t bufferSize = kDefaultBufferSize, StateError* err = nullptr);
+
+    // Creates/truncates 'path' and writes it with write(2); the descriptor is owned.
+    static std::unique_ptr<BufferedOutputStream> CreateFile(const std::string& path, size_t bufferSize = kDefaultBufferSize, StateError* err = nullptr);
+
+    // Writes to an already open descriptor (e.g. STDOUT_FILENO); not closed by us.
+    static std::unique_ptr<BufferedOutputStream> CreateFd(int fd, size_t bufferSize = kDefaultBufferSize, StateError* err = nullptr);
+
+    // Appends to 'sink' (e.g. per-thread output that is stitched together later).
+    static std::unique_ptr<BufferedOutputStream> CreateString(std::string& sink, size_t bufferSize = kDefaultBufferSize, StateError* err = nullptr);
+
+    // Like CreateFile, but opened with O_DIRECT so bulk output bypasses the page
+    // cache. The buffer is block aligned and only whole blocks are written; a
+    // partial flush (normally the last one) switches the descriptor back to
+    // buffered I/O for the tail. Refs are copied in this mode. Falls back to plain
+    // buffered I/O when the platform or filesystem refuses O_DIRECT.
+    static std::unique_ptr<BufferedOutputStream> CreateFileDirect(const std::string& path, size_t bufferSize = kDefaultBufferSize, StateError* err = nullptr);
+
+    BufferedOutputStream(const BufferedOutputStream&) = delete;
+    BufferedOutputStream& operator=(const BufferedOutputStream&) = delete;
+    BufferedOutputStream(BufferedOutputStream&&) = delete;
+    BufferedOutputStream& operator=(BufferedOutputStream&&) = delete;
+
+    // Flushes what is left (errors are only visible through good()/error() before this).
+    ~BufferedOutputStream();
+
+    // Appends n bytes; a single memcpy unless the buffer fills up.
+    inline void write(const char* p, std::size_t n) {
+        if (n <= static_cast<std::size_t>(end_ - pos_)) {
+            std::memcpy(pos_, p, n);
+            pos_ += n;
+            return;
+        }
+        writeSlow(p, n);
+    }
+
+    inline void put(char c) {
+        if (pos_ == end_) flushBuffer();
+        *pos_++ = c;
+    }
+
+    // Appends [p, p+n) by reference: the bytes must stay valid and unchanged until
+    // the next flush() (e.g. a file mapping). Small spans, stream sinks and direct
+    // mode fall back to write().
+    inline void writeRef(const char* p, std::size_t n) {
+        if (n < kMinRefBytes || !refsEnabled_) {
+            write(p, n);
+            return;
+        }
+        queueRef(p, n);
+    }
+
+    // True while the sink is written with O_DIRECT (see CreateFileDirect).
+    bool isDirect() const noexcept { return direct_; }
+
+    // Hands everything buffered to the sink; false once any write has failed.
+    bool flush();
+
+    bool good() const noexcept { return error_ == StateError::None; }
+    StateError error() const noexcept { return error_; }
+
+    // Bytes accepted so far (buffered + already written).
+    uint64_t bytesWritten() const noexcept { return flushed_ + queuedRefBytes_ + static_cast<uint64_t>(pos_ - base_); }
+
+private:
+    // A queued reference, placed after the first 'bufOff' buffered bytes.
+    struct Ref {
+        const char* data;
+        std::size_t len;
+        std::size_t bufOff;
+    };
+
+    BufferedOutputStream(std::ostream* stream, int fd, bool ownsFd, size_t bufferSize, bool direct = false,
+                         std::string* str = nullptr);
+
+    // CreateFile / CreateFileDirect.
+    static std::unique_ptr<BufferedOutputStream> openFile(const std::string& path, size_t bufferSize, StateError* err, bool direct);
+
+    // Shared size validation for the factories.
+    static bool checkBufferSize(size_t bufferSize, StateError* err) noexcept;
+
+    // Writes the buffer to the sink and rewinds it; write errors latch into error_.
+    void flushBuffer();
+
+    // Large or buffer-crossing write: fill, flush, and send big tails straight through.
+    void writeSlow(const char* p, std::size_t n);
+
+    // Single sink write of [p, p+n); false on error.
+    bool sinkWrite(const char* p, std::size_t n);
+
+    // Queues a reference; flushes once kMaxRefs or a buffer's worth of bytes are queued.
+    void queueRef(const char* p, std::size_t n);
+
+    // One writev() (looped on short writes) of the buffer interleaved with refs_.
+    bool sinkWriteVectored(std::size_t bufBytes);
+
+    // Clears O_DIRECT on the descriptor; later writes go through the page cache.
+    void dropDirect() noexcept;
+
+    std::ostream* stream_ = nullptr;  // stream sink, or
+    std::string*  string_ = nullptr;  // string sink, or
+    int           fd_ = -1;           // descriptor sink
+    bool          ownsFd_ = false;
+
+    std::unique_ptr<char[]> buf_;     // storage; base_ is its (aligned) start
+    char*         base_ = nullptr;
+    char*         pos_ = nullptr;
+    char*         end_ = nullptr;
+    std::size_t   cap_ = 0;
+    uint64_t      flushed_ = 0;
+    StateError    error_ = StateError::None;
+
+    std::vector<Ref> refs_;           // queued references, in output order
+    uint64_t      queuedRefBytes_ = 0;
+    bool          refsEnabled_ = false;  // descriptor sink, not direct
+    bool          direct_ = false;
+};
+
+} // namespace LXMLFormatter
+
+#endif // BUFFERED_OUTPUT_STREAM_H
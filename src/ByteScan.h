@@ -0,0 +1,422 @@
+/*
+    * Byte scanning helpers
+    * Version: 0.0.1
+    * License: MIT
+    *
+    * Block-wise (SIMD) primitives shared by BufferedInputStream and the tokenizer.
+    * Each primitive has a scalar reference implementation and vector variants:
+    *   - x86-64: SSE2 (baseline, always available) and AVX2 (selected at runtime
+    *     via __builtin_cpu_supports, or directly when compiled with -mavx2/-march=native)
+    *   - AArch64: NEON
+    * All variants must return exactly what the scalar version returns; the vector
+    * code only decides how many bytes are examined per step.
+    * NOTE: like UTF8Handler, this header favours speed over readability.
+*/
+
+#ifndef LXMLFORMATTER_BYTESCAN_H
+#define LXMLFORMATTER_BYTESCAN_H
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  include <immintrin.h>
+#  define LXML_BYTESCAN_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define LXML_BYTESCAN_NEON 1
+#endif
+
+namespace LXMLFormatter {
+namespace ByteScan {
+
+// Result of scanning a range for line breaks (see scanLines()).
+struct LineScan {
+    std::size_t lines = 0;      // line increments: #CR + #LF - #CRLF
+    std::size_t lastBreak = 0;  // index of the last CR or LF; == n if none
+};
+
+// Below this size the call overhead of the vector paths is not worth it.
+inline constexpr std::size_t kMinVectorBytes = 16;
+
+namespace detail {
+
+    // ---- scalar reference ----
+    inline LineScan scanLinesScalar(const uint8_t* p, std::size_t n, bool prevCR) noexcept {
+        LineScan r;
+        r.lastBreak = n;
+        for (std::size_t i = 0; i < n; ++i) {
+            const uint8_t ch = p[i];
+            if (ch == 0x0D) {
+                ++r.lines;
+                r.lastBreak = i;
+                prevCR = true;
+            } else if (ch == 0x0A) {
+                r.lines += prevCR ? 0 : 1;
+                r.lastBreak = i;
+                prevCR = false;
+            } else {
+                prevCR = false;
+            }
+        }
+        return r;
+    }
+
+    inline std::size_t asciiPrefixScalar(const uint8_t* p, std::size_t n) noexcept {
+        std::size_t i = 0;
+        while (i < n && p[i] < 0x80) ++i;
+        return i;
+    }
+
+    // findFirstOf*<K>: only the first K of a, b, c, d are compared.
+    template<unsigned K>
+    inline std::size_t findFirstOfScalar(const uint8_t* p, std::size_t n,
+                                         uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+        static_assert(K >= 1 && K <= 4, "1 to 4 delimiters");
+        for (std::size_t i = 0; i < n; ++i) {
+            const uint8_t ch = p[i];
+            if (ch == a || (K > 1 && ch == b) || (K > 2 && ch == c) || (K > 3 && ch == d)) return i;
+        }
+        return n;
+    }
+
+    inline std::size_t narrowAscii16Scalar(const uint8_t* src, std::size_t n, bool bigEndian, uint8_t* dst) noexcept {
+        const std::size_t lo = bigEndian ? 1 : 0;
+        std::size_t i = 0;
+        for (; i < n; ++i) {
+            const uint8_t low = src[2 * i + lo];
+            if (src[2 * i + (1 - lo)] != 0 || low >= 0x80) break;
+            dst[i] = low;
+        }
+        return i;
+    }
+
+    // Folds one block's CR/LF bitmasks (bit i = byte i) into the running result.
+    // 'carry' is 1 if the byte before the block was CR; returns the new carry.
+    template<unsigned Width, typename Mask>
+    inline uint32_t foldLineMasks(Mask cr, Mask lf, uint32_t carry, std::size_t base, LineScan& r) noexcept {
+        const Mask crlf   = lf & static_cast<Mask>((cr << 1) | carry);
+        const Mask breaks = cr | lf;
+        if (breaks) {
+            r.lines += static_cast<std::size_t>(__builtin_popcountll(cr) + __builtin_popcountll(lf)
+                                                - __builtin_popcountll(crlf));
+            r.lastBreak = base + (63u - static_cast<unsigned>(__builtin_clzll(breaks)));
+        }
+        return static_cast<uint32_t>((cr >> (Width - 1)) & 1u);
+    }
+
+#if defined(LXML_BYTESCAN_X86)
+    // ---- SSE2: 16 bytes per step ----
+    inline LineScan scanLinesSSE2(const uint8_t* p, std::size_t n, bool prevCR) noexcept {
+        LineScan r;
+        r.lastBreak = n;
+        const __m128i vCR = _mm_set1_epi8(0x0D);
+        const __m128i vLF = _mm_set1_epi8(0x0A);
+        uint32_t carry = prevCR ? 1u : 0u;
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            const uint32_t cr = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, vCR)));
+            const uint32_t lf = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, vLF)));
+            carry = foldLineMasks<16, uint64_t>(cr, lf, carry, i, r);
+        }
+        if (i < n) {
+            const LineScan t = scanLinesScalar(p + i, n - i, carry != 0);
+            r.lines += t.lines;
+            if (t.lastBreak != n - i) r.lastBreak = i + t.lastBreak;
+        }
+        return r;
+    }
+
+    inline std::size_t asciiPrefixSSE2(const uint8_t* p, std::size_t n) noexcept {
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            const uint32_t hi = static_cast<uint32_t>(_mm_movemask_epi8(v)); // top bit of each byte
+            if (hi) return i + static_cast<std::size_t>(__builtin_ctz(hi));
+        }
+        return i + asciiPrefixScalar(p + i, n - i);
+    }
+
+    template<unsigned K>
+    inline __m128i matchAnySSE2(__m128i v, uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+        __m128i hit = _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(a)));
+        if constexpr (K > 1) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(b))));
+        if constexpr (K > 2) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(c))));
+        if constexpr (K > 3) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(d))));
+        return hit;
+    }
+
+    template<unsigned K>
+    inline std::size_t findFirstOfSSE2(const uint8_t* p, std::size_t n,
+                                       uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            const uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(matchAnySSE2<K>(v, a, b, c, d)));
+            if (m) return i + static_cast<std::size_t>(__builtin_ctz(m));
+        }
+        return i + findFirstOfScalar<K>(p + i, n - i, a, b, c, d);
+    }
+
+    // 8 code units per step: byte-swap if needed, check every unit < 0x80, pack.
+    inline std::size_t narrowAscii16SSE2(const uint8_t* src, std::size_t n, bool bigEndian, uint8_t* dst) noexcept {
+        const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+            if (bigEndian) v = _mm_or_si128(_mm_srli_epi16(v, 8), _mm_slli_epi16(v, 8));
+            const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, nonAscii), zero);
+            if (_mm_movemask_epi8(ascii) != 0xFFFF) break;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(v, v));
+        }
+        return i + narrowAscii16Scalar(src + 2 * i, n - i, bigEndian, dst + i);
+    }
+
+    // ---- AVX2: 32 bytes per step (compiled for AVX2 regardless of -m flags) ----
+    __attribute__((target("avx2")))
+    inline LineScan scanLinesAVX2(const uint8_t* p, std::size_t n, bool prevCR) noexcept {
+        LineScan r;
+        r.lastBreak = n;
+        const __m256i vCR = _mm256_set1_epi8(0x0D);
+        const __m256i vLF = _mm256_set1_epi8(0x0A);
+        uint32_t carry = prevCR ? 1u : 0u;
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            const uint32_t cr = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vCR)));
+            const uint32_t lf = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vLF)));
+            carry = foldLineMasks<32, uint64_t>(cr, lf, carry, i, r);
+        }
+        if (i < n) {
+            const LineScan t = scanLinesSSE2(p + i, n - i, carry != 0);
+            r.lines += t.lines;
+            if (t.lastBreak != n - i) r.lastBreak = i + t.lastBreak;
+        }
+        return r;
+    }
+
+    __attribute__((target("avx2")))
+    inline std::size_t asciiPrefixAVX2(const uint8_t* p, std::size_t n) noexcept {
+        std::size_t i = 0;
+        for (; i + 64 <= n; i += 64) { // two vectors per step; most input is ASCII
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32));
+            if (_mm256_movemask_epi8(_mm256_or_si256(a, b))) break;
+        }
+        for (; i + 32 <= n; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            const uint32_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+            if (hi) return i + static_cast<std::size_t>(__builtin_ctz(hi));
+        }
+        return i + asciiPrefixSSE2(p + i, n - i);
+    }
+
+    template<unsigned K>
+    __attribute__((target("avx2")))
+    inline __m256i matchAnyAVX2(__m256i v, uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+        __m256i hit = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(a)));
+        if constexpr (K > 1) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(b))));
+        if constexpr (K > 2) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(c))));
+        if constexpr (K > 3) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(d))));
+        return hit;
+    }
+
+    template<unsigned K>
+    __attribute__((target("avx2")))
+    inline std::size_t findFirstOfAVX2(const uint8_t* p, std::size_t n,
+                                       uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            const uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(matchAnyAVX2<K>(v, a, b, c, d)));
+            if (m) return i + static_cast<std::size_t>(__builtin_ctz(m));
+        }
+        return i + findFirstOfSSE2<K>(p + i, n - i, a, b, c, d);
+    }
+
+    __attribute__((target("avx2")))
+    inline std::size_t narrowAscii16AVX2(const uint8_t* src, std::size_t n, bool bigEndian, uint8_t* dst) noexcept {
+        const __m256i nonAscii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+            if (bigEndian) v = _mm256_or_si256(_mm256_srli_epi16(v, 8), _mm256_slli_epi16(v, 8));
+            if (!_mm256_testz_si256(v, nonAscii)) break;
+            // packus works per 128-bit lane; gather the two low quadwords.
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(packed));
+        }
+        return i + narrowAscii16SSE2(src + 2 * i, n - i, bigEndian, dst + i);
+    }
+
+    inline bool cpuHasAVX2() noexcept {
+#  if defined(__AVX2__)
+        return true;
+#  else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#  endif
+    }
+    // Resolved once at static-initialisation time; read-only afterwards.
+    inline const bool kHasAVX2 = cpuHasAVX2();
+#endif
+
+#if defined(LXML_BYTESCAN_NEON)
+    // NEON has no movemask; narrowing shift gives 4 bits per byte (nibble mask).
+    inline uint64_t neonNibbleMask(uint8x16_t cmp) noexcept {
+        const uint8x8_t nib = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+        return vget_lane_u64(vreinterpret_u64_u8(nib), 0);
+    }
+
+    inline std::size_t asciiPrefixNEON(const uint8_t* p, std::size_t n) noexcept {
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const uint8x16_t v = vld1q_u8(p + i);
+            if (vmaxvq_u8(v) >= 0x80) {
+                const uint64_t hi = neonNibbleMask(vcgeq_u8(v, vdupq_n_u8(0x80)));
+                return i + (static_cast<std::size_t>(__builtin_ctzll(hi)) >> 2);
+            }
+        }
+        return i + asciiPrefixScalar(p + i, n - i);
+    }
+
+    template<unsigned K>
+    inline std::size_t findFirstOfNEON(const uint8_t* p, std::size_t n,
+                                       uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const uint8x16_t v = vld1q_u8(p + i);
+            uint8x16_t hit = vceqq_u8(v, vdupq_n_u8(a));
+            if constexpr (K > 1) hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8(b)));
+            if constexpr (K > 2) hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8(c)));
+            if constexpr (K > 3) hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8(d)));
+            const uint64_t m = neonNibbleMask(hit);
+            if (m) return i + (static_cast<std::size_t>(__builtin_ctzll(m)) >> 2);
+        }
+        return i + findFirstOfScalar<K>(p + i, n - i, a, b, c, d);
+    }
+
+    inline std::size_t narrowAscii16NEON(const uint8_t* src, std::size_t n, bool bigEndian, uint8_t* dst) noexcept {
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint8x16_t b = vld1q_u8(src + 2 * i);
+            if (bigEndian) b = vrev16q_u8(b);
+            const uint16x8_t v = vreinterpretq_u16_u8(b);
+            if (vmaxvq_u16(v) >= 0x80) break;
+            vst1_u8(dst + i, vmovn_u16(v));
+        }
+        return i + narrowAscii16Scalar(src + 2 * i, n - i, bigEndian, dst + i);
+    }
+
+    inline LineScan scanLinesNEON(const uint8_t* p, std::size_t n, bool prevCR) noexcept {
+        LineScan r;
+        r.lastBreak = n;
+        const uint8x16_t vCR = vdupq_n_u8(0x0D);
+        const uint8x16_t vLF = vdupq_n_u8(0x0A);
+        bool carry = prevCR;
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const uint8x16_t v = vld1q_u8(p + i);
+            // Keep the low bit of each nibble so popcount counts bytes.
+            const uint64_t cr = neonNibbleMask(vceqq_u8(v, vCR)) & 0x1111111111111111ull;
+            const uint64_t lf = neonNibbleMask(vceqq_u8(v, vLF)) & 0x1111111111111111ull;
+            const uint64_t crlf   = lf & ((cr << 4) | (carry ? 1u : 0u));
+            const uint64_t breaks = cr | lf;
+            if (breaks) {
+                r.lines += static_cast<std::size_t>(__builtin_popcountll(cr) + __builtin_popcountll(lf)
+                                                    - __builtin_popcountll(crlf));
+                r.lastBreak = i + ((63u - static_cast<unsigned>(__builtin_clzll(breaks))) >> 2);
+            }
+            carry = (cr >> 60) != 0;
+        }
+        if (i < n) {
+            const LineScan t = scanLinesScalar(p + i, n - i, carry);
+            r.lines += t.lines;
+            if (t.lastBreak != n - i) r.lastBreak = i + t.lastBreak;
+        }
+        return r;
+    }
+#endif
+
+} // namespace detail
+
+// Counts line increments over [p, p+n) under BufferedInputStream's rules
+// (CR, LF and CRLF each start one new line; 'prevCR' = byte before p was CR)
+// and reports the index of the last CR/LF so the caller can derive the column.
+inline LineScan scanLines(const uint8_t* p, std::size_t n, bool prevCR) noexcept {
+    if (n < kMinVectorBytes) return detail::scanLinesScalar(p, n, prevCR);
+#if defined(LXML_BYTESCAN_X86)
+    if (detail::kHasAVX2) return detail::scanLinesAVX2(p, n, prevCR);
+    return detail::scanLinesSSE2(p, n, prevCR);
+#elif defined(LXML_BYTESCAN_NEON)
+    return detail::scanLinesNEON(p, n, prevCR);
+#else
+    return detail::scanLinesScalar(p, n, prevCR);
+#endif
+}
+
+// Length of the leading run of ASCII bytes (< 0x80) in [p, p+n).
+inline std::size_t asciiPrefix(const uint8_t* p, std::size_t n) noexcept {
+    if (n < kMinVectorBytes) return detail::asciiPrefixScalar(p, n);
+#if defined(LXML_BYTESCAN_X86)
+    if (detail::kHasAVX2) return detail::asciiPrefixAVX2(p, n);
+    return detail::asciiPrefixSSE2(p, n);
+#elif defined(LXML_BYTESCAN_NEON)
+    return detail::asciiPrefixNEON(p, n);
+#else
+    return detail::asciiPrefixScalar(p, n);
+#endif
+}
+
+// Index of the first byte in [p, p+n) equal to any of the first K of a, b, c, d;
+// n if none. Each delimiter is one compare per block, so pass only the ones needed
+// (the overloads below).
+template<unsigned K>
+inline std::size_t findFirstOfN(const uint8_t* p, std::size_t n,
+                                uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+    if (n < kMinVectorBytes) return detail::findFirstOfScalar<K>(p, n, a, b, c, d);
+#if defined(LXML_BYTESCAN_X86)
+    if (detail::kHasAVX2) return detail::findFirstOfAVX2<K>(p, n, a, b, c, d);
+    return detail::findFirstOfSSE2<K>(p, n, a, b, c, d);
+#elif defined(LXML_BYTESCAN_NEON)
+    return detail::findFirstOfNEON<K>(p, n, a, b, c, d);
+#else
+    return detail::findFirstOfScalar<K>(p, n, a, b, c, d);
+#endif
+}
+
+inline std::size_t findFirstOf(const uint8_t* p, std::size_t n,
+                               uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept {
+    return findFirstOfN<4>(p, n, a, b, c, d);
+}
+inline std::size_t findFirstOf(const uint8_t* p, std::size_t n, uint8_t a, uint8_t b, uint8_t c) noexcept {
+    return findFirstOfN<3>(p, n, a, b, c, c);
+}
+inline std::size_t findFirstOf(const uint8_t* p, std::size_t n, uint8_t a, uint8_t b) noexcept {
+    return findFirstOfN<2>(p, n, a, b, b, b);
+}
+inline std::size_t findFirstOf(const uint8_t* p, std::size_t n, uint8_t a) noexcept {
+    return findFirstOfN<1>(p, n, a, a, a, a);
+}
+
+// Copies the leading run of ASCII UTF-16 code units (< 0x80) in the 'n' units
+// at src to dst as single bytes, which is also their UTF-8 form; returns how
+// many units were copied. dst needs room for n bytes.
+inline std::size_t narrowAscii16(const uint8_t* src, std::size_t n, bool bigEndian, uint8_t* dst) noexcept {
+    if (n < kMinVectorBytes) return detail::narrowAscii16Scalar(src, n, bigEndian, dst);
+#if defined(LXML_BYTESCAN_X86)
+    if (detail::kHasAVX2) return detail::narrowAscii16AVX2(src, n, bigEndian, dst);
+    return detail::narrowAscii16SSE2(src, n, bigEndian, dst);
+#elif defined(LXML_BYTESCAN_NEON)
+    return detail::narrowAscii16NEON(src, n, bigEndian, dst);
+#else
+    return detail::narrowAscii16Scalar(src, n, bigEndian, dst);
+#endif
+}
+
+} // namespace ByteScan
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_BYTESCAN_H
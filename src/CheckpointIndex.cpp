@@ -0,0 +1,58 @@
+#include "CheckpointIndex.h"
+
+#include <fstream>
+#include <istream>
+#include <ostream>
+
+namespace LXMLFormatter {
+
+namespace {
+    constexpr const char* kMagic = "lxml-checkpoints";
+    constexpr unsigned    kVersion = 1;
+}
+
+void CheckpointIndex::write(std::ostream& os) const {
+    os << kMagic << ' ' << kVersion << ' ' << every_ << '\n';
+    for (const TokenizerCheckpoint& cp : entries_) cp.write(os);
+}
+
+bool CheckpointIndex::read(std::istream& is) {
+    clear();
+    std::string magic;
+    unsigned version = 0;
+    U64 every = 0;
+    if (!(is >> magic >> version >> every) || magic != kMagic || version != kVersion || every == 0) return false;
+    every_ = every;
+    next_ = every;
+
+    is >> std::ws; // rest of the header line
+    while (is.peek() != std::char_traits<char>::eof()) {
+        TokenizerCheckpoint cp;
+        if (!cp.read(is) ||
+            (!entries_.empty() && cp.where.byteOffset <= entries_.back().where.byteOffset)) {
+            clear();
+            return false;
+        }
+        add(std::move(cp));
+    }
+    return true;
+}
+
+bool CheckpointIndex::save(const std::string& path) const {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f) return false;
+    write(f);
+    f.flush();
+    return static_cast<bool>(f);
+}
+
+bool CheckpointIndex::load(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+        clear();
+        return false;
+    }
+    return read(f);
+}
+
+} // namespace LXMLFormatter
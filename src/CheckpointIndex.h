@@ -0,0 +1,76 @@
+/*
+    * Checkpoint index
+    * Version: 0.0.1
+    * License: MIT
+    *
+    * A sparse, sorted list of TokenizerCheckpoints taken every everyBytes() of input
+    * (XMLTokenizer::recordCheckpoints), saved next to a document as a sidecar file.
+    * findBefore(offset) gives the last checkpoint at or before a byte offset, so a
+    * failed job can resume, a reader can seek into a region, or workers can be
+    * handed [entry i, entry i+1) ranges, without rescanning from byte 0.
+    *
+    * File format (text): a header line "lxml-checkpoints 1 <everyBytes>", then one
+    * TokenizerCheckpoint::write() line per entry in byte order.
+*/
+
+#ifndef LXMLFORMATTER_CHECKPOINTINDEX_H
+#define LXMLFORMATTER_CHECKPOINTINDEX_H
+
+#include "XMLTokenizerTypes.h"
+#include <algorithm>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace LXMLFormatter {
+
+class CheckpointIndex {
+public:
+    static constexpr U64 kDefaultEvery = 64ull << 20; // 64MB
+
+    explicit CheckpointIndex(U64 everyBytes = kDefaultEvery) noexcept
+        : every_(everyBytes ? everyBytes : 1), next_(every_) {}
+
+    U64 everyBytes() const noexcept { return every_; }
+
+    // True once the input has moved everyBytes() past the last entry.
+    bool due(ByteOff byteOffset) const noexcept { return byteOffset >= next_; }
+
+    // Appends 'cp' (offsets must grow) and schedules the next one everyBytes() later.
+    void add(TokenizerCheckpoint cp) {
+        next_ = cp.where.byteOffset + every_;
+        entries_.push_back(std::move(cp));
+    }
+
+    // Last entry at or before 'byteOffset'; nullptr if there is none (start at 0).
+    const TokenizerCheckpoint* findBefore(ByteOff byteOffset) const noexcept {
+        auto it = std::upper_bound(entries_.begin(), entries_.end(), byteOffset,
+                                   [](ByteOff off, const TokenizerCheckpoint& e) { return off < e.where.byteOffset; });
+        return it == entries_.begin() ? nullptr : &*(it - 1);
+    }
+
+    const std::vector<TokenizerCheckpoint>& entries() const noexcept { return entries_; }
+    std::size_t size() const noexcept { return entries_.size(); }
+    bool empty() const noexcept { return entries_.empty(); }
+
+    void clear() noexcept {
+        entries_.clear();
+        next_ = every_;
+    }
+
+    // Sidecar file I/O. load() replaces the contents and returns false (leaving the
+    // index empty) on an unreadable or malformed file.
+    void write(std::ostream& os) const;
+    bool read(std::istream& is);
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    U64 every_;
+    U64 next_;
+    std::vector<TokenizerCheckpoint> entries_;
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_CHECKPOINTINDEX_H
@@ -0,0 +1,209 @@
+#include "DecompressingStreamBuf.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(LXML_HAVE_ZLIB)
+#define ZLIB_CONST
+#include <zlib.h>
+#endif
+#if defined(LXML_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace LXMLFormatter {
+
+namespace {
+    // zlib counts in uInt; any window we are handed fits, but clamp anyway.
+    constexpr std::size_t kMaxStep = 1u << 30;
+
+    // zstd skippable frames (0x184D2A50..5F, little endian) may sit between frames.
+    bool isZstdSkippable(const uint8_t* p, std::size_t n) noexcept {
+        return n >= 4 && (p[0] & 0xF0) == 0x50 && p[1] == 0x2A && p[2] == 0x4D && p[3] == 0x18;
+    }
+}
+
+// One decoder per stream; which members exist depends on the build.
+struct DecompressingStreamBuf::Codec {
+    enum class Status { Ok, FrameEnd, Error };
+
+    Compression kind;
+    bool midFrame = false;   // inside a gzip member / zstd frame: EOF here is truncation
+#if defined(LXML_HAVE_ZLIB)
+    z_stream z{};
+    bool     zReady = false;
+#endif
+#if defined(LXML_HAVE_ZSTD)
+    ZSTD_DStream* zs = nullptr;
+#endif
+
+    explicit Codec(Compression c) noexcept : kind(c) {}
+
+    ~Codec() {
+#if defined(LXML_HAVE_ZLIB)
+        if (zReady) inflateEnd(&z);
+#endif
+#if defined(LXML_HAVE_ZSTD)
+        if (zs) ZSTD_freeDStream(zs);
+#endif
+    }
+
+    bool init() noexcept {
+        switch (kind) {
+#if defined(LXML_HAVE_ZLIB)
+            case Compression::Gzip:
+                zReady = inflateInit2(&z, 15 + 16) == Z_OK; // gzip wrapper only
+                return zReady;
+#endif
+#if defined(LXML_HAVE_ZSTD)
+            case Compression::Zstd:
+                zs = ZSTD_createDStream();
+                return zs && !ZSTD_isError(ZSTD_initDStream(zs));
+#endif
+            default:
+                return false;
+        }
+    }
+
+    // Consumes from [in, in+inLen) and produces into [out, out+outCap); all four advance.
+    Status step(const uint8_t*& in, std::size_t& inLen, uint8_t*& out, std::size_t& outCap) noexcept {
+        switch (kind) {
+#if defined(LXML_HAVE_ZLIB)
+            case Compression::Gzip: {
+                const uInt giveIn  = static_cast<uInt>(std::min(inLen, kMaxStep));
+                const uInt giveOut = static_cast<uInt>(std::min(outCap, kMaxStep));
+                z.next_in   = in;
+                z.avail_in  = giveIn;
+                z.next_out  = out;
+                z.avail_out = giveOut;
+                const int rc = inflate(&z, Z_NO_FLUSH);
+                const std::size_t usedIn  = giveIn - z.avail_in;
+                const std::size_t usedOut = giveOut - z.avail_out;
+                in += usedIn;    inLen -= usedIn;
+                out += usedOut;  outCap -= usedOut;
+                if (rc == Z_STREAM_END) { midFrame = false; return Status::FrameEnd; }
+                if (rc == Z_OK || rc == Z_BUF_ERROR) { midFrame = true; return Status::Ok; }
+                return Status::Error;
+            }
+#endif
+#if defined(LXML_HAVE_ZSTD)
+            case Compression::Zstd: {
+                ZSTD_inBuffer  ib{in, inLen, 0};
+                ZSTD_outBuffer ob{out, outCap, 0};
+                const std::size_t rc = ZSTD_decompressStream(zs, &ob, &ib);
+                if (ZSTD_isError(rc)) return Status::Error;
+                in += ib.pos;   inLen -= ib.pos;
+                out += ob.pos;  outCap -= ob.pos;
+                if (rc == 0) { midFrame = false; return Status::FrameEnd; }
+                midFrame = true;
+                return Status::Ok;
+            }
+#endif
+            default:
+                return Status::Error;
+        }
+    }
+
+    // Prepares for the next gzip member / zstd frame.
+    bool nextFrame() noexcept {
+#if defined(LXML_HAVE_ZLIB)
+        if (kind == Compression::Gzip) return inflateReset(&z) == Z_OK;
+#endif
+        return true; // a zstd stream moves on to the next frame by itself
+    }
+};
+
+DecompressingStreamBuf::DecompressingStreamBuf(std::istream& source, std::size_t inputChunk)
+    : InputFilterBuf(source, inputChunk)
+{
+}
+
+DecompressingStreamBuf::~DecompressingStreamBuf() = default;
+
+bool DecompressingStreamBuf::supports(Compression c) noexcept {
+    switch (c) {
+        case Compression::None: return true;
+#if defined(LXML_HAVE_ZLIB)
+        case Compression::Gzip: return true;
+#endif
+#if defined(LXML_HAVE_ZSTD)
+        case Compression::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+bool DecompressingStreamBuf::open() {
+    while (inputAvailable() < 4 && refillInput()) {}
+    compression_ = BufferedInputStream::detectCompression(inputData(), inputAvailable());
+    if (compression_ == Compression::None) return true;
+    if (!supports(compression_)) return false;
+    codec_ = std::make_unique<Codec>(compression_);
+    if (!codec_->init()) {
+        codec_.reset();
+        return false;
+    }
+    return true;
+}
+
+std::size_t DecompressingStreamBuf::decode(uint8_t* dst, std::size_t cap) {
+    if (ended_ || cap == 0) return 0;
+    uint8_t* out = dst;
+    std::size_t room = cap;
+
+    if (!codec_) {
+        // Plain input: what open() buffered, then straight from the source.
+        const std::size_t take = std::min(inputAvailable(), room);
+        std::memcpy(out, inputData(), take);
+        consumeInput(take);
+        out += take;
+        room -= take;
+        if (room && source_) {
+            source_.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(room));
+            const std::streamsize got = source_.gcount();
+            if (got > 0) {
+                out += got;
+                room -= static_cast<std::size_t>(got);
+            }
+        }
+        if (room) ended_ = true;
+        return cap - room;
+    }
+
+    while (room) {
+        if (inputAvailable() == 0 && !refillInput()) {
+            if (codec_->midFrame) fail(); // truncated
+            ended_ = true;
+            break;
+        }
+        const uint8_t* p = inputData();
+        std::size_t avail = inputAvailable();
+        const std::size_t availBefore = avail;
+        const std::size_t roomBefore = room;
+        const Codec::Status st = codec_->step(p, avail, out, room);
+        consumeInput(availBefore - avail);
+
+        // Corrupt data, or a decoder stuck with both input and room available.
+        if (st == Codec::Status::Error ||
+            (st == Codec::Status::Ok && avail == availBefore && room == roomBefore)) {
+            fail();
+            break;
+        }
+        if (st == Codec::Status::FrameEnd) {
+            // Concatenated gzip members / zstd frames continue the document;
+            // anything else after a complete frame is ignored, as gzip -d does.
+            while (inputAvailable() < 4 && refillInput()) {}
+            const uint8_t* next = inputData();
+            const std::size_t left = inputAvailable();
+            const bool more = BufferedInputStream::detectCompression(next, left) == compression_
+                           || (compression_ == Compression::Zstd && isZstdSkippable(next, left));
+            if (!more || !codec_->nextFrame()) {
+                ended_ = true;
+                break;
+            }
+        }
+    }
+    return cap - room;
+}
+
+} // namespace LXMLFormatter
@@ -0,0 +1,47 @@
+#ifndef LXMLFORMATTER_DECOMPRESSINGSTREAMBUF_H
+#define LXMLFORMATTER_DECOMPRESSINGSTREAMBUF_H
+
+#include "BufferedInputStream.h"
+#include "InputFilterBuf.h"
+#include <istream>
+#include <memory>
+
+namespace LXMLFormatter {
+
+// Read-only streambuf that decodes a gzip or zstd source (or passes plain input
+// through). read()/sgetn() decode straight into the caller's buffer, so a
+// BufferedInputStream on top of it inflates directly into its window; under
+// CreatePrefetched that work happens on the reader thread.
+//
+// gzip needs zlib (LXML_HAVE_ZLIB) and zstd libzstd (LXML_HAVE_ZSTD); both are
+// switched on by the makefile when their headers are found.
+class DecompressingStreamBuf final : public InputFilterBuf {
+public:
+    using Compression = BufferedInputStream::Compression;
+
+    explicit DecompressingStreamBuf(std::istream& source, std::size_t inputChunk = kInputChunk);
+    ~DecompressingStreamBuf() override;
+
+    // Reads the first chunk, detects the format from its magic bytes and sets up
+    // the decoder. False if the format is not compiled in or the decoder could not
+    // be created (allocation); detected() tells which format it was.
+    bool open();
+
+    Compression detected() const noexcept { return compression_; }
+
+    // Whether this build can decode 'c'.
+    static bool supports(Compression c) noexcept;
+
+protected:
+    std::size_t decode(uint8_t* dst, std::size_t cap) override;
+
+private:
+    struct Codec;   // gzip/zstd state (defined in the .cpp)
+
+    std::unique_ptr<Codec>     codec_;
+    Compression                compression_ = Compression::None;
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_DECOMPRESSINGSTREAMBUF_H
@@ -0,0 +1,75 @@
+#include "InputFilterBuf.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace LXMLFormatter {
+
+InputFilterBuf::InputFilterBuf(std::istream& source, std::size_t inputChunk)
+    : source_(source)
+    , chunk_(std::max<std::size_t>(inputChunk, 16))
+    , in_(new uint8_t[chunk_]) // not zero-filled: only [inPos_, inEnd_) is read
+    , inCap_(chunk_)
+{
+    setg(getArea_, getArea_, getArea_);
+}
+
+void InputFilterBuf::seedInput(const uint8_t* p, std::size_t n) {
+    if (inEnd_ - inPos_ + n > inCap_) {
+        const std::size_t cap = inEnd_ - inPos_ + n;
+        std::unique_ptr<uint8_t[]> bigger(new uint8_t[cap]);
+        std::memcpy(bigger.get(), in_.get() + inPos_, inEnd_ - inPos_);
+        inEnd_ -= inPos_;
+        inPos_ = 0;
+        in_ = std::move(bigger);
+        inCap_ = cap;
+    } else if (inPos_ > 0) {
+        std::memmove(in_.get(), in_.get() + inPos_, inEnd_ - inPos_);
+        inEnd_ -= inPos_;
+        inPos_ = 0;
+    }
+    std::memcpy(in_.get() + inEnd_, p, n);
+    inEnd_ += n;
+}
+
+bool InputFilterBuf::refillInput() {
+    if (inPos_ > 0) {
+        std::memmove(in_.get(), in_.get() + inPos_, inEnd_ - inPos_);
+        inEnd_ -= inPos_;
+        inPos_ = 0;
+    }
+    if (inEnd_ == inCap_ || !source_) return false;
+    const std::size_t want = std::min(chunk_, inCap_ - inEnd_);
+    source_.read(reinterpret_cast<char*>(in_.get() + inEnd_), static_cast<std::streamsize>(want));
+    const std::streamsize got = source_.gcount();
+    if (got <= 0) return false;
+    inEnd_ += static_cast<std::size_t>(got);
+    return true;
+}
+
+InputFilterBuf::int_type InputFilterBuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    const std::size_t n = decode(reinterpret_cast<uint8_t*>(getArea_), sizeof(getArea_));
+    if (n == 0) return traits_type::eof();
+    setg(getArea_, getArea_, getArea_ + n);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize InputFilterBuf::xsgetn(char_type* s, std::streamsize n) {
+    std::streamsize done = 0;
+    const std::streamsize buffered = egptr() - gptr();
+    if (buffered > 0) {
+        const std::streamsize take = std::min(buffered, n);
+        std::memcpy(s, gptr(), static_cast<std::size_t>(take));
+        gbump(static_cast<int>(take));
+        done = take;
+    }
+    while (done < n) {
+        const std::size_t got = decode(reinterpret_cast<uint8_t*>(s + done), static_cast<std::size_t>(n - done));
+        if (got == 0) break;
+        done += static_cast<std::streamsize>(got);
+    }
+    return done;
+}
+
+} // namespace LXMLFormatter
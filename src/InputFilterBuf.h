@@ -0,0 +1,70 @@
+#ifndef LXMLFORMATTER_INPUTFILTERBUF_H
+#define LXMLFORMATTER_INPUTFILTERBUF_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+
+namespace LXMLFormatter {
+
+// Base for the read-only streambufs that sit between a source istream and
+// BufferedInputStream (DecompressingStreamBuf, TranscodingStreamBuf).
+// Subclasses implement decode(); read()/sgetn() hand it the caller's buffer, so
+// the result lands in the BufferedInputStream window without another copy. The
+// get area is only used by get()/peek() callers.
+class InputFilterBuf : public std::streambuf {
+public:
+    static constexpr std::size_t kInputChunk = 256u * 1024u; // source bytes per read
+
+    InputFilterBuf(const InputFilterBuf&)            = delete;
+    InputFilterBuf& operator=(const InputFilterBuf&) = delete;
+    ~InputFilterBuf() override = default;
+
+    // True once the source turned out corrupt or truncated; output stops there,
+    // so the consumer sees an early EOF.
+    bool failed() const noexcept { return failed_.load(std::memory_order_acquire); }
+
+protected:
+    InputFilterBuf(std::istream& source, std::size_t inputChunk);
+
+    // Produces up to 'cap' bytes at dst; returns the count (0 at end or error).
+    virtual std::size_t decode(uint8_t* dst, std::size_t cap) = 0;
+
+    // Appends the next source bytes to in_, moving unread bytes to the front
+    // first (so a multi-byte unit never straddles a refill). False at source EOF.
+    bool refillInput();
+
+    // Source bytes already read elsewhere (e.g. a stream's initial window) go first.
+    void seedInput(const uint8_t* p, std::size_t n);
+
+    std::size_t inputAvailable() const noexcept { return inEnd_ - inPos_; }
+    const uint8_t* inputData() const noexcept { return in_.get() + inPos_; }
+    void consumeInput(std::size_t n) noexcept { inPos_ += n; }
+
+    void fail() noexcept {
+        failed_.store(true, std::memory_order_release);
+        ended_ = true;
+    }
+
+    std::istream&              source_;
+    bool                       ended_ = false;
+
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize n) override;
+
+private:
+    std::size_t                chunk_;
+    std::unique_ptr<uint8_t[]> in_;
+    std::size_t                inCap_;
+    std::size_t                inPos_ = 0;
+    std::size_t                inEnd_ = 0;
+    std::atomic<bool>          failed_{false};
+    char                       getArea_[4096];
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_INPUTFILTERBUF_H
@@ -0,0 +1,135 @@
+/*
+    * Name interning table
+    * Version: 0.0.1
+    * License: MIT
+    *
+    * Maps element/attribute names to small integer ids (1..maxNames; 0 = not interned).
+    * Open addressing with linear probing over a power-of-two slot array kept at most
+    * half full; the hash is stored per slot so probes rarely touch the name bytes.
+    * Names are copied into one pool, so ids and name() views stay valid until clear().
+    * The table is bounded (DoS safety): once maxNames names are stored, intern()
+    * returns 0 for new names and callers fall back to comparing bytes.
+*/
+
+#ifndef LXMLFORMATTER_NAMETABLE_H
+#define LXMLFORMATTER_NAMETABLE_H
+
+#include "XMLTokenizerTypes.h"
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace LXMLFormatter {
+
+class NameTable {
+public:
+    static constexpr NameId kNone = 0;
+
+    explicit NameTable(U16 maxNames = 4096) noexcept : maxNames_(maxNames) {}
+
+    // Id for [s, s+len), inserting it if new; kNone if the table is full or allocation fails.
+    NameId intern(const char* s, U32 len) noexcept {
+        const U32 h = hash(s, len);
+        if (!slots_.empty()) {
+            const NameId id = probe(s, len, h);
+            if (id != kNone) return id;
+        }
+        if (entries_.size() >= maxNames_) return kNone;
+        try {
+            if ((entries_.size() + 1) * 2 > slots_.size()) rehash(slots_.empty() ? 64 : slots_.size() * 2);
+            const U32 off = static_cast<U32>(pool_.size());
+            pool_.insert(pool_.end(), s, s + len);
+            entries_.push_back(Entry{off, len});
+        } catch (...) {
+            return kNone;
+        }
+        const NameId id = static_cast<NameId>(entries_.size());
+        place(h, id);
+        return id;
+    }
+
+    // Id for [s, s+len) if already interned; kNone otherwise. Never inserts.
+    NameId find(const char* s, U32 len) const noexcept {
+        return slots_.empty() ? kNone : probe(s, len, hash(s, len));
+    }
+
+    // Bytes of an interned name; empty for kNone or unknown ids.
+    std::string_view name(NameId id) const noexcept {
+        if (id == kNone || id > entries_.size()) return {};
+        const Entry& e = entries_[id - 1];
+        return std::string_view(pool_.data() + e.off, e.len);
+    }
+
+    size_t size() const noexcept { return entries_.size(); }
+    U16    maxNames() const noexcept { return maxNames_; }
+
+    // Heap bytes held, capacity included.
+    size_t memoryBytes() const noexcept {
+        return slots_.capacity() * sizeof(Slot) + entries_.capacity() * sizeof(Entry) + pool_.capacity();
+    }
+
+    // Forgets every name; ids are handed out from 1 again. Capacity is kept.
+    void clear() noexcept {
+        slots_.clear();
+        entries_.clear();
+        pool_.clear();
+    }
+
+    // clear(), and the memory is freed too.
+    void release() noexcept {
+        std::vector<Slot>().swap(slots_);
+        std::vector<Entry>().swap(entries_);
+        std::vector<char>().swap(pool_);
+    }
+
+private:
+    struct Slot  { U32 hash = 0; NameId id = kNone; };
+    struct Entry { U32 off = 0; U32 len = 0; };
+
+    std::vector<Slot>  slots_;   // power-of-two size, <= 50% full
+    std::vector<Entry> entries_; // entries_[id - 1]
+    std::vector<char>  pool_;    // name bytes (offsets, so growth is fine)
+    U16                maxNames_;
+
+    // FNV-1a over the bytes, mixed with the length. Names are short, so this beats
+    // anything that needs a setup step.
+    static U32 hash(const char* s, U32 len) noexcept {
+        U32 h = 2166136261u ^ len;
+        for (U32 i = 0; i < len; ++i) {
+            h ^= static_cast<U8>(s[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    NameId probe(const char* s, U32 len, U32 h) const noexcept {
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot& sl = slots_[i];
+            if (sl.id == kNone) return kNone;
+            if (sl.hash == h) {
+                const Entry& e = entries_[sl.id - 1];
+                if (e.len == len && std::memcmp(pool_.data() + e.off, s, len) == 0) return sl.id;
+            }
+        }
+    }
+
+    void place(U32 h, NameId id) noexcept {
+        const size_t mask = slots_.size() - 1;
+        size_t i = h & mask;
+        while (slots_[i].id != kNone) i = (i + 1) & mask;
+        slots_[i] = Slot{h, id};
+    }
+
+    void rehash(size_t newSize) {
+        std::vector<Slot> old(newSize);
+        old.swap(slots_);
+        for (const Slot& sl : old) {
+            if (sl.id != kNone) place(sl.hash, sl.id);
+        }
+    }
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_NAMETABLE_H
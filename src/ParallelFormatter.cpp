@@ -0,0 +1,388 @@
+#include "ParallelFormatter.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+namespace LXMLFormatter {
+
+namespace {
+    constexpr std::size_t kTokenBatch = 256;
+    constexpr std::size_t kChunkOutputBuffer = 256u * 1024u;
+
+    // Tokenizer options for chunks and for the sequential redo: both start at an
+    // element boundary, and errors are logged by the stitcher with document positions.
+    // An error stops the run (a chunk's repairs could not be checked by the stitcher).
+    TokenizerOptions fragmentOptions(TokenizerOptions o) noexcept {
+        o.flags |= TokenizerOptions::Fragment | TokenizerOptions::QuietErrors;
+        o.flags &= ~TokenizerOptions::RecoverErrors;
+        return o;
+    }
+}
+
+// Element names in one pooled string; the stitcher's open-element stack and the
+// per-chunk lists of closed/still-open names.
+class ParallelFormatter::NameStack {
+public:
+    void push(const char* p, std::size_t n) {
+        pool_.append(p, n);
+        ends_.push_back(pool_.size());
+    }
+    void push(std::string_view s) { push(s.data(), s.size()); }
+    void pop() noexcept {
+        ends_.pop_back();
+        pool_.resize(ends_.empty() ? 0 : ends_.back());
+    }
+    bool empty() const noexcept { return ends_.empty(); }
+    std::size_t size() const noexcept { return ends_.size(); }
+
+    // i-th name from the bottom (or in push order).
+    std::string_view at(std::size_t i) const noexcept {
+        const std::size_t b = i ? ends_[i - 1] : 0;
+        return std::string_view(pool_.data() + b, ends_[i] - b);
+    }
+    std::string_view top() const noexcept { return at(ends_.size() - 1); }
+
+private:
+    std::string pool_;
+    std::vector<std::size_t> ends_;
+};
+
+struct ParallelFormatter::Chunk {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    std::string text;                   // formatted output, indents left out
+    XMLFormatter::FragmentResult frag;
+    NameStack closed;                   // end tags of outer elements, in order
+    NameStack open;                     // elements still open at the end, bottom up
+    Position  endPos;                   // line/column at the end, relative to the chunk
+    bool ok = false;                    // formatted to its end with no error
+};
+
+namespace {
+    // Chunk-relative line/column -> document position, given the chunk start.
+    template <typename Pos>
+    Pos absolute(const Pos& base, U32 line, U32 column) noexcept {
+        Pos p;
+        p.line   = base.line + line - 1;
+        p.column = (line == 1) ? base.column + column - 1 : column;
+        return p;
+    }
+}
+
+ParallelFormatter::ParallelFormatter(BufferedOutputStream& out, FormatterOptions fopts,
+                                     ParallelOptions popts, TokenizerOptions topts,
+                                     TokenizerLimits lims)
+    : out_(out), fopts_(fopts), popts_(popts), topts_(topts), lims_(lims)
+{
+    // References are passed through as written: nothing to decode and escape again.
+    topts_.flags &= ~TokenizerOptions::ExpandInternalEntities;
+}
+
+// A boundary is a '<' that starts a start tag with only whitespace back to the
+// previous '>': most likely element content, not text, and never inside a tag.
+// It may still be inside a comment, CDATA or PI; the stitcher finds out.
+std::vector<uint64_t> ParallelFormatter::findBoundaries(const uint8_t* data, std::size_t len) const {
+    std::vector<uint64_t> b{0};
+    const std::size_t step = std::max<std::size_t>(popts_.chunkBytes, 1);
+
+    uint64_t target = step;
+    while (target < len) {
+        const std::size_t limit = static_cast<std::size_t>(std::min<uint64_t>(len, target + step));
+        std::size_t pos = static_cast<std::size_t>(target);
+        bool found = false;
+        while (pos < limit) {
+            const void* hit = std::memchr(data + pos, '<', limit - pos);
+            if (!hit) break;
+            const std::size_t q = static_cast<std::size_t>(static_cast<const uint8_t*>(hit) - data);
+            if (q + 1 < len && CharClass::isNameStart(data[q + 1])) {
+                std::size_t r = q;
+                while (r > b.back() && CharClass::isXMLWhitespace(data[r - 1])) --r;
+                if (r > b.back() && data[r - 1] == '>') {
+                    b.push_back(q);
+                    found = true;
+                    break;
+                }
+            }
+            pos = q + 1;
+        }
+        // No boundary in this window: the chunk simply grows by another step.
+        target = (found ? b.back() : target) + step;
+    }
+    return b;
+}
+
+void ParallelFormatter::formatChunk(const uint8_t* data, Chunk& c, bool first) const {
+    c.ok = false;
+    try {
+        const std::size_t n = static_cast<std::size_t>(c.end - c.begin);
+        c.text.reserve(n + n / 4);
+        auto view = BufferedInputStream::CreateView(data + c.begin, n, c.begin);
+        auto sink = BufferedOutputStream::CreateString(c.text, kChunkOutputBuffer);
+        if (!view || !sink) return;
+
+        XMLTokenizer tz(*view, fragmentOptions(topts_), lims_);
+        XMLFormatter fmt(*sink, fopts_);
+        fmt.beginFragment(first);
+        fmt.setRawSource(data + c.begin, n, c.begin, topts_.normalizeLineEndings());
+
+        alignas(64) XMLToken batch[kTokenBatch];
+        bool started = first;   // later chunks must open with the start tag they were cut at
+        bool done = false;
+        while (!done) {
+            const std::size_t got = tz.nextTokens(batch, kTokenBatch);
+            if (got == 0) return;
+            for (std::size_t i = 0; i < got; ++i) {
+                const XMLToken& t = batch[i];
+                if (t.type == XMLTokenType::DocumentStart) continue;
+                if (!started) {
+                    if (t.type != XMLTokenType::StartTag || t.byteOffset != c.begin) return;
+                    started = true;
+                }
+                switch (t.type) {
+                    case XMLTokenType::StartTag: c.open.push(t.data, t.length); break;
+                    case XMLTokenType::EmptyTag: c.open.pop(); break;
+                    case XMLTokenType::EndTag:
+                        if (c.open.empty()) c.closed.push(t.data, t.length);
+                        else c.open.pop();
+                        break;
+                    case XMLTokenType::Error:       return;
+                    case XMLTokenType::DocumentEnd: done = true; break;
+                    default: break;
+                }
+                if (!fmt.consume(t)) return;
+            }
+        }
+        c.frag = fmt.endFragment();
+        if (!sink->flush()) return;
+        c.endPos = Position{ static_cast<U32>(view->getCurrentLine()), static_cast<U32>(view->getCurrentColumn()) };
+        c.ok = true;
+    } catch (const std::bad_alloc&) {
+        c.ok = false;   // redone sequentially
+    }
+}
+
+long ParallelFormatter::redoFrom(const uint8_t* data, std::size_t len, const std::vector<Chunk>& chunks,
+                                 std::size_t index, XMLFormatter& fmt, NameStack& names, Position& base)
+{
+    const uint64_t begin = chunks[index].begin;
+    auto view = BufferedInputStream::CreateView(data + begin, static_cast<std::size_t>(len - begin), begin);
+    if (!view) return -1;
+    XMLTokenizer tz(*view, fragmentOptions(topts_), lims_);
+
+    auto fail = [&](TokenizerError e) -> long {
+        const Position p = absolute(base, e.where.line, e.where.column);
+        e.where.line   = p.line;
+        e.where.column = p.column;
+        report(e);
+        return -1;
+    };
+
+    std::size_t k = index + 1;
+    XMLToken t;
+    while (tz.nextToken(t)) {
+        switch (t.type) {
+            case XMLTokenType::DocumentStart:
+                continue;
+            case XMLTokenType::Error:
+                return tz.errors().empty() ? -1 : fail(tz.errors().back());
+            case XMLTokenType::DocumentEnd:
+                base = absolute(base, t.line, t.column);
+                return static_cast<long>(chunks.size());
+            default:
+                break;
+        }
+
+        // Back on a chunk boundary at a token boundary: the chunk's own result applies again.
+        while (k < chunks.size() && chunks[k].begin < t.byteOffset) ++k;
+        if (k < chunks.size() && chunks[k].begin == t.byteOffset && t.type == XMLTokenType::StartTag) {
+            base = absolute(base, t.line, t.column);
+            return static_cast<long>(k);
+        }
+
+        if (t.type == XMLTokenType::StartTag) {
+            names.push(t.data, t.length);
+        } else if (t.type == XMLTokenType::EndTag) {
+            if (names.empty() || names.top() != std::string_view(t.data, t.length)) {
+                // What the tokenizer reports for the whole document.
+                TokenizerError e;
+                e.code  = TokenizerErrorCode::MismatchedEndTag;
+                e.sev   = ErrorSeverity::Fatal;
+                e.where = SourcePosition{};
+                e.where.byteOffset = t.byteOffset;
+                e.where.line   = t.line;
+                e.where.column = t.column;
+                e.msg = names.empty() ? "End tag without matching start tag"
+                                      : "End tag does not match open element";
+                return fail(e);
+            }
+            names.pop();
+        } else if (t.type == XMLTokenType::EmptyTag) {
+            names.pop();
+        }
+        if (!fmt.consume(t)) return -1;
+    }
+    return static_cast<long>(chunks.size());
+}
+
+void ParallelFormatter::report(const TokenizerError& e, bool logged) {
+    lastErrorMsg_.assign(e.msg.data(), e.msg.size());
+    lastError_ = e;
+    lastError_.msg = lastErrorMsg_;
+    if (!logged && !topts_.quietErrors()) XMLTokenizer::logError(lastError_);
+}
+
+bool ParallelFormatter::runSequential(BufferedInputStream& in) {
+    XMLTokenizer tz(in, topts_, lims_);
+    XMLFormatter fmt(out_, fopts_);
+    const bool ok = fmt.run(tz);
+    if (tz.errorCount() != 0) report(tz.lastError(), true);
+    return ok;
+}
+
+bool ParallelFormatter::run(BufferedInputStream& in) {
+    chunks_ = 0;
+    fallbacks_ = 0;
+    lastError_ = TokenizerError{};
+    lastErrorMsg_.clear();
+
+    std::size_t len = 0;
+    const uint8_t* data = in.mappedContent(len);
+    if (!data || in.baseOffset() != 0) return runSequential(in);
+
+    const std::vector<uint64_t> bounds = findBoundaries(data, len);
+    if (bounds.size() < 2) return runSequential(in);
+
+    std::vector<Chunk> chunks(bounds.size());
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+        chunks[i].begin = bounds[i];
+        chunks[i].end   = (i + 1 < bounds.size()) ? bounds[i + 1] : len;
+    }
+    chunks_ = chunks.size();
+
+    unsigned threads = popts_.threads ? popts_.threads : std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    const std::size_t window = popts_.maxInFlight ? popts_.maxInFlight : 2u * threads;
+
+    // Workers take chunks in order but stay within 'window' chunks of the stitcher,
+    // which bounds the memory held by formatted-but-unwritten output.
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<char> ready(chunks.size(), 0);
+    std::size_t next = 0;
+    std::size_t applied = 0;
+    bool stop = false;
+
+    auto worker = [&]() {
+        for (;;) {
+            std::size_t i;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return stop || next >= chunks.size() || next < applied + window; });
+                if (stop || next >= chunks.size()) return;
+                i = next++;
+            }
+            formatChunk(data, chunks[i], i == 0);
+            {
+                std::lock_guard<std::mutex> lock(m);
+                ready[i] = 1;
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    try {
+        for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    } catch (const std::system_error&) {
+        if (pool.empty()) return runSequential(in);
+    }
+
+    auto waitFor = [&](std::size_t i) {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&] { return ready[i] != 0; });
+    };
+    auto release = [&](std::size_t i) {
+        std::string().swap(chunks[i].text);
+        chunks[i].frag = XMLFormatter::FragmentResult{};
+        {
+            std::lock_guard<std::mutex> lock(m);
+            applied = i + 1;
+        }
+        cv.notify_all();
+    };
+
+    XMLFormatter fmt(out_, fopts_);
+    fmt.setRawSource(data, len, 0, topts_.normalizeLineEndings());
+    NameStack names;
+    Position base;
+    bool ok = true;
+
+    std::size_t i = 0;
+    while (i < chunks.size()) {
+        waitFor(i);
+        Chunk& c = chunks[i];
+
+        bool closesMatch = c.ok && c.closed.size() <= names.size();
+        for (std::size_t j = 0; closesMatch && j < c.closed.size(); ++j) {
+            closesMatch = (c.closed.at(j) == names.at(names.size() - 1 - j));
+        }
+        if (closesMatch && fmt.applyFragment(c.frag, c.text.data(), c.text.size(), c.begin)) {
+            for (std::size_t j = 0; j < c.closed.size(); ++j) names.pop();
+            for (std::size_t j = 0; j < c.open.size(); ++j) names.push(c.open.at(j));
+            base = absolute(base, c.endPos.line, c.endPos.column);
+            release(i);
+            ++i;
+            continue;
+        }
+        if (!out_.good()) {
+            ok = false;
+            break;
+        }
+
+        ++fallbacks_;
+        const long stopAt = redoFrom(data, len, chunks, i, fmt, names, base);
+        if (stopAt < 0) {
+            ok = false;
+            break;
+        }
+        for (std::size_t j = i; j < static_cast<std::size_t>(stopAt); ++j) {
+            waitFor(j);     // a worker may still be writing it
+            release(j);
+        }
+        i = static_cast<std::size_t>(stopAt);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stop = true;
+    }
+    cv.notify_all();
+    for (std::thread& t : pool) t.join();
+
+    if (ok) {
+        if (!names.empty()) {
+            TokenizerError e;
+            e.code  = TokenizerErrorCode::UnexpectedEOF;
+            e.sev   = ErrorSeverity::Fatal;
+            e.where.byteOffset = len;
+            e.where.line   = base.line;
+            e.where.column = base.column;
+            e.msg = "Unclosed tag at end of document";
+            report(e);
+            ok = false;
+        } else {
+            XMLToken end;
+            end.type       = XMLTokenType::DocumentEnd;
+            end.byteOffset = len;
+            ok = fmt.consume(end);
+        }
+    }
+    return out_.flush() && ok;
+}
+
+} // namespace LXMLFormatter
@@ -0,0 +1,96 @@
+#ifndef LXMLFORMATTER_PARALLELFORMATTER_H
+#define LXMLFORMATTER_PARALLELFORMATTER_H
+
+#include "XMLFormatter.h"
+#include <cstddef>
+#include <string>
+
+namespace LXMLFormatter {
+
+struct ParallelOptions {
+    unsigned    threads = 0;               // workers; 0 = hardware concurrency
+    std::size_t chunkBytes = 8u << 20;     // target chunk size (8MB)
+    std::size_t maxInFlight = 0;           // chunks formatted ahead of the writer; 0 = 2 * threads
+};
+
+// Formats a mapped document on several cores with the output of XMLFormatter::run().
+//
+// The input is cut into chunks at speculative element boundaries: a '<' that
+// starts a start tag and follows a '>' with only whitespace in between. Workers
+// tokenize their chunk as a fragment (TokenizerOptions::Fragment) and format it
+// at an unknown depth (XMLFormatter::beginFragment), recording indents instead of
+// writing them. The calling thread stitches the chunks in order: it checks the end
+// tags that closed outer elements against its own open-element stack, places the
+// recorded indents at the real depth and carries formatter state across.
+//
+// A chunk whose speculation does not hold (its start was inside markup, an outer
+// element turned out to hold text, a tokenizer error, ...) is redone sequentially
+// from its start with the exact state, until a later chunk boundary is reached on
+// a token boundary; errors are reported from that sequential pass with document
+// positions, exactly once.
+//
+// ExpandInternalEntities in 'topts' is ignored: references are copied as written.
+// So is RecoverErrors: the first error stops the run. QuietErrors is honoured;
+// lastError() has the error either way.
+class ParallelFormatter {
+public:
+    ParallelFormatter(BufferedOutputStream& out,
+                      FormatterOptions fopts = {},
+                      ParallelOptions popts = {},
+                      TokenizerOptions topts = {},
+                      TokenizerLimits lims = {});
+
+    ParallelFormatter(const ParallelFormatter&)            = delete;
+    ParallelFormatter& operator=(const ParallelFormatter&) = delete;
+
+    // Formats the whole mapped input 'in' (see BufferedInputStream::CreateMapped).
+    // Input that is not mapped, or too small to split, is formatted sequentially.
+    // Returns false on malformed XML or output failure, like XMLFormatter::run().
+    bool run(BufferedInputStream& in);
+
+    // Chunks of the last run, and how many of them had to be redone sequentially.
+    std::size_t chunks() const noexcept { return chunks_; }
+    std::size_t fallbacks() const noexcept { return fallbacks_; }
+
+    // The error that made the last run() fail (code None when it was the output
+    // that failed); its message stays valid until the next run().
+    const TokenizerError& lastError() const noexcept { return lastError_; }
+
+private:
+    struct Chunk;
+    struct Position { U32 line = 1; U32 column = 1; };
+    class NameStack;
+
+    BufferedOutputStream& out_;
+    FormatterOptions      fopts_;
+    ParallelOptions       popts_;
+    TokenizerOptions      topts_;
+    TokenizerLimits       lims_;
+    std::size_t           chunks_ = 0;
+    std::size_t           fallbacks_ = 0;
+    TokenizerError        lastError_{};
+    std::string           lastErrorMsg_;      // lastError_.msg points here
+
+    // Speculative chunk starts in (0, len); always begins with 0.
+    std::vector<uint64_t> findBoundaries(const uint8_t* data, std::size_t len) const;
+
+    // Worker: formats one chunk as a fragment into c.
+    void formatChunk(const uint8_t* data, Chunk& c, bool first) const;
+
+    // Sequential pass over data[begin..) with 'fmt' and 'names' in their exact state.
+    // Returns the index of the chunk boundary it stopped at, chunks.size() at EOF,
+    // or -1 on error (already logged).
+    long redoFrom(const uint8_t* data, std::size_t len, const std::vector<Chunk>& chunks,
+                  std::size_t index, XMLFormatter& fmt, NameStack& names, Position& base);
+
+    // Keeps 'e' as lastError() and logs it unless QuietErrors is set or the
+    // tokenizer that produced it has already done so.
+    void report(const TokenizerError& e, bool logged = false);
+
+    // Sequential fallback for input that cannot be split.
+    bool runSequential(BufferedInputStream& in);
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_PARALLELFORMATTER_H
@@ -0,0 +1,182 @@
+#include "PipelinedFormatter.h"
+
+#include <algorithm>
+#include <system_error>
+#include <thread>
+
+namespace LXMLFormatter {
+
+namespace {
+    constexpr std::size_t kNoCopy = static_cast<std::size_t>(-1);
+    constexpr std::size_t kMinBatchTokens = 16;     // room for a start tag and its attributes
+    constexpr std::size_t kSinkBuffer = 64u * 1024u;
+}
+
+PipelinedFormatter::PipelinedFormatter(BufferedOutputStream& out, FormatterOptions fopts,
+                                       PipelineOptions popts, TokenizerOptions topts,
+                                       TokenizerLimits lims)
+    : out_(out), fopts_(fopts), popts_(popts), topts_(topts), lims_(lims)
+{
+    // References are passed through as written: nothing to decode and escape again.
+    topts_.flags &= ~TokenizerOptions::ExpandInternalEntities;
+    popts_.batchTokens = std::max(popts_.batchTokens, kMinBatchTokens);
+    popts_.outputBlock = std::max<std::size_t>(popts_.outputBlock, 1);
+}
+
+// Offsets first, pointers at the end: the slab may grow while the batch fills.
+void PipelinedFormatter::copyTokenData(Batch& b, std::size_t from, bool stableSlices) {
+    for (std::size_t i = from; i < b.count; ++i) {
+        const XMLToken& t = b.tokens[i];
+        if (!t.data || (stableSlices && t.isInputSlice())) {
+            b.offsets[i] = kNoCopy;
+            continue;
+        }
+        b.offsets[i] = b.slab.size();
+        b.slab.append(t.data, t.length);
+    }
+}
+
+void PipelinedFormatter::tokenizeStage(BufferedInputStream& in, Channels& ch) const noexcept {
+    try {
+        XMLTokenizer tz(in, topts_, lims_);
+        const bool stableSlices = in.isMapped();
+        bool ended = false;
+        while (!ended) {
+            Batch* b = nullptr;
+            if (!ch.freeBatches.pop(b)) return;    // formatter stopped
+            b->count = 0;
+            b->last = false;
+            b->slab.clear();
+
+            // Several nextTokens() calls per batch (each stops at Text or markup); every
+            // call's bytes are copied out before the next one reuses the storage.
+            while (b->count + kMinBatchTokens <= b->tokens.size() && b->slab.size() < popts_.slabBytes) {
+                const std::size_t from = b->count;
+                const std::size_t n = tz.nextTokens(b->tokens.data() + from, b->tokens.size() - from);
+                if (n == 0) {
+                    ended = true;
+                    break;
+                }
+                b->count += n;
+                copyTokenData(*b, from, stableSlices);
+                const XMLToken& last = b->tokens[b->count - 1];
+                if (last.type == XMLTokenType::DocumentEnd ||
+                    (last.type == XMLTokenType::Error && !last.isRecovered())) {
+                    ended = true;
+                    break;
+                }
+            }
+            b->last = ended;
+            for (std::size_t i = 0; i < b->count; ++i) {
+                if (b->offsets[i] != kNoCopy) b->tokens[i].data = b->slab.data() + b->offsets[i];
+            }
+            if (!ch.fullBatches.push(std::move(b))) return;
+        }
+    } catch (...) {
+        // Allocation failure while copying: the formatter sees the queue close early.
+        ch.tokenizerFailed.store(true, std::memory_order_release);
+        ch.fullBatches.close();
+    }
+}
+
+void PipelinedFormatter::writeStage(Channels& ch) noexcept {
+    std::string* block = nullptr;
+    while (ch.fullBlocks.pop(block)) {
+        out_.write(block->data(), block->size());
+        block->clear();
+        if (!out_.good()) {
+            ch.writerFailed.store(true, std::memory_order_release);
+            ch.abort();
+            return;
+        }
+        ch.freeBlocks.push(std::move(block));
+    }
+}
+
+bool PipelinedFormatter::run(BufferedInputStream& in) {
+    batches_ = 0;
+
+    Channels ch;
+    std::vector<std::unique_ptr<Batch>> batchPool;
+    std::vector<std::unique_ptr<std::string>> blockPool;
+    std::string current;
+    std::unique_ptr<BufferedOutputStream> sink;
+    try {
+        for (std::size_t i = 0; i < kBatches; ++i) {
+            batchPool.push_back(std::make_unique<Batch>());
+            batchPool.back()->tokens.resize(popts_.batchTokens);
+            batchPool.back()->offsets.resize(popts_.batchTokens);
+            batchPool.back()->slab.reserve(popts_.slabBytes + popts_.slabBytes / 4);
+            Batch* b = batchPool.back().get();
+            ch.freeBatches.tryPush(std::move(b));
+        }
+        // One block is filled by the formatter while the others wait for or sit in the writer.
+        for (std::size_t i = 0; i + 1 < kBlocks; ++i) {
+            blockPool.push_back(std::make_unique<std::string>());
+            blockPool.back()->reserve(popts_.outputBlock + kSinkBuffer);
+            std::string* s = blockPool.back().get();
+            ch.freeBlocks.tryPush(std::move(s));
+        }
+        current.reserve(popts_.outputBlock + kSinkBuffer);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    sink = BufferedOutputStream::CreateString(current, kSinkBuffer);
+    if (!sink) return false;
+
+    std::thread writer;
+    std::thread tokenizer;
+    try {
+        writer = std::thread([this, &ch] { writeStage(ch); });
+        tokenizer = std::thread([this, &in, &ch] { tokenizeStage(in, ch); });
+    } catch (const std::system_error&) {
+        ch.abort();
+        if (writer.joinable()) writer.join();
+        return false;
+    }
+
+    XMLFormatter fmt(*sink, fopts_);
+    if (fopts_.minify && !topts_.recoverErrors()) {
+        std::size_t rawLen = 0;
+        const uint8_t* raw = in.mappedContent(rawLen);
+        if (raw) fmt.setRawSource(raw, rawLen, in.baseOffset(), topts_.normalizeLineEndings());
+    }
+
+    // Hands the formatted bytes to the writer, swapping in an empty block.
+    auto handOff = [&]() -> bool {
+        if (!sink->flush()) return false;
+        std::string* next = nullptr;
+        if (!ch.freeBlocks.pop(next)) return false;
+        next->swap(current);
+        return ch.fullBlocks.push(std::move(next));
+    };
+
+    bool ok = true;
+    bool ended = false;
+    while (ok && !ended) {
+        Batch* b = nullptr;
+        if (!ch.fullBatches.pop(b)) {
+            ok = false;     // tokenizer failed or the writer aborted
+            break;
+        }
+        ++batches_;
+        for (std::size_t i = 0; i < b->count && ok; ++i) ok = fmt.consume(b->tokens[i]);
+        ended = b->last;
+        ch.freeBatches.push(std::move(b));
+        if (ok && current.size() >= popts_.outputBlock) ok = handOff();
+    }
+    // Output up to a malformed token is written, as XMLFormatter::run() does.
+    const bool handed = !ch.writerFailed.load() && handOff();
+    ok = ok && handed;
+
+    if (!ok) ch.abort();
+    ch.fullBlocks.close();      // writer drains what is queued, then exits
+    ch.freeBatches.close();     // tokenizer stops if it is still running
+    tokenizer.join();
+    writer.join();
+
+    ok = ok && !ch.tokenizerFailed.load() && !ch.writerFailed.load();
+    return out_.flush() && ok && fmt.recoveredErrors() == 0;
+}
+
+} // namespace LXMLFormatter
@@ -0,0 +1,103 @@
+#ifndef LXMLFORMATTER_PIPELINEDFORMATTER_H
+#define LXMLFORMATTER_PIPELINEDFORMATTER_H
+
+#include "XMLFormatter.h"
+#include "SPSCQueue.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace LXMLFormatter {
+
+struct PipelineOptions {
+    std::size_t batchTokens = 1024;       // tokens per batch
+    std::size_t slabBytes = 256u << 10;   // token bytes per batch before it is handed on
+    std::size_t outputBlock = 1u << 20;   // formatted bytes per block handed to the writer
+};
+
+// Runs tokenizing, formatting and writing on separate threads, with the output of
+// XMLFormatter::run(). Reading overlaps too when the input is CreatePrefetched
+// (mapped input is read by page faults in the tokenizer stage).
+//
+//   tokenizer thread --Batch--> calling thread (XMLFormatter) --block--> writer thread
+//
+// Stages are joined by bounded SPSCQueues, each paired with a return queue, so a
+// fixed set of batches and output blocks circulates and nothing is allocated in
+// the steady state. A batch owns a slab with a copy of every token's bytes (tag
+// and text storage in the tokenizer is reused as soon as it moves on); only
+// zero-copy Text slices of a mapped input are passed by pointer, since the mapping
+// outlives the run. A batch goes back to the tokenizer once it is formatted, which
+// is all the lifetime tracking the slabs need.
+//
+// ExpandInternalEntities in 'topts' is ignored: references are copied as written.
+class PipelinedFormatter {
+public:
+    PipelinedFormatter(BufferedOutputStream& out,
+                       FormatterOptions fopts = {},
+                       PipelineOptions popts = {},
+                       TokenizerOptions topts = {},
+                       TokenizerLimits lims = {});
+
+    PipelinedFormatter(const PipelinedFormatter&)            = delete;
+    PipelinedFormatter& operator=(const PipelinedFormatter&) = delete;
+
+    // Formats all of 'in'. Returns false on malformed XML (reported on stderr by
+    // the tokenizer; with RecoverErrors in 'topts' after formatting all of it),
+    // output failure or if a stage could not be started.
+    bool run(BufferedInputStream& in);
+
+    // Batches the last run passed from the tokenizer to the formatter.
+    std::size_t batches() const noexcept { return batches_; }
+
+private:
+    static constexpr std::size_t kBatches = 8;   // in circulation (queue capacity)
+    static constexpr std::size_t kBlocks  = 4;
+
+    struct Batch {
+        std::vector<XMLToken>    tokens;
+        std::vector<std::size_t> offsets;  // slab offset per token while filling; kNoCopy = keep pointer
+        std::string              slab;
+        std::size_t              count = 0;
+        bool                     last = false;   // ends with DocumentEnd or a fatal Error
+    };
+
+    // Queues and failure flags of one run.
+    struct Channels {
+        SPSCQueue<Batch*, kBatches>      fullBatches;
+        SPSCQueue<Batch*, kBatches>      freeBatches;
+        SPSCQueue<std::string*, kBlocks> fullBlocks;
+        SPSCQueue<std::string*, kBlocks> freeBlocks;
+        std::atomic<bool> tokenizerFailed{false};
+        std::atomic<bool> writerFailed{false};
+
+        // Stops every stage (error path).
+        void abort() noexcept {
+            fullBatches.close();
+            freeBatches.close();
+            fullBlocks.close();
+            freeBlocks.close();
+        }
+    };
+
+    BufferedOutputStream& out_;
+    FormatterOptions      fopts_;
+    PipelineOptions       popts_;
+    TokenizerOptions      topts_;
+    TokenizerLimits       lims_;
+    std::size_t           batches_ = 0;
+
+    // Tokenizer stage: fills batches until DocumentEnd/Error or shutdown.
+    void tokenizeStage(BufferedInputStream& in, Channels& ch) const noexcept;
+
+    // Writer stage: writes blocks to out_ until the queue is closed and drained.
+    void writeStage(Channels& ch) noexcept;
+
+    // Copies the bytes of b.tokens[from, b.count) into the slab (by offset).
+    static void copyTokenData(Batch& b, std::size_t from, bool stableSlices);
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_PIPELINEDFORMATTER_H
@@ -0,0 +1,126 @@
+/*
+    * Bounded single-producer/single-consumer queue
+    * Version: 0.0.1
+    * License: MIT
+    *
+    * Lock-free ring of Capacity slots (a power of two). head_ is written only by
+    * the consumer and tail_ only by the producer, each on its own cache line, so
+    * the fast path is one acquire load and one release store per operation.
+    * push()/pop() spin briefly, then yield a few times, then park on a condition
+    * variable while the ring is full/empty, so an idle stage costs no CPU. Every
+    * tryPush()/tryPop() wakes a parked other side (a fence and one load when
+    * nobody is parked); close() wakes both sides for shutdown or abort.
+*/
+
+#ifndef LXMLFORMATTER_SPSCQUEUE_H
+#define LXMLFORMATTER_SPSCQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace LXMLFormatter {
+
+template <typename T, std::size_t Capacity>
+class SPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SPSCQueue() = default;
+    SPSCQueue(const SPSCQueue&)            = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // Producer side. False if the ring is full.
+    bool tryPush(T&& v) noexcept {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) return false;
+        slots_[tail & (Capacity - 1)] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        wake();
+        return true;
+    }
+
+    // Consumer side. False if the ring is empty.
+    bool tryPop(T& out) noexcept {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (tail_.load(std::memory_order_acquire) == head) return false;
+        out = std::move(slots_[head & (Capacity - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        wake();
+        return true;
+    }
+
+    // Blocking variants; false once the queue is closed (pop drains first).
+    bool push(T&& v) noexcept {
+        for (unsigned spins = 0; !tryPush(std::move(v)); ++spins) {
+            if (closed()) return false;
+            backoff(spins, [this] { return !full() || closed(); });
+        }
+        return true;
+    }
+    bool pop(T& out) noexcept {
+        for (unsigned spins = 0; !tryPop(out); ++spins) {
+            if (closed()) return tryPop(out);
+            backoff(spins, [this] { return !empty() || closed(); });
+        }
+        return true;
+    }
+
+    void close() noexcept {
+        closed_.store(true, std::memory_order_release);
+        wake();
+    }
+    bool closed() const noexcept { return closed_.load(std::memory_order_acquire); }
+
+    // A push() or pop() is parked (for tests and diagnostics).
+    bool hasWaiter() const noexcept { return waiters_.load(std::memory_order_acquire) != 0; }
+
+private:
+    static constexpr unsigned kSpins  = 64;  // busy retries
+    static constexpr unsigned kYields = 64;  // then yields, then park
+
+    bool full() const noexcept {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire) == Capacity;
+    }
+    bool empty() const noexcept {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    template <class Ready>
+    void backoff(unsigned spins, Ready ready) noexcept {
+        if (spins < kSpins) return;
+        if (spins < kSpins + kYields) {
+            std::this_thread::yield();
+            return;
+        }
+        // Park. The waiter count is raised before 'ready' is checked under the
+        // lock, and wake() reads it after its store, so one of them sees the other.
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv_.wait(lock, ready);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0) return;
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        cv_.notify_all();
+    }
+
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::atomic<bool>        closed_{false};
+    std::atomic<unsigned>                waiters_{0};
+    std::mutex                           mutex_;
+    std::condition_variable              cv_;
+    T slots_[Capacity];
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_SPSCQUEUE_H
@@ -0,0 +1,250 @@
+/*
+    * SAX layer
+    * Version: 0.0.1
+    * License: MIT
+    *
+    * Turns XMLTokenizer tokens into element events for a handler that is a template
+    * parameter, so every callback is a direct (usually inlined) call inside the token
+    * loop: no virtual dispatch and no switch on XMLToken::type in user code.
+    *
+    * A handler derives from SaxHandler, whose callbacks do nothing, and hides the ones
+    * it wants (same name and parameters; no 'virtual'). A callback may return bool
+    * instead of void: false stops run().
+    *
+    *   struct Count : SaxHandler {
+    *       size_t items = 0;
+    *       void onStartElement(const SaxName& n, const SaxAttributes&) { items += n.text == "item"; }
+    *   };
+    *   Count c;
+    *   SaxParser<Count>(tz, c).run();
+    *
+    * Lifetimes are the tokenizer's: element names, attribute names and values point
+    * into the element's TagBuffer and stay valid until the element closes (after its
+    * onEndElement); text, comments, CDATA, PIs and the DOCTYPE are valid during their
+    * callback only. The SaxAttributes array itself is scratch of the parser, valid
+    * during onStartElement only.
+*/
+
+#ifndef LXMLFORMATTER_SAXPARSER_H
+#define LXMLFORMATTER_SAXPARSER_H
+
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace LXMLFormatter {
+
+struct SaxName {
+    std::string_view text;   // qualified name as written (prefix:local)
+    NameId           id = 0; // NameTable id with TokenizerOptions::InternNames; 0 otherwise
+};
+
+struct SaxAttribute {
+    SaxName          name;
+    std::string_view value;  // as the AttributeValue token has it (references expanded with ExpandInternalEntities)
+};
+
+// The attributes of one start tag, in document order.
+class SaxAttributes {
+public:
+    SaxAttributes(const SaxAttribute* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    const SaxAttribute& operator[](std::size_t i) const noexcept { return data_[i]; }
+    const SaxAttribute* begin() const noexcept { return data_; }
+    const SaxAttribute* end() const noexcept { return data_ + size_; }
+
+    // First attribute with this name; nullptr if there is none.
+    const SaxAttribute* find(std::string_view name) const noexcept {
+        for (const SaxAttribute& a : *this) {
+            if (a.name.text == name) return &a;
+        }
+        return nullptr;
+    }
+    const SaxAttribute* find(NameId id) const noexcept {
+        if (id == 0) return nullptr;
+        for (const SaxAttribute& a : *this) {
+            if (a.name.id == id) return &a;
+        }
+        return nullptr;
+    }
+
+private:
+    const SaxAttribute* data_;
+    std::size_t         size_;
+};
+
+// No-op callbacks; see the file comment.
+struct SaxHandler {
+    void onStartDocument() {}
+    void onStartElement(const SaxName&, const SaxAttributes&) {}
+    void onEndElement(const SaxName&) {}
+    // A chunked run (TokenizerOptions::ChunkedText) arrives in pieces; 'continued'
+    // is set on every piece but the last.
+    void onText(std::string_view, bool /*continued*/) {}
+    // CDATA content; chunked like text (a long section arrives in pieces).
+    void onCData(std::string_view, bool /*continued*/) {}
+    void onComment(std::string_view) {}
+    // 'data' starts after the whitespace that follows the target; the XML
+    // declaration is reported here too (target "xml") unless ReportXmlDecl is off.
+    void onProcessingInstruction(std::string_view /*target*/, std::string_view /*data*/) {}
+    // What follows "<!DOCTYPE ", internal subset included, unprocessed.
+    void onDoctype(std::string_view) {}
+    void onError(const TokenizerError&) {}
+    void onEndDocument() {}
+};
+
+template <class Handler>
+class SaxParser {
+public:
+    SaxParser(XMLTokenizer& tz, Handler& handler) : tz_(tz), handler_(handler) {
+        attrs_.reserve(16);
+    }
+
+    SaxParser(const SaxParser&)            = delete;
+    SaxParser& operator=(const SaxParser&) = delete;
+
+    // Feeds the rest of the document to the handler. True if it ended without an
+    // Error token and no callback stopped it. With TokenizerOptions::RecoverErrors
+    // it goes on after an error (onError, then the events of the repaired stream);
+    // an error inside a start tag, or right after one, comes before its element.
+    // With push input (CreatePush) it also returns when the bytes fed so far run
+    // out: if tz.needMoreInput(), feed() more and call run() again; a start tag cut
+    // off in between is delivered whole.
+    bool run() {
+        alignas(64) XMLToken batch[kTokenBatch];
+        while (!stopped_) {
+            const std::size_t n = tz_.nextTokens(batch, kTokenBatch);
+            if (n == 0) break;
+            for (std::size_t i = 0; i < n && !stopped_; ++i) dispatch(batch[i]);
+        }
+        return !stopped_ && !failed_;
+    }
+
+    // A callback returned false. Tokens are read in batches, so the tokenizer may
+    // already be past the event that stopped it.
+    bool stopped() const noexcept { return stopped_; }
+    bool failed() const noexcept { return failed_; }   // an Error token was seen
+
+private:
+    static constexpr std::size_t kTokenBatch = 256;
+
+    // Calls 'f'; a void callback always continues.
+    template <class F>
+    void call(F&& f) {
+        if constexpr (std::is_void_v<std::invoke_result_t<F>>) {
+            f();
+        } else {
+            if (!f()) stopped_ = true;
+        }
+    }
+
+    // Delivers the start tag collected so far; it is complete once a token other
+    // than an attribute follows it.
+    void flushStart() {
+        inStart_ = false;
+        const SaxAttributes attrs(attrs_.data(), attrs_.size());
+        call([&] { return handler_.onStartElement(start_, attrs); });
+    }
+
+    // An Error ends its batch, so state() is still where it was raised: inside the
+    // start tag (the tag is dropped) or after its '>' (the element is reported).
+    static bool insideStartTag(State s) noexcept {
+        switch (s) {
+            case State::StartTagName: case State::InTag: case State::AttrName:
+            case State::AfterAttrName: case State::BeforeAttrValue: case State::AttrValueQuoted:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static SaxName nameOf(const XMLToken& t) noexcept {
+        return SaxName{std::string_view(t.data, t.length), t.nameId};
+    }
+
+    void dispatch(const XMLToken& t) {
+        switch (t.type) {
+            case XMLTokenType::AttributeName:
+                attrs_.push_back(SaxAttribute{nameOf(t), {}});
+                return;
+            case XMLTokenType::AttributeValue:
+                if (!attrs_.empty()) attrs_.back().value = std::string_view(t.data, t.length);
+                return;
+            default:
+                break;
+        }
+        if (inStart_ && (t.type != XMLTokenType::Error || (!t.isRecovered() && !insideStartTag(tz_.state())))) {
+            flushStart();
+            if (stopped_) return;
+        }
+
+        switch (t.type) {
+            case XMLTokenType::StartTag:
+                start_ = nameOf(t);
+                attrs_.clear();
+                inStart_ = true;
+                break;
+            case XMLTokenType::EmptyTag:
+                call([&] { return handler_.onEndElement(start_); });
+                break;
+            case XMLTokenType::EndTag: {
+                const SaxName name = nameOf(t);
+                call([&] { return handler_.onEndElement(name); });
+                break;
+            }
+            case XMLTokenType::Text:
+                call([&] { return handler_.onText(std::string_view(t.data, t.length), t.isContinued()); });
+                break;
+            case XMLTokenType::CDATA:
+                call([&] { return handler_.onCData(std::string_view(t.data, t.length), t.isContinued()); });
+                break;
+            case XMLTokenType::Comment:
+                call([&] { return handler_.onComment(std::string_view(t.data, t.length)); });
+                break;
+            case XMLTokenType::PI: {
+                const std::string_view pi(t.data, t.length);
+                std::size_t n = 0;
+                while (n < pi.size() && !CharClass::isXMLWhitespace(static_cast<unsigned char>(pi[n]))) ++n;
+                std::size_t d = n;
+                while (d < pi.size() && CharClass::isXMLWhitespace(static_cast<unsigned char>(pi[d]))) ++d;
+                call([&] { return handler_.onProcessingInstruction(pi.substr(0, n), pi.substr(d)); });
+                break;
+            }
+            case XMLTokenType::DOCTYPE:
+                call([&] { return handler_.onDoctype(std::string_view(t.data, t.length)); });
+                break;
+            case XMLTokenType::DocumentStart:
+                call([&] { return handler_.onStartDocument(); });
+                break;
+            case XMLTokenType::DocumentEnd:
+                call([&] { return handler_.onEndDocument(); });
+                break;
+            case XMLTokenType::Error: {
+                // Unfinished: not reported, unless the tokenizer repairs it.
+                if (!t.isRecovered()) inStart_ = false;
+                failed_ = true;
+                call([&] { return handler_.onError(tz_.lastError()); });
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    XMLTokenizer&             tz_;
+    Handler&                  handler_;
+    std::vector<SaxAttribute> attrs_;    // attributes of the pending start tag
+    SaxName                   start_;    // its name
+    bool                      inStart_ = false;
+    bool                      stopped_ = false;
+    bool                      failed_  = false;
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_SAXPARSER_H
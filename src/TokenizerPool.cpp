@@ -0,0 +1,53 @@
+#include "TokenizerPool.h"
+
+#include <new>
+
+namespace LXMLFormatter {
+
+TokenizerPool::Lease TokenizerPool::acquire(std::istream& source, BufferedInputStream::StateError* err) {
+    if (!idle_.empty()) {
+        Entry entry = std::move(idle_.back());
+        idle_.pop_back();
+        if (!entry.in->rebind(source, err)) return Lease(); // out of memory; the pair is dropped
+        ++reuses_;
+        return Lease(this, std::move(entry));
+    }
+
+    Entry entry;
+    entry.in = BufferedInputStream::Create(source, config_.bufferSize, err);
+    if (!entry.in) return Lease();
+    try {
+        entry.tz = std::make_unique<XMLTokenizer>(*entry.in, config_.options, config_.limits, config_.memory);
+    } catch (const std::bad_alloc&) {
+        if (err) *err = BufferedInputStream::StateError::OutOfMemory;
+        return Lease();
+    }
+    ++creations_;
+    return Lease(this, std::move(entry));
+}
+
+void TokenizerPool::release(Entry entry) noexcept {
+    if (idle_.size() >= config_.maxIdle) return;
+    // Per-document hooks a caller may have set go with the document.
+    entry.tz->recordCheckpoints(nullptr);
+    entry.tz->setStateTiming(0);
+    if (!config_.keepNames) entry.tz->clearNames();
+    if (entry.tz->memoryInUse() + entry.tz->names().memoryBytes() > config_.maxRetainedBytes) {
+        entry.tz->releaseMemory();
+        entry.tz->clearNames(true);
+    } else {
+        entry.tz->reset();
+    }
+    try {
+        idle_.push_back(std::move(entry));
+    } catch (const std::bad_alloc&) {
+        // not kept
+    }
+}
+
+TokenizerPool& TokenizerPool::threadLocal() {
+    static thread_local TokenizerPool pool;
+    return pool;
+}
+
+} // namespace LXMLFormatter
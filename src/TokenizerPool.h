@@ -0,0 +1,110 @@
+#ifndef LXMLFORMATTER_TOKENIZERPOOL_H
+#define LXMLFORMATTER_TOKENIZERPOOL_H
+
+#include "BufferedInputStream.h"
+#include "XMLTokenizer.h"
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace LXMLFormatter {
+
+struct TokenizerPoolConfig {
+    std::size_t      bufferSize = 64u << 10;     // input buffer of each stream
+    TokenizerOptions options{};
+    TokenizerLimits  limits{};
+    std::pmr::memory_resource* memory = nullptr; // tokenizer buffers (nullptr = default resource)
+    std::size_t      maxIdle = 8;                // pairs kept between leases
+    std::size_t      maxRetainedBytes = 1u << 20; // tokenizer memory kept by an idle pair, NameTable included
+    // InternNames: keep a pair's interned names from one lease to the next, so its
+    // ids stay the same (each pair has its own table). Off, the table is cleared
+    // when the pair comes back: one document cannot use up maxInternedNames for
+    // every later one.
+    bool             keepNames = false;
+};
+
+// Stream + tokenizer pairs for many small documents. Constructing a pair costs an
+// input buffer and, on first use, the tokenizer's arenas and stack; a pooled pair
+// keeps all of them, so acquire() on a warm pool allocates nothing: the stream is
+// rebound to the new source (BufferedInputStream::rebind) and the tokenizer was
+// reset() when it came back. A pair whose tokenizer grew past maxRetainedBytes
+// (one unusually large document) gives that memory back instead of keeping it;
+// the NameTable counts toward the limit and is emptied with it, even with
+// keepNames.
+//
+// Not thread-safe: use one pool per thread, e.g. threadLocal(). A Lease must be
+// destroyed on the thread, and before the pool, it came from.
+class TokenizerPool {
+    struct Entry {
+        std::unique_ptr<BufferedInputStream> in;
+        std::unique_ptr<XMLTokenizer>        tz; // declared last: refers to *in
+    };
+
+public:
+    // One document's stream and tokenizer; goes back to the pool when destroyed.
+    class Lease {
+    public:
+        Lease() noexcept = default;
+        Lease(Lease&& o) noexcept : pool_(o.pool_), entry_(std::move(o.entry_)) { o.pool_ = nullptr; }
+        Lease& operator=(Lease&& o) noexcept {
+            if (this != &o) {
+                giveBack();
+                pool_ = o.pool_;
+                entry_ = std::move(o.entry_);
+                o.pool_ = nullptr;
+            }
+            return *this;
+        }
+        ~Lease() { giveBack(); }
+
+        explicit operator bool() const noexcept { return entry_.tz != nullptr; }
+        XMLTokenizer&        tokenizer() const noexcept { return *entry_.tz; }
+        BufferedInputStream& input() const noexcept { return *entry_.in; }
+
+    private:
+        friend class TokenizerPool;
+        Lease(TokenizerPool* pool, Entry&& entry) noexcept : pool_(pool), entry_(std::move(entry)) {}
+
+        void giveBack() noexcept {
+            if (pool_ && entry_.tz) pool_->release(std::move(entry_));
+            pool_ = nullptr;
+        }
+
+        TokenizerPool* pool_ = nullptr;
+        Entry          entry_;
+    };
+
+    explicit TokenizerPool(TokenizerPoolConfig config = {}) : config_(config) {}
+
+    TokenizerPool(const TokenizerPool&)            = delete;
+    TokenizerPool& operator=(const TokenizerPool&) = delete;
+
+    // A pair reading 'source' from its start, reused if one is idle. An empty Lease
+    // (and *err set) if a new stream cannot be created or the allocation fails.
+    Lease acquire(std::istream& source, BufferedInputStream::StateError* err = nullptr);
+
+    // This thread's pool, created with the default config on first use.
+    static TokenizerPool& threadLocal();
+
+    const TokenizerPoolConfig& config() const noexcept { return config_; }
+    std::size_t idle() const noexcept { return idle_.size(); }
+    std::size_t creations() const noexcept { return creations_; } // pairs constructed
+    std::size_t reuses() const noexcept { return reuses_; }        // acquires served from idle pairs
+
+    // Destroys the idle pairs.
+    void clear() noexcept { idle_.clear(); }
+
+private:
+    void release(Entry entry) noexcept; // by value: a pair not kept is destroyed here, tokenizer first
+
+    TokenizerPoolConfig config_;
+    std::vector<Entry>  idle_;
+    std::size_t         creations_ = 0;
+    std::size_t         reuses_ = 0;
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_TOKENIZERPOOL_H
@@ -0,0 +1,122 @@
+#include "TranscodingStreamBuf.h"
+#include "ByteScan.h"
+#include "UTF8Handler.h"
+
+#include <algorithm>
+
+namespace LXMLFormatter {
+
+namespace {
+    inline uint32_t load16(const uint8_t* p, bool be) noexcept {
+        return be ? (uint32_t(p[0]) << 8) | p[1] : (uint32_t(p[1]) << 8) | p[0];
+    }
+
+    inline uint32_t load32(const uint8_t* p, bool be) noexcept {
+        return be ? (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]
+                  : (uint32_t(p[3]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[1]) << 8) | p[0];
+    }
+}
+
+TranscodingStreamBuf::TranscodingStreamBuf(std::istream& source, Encoding from,
+                                           const uint8_t* prefix, std::size_t prefixLen,
+                                           std::size_t inputChunk)
+    : InputFilterBuf(source, inputChunk)
+    , from_(from)
+    , unit_((from == Encoding::UTF32_LE || from == Encoding::UTF32_BE) ? 4u : 2u)
+    , bigEndian_(from == Encoding::UTF16_BE || from == Encoding::UTF32_BE)
+{
+    if (prefixLen) seedInput(prefix, prefixLen);
+}
+
+bool TranscodingStreamBuf::supports(Encoding e) noexcept {
+    return e == Encoding::UTF16_LE || e == Encoding::UTF16_BE ||
+           e == Encoding::UTF32_LE || e == Encoding::UTF32_BE;
+}
+
+TranscodingStreamBuf::Step TranscodingStreamBuf::decodeOne(const uint8_t* p, std::size_t avail,
+                                                           uint32_t& cp, std::size_t& used) const noexcept {
+    if (unit_ == 4) {
+        cp = load32(p, bigEndian_);
+        used = 4;
+        return Step::Ok; // range and surrogates are checked by the encoder
+    }
+    const uint32_t u = load16(p, bigEndian_);
+    if (u < 0xD800 || u > 0xDFFF) {
+        cp = u;
+        used = 2;
+        return Step::Ok;
+    }
+    if (u > 0xDBFF) return Step::Invalid;           // low surrogate without a high one
+    if (avail < 4) return Step::NeedMore;
+    const uint32_t lo = load16(p + 2, bigEndian_);
+    if (lo < 0xDC00 || lo > 0xDFFF) return Step::Invalid;
+    cp = 0x10000u + ((u - 0xD800u) << 10) + (lo - 0xDC00u);
+    used = 4;
+    return Step::Ok;
+}
+
+std::size_t TranscodingStreamBuf::decode(uint8_t* dst, std::size_t cap) {
+    uint8_t* out = dst;
+    std::size_t room = cap;
+    while (room && pendPos_ < pendEnd_) {
+        *out++ = pending_[pendPos_++];
+        --room;
+    }
+
+    while (room && !ended_) {
+        // Keep a whole surrogate pair / UTF-32 unit in view.
+        if (inputAvailable() < 4 && !sourceEnded_ && !refillInput()) sourceEnded_ = true;
+        const std::size_t avail = inputAvailable();
+        if (avail < unit_) {
+            if (!sourceEnded_) continue;  // short read; try again
+            if (avail) fail();            // truncated final unit
+            ended_ = true;
+            break;
+        }
+        const uint8_t* p = inputData();
+
+        // ASCII runs map 1:1 onto UTF-8 bytes.
+        std::size_t n = 0;
+        const std::size_t units = std::min<std::size_t>(avail / unit_, room);
+        if (unit_ == 2) {
+            n = ByteScan::narrowAscii16(p, units, bigEndian_, out);
+        } else {
+            while (n < units) {
+                const uint32_t cp = load32(p + 4 * n, bigEndian_);
+                if (cp >= 0x80) break;
+                out[n++] = static_cast<uint8_t>(cp);
+            }
+        }
+        if (n) {
+            consumeInput(n * unit_);
+            out += n;
+            room -= n;
+            continue;
+        }
+
+        uint32_t cp = 0;
+        std::size_t used = 0;
+        const Step st = decodeOne(p, avail, cp, used);
+        if (st == Step::NeedMore && !sourceEnded_) continue; // refilled at the top
+        uint8_t utf8[4];
+        const UTF8Handler::EncodeResult enc = st == Step::Ok ? UTF8Handler::encode(cp, utf8)
+                                                             : UTF8Handler::EncodeResult{};
+        if (enc.status != UTF8Handler::EncodeStatus::Ok) {
+            fail();
+            break;
+        }
+        consumeInput(used);
+        const std::size_t now = std::min<std::size_t>(enc.width, room);
+        std::copy(utf8, utf8 + now, out);
+        out += now;
+        room -= now;
+        if (now < enc.width) {
+            std::copy(utf8 + now, utf8 + enc.width, pending_);
+            pendPos_ = 0;
+            pendEnd_ = static_cast<uint8_t>(enc.width - now);
+        }
+    }
+    return cap - room;
+}
+
+} // namespace LXMLFormatter
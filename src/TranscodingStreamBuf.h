@@ -0,0 +1,54 @@
+#ifndef LXMLFORMATTER_TRANSCODINGSTREAMBUF_H
+#define LXMLFORMATTER_TRANSCODINGSTREAMBUF_H
+
+#include "BufferedInputStream.h"
+#include "InputFilterBuf.h"
+#include <istream>
+
+namespace LXMLFormatter {
+
+// Read-only streambuf that turns a UTF-16 or UTF-32 source (either byte order)
+// into UTF-8, so BufferedInputStream and the tokenizer keep working on UTF-8
+// bytes and zero-copy slices. BufferedInputStream layers it in by itself when
+// it sees a UTF-16/32 BOM or '<' pattern (see detectEncoding()); runs of ASCII
+// UTF-16 units are narrowed a vector at a time (ByteScan::narrowAscii16).
+//
+// Unpaired surrogates, code points above U+10FFFF and a truncated final unit
+// end the output and set failed(), which BufferedInputStream::sourceFailed()
+// reports even when the damage comes after the root element.
+class TranscodingStreamBuf final : public InputFilterBuf {
+public:
+    using Encoding = BufferedInputStream::Encoding;
+
+    // 'prefix' holds source bytes already read (after any BOM); they are decoded
+    // before anything else is read from 'source'.
+    TranscodingStreamBuf(std::istream& source, Encoding from,
+                         const uint8_t* prefix = nullptr, std::size_t prefixLen = 0,
+                         std::size_t inputChunk = kInputChunk);
+
+    Encoding encoding() const noexcept { return from_; }
+
+    // True for the encodings this class converts (UTF-16/32, LE and BE).
+    static bool supports(Encoding e) noexcept;
+
+protected:
+    std::size_t decode(uint8_t* dst, std::size_t cap) override;
+
+private:
+    enum class Step { Ok, NeedMore, Invalid };
+
+    // Decodes the code point at p (avail source bytes); 'used' = bytes consumed.
+    Step decodeOne(const uint8_t* p, std::size_t avail, uint32_t& cp, std::size_t& used) const noexcept;
+
+    Encoding from_;
+    unsigned unit_;             // 2 or 4 bytes
+    bool     bigEndian_;
+    bool     sourceEnded_ = false;
+    uint8_t  pending_[4];       // tail of a code point that did not fit the caller's buffer
+    uint8_t  pendPos_ = 0;
+    uint8_t  pendEnd_ = 0;
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_TRANSCODINGSTREAMBUF_H
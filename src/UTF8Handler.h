@@ -19,6 +19,7 @@
 #include <cstddef>
 #include <array>
 #include <utility>
+#include "ByteScan.h"
 
 /// \namespace ShUTF8Detail
 /// \brief Implementation details for UTF-8 table generation. Not public API.
@@ -140,8 +141,36 @@ public:
     [[nodiscard]] static EncodeResult encode(uint32_t cp, uint8_t out[4]) noexcept {
         return encode(cp, out, 4);
     }    
+
+    struct ValidateResult {
+        std::size_t  validBytes = 0;            // length of the valid, complete prefix
+        DecodeStatus status = DecodeStatus::Ok; // Ok: all n bytes valid
+                                                // NeedMore: sequence at validBytes is cut off by n
+                                                // Invalid: bad sequence starts at validBytes
+    };
+
+    /// Bulk validation with the same strictness as decode() (overlongs, surrogates,
+    /// > U+10FFFF). AVX2 (runtime dispatch) checks 32 bytes per step with the
+    /// nibble-lookup range-check technique; other targets skip ASCII runs with
+    /// SIMD and decode only the non-ASCII sequences.
+    [[nodiscard]] static ValidateResult validate(const uint8_t* p, std::size_t n) noexcept;
+
+    /// Number of leading pure-ASCII bytes (each one is a complete code point).
+    [[nodiscard]] static std::size_t asciiPrefixLength(const uint8_t* p, std::size_t n) noexcept {
+        return LXMLFormatter::ByteScan::asciiPrefix(p, n);
+    }
     
 private:        
+    // Scalar validation of [from, n): SIMD ASCII skip + decode() per multi-byte sequence.
+    [[nodiscard]] static ValidateResult validateFrom(const uint8_t* p, std::size_t n, std::size_t from) noexcept;
+
+#if defined(LXML_BYTESCAN_X86)
+    // Returns the start of the first 32-byte block that contains (or completes) an
+    // error, or the end of the last full block if none; the caller resumes scalar there.
+    __attribute__((target("avx2")))
+    [[nodiscard]] static std::size_t validateBlocksAVX2(const uint8_t* p, std::size_t n) noexcept;
+#endif
+
     alignas(64) static inline const std::array<ShUTF8Detail::Utf8Info, 256> utf8_table = ShUTF8Detail::generate_table();
 
     // Branch-free surrogate check: returns true if NOT a surrogate
@@ -343,6 +372,136 @@ inline UTF8Handler::EncodeResult UTF8Handler::encode(uint32_t cp, uint8_t* out,
     return res;
 }
 
+inline UTF8Handler::ValidateResult UTF8Handler::validateFrom(const uint8_t* p, std::size_t n, std::size_t from) noexcept {
+    ValidateResult res;
+    std::size_t i = from;
+    while (i < n) {
+        i += asciiPrefixLength(p + i, n - i);
+        if (i == n) break;
+        const DecodeResult r = decode(p + i, n - i);
+        if (UNLIKELY(r.status != DecodeStatus::Ok)) {
+            res.validBytes = i;
+            res.status     = r.status;
+            return res;
+        }
+        i += r.width;
+    }
+    res.validBytes = n;
+    res.status     = DecodeStatus::Ok;
+    return res;
+}
+
+#if defined(LXML_BYTESCAN_X86)
+/* Range-check validation (Keiser & Lemire, "Validating UTF-8 In Less Than One
+ * Instruction Per Byte"): three 16-entry nibble tables classify every byte pair
+ * (prev1 high/low nibble, current high nibble); the AND of the three lookups is
+ * non-zero exactly for the invalid 2-byte patterns. 3rd/4th continuation bytes
+ * are checked separately from prev2/prev3. */
+__attribute__((target("avx2")))
+inline std::size_t UTF8Handler::validateBlocksAVX2(const uint8_t* p, std::size_t n) noexcept {
+    constexpr uint8_t TOO_SHORT      = 1u << 0; // lead not followed by continuation
+    constexpr uint8_t TOO_LONG       = 1u << 1; // ASCII followed by continuation
+    constexpr uint8_t OVERLONG_3     = 1u << 2;
+    constexpr uint8_t TOO_LARGE      = 1u << 3; // > U+10FFFF
+    constexpr uint8_t SURROGATE      = 1u << 4;
+    constexpr uint8_t OVERLONG_2     = 1u << 5;
+    constexpr uint8_t TOO_LARGE_1000 = 1u << 6;
+    constexpr uint8_t OVERLONG_4     = 1u << 6;
+    constexpr uint8_t TWO_CONTS      = 1u << 7; // continuation after continuation (checked by prev2/3)
+    constexpr uint8_t CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    // Each 16-entry table is broadcast to both 128-bit lanes for vpshufb.
+    static constexpr uint8_t kByte1High[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, // 0_______
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                                     // 10______
+        TOO_SHORT | OVERLONG_2,                                                         // 1100____
+        TOO_SHORT,                                                                      // 1101____
+        TOO_SHORT | OVERLONG_3 | SURROGATE,                                             // 1110____
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4 };                          // 1111____
+    static constexpr uint8_t kByte1Low[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,   // ____0000
+        CARRY | OVERLONG_2,                             // ____0001
+        CARRY, CARRY,                                   // ____001_
+        CARRY | TOO_LARGE,                              // ____0100
+        CARRY | TOO_LARGE | TOO_LARGE_1000,             // ____0101
+        CARRY | TOO_LARGE | TOO_LARGE_1000,             // ____011_
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,             // ____1___
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, // ____1101
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 };
+    static constexpr uint8_t kByte2High[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, // 0_______
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,           // 1000____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,                             // 1001____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE  | TOO_LARGE,                             // 101_____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE  | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT };                                           // 11______
+
+    const __m256i byte1High = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(kByte1High)));
+    const __m256i byte1Low  = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(kByte1Low)));
+    const __m256i byte2High = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(kByte2High)));
+
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    const __m256i hiBit     = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i third     = _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)); // prev2 >= 0xE0 -> must be cont
+    const __m256i fourth    = _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)); // prev3 >= 0xF0 -> must be cont
+    // Last bytes of a block above these values start a sequence that is still open.
+    const __m256i openLimit = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+
+    __m256i prev = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+
+        if (_mm256_movemask_epi8(in) == 0) {
+            // ASCII block: only an open sequence from the previous block can fail here.
+            const __m256i open = _mm256_subs_epu8(prev, openLimit);
+            if (!_mm256_testz_si256(open, open)) return i;
+            prev = in;
+            continue;
+        }
+
+        const __m256i carried = _mm256_permute2x128_si256(prev, in, 0x21); // [prev.hi | in.lo]
+        const __m256i prev1 = _mm256_alignr_epi8(in, carried, 15);
+        const __m256i prev2 = _mm256_alignr_epi8(in, carried, 14);
+        const __m256i prev3 = _mm256_alignr_epi8(in, carried, 13);
+
+        const __m256i b1h = _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lowNibble));
+        const __m256i b1l = _mm256_shuffle_epi8(byte1Low,  _mm256_and_si256(prev1, lowNibble));
+        const __m256i b2h = _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(in, 4), lowNibble));
+        const __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+
+        const __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, third), _mm256_subs_epu8(prev3, fourth));
+        const __m256i err    = _mm256_xor_si256(_mm256_and_si256(must23, hiBit), special);
+        if (!_mm256_testz_si256(err, err)) return i;
+        prev = in;
+    }
+    return i;
+}
+#endif
+
+inline UTF8Handler::ValidateResult UTF8Handler::validate(const uint8_t* p, std::size_t n) noexcept {
+    std::size_t resume = 0;
+#if defined(LXML_BYTESCAN_X86)
+    if (n >= 64 && LXMLFormatter::ByteScan::detail::kHasAVX2) {
+        const std::size_t clean = validateBlocksAVX2(p, n);
+        // Everything ending before 'clean' is valid, but a sequence may start up to
+        // 3 bytes earlier. Resume at the first code point boundary in that window.
+        resume = clean >= 3 ? clean - 3 : 0;
+        while (resume < clean && IS_CONTINUATION(p[resume])) ++resume;
+    }
+#endif
+    return validateFrom(p, n, resume);
+}
+
 #undef LIKELY
 #undef UNLIKELY  
 #undef IS_CONTINUATION
@@ -0,0 +1,407 @@
+#include "XMLFormatter.h"
+#include "ByteScan.h"
+#include <algorithm>
+#include <cstring>
+
+namespace LXMLFormatter {
+
+namespace {
+    constexpr std::size_t kInitialIndentLevels = 64;
+    constexpr std::size_t kTokenBatch = 256; // 8KB of tokens per nextTokens() call
+}
+
+XMLFormatter::XMLFormatter(BufferedOutputStream& out, FormatterOptions opts)
+    : out_(out), opts_(opts)
+{
+    unit_ = opts_.useTabs ? 1u : opts_.indentWidth;
+    indent_.assign(1, '\n');
+    indent_.append(kInitialIndentLevels * unit_, opts_.useTabs ? '\t' : ' ');
+    frames_.reserve(kInitialIndentLevels);
+}
+
+void XMLFormatter::writeIndent(std::size_t depth) {
+    if (opts_.minify) return;
+    if (fragment_) {
+        // Depth is only known once the fragment is placed (applyFragment).
+        indents_.push_back(IndentMark{out_.bytesWritten(), static_cast<int32_t>(depth) + depthBias_, !atStart_});
+        atStart_ = false;
+        return;
+    }
+    const std::size_t need = 1 + depth * unit_;
+    if (indent_.size() < need) {
+        indent_.append(std::max(need, indent_.size() * 2) - indent_.size(), opts_.useTabs ? '\t' : ' ');
+    }
+    if (atStart_) {
+        // First line of output: indentation only, no leading newline.
+        atStart_ = false;
+        out_.write(indent_.data() + 1, need - 1);
+        return;
+    }
+    out_.write(indent_.data(), need);
+}
+
+bool XMLFormatter::isWhitespaceOnly(const char* p, std::size_t n) noexcept {
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!CharClass::isXMLWhitespace(static_cast<U8>(p[i]))) return false;
+    }
+    return true;
+}
+
+// Values are always written inside double quotes; a '"' that came from a
+// single-quoted value becomes &quot;. Everything else is copied as read (or
+// escaped again, see escape_).
+void XMLFormatter::writeAttrValue(const char* p, std::size_t n) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(p);
+    while (n) {
+        const std::size_t run = escape_ ? ByteScan::findFirstOf(b, n, '"', '&', '<') : ByteScan::findFirstOf(b, n, '"');
+        out_.write(reinterpret_cast<const char*>(b), run);
+        if (run == n) break;
+        writeEscape(b[run]);
+        b += run + 1;
+        n -= run + 1;
+    }
+}
+
+// '>' is only escaped where it would complete "]]>".
+void XMLFormatter::writeEscapedText(const char* p, std::size_t n) {
+    const uint8_t* const start = reinterpret_cast<const uint8_t*>(p);
+    const uint8_t* b = start;
+    while (n) {
+        const std::size_t run = ByteScan::findFirstOf(b, n, '&', '<', '>');
+        const uint8_t* at = b + run;
+        if (run < n && *at == '>' && (at - start < 2 || at[-1] != ']' || at[-2] != ']')) {
+            out_.write(reinterpret_cast<const char*>(b), run + 1);
+        } else {
+            out_.write(reinterpret_cast<const char*>(b), run);
+            if (run == n) break;
+            writeEscape(*at);
+        }
+        b += run + 1;
+        n -= run + 1;
+    }
+}
+
+void XMLFormatter::writeEscape(uint8_t c) {
+    switch (c) {
+        case '"': out_.write("&quot;", 6); break;
+        case '&': out_.write("&amp;", 5);  break;
+        case '<': out_.write("&lt;", 4);   break;
+        default:  out_.write("&gt;", 4);   break;
+    }
+}
+
+XMLFormatter::Frame XMLFormatter::closeFrame() {
+    if (frames_.empty()) return Frame{};
+    const Frame f = frames_.back();
+    frames_.pop_back();
+    if (frames_.empty() && outerFrame_) {
+        // Closed an outer element: its parent is the innermost outer one now.
+        frames_.push_back(Frame{true, false});
+        ++closedOuter_;
+        --depthBias_;
+    }
+    return f;
+}
+
+bool XMLFormatter::consume(const XMLToken& t) {
+    if (raw_) return passThrough(t);
+    if (inRun_ && t.type != XMLTokenType::Text) endTextRun();
+
+    switch (t.type) {
+        case XMLTokenType::DocumentStart:
+            break;
+
+        case XMLTokenType::StartTag: {
+            closeOpenTag();
+            // Children of inline content are inline too.
+            if (!openFrame()) writeIndent(frames_.size() - 1);
+            atStart_ = false;
+            out_.put('<');
+            out_.write(t.data, t.length);
+            tagOpen_ = true;
+            break;
+        }
+
+        case XMLTokenType::AttributeName:
+            out_.put(' ');
+            out_.write(t.data, t.length);
+            out_.write("=\"", 2);
+            break;
+
+        case XMLTokenType::AttributeValue:
+            writeAttrValue(t.data, t.length);
+            out_.put('"');
+            break;
+
+        case XMLTokenType::EmptyTag:
+            out_.write("/>", 2);
+            tagOpen_ = false;
+            closeFrame();
+            break;
+
+        case XMLTokenType::EndTag: {
+            const Frame f = closeFrame();
+            if (tagOpen_) {
+                closeOpenTag();              // <a></a>: nothing inside
+            } else if (f.hasChildElements && !f.hasText) {
+                writeIndent(frames_.size());
+            }
+            out_.write("</", 2);
+            out_.write(t.data, t.length);
+            out_.put('>');
+            break;
+        }
+
+        case XMLTokenType::Text: {
+            // A whitespace piece of a chunked run is held back until a later piece
+            // shows whether the run is kept; an all-whitespace run is dropped whole.
+            const bool more = t.isContinued();
+            if (!keepRun_) {
+                if (droppableText(t)) {
+                    if (more) heldSpace_.append(t.data, t.length);
+                    else heldSpace_.clear();
+                    inRun_ = more;
+                    break;
+                }
+                closeOpenTag();
+                if (!frames_.empty()) frames_.back().hasText = true;
+                atStart_ = false;
+                if (!heldSpace_.empty()) {
+                    out_.write(heldSpace_.data(), heldSpace_.size());
+                    heldSpace_.clear();
+                }
+            }
+            writeTokenData(t);
+            inRun_ = keepRun_ = more;
+            break;
+        }
+
+        case XMLTokenType::Comment:
+        case XMLTokenType::PI:
+        case XMLTokenType::CDATA:
+        case XMLTokenType::DOCTYPE: {
+            static constexpr const char* open[]  = { "<!--", "<?", "<![CDATA[", "<!DOCTYPE " };
+            static constexpr const char* close[] = { "-->",  "?>", "]]>",       ">" };
+            const std::size_t k = static_cast<std::size_t>(t.type) - static_cast<std::size_t>(XMLTokenType::Comment);
+            if (!inCData_) {            // not a later piece of a chunked CDATA section
+                closeOpenTag();
+                const bool inl = inlineContent() || t.type == XMLTokenType::CDATA;
+                if (!frames_.empty() && !inl) frames_.back().hasChildElements = true;
+                if (!inl) writeIndent(frames_.size());
+                atStart_ = false;
+                out_.write(open[k], std::strlen(open[k]));
+            }
+            // Never escaped; a large CDATA slice of a mapping goes out by reference.
+            if (stableInput_ && t.isInputSlice()) out_.writeRef(t.data, t.length);
+            else out_.write(t.data, t.length);
+            inCData_ = t.isContinued();
+            if (!inCData_) out_.write(close[k], std::strlen(close[k]));
+            // CDATA is character data: its element is inline from here on.
+            if (t.type == XMLTokenType::CDATA && !frames_.empty()) frames_.back().hasText = true;
+            break;
+        }
+
+        case XMLTokenType::DocumentEnd:
+            if (fragment_) break;        // end of the chunk, not of the document
+            closeOpenTag();
+            if (!atStart_ && !opts_.minify) out_.put('\n');
+            atStart_ = true;
+            break;
+
+        case XMLTokenType::Error:
+            // Recovered: the repair tokens that follow keep the output balanced.
+            if (!t.isRecovered()) return false;
+            ++recovered_;
+            break;
+    }
+    return out_.good();
+}
+
+bool XMLFormatter::run(XMLTokenizer& tz) {
+    stableInput_ = tz.input().isMapped();
+    escape_ = tz.options().expandInternalEntities();
+    recovered_ = 0;
+    raw_ = nullptr;
+    if (opts_.minify && !tz.options().recoverErrors()) {
+        std::size_t rawLen = 0;
+        const uint8_t* raw = tz.input().mappedContent(rawLen);
+        if (raw) setRawSource(raw, rawLen, tz.input().baseOffset(), tz.options().normalizeLineEndings());
+    }
+
+    alignas(64) XMLToken batch[kTokenBatch];
+    bool ok = true;
+    while (ok) {
+        const size_t n = tz.nextTokens(batch, kTokenBatch);
+        if (n == 0) break;
+        for (size_t i = 0; i < n && ok; ++i) ok = consume(batch[i]);
+    }
+    return out_.flush() && ok && recovered_ == 0;
+}
+
+void XMLFormatter::setRawSource(const uint8_t* raw, std::size_t len, uint64_t base, bool normalizeNewlines) noexcept {
+    if (!opts_.minify) return;
+    raw_      = raw;
+    rawLF_    = normalizeNewlines;
+    rawLen_   = len;
+    rawBase_  = base;
+    cut_      = base;
+    dropping_ = false;
+}
+
+void XMLFormatter::copyRawTo(uint64_t off) {
+    const uint64_t end = std::min<uint64_t>(off, rawBase_ + rawLen_);
+    if (end <= cut_) return;
+    const char* p = reinterpret_cast<const char*>(raw_) + (cut_ - rawBase_);
+    const char* const stop = reinterpret_cast<const char*>(raw_) + (end - rawBase_);
+    if (rawLF_) {
+        // Spans start at a '<' or right after a '>', so a CRLF is never split.
+        while (const void* hit = std::memchr(p, '\r', static_cast<std::size_t>(stop - p))) {
+            const char* cr = static_cast<const char*>(hit);
+            out_.writeRef(p, static_cast<std::size_t>(cr - p));
+            out_.put('\n');
+            p = cr + 1;
+            if (p < stop && *p == '\n') ++p;
+        }
+    }
+    out_.writeRef(p, static_cast<std::size_t>(stop - p));
+    cut_ = end;
+}
+
+void XMLFormatter::endTextRun() {
+    inRun_ = false;
+    if (raw_ && !keepRun_) {
+        copyRawTo(runStart_);            // all whitespace: drop it from its first piece
+        dropping_ = true;
+    }
+    keepRun_ = false;
+    heldSpace_.clear();
+}
+
+// Tag tokens report the offset of their '<' and text tokens the offset of their
+// first byte, so the input is a sequence of [kept][dropped whitespace][kept]...
+// spans. Kept spans are queued as references into the mapping, so large ones
+// reach the kernel through writev() without a user-space copy.
+bool XMLFormatter::passThrough(const XMLToken& t) {
+    if (inRun_ && t.type != XMLTokenType::Text) endTextRun();
+    if (dropping_ && t.type != XMLTokenType::Error) {
+        cut_ = t.byteOffset;
+        dropping_ = false;
+    }
+    switch (t.type) {
+        case XMLTokenType::StartTag: openFrame(); break;
+        case XMLTokenType::EmptyTag:
+        case XMLTokenType::EndTag:   closeFrame(); break;
+        case XMLTokenType::Text:
+            // Pieces of a chunked run are dropped together, from the first one on.
+            if (!inRun_) runStart_ = t.byteOffset;
+            inRun_ = t.isContinued();
+            if (keepRun_ || !droppableText(t)) {
+                keepRun_ = inRun_;
+                if (!frames_.empty()) frames_.back().hasText = true;
+            } else if (!inRun_) {
+                copyRawTo(runStart_);
+                dropping_ = true;
+            }
+            break;
+        case XMLTokenType::CDATA:
+            if (!frames_.empty()) frames_.back().hasText = true;
+            break;
+        case XMLTokenType::DocumentEnd:
+            copyRawTo(t.byteOffset);
+            break;
+        case XMLTokenType::Error:
+            return false;
+        default:
+            break;
+    }
+    return out_.good();
+}
+
+void XMLFormatter::beginFragment(bool documentStart) {
+    fragment_    = true;
+    outerFrame_  = !documentStart;
+    depthBias_   = documentStart ? 0 : -1; // frames_[0] is not an element of the chunk
+    closedOuter_ = 0;
+    tagOpen_     = false;
+    atStart_     = documentStart;
+    dropping_    = false;
+    inRun_       = false;
+    keepRun_     = false;
+    inCData_     = false;
+    heldSpace_.clear();
+    indents_.clear();
+    frames_.clear();
+    if (outerFrame_) frames_.push_back(Frame{true, false});
+}
+
+XMLFormatter::FragmentResult XMLFormatter::endFragment() {
+    FragmentResult r;
+    r.indents = std::move(indents_);
+    std::size_t first = 0;
+    if (outerFrame_ && !frames_.empty()) {
+        r.outer = frames_[0];
+        first = 1;
+    }
+    r.open.assign(frames_.begin() + static_cast<std::ptrdiff_t>(first), frames_.end());
+    r.closedOuter  = closedOuter_;
+    r.tagOpen      = tagOpen_;
+    r.fromStart    = !outerFrame_;
+    r.rawEnd       = cut_;
+
+    fragment_    = false;
+    outerFrame_  = false;
+    depthBias_   = 0;
+    closedOuter_ = 0;
+    tagOpen_     = false;
+    atStart_     = true;
+    indents_.clear();
+    frames_.clear();
+    return r;
+}
+
+bool XMLFormatter::applyFragment(const FragmentResult& r, const char* text, std::size_t len, uint64_t start) {
+    // The chunk was formatted assuming no outer element holds text (nothing inline)
+    // and that something was written before it; check that against the real state.
+    if (r.fromStart) {
+        if (!frames_.empty() || !atStart_ || tagOpen_) return false;
+    } else {
+        if (atStart_ || frames_.size() < r.closedOuter) return false;
+        for (const Frame& f : frames_) {
+            if (f.hasText) return false;
+        }
+    }
+
+    if (raw_) {
+        if (dropping_) cut_ = start;     // whitespace before the chunk was dropped
+        else copyRawTo(start);
+        dropping_ = false;
+    }
+    closeOpenTag();  // the chunk starts with a start tag, which would have closed it
+
+    const int64_t base = static_cast<int64_t>(frames_.size());
+    uint64_t pos = 0;
+    for (const IndentMark& m : r.indents) {
+        if (m.offset > pos) {
+            out_.write(text + pos, static_cast<std::size_t>(m.offset - pos));
+            atStart_ = false;
+            pos = m.offset;
+        }
+        writeIndent(static_cast<std::size_t>(std::max<int64_t>(0, base + m.depth)));
+    }
+    if (len > pos) {
+        out_.write(text + pos, len - static_cast<std::size_t>(pos));
+        atStart_ = false;
+    }
+
+    frames_.resize(frames_.size() - r.closedOuter);
+    if (!r.fromStart && !frames_.empty()) {
+        frames_.back().hasChildElements |= r.outer.hasChildElements;
+        frames_.back().hasText          |= r.outer.hasText;
+    }
+    frames_.insert(frames_.end(), r.open.begin(), r.open.end());
+    tagOpen_ = r.tagOpen;
+    if (raw_) cut_ = r.rawEnd;
+    return out_.good();
+}
+
+} // namespace LXMLFormatter
@@ -0,0 +1,197 @@
+#ifndef LXMLFORMATTER_XMLFORMATTER_H
+#define LXMLFORMATTER_XMLFORMATTER_H
+
+#include "XMLTokenizer.h"
+#include "BufferedOutputStream.h"
+#include <string>
+#include <vector>
+
+namespace LXMLFormatter {
+
+struct FormatterOptions {
+    U8   indentWidth = 2;     // spaces per level (ignored with useTabs)
+    bool useTabs = false;     // one '\t' per level
+    bool minify = false;      // no indentation; inter-tag whitespace dropped
+};
+
+// Streaming pretty-printer: consumes XMLTokenizer tokens and writes indented XML
+// to a BufferedOutputStream. No DOM; state is one small frame per open element.
+//
+// Layout rules:
+//  - Each start/empty tag starts on a new line at its depth; attributes stay on
+//    the tag line, always written with double quotes.
+//  - Whitespace-only text is dropped (the indentation replaces it).
+//  - Other text is written verbatim. Once an element holds text, everything
+//    else inside it is written inline, so mixed content keeps its spacing.
+//  - References are passed through as written when the tokenizer does not expand
+//    them (TokenizerOptions::ExpandInternalEntities cleared, as the formatter
+//    drivers do). Given an expanding tokenizer, run() escapes '&' and '<' (and a
+//    '>' after "]]") in copied text and values again.
+//  - An end tag goes on its own line only if the element had child elements and no text.
+//
+// Minify drops the whitespace-only text the pretty printer would replace, and adds
+// none. On mapped input, run() copies everything between dropped runs straight
+// from the mapping, so tags keep their original spelling; otherwise tokens are
+// re-serialized compactly.
+//
+// A recovered Error (TokenizerOptions::RecoverErrors) is counted and skipped: the
+// tokenizer's repair tokens keep the output well-formed, and run() still returns
+// false at the end. Recovery re-serializes tokens, so no raw pass-through then.
+class XMLFormatter {
+public:
+    struct Frame {
+        bool hasChildElements = false;
+        bool hasText = false;        // element holds non-whitespace text: write inline
+    };
+
+    // Where a fragment wrote an indent: output offset and depth relative to the
+    // depth at the fragment start (negative once it closed outer elements).
+    struct IndentMark {
+        uint64_t offset;
+        int32_t  depth;
+        bool     newline;            // false only for the first line of a document
+    };
+
+    // What a fragment run leaves behind; see beginFragment().
+    struct FragmentResult {
+        std::vector<IndentMark> indents;
+        std::vector<Frame> open;     // elements opened in the fragment and still open
+        Frame    outer;              // innermost outer element, as the fragment left it
+        uint32_t closedOuter = 0;    // outer elements the fragment closed
+        bool     tagOpen = false;    // ends inside a start tag ('>' pending)
+        bool     fromStart = false;  // beginFragment(true)
+        uint64_t rawEnd = 0;         // pass-through: input offset copied up to
+    };
+
+    XMLFormatter(BufferedOutputStream& out, FormatterOptions opts = {});
+
+    XMLFormatter(const XMLFormatter&)            = delete;
+    XMLFormatter& operator=(const XMLFormatter&) = delete;
+
+    // Pulls every token from 'tz' (in batches) and formats it.
+    // Returns false on a tokenizer error or output failure.
+    // Escapes decoded text again if 'tz' expands references (see above).
+    bool run(XMLTokenizer& tz);
+
+    // Formats one token. Returns false on an Error token (unless recovered) or
+    // output failure.
+    bool consume(const XMLToken& t);
+
+    // Recovered Error tokens consumed since construction (or the last run()).
+    std::size_t recoveredErrors() const noexcept { return recovered_; }
+
+    // Formatter depth (open elements); 0 between documents.
+    size_t depth() const noexcept { return frames_.size(); }
+
+    // Minify pass-through source: token byteOffsets index raw[offset - base].
+    // Set by run() for mapped input; callers driving consume() may set it themselves.
+    // 'normalizeNewlines' should match the tokenizer's NormalizeLineEndings: copied
+    // spans then write CRLF and lone CR as LF, like the stream path.
+    void setRawSource(const uint8_t* raw, std::size_t len, uint64_t base, bool normalizeNewlines) noexcept;
+
+    // Fragment mode (ParallelFormatter): formats a chunk that starts at an element
+    // boundary at an unknown depth. Outer elements are assumed to hold no text and
+    // to have child elements; indents are recorded instead of written, and
+    // DocumentEnd only finishes the pass-through copy. 'documentStart' is set for
+    // the chunk that begins the document (depth 0, nothing written yet).
+    void beginFragment(bool documentStart);
+    FragmentResult endFragment();
+
+    // Appends a fragment's output 'text' (starting at input offset 'start') at the
+    // current depth and takes over its end state. Returns false, writing nothing,
+    // if the fragment's assumptions about the outer elements do not hold here.
+    bool applyFragment(const FragmentResult& r, const char* text, std::size_t len, uint64_t start);
+
+private:
+    BufferedOutputStream& out_;
+    FormatterOptions      opts_;
+    std::vector<Frame>    frames_;   // O(depth)
+    std::string           indent_;   // "\n" + unit * maxDepth, grown on demand
+    std::size_t           unit_ = 2; // bytes per indent level
+    bool tagOpen_ = false;           // "<name ..." written, '>' pending
+    bool atStart_ = true;            // nothing written yet (no leading newline)
+    bool stableInput_ = false;       // input slices outlive the run (mapped input): writeRef them
+    bool escape_ = false;            // the tokenizer expands references: escape copied text
+    std::size_t recovered_ = 0;      // recovered Error tokens seen
+
+    // Pass-through state (minify over a mapping).
+    const uint8_t* raw_ = nullptr;
+    std::size_t    rawLen_ = 0;
+    uint64_t       rawBase_ = 0;
+    uint64_t       cut_ = 0;          // start of the span not yet written
+    bool           dropping_ = false; // cut_ moves to the next token's offset
+    bool           rawLF_ = false;    // copied spans turn CR / CRLF into LF
+
+    // Chunked text (XMLToken::Continued): the pieces of a run share one keep/drop
+    // decision, so whitespace-only pieces wait until the run turns out otherwise.
+    bool        inRun_ = false;       // the last Text piece was Continued
+    bool        keepRun_ = false;     // the open run is being written
+    uint64_t    runStart_ = 0;        // pass-through: offset of the run's first piece
+    std::string heldSpace_;           // whitespace pieces of the open run, not written yet
+    bool        inCData_ = false;     // the last CDATA piece was Continued
+
+    // Fragment state.
+    bool     fragment_ = false;
+    bool     outerFrame_ = false;    // frames_[0] stands for the innermost outer element
+    int32_t  depthBias_ = 0;         // recorded depth = writeIndent depth + bias
+    uint32_t closedOuter_ = 0;
+    std::vector<IndentMark> indents_;
+
+    // newline + depth * unit in one write; skipped inside inline (text) content.
+    void writeIndent(std::size_t depth);
+
+    // Writes the pending '>' of the current start tag, if any.
+    inline void closeOpenTag() {
+        if (tagOpen_) {
+            out_.put('>');
+            tagOpen_ = false;
+        }
+    }
+
+    // True if the innermost open element holds text (its children are inline).
+    bool inlineContent() const noexcept { return !frames_.empty() && frames_.back().hasText; }
+
+    // Frame bookkeeping shared by both output paths. openFrame() returns whether the
+    // new element is inline (its parent holds text).
+    bool openFrame() {
+        const bool inlineParent = inlineContent();
+        if (!frames_.empty()) frames_.back().hasChildElements = true;
+        frames_.push_back(Frame{false, inlineParent});
+        return inlineParent;
+    }
+    Frame closeFrame();
+
+    // Text that layout replaces: whitespace-only and not inside inline content.
+    bool droppableText(const XMLToken& t) const noexcept {
+        return !inlineContent() && isWhitespaceOnly(t.data, t.length);
+    }
+
+    void writeAttrValue(const char* p, std::size_t n);
+
+    // Token bytes: by reference when they point into a mapping, else copied.
+    // Input slices hold no decoded reference, so only copied text is escaped.
+    inline void writeTokenData(const XMLToken& t) {
+        if (stableInput_ && t.isInputSlice()) out_.writeRef(t.data, t.length);
+        else if (escape_ && !t.isInputSlice()) writeEscapedText(t.data, t.length);
+        else out_.write(t.data, t.length);
+    }
+    void writeEscapedText(const char* p, std::size_t n);
+
+    // The reference written for an escaped byte.
+    void writeEscape(uint8_t c);
+
+    // A run whose last piece was Continued ended at a non-Text token: settle it.
+    void endTextRun();
+
+    // Minify over a mapping: tokens only decide which raw spans are copied.
+    bool passThrough(const XMLToken& t);
+
+    // Writes raw input up to 'off' (clamped to the source) and moves cut_ there.
+    void copyRawTo(uint64_t off);
+
+    static bool isWhitespaceOnly(const char* p, std::size_t n) noexcept;
+};
+
+} // namespace LXMLFormatter
+
+#endif // LXMLFORMATTER_XMLFORMATTER_H
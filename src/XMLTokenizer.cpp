@@ -1,5 +1,21 @@
 #include "XMLTokenizer.h"
 #include "XMLTokenizerTypes.h"
+#include "ByteScan.h"
+#include "CheckpointIndex.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <istream>
+#include <new>
+#include <ostream>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  include <x86intrin.h>
+#  define LXML_STATS_TSC 1
+#endif
 
 namespace LXMLFormatter {
 
@@ -13,6 +29,256 @@ namespace {
     inline ByteLen clampBL(ByteLen v, ByteLen cap) noexcept {
         return (v > cap) ? cap : v;
     }
+
+    // Hands a container's storage back to its memory resource.
+    template<class V>
+    inline void dropStorage(V& v) noexcept {
+        V(v.get_allocator()).swap(v);
+    }
+
+    // End of the text run at p: the next '<', or CR too when it has to be rewritten,
+    // or '&' too when references are expanded.
+    template<bool Normalize, bool Expand>
+    inline std::size_t textRunEnd(const uint8_t* p, std::size_t len) noexcept {
+        if constexpr (Normalize && Expand) return ByteScan::findFirstOf(p, len, '<', '\r', '&');
+        else if constexpr (Normalize)      return ByteScan::findFirstOf(p, len, '<', '\r');
+        else if constexpr (Expand)         return ByteScan::findFirstOf(p, len, '<', '&');
+        else                               return ByteScan::findFirstOf(p, len, '<');
+    }
+
+    // ---- References (ExpandInternalEntities) ----
+
+    // '&' through ';' of the longest reference accepted (leading zeros included).
+    constexpr std::size_t kMaxRefBytes = 32;
+
+    // A builtin entity name of 2..4 bytes packed into a U32, first byte lowest.
+    constexpr U32 refKey(const char* name) noexcept {
+        U32 key = 0;
+        for (unsigned i = 0; name[i]; ++i) key |= static_cast<U32>(static_cast<U8>(name[i])) << (8 * i);
+        return key;
+    }
+
+    // Hex digit values; 0xFF for every other byte.
+    constexpr std::array<U8, 256> kHexValue = []() {
+        std::array<U8, 256> t{};
+        for (auto& v : t) v = 0xFF;
+        for (unsigned c = 0; c < 10; ++c) t['0' + c] = static_cast<U8>(c);
+        for (unsigned c = 0; c < 6; ++c) t['a' + c] = t['A' + c] = static_cast<U8>(10 + c);
+        return t;
+    }();
+
+    // XML 1.0 Char production.
+    inline bool isXmlChar(U32 cp) noexcept {
+        if (cp < 0xD800) return cp >= 0x20 || cp == 0x9 || cp == 0xA || cp == 0xD;
+        return (cp >= 0xE000 && cp <= 0xFFFD) || (cp >= 0x10000 && cp <= 0x10FFFF);
+    }
+
+    // Parses the reference at p[0] == '&' (n bytes readable). ok with Builtin for
+    // &lt; &gt; &amp; &apos; &quot;, with Numeric for &#ddd; / &#xhhh; naming an
+    // XML Char, with Unknown (nameLen set) for any other &Name;. Not ok otherwise,
+    // including no ';' within kMaxRefBytes; rawLen is set whenever a ';' was found.
+    // Digits are folded without early exits: a bad digit or overflow only sets a flag.
+    inline EntityScan scanReference(const uint8_t* p, std::size_t n) noexcept {
+        EntityScan e;
+        const auto* semi = static_cast<const uint8_t*>(std::memchr(p, ';', std::min(n, kMaxRefBytes)));
+        if (!semi) return e;
+        const std::size_t end = static_cast<std::size_t>(semi - p);
+        e.rawLen = static_cast<U16>(end + 1);
+        if (end < 2) return e; // "&;"
+
+        if (p[1] == '#') {
+            const bool hex = p[2] == 'x';
+            std::size_t i = hex ? 3 : 2;
+            if (i >= end) return e; // "&#;", "&#x;"
+            U32  v = 0;
+            bool bad = false;
+            if (hex) {
+                for (; i < end; ++i) {
+                    const U32 d = kHexValue[p[i]];
+                    bad |= (d > 15) | (v > 0x10FFFF);
+                    v = (v << 4) | (d & 15);
+                }
+            } else {
+                for (; i < end; ++i) {
+                    const U32 d = static_cast<U32>(p[i]) - '0';
+                    bad |= (d > 9) | (v > 0x10FFFF);
+                    v = v * 10 + d;
+                }
+            }
+            if (bad || !isXmlChar(v)) return e;
+            e.kind  = EntityKind::Numeric;
+            e.value = v;
+            e.ok    = true;
+            return e;
+        }
+
+        const std::size_t nameLen = end - 1;
+        if (nameLen <= 4) {
+            U32 key = 0;
+            for (std::size_t i = 0; i < nameLen; ++i) key |= static_cast<U32>(p[1 + i]) << (8 * i);
+            switch (key) {
+                case refKey("lt"):   e.value = '<';  break;
+                case refKey("gt"):   e.value = '>';  break;
+                case refKey("amp"):  e.value = '&';  break;
+                case refKey("apos"): e.value = '\''; break;
+                case refKey("quot"): e.value = '"';  break;
+                default: break;
+            }
+            if (e.value) {
+                e.kind = EntityKind::Builtin;
+                e.ok   = true;
+                return e;
+            }
+        }
+        // Any other name (no DTD is read, so it cannot be declared). Non-ASCII
+        // bytes pass, as in tag names.
+        for (std::size_t i = 1; i < end; ++i) {
+            const U8 b = p[i];
+            if (b < 0x80 && !(i == 1 ? CharClass::AsciiNameStart[b] : CharClass::AsciiNameChar[b])) return e;
+        }
+        e.nameLen = static_cast<U16>(nameLen);
+        e.ok      = true;
+        return e;
+    }
+
+    // ---- Comments, CDATA sections, PIs and DOCTYPE ----
+
+    // First index in [p+i, p+n) where a terminator t0 t1 [...] may start: t0
+    // followed by t1, or t0 too close to n to tell; with Normalize, a CR too.
+    // n if neither. Bodies are crossed by the SIMD scan for t0 alone.
+    template<bool Normalize>
+    inline std::size_t markupStop(const uint8_t* p, std::size_t n, std::size_t i, uint8_t t0, uint8_t t1) noexcept {
+        for (;;) {
+            if constexpr (Normalize) i += ByteScan::findFirstOf(p + i, n - i, t0, '\r');
+            else                     i += ByteScan::findFirstOf(p + i, n - i, t0);
+            if (i + 1 >= n || p[i + 1] == t1 || (Normalize && p[i] == '\r')) return i;
+            ++i;
+        }
+    }
+
+    // CR and CRLF to LF in place.
+    template<class V>
+    inline void normalizeNewlines(V& v) noexcept {
+        std::size_t w = 0;
+        for (std::size_t r = 0; r < v.size(); ++r) {
+            const char c = v[r];
+            if (c == '\r' && r + 1 < v.size() && v[r + 1] == '\n') ++r;
+            v[w++] = (c == '\r') ? '\n' : c;
+        }
+        v.resize(w);
+    }
+
+    // The '>' that ends a DOCTYPE declaration, stepping over quoted literals and
+    // the internal subset with its comments and PIs. Resumable at any byte, so a
+    // declaration longer than the window is scanned one window at a time.
+    struct DoctypeScan {
+        enum class S : U8 { Decl, Subset, Quoted, Lt, Bang, BangDash, Comment, Dash, DashDash, PI, Question };
+        S       st   = S::Decl;
+        S       back = S::Decl; // where Quoted returns to
+        uint8_t quote = 0;
+
+        // Index of the closing '>' in [p+i, p+n), or n.
+        std::size_t run(const uint8_t* p, std::size_t n, std::size_t i) noexcept {
+            while (i < n) {
+                const uint8_t c = p[i];
+                switch (st) {
+                    case S::Decl:
+                        i += ByteScan::findFirstOf(p + i, n - i, '>', '[', '"', '\'');
+                        if (i == n) return n;
+                        if (p[i] == '>') return i;
+                        if (p[i] == '[') st = S::Subset;
+                        else { quote = p[i]; back = S::Decl; st = S::Quoted; }
+                        break;
+                    case S::Subset:
+                        i += ByteScan::findFirstOf(p + i, n - i, ']', '<', '"', '\'');
+                        if (i == n) return n;
+                        if (p[i] == ']')      st = S::Decl;
+                        else if (p[i] == '<') st = S::Lt;
+                        else { quote = p[i]; back = S::Subset; st = S::Quoted; }
+                        break;
+                    case S::Quoted:
+                        i += ByteScan::findFirstOf(p + i, n - i, quote);
+                        if (i == n) return n;
+                        st = back;
+                        break;
+                    case S::Comment:
+                        i += ByteScan::findFirstOf(p + i, n - i, '-');
+                        if (i == n) return n;
+                        st = S::Dash;
+                        break;
+                    case S::PI:
+                        i += ByteScan::findFirstOf(p + i, n - i, '?');
+                        if (i == n) return n;
+                        st = S::Question;
+                        break;
+                    // One byte of lookahead each; any other byte is looked at again.
+                    case S::Lt:
+                        st = (c == '!') ? S::Bang : (c == '?') ? S::PI : S::Subset;
+                        if (st == S::Subset) continue;
+                        break;
+                    case S::Bang:
+                        st = (c == '-') ? S::BangDash : S::Subset;
+                        if (st == S::Subset) continue;
+                        break;
+                    case S::BangDash:
+                        st = (c == '-') ? S::Comment : S::Subset;
+                        if (st == S::Subset) continue;
+                        break;
+                    case S::Dash:
+                        st = (c == '-') ? S::DashDash : S::Comment;
+                        if (st == S::Comment) continue;
+                        break;
+                    case S::DashDash:
+                        if (c == '-') break;
+                        st = (c == '>') ? S::Subset : S::Comment;
+                        if (st == S::Comment) continue;
+                        break;
+                    case S::Question:
+                        if (c == '?') break;
+                        st = (c == '>') ? S::Subset : S::PI;
+                        if (st == S::PI) continue;
+                        break;
+                }
+                ++i;
+            }
+            return n;
+        }
+    };
+
+    inline U64 statTicks() noexcept {
+#if defined(LXML_STATS_TSC)
+        return __rdtsc();
+#else
+        return static_cast<U64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // Charges the time until the end of one DFA loop iteration to the state it
+    // started in; inert when 's' is null (call not sampled).
+    struct StateTimer {
+        TokenizerStats* s;
+        std::size_t     state;
+        U64             t0;
+        StateTimer(TokenizerStats* stats, State st) noexcept
+            : s(stats), state(static_cast<std::size_t>(st)), t0(stats ? statTicks() : 0) {}
+        ~StateTimer() {
+            if (!s) return;
+            s->stateTicks[state] += statTicks() - t0;
+            ++s->stateSamples[state];
+        }
+    };
+
+    constexpr const char* kTokenTypeNames[TokenizerStats::kTokenTypes] = {
+        "StartTag", "EndTag", "EmptyTag", "AttributeName", "AttributeValue",
+        "Text", "Comment", "PI", "CDATA", "DOCTYPE", "DocumentStart", "DocumentEnd", "Error"
+    };
+    constexpr const char* kStateNames[TokenizerStats::kStates] = {
+        "Content", "TagOpen", "StartTagName", "EndTagName", "InTag",
+        "AttrName", "AfterAttrName", "BeforeAttrValue", "AttrValueQuoted",
+        "AfterBang", "CommentStart1", "CommentStart2", "InComment", "CommentEnd1", "CommentEnd2",
+        "CDataStart", "InCData", "CDataEnd1", "CDataEnd2", "PITarget", "PIContent", "Resyncing"
+    };
 }
 
 // Temporary: map severity to a short label for stderr,
@@ -29,17 +295,20 @@ static inline const char* sevLabel(ErrorSeverity s) noexcept {
 clamp limits to caps.
 don’t allocate in the noexcept constructor to avoid std::terminate on OOM.
 initialize state/flags so the first nextToken() call emits DocumentStart.
-tie the freelist block size to the (sanitized) maxPerTagBytes for later reuse.
 */
 XMLTokenizer::XMLTokenizer(BufferedInputStream& in,
                            TokenizerOptions opts,
-                           TokenizerLimits lims) noexcept
-    : in_(in), opts_(opts), lims_(lims) 
+                           TokenizerLimits lims,
+                           std::pmr::memory_resource* memory) noexcept
+    : in_(in), opts_(opts), lims_(lims), memory_(memory),
+      tagStack_(&memory_), tagArena_(&memory_), names_(lims.maxInternedNames), textArena_(&memory_),
+      skipNames_(&memory_), skipNameEnds_(&memory_), errors_(&memory_), errorArena_(&memory_)
 {
     // Clamp soft limits to absolute caps (defensive, prevents misconfig/DoS).
     lims_.maxNameBytes      = clampBL(lims_.maxNameBytes,      Caps::AbsMaxNameBytes);
     lims_.maxAttrValueBytes = clampBL(lims_.maxAttrValueBytes, Caps::AbsMaxAttrValueBytes);
     lims_.maxTextRunBytes   = clampBL(lims_.maxTextRunBytes,   Caps::AbsMaxTextRunBytes);
+    lims_.textChunkBytes    = std::max<ByteLen>(clampBL(lims_.textChunkBytes, lims_.maxTextRunBytes), 4); // a full UTF-8 sequence fits
     lims_.maxCommentBytes   = clampBL(lims_.maxCommentBytes,   Caps::AbsMaxCommentBytes);
     lims_.maxCdataBytes     = clampBL(lims_.maxCdataBytes,     Caps::AbsMaxCdataBytes);
     lims_.maxDoctypeBytes   = clampBL(lims_.maxDoctypeBytes,   Caps::AbsMaxDoctypeBytes);
@@ -51,7 +320,7 @@ XMLTokenizer::XMLTokenizer(BufferedInputStream& in,
 
     // No allocations in a noexcept ctor; start with empty containers.
     tagStack_.clear();
-    tagBufFreelist_.clear();
+    tagArena_.clear();
     errors_.clear();
     errorArena_.clear();
     textArena_.buf.clear();
@@ -61,16 +330,28 @@ XMLTokenizer::XMLTokenizer(BufferedInputStream& in,
     la_.has       = false;
     pendingStart_ = SourcePosition{};
     pendingStartValid_ = false;
-    
-    // Bind freelist block size to current per-tag capacity.
-    freelistBlockSize_ = lims_.maxPerTagBytes;
+}
+
+void XMLTokenizer::releaseMemory() noexcept {
+    reset();
+    dropStorage(tagStack_);
+    tagArena_.releaseMemory();
+    dropStorage(textArena_.buf);
+    dropStorage(skipNames_);
+    dropStorage(skipNameEnds_);
+    dropStorage(errors_);
+    dropStorage(errorArena_);
+}
 
-    // stats_ is trivially zero-initialized (enabled build collects later).
+void XMLTokenizer::setMemoryResource(std::pmr::memory_resource* memory) noexcept {
+    releaseMemory();
+    memory_.retarget(memory);
 }
 
 
 // Intern error message into errorArena_ as a null-terminated C string.
-// Returns a stable pointer (Phase-1 fail-fast makes this safe).
+// Returns a pointer that stays valid until the arena grows; the queued errors are
+// moved along then (only the current Error token is alive, so nothing else points here).
 const char* XMLTokenizer::internError(const char* msg, U32 len) noexcept {
     const bool   useDefault = (msg == nullptr);
     const char*  src        = useDefault ? defaultErrorMessage : msg;
@@ -80,7 +361,11 @@ const char* XMLTokenizer::internError(const char* msg, U32 len) noexcept {
     if (errorArena_.capacity() < need) {
         size_t newCap = errorArena_.capacity() ? errorArena_.capacity() * 2 : 256;
         if (newCap < need) newCap = need;
+        const char* old = errorArena_.data();
         errorArena_.reserve(newCap);
+        for (TokenizerError& e : errors_) {
+            e.msg = std::string_view(errorArena_.data() + (e.msg.data() - old), e.msg.size());
+        }
     }
 
     const size_t base = errorArena_.size();
@@ -91,12 +376,28 @@ const char* XMLTokenizer::internError(const char* msg, U32 len) noexcept {
 }
 
 
+// Temporary stderr logging (will be replaced by callbacks).
+void XMLTokenizer::logError(const TokenizerError& e) noexcept {
+    std::fprintf(stderr,
+                 "[LXMLTokenizer %s] code=0x%04X at byte=%llu line=%u col=%u: %.*s\n",
+                 sevLabel(e.sev),
+                 static_cast<unsigned>(e.code),
+                 static_cast<unsigned long long>(e.where.byteOffset),
+                 static_cast<unsigned>(e.where.line),
+                 static_cast<unsigned>(e.where.column),
+                 static_cast<int>(e.msg.size()),
+                 e.msg.data());
+}
+
 bool XMLTokenizer::emitError(XMLToken& out,
                              TokenizerErrorCode code,
                              ErrorSeverity sev,
                              const char* msg,
                              U32 msgLen) noexcept
 {
+    // Pushed input ran out inside the token: it is undone, not reported (scanPushToken).
+    if (in_.starved()) return true;
+
     // Prefer token-start position if set; otherwise, current cursor.
     const SourcePosition where = pendingStartValid_ ? pendingStart_ : currentPosition();
     pendingStartValid_ = false; // avoid accidental reuse
@@ -104,10 +405,20 @@ bool XMLTokenizer::emitError(XMLToken& out,
     const bool useDefault = (msg == nullptr);
     const U32  effLen     = useDefault ? static_cast<U32>(sizeof(defaultErrorMessage) - 1) : msgLen;
 
-    // Intern message and fill the immediate Error token.
-    const char* stableMsg = internError(msg, effLen);
+    // RecoverErrors: the stream goes on after a resync (State::Resyncing). Internal
+    // errors (code None) and those after Ended was set (allocation failures) do not.
+    const bool recover = sev == ErrorSeverity::Fatal && opts_.recoverErrors() &&
+                         code != TokenizerErrorCode::None && !flags_.test(TokenizerFlags::Ended);
+    if (recover) sev = ErrorSeverity::Recoverable;
+
+    // Intern message and fill the immediate Error token. Past maxErrors nothing is
+    // kept, so a document full of errors cannot grow errors_ or errorArena_.
+    const bool  queued    = errors_.size() < lims_.maxErrors;
+    const char* stableMsg = queued ? internError(msg, effLen) : (useDefault ? defaultErrorMessage : msg);
 
     out.type       = XMLTokenType::Error;
+    out.flags      = recover ? XMLToken::Recovered : 0;
+    out.nameId     = 0;
     out.data       = stableMsg;
     out.length     = effLen;
     out.byteOffset = where.byteOffset;
@@ -124,21 +435,18 @@ bool XMLTokenizer::emitError(XMLToken& out,
     rec.sev   = sev;
     rec.where = where;
     rec.msg   = std::string_view(stableMsg, effLen);
-    errors_.push_back(rec);
+    ++errorCount_;
+    lastError_ = rec;
+    if (queued) {
+        errors_.push_back(rec);
+        if (!opts_.quietErrors()) logError(rec);
+    }
 
-    // Temporary stderr logging (will be replaced by callbacks).
-    std::fprintf(stderr,
-                 "[LXMLTokenizer %s] code=0x%04X at byte=%llu line=%u col=%u: %.*s\n",
-                 sevLabel(sev),
-                 static_cast<unsigned>(code),
-                 static_cast<unsigned long long>(where.byteOffset),
-                 static_cast<unsigned>(where.line),
-                 static_cast<unsigned>(where.column),
-                 static_cast<int>(effLen),
-                 stableMsg);
-
-    // Phase-1: end stream on fatal errors (next nextToken() returns false).
-    if (sev == ErrorSeverity::Fatal) {
+    // End stream on fatal errors (next nextToken() returns false); resync otherwise.
+    if (recover) {
+        resyncFrom_ = state_;
+        state_ = State::Resyncing;
+    } else if (sev == ErrorSeverity::Fatal) {
         flags_.set(TokenizerFlags::Ended);
     }
     return true; // One token (Error) emitted
@@ -146,12 +454,17 @@ bool XMLTokenizer::emitError(XMLToken& out,
 
 
 // Text tokens: lifetime = until next nextToken()
-bool XMLTokenizer::makeTextToken(XMLToken& out, U32 off, U32 len) noexcept {
+bool XMLTokenizer::makeTextToken(XMLToken& out, U32 off, U32 len, U8 flags, XMLTokenType type) noexcept {
     // Use the marked start if available; otherwise snapshot current cursor.
     const SourcePosition where = pendingStartValid_ ? pendingStart_ : currentPosition();
     pendingStartValid_ = false;
+    if ((flags & XMLToken::Continued) && (type == XMLTokenType::Text || type == XMLTokenType::CDATA)) {
+        flags_.set(TokenizerFlags::InTextRun);
+    }
 
-    out.type       = XMLTokenType::Text;
+    out.type       = type;
+    out.flags      = flags;
+    out.nameId     = 0;
     out.data       = (len != 0) ? (const char*)(textArena_.buf.data() + off) : nullptr;
     out.length     = len;
     out.byteOffset = where.byteOffset;
@@ -165,7 +478,135 @@ bool XMLTokenizer::makeTextToken(XMLToken& out, U32 off, U32 len) noexcept {
     return true; // one token emitted
 }
 
+// Zero-copy Text: lifetime = until next nextToken() (the window is only refilled by
+// later reads). Uses pendingStart_ for position info.
+bool XMLTokenizer::makeInputSliceToken(XMLToken& out, const uint8_t* p, U32 len, U8 flags, XMLTokenType type) noexcept {
+    const SourcePosition where = pendingStartValid_ ? pendingStart_ : currentPosition();
+    pendingStartValid_ = false;
+    if ((flags & XMLToken::Continued) && (type == XMLTokenType::Text || type == XMLTokenType::CDATA)) {
+        flags_.set(TokenizerFlags::InTextRun);
+    }
+
+    out.type       = type;
+    out.flags      = XMLToken::InputSlice | flags;
+    out.nameId     = 0;
+    out.data       = reinterpret_cast<const char*>(p);
+    out.length     = len;
+    out.byteOffset = where.byteOffset;
+    out.line       = where.line;
+    out.column     = where.column;
+
+#if defined(LXML_DEBUG_SLICES)
+    out.arena      = ArenaId::Input;
+    out.generation = 0;
+#endif
+    return true; // one token emitted
+}
+
+// The reference must end within kMaxRefBytes, so one peekSpan() holds it; it is
+// consumed only once decoded. Outside Strict, a malformed or undeclared one is
+// kept as written: the '&' is appended and the rest is read as ordinary data.
+template<class Append>
+XMLTokenizer::RefResult XMLTokenizer::expandReference(Append&& append) {
+    std::size_t len = 0;
+    const uint8_t* p = in_.peekSpan(len);
+    if (p && len < kMaxRefBytes && !std::memchr(p, ';', len)) {
+        p = in_.peekSpan(len, kMaxRefBytes); // the ';' may lie past the window
+    }
+    if (!p) return RefResult::Malformed;
+
+    const EntityScan e = scanReference(p, len);
+    if (e.ok && e.kind != EntityKind::Unknown) {
+        uint8_t utf8[4];
+        const auto enc = UTF8Handler::encode(e.value, utf8);
+        if (!append(reinterpret_cast<const char*>(utf8), static_cast<U32>(enc.width))) return RefResult::Limit;
+        in_.consumeSpan(e.rawLen);
+        return RefResult::Ok;
+    }
+    if (opts_.strict()) return e.ok ? RefResult::Undeclared : RefResult::Malformed;
+    if (!append("&", 1)) return RefResult::Limit;
+    in_.consumeSpan(1);
+    return RefResult::Ok;
+}
+
+bool XMLTokenizer::emitReferenceError(XMLToken& out, RefResult r) noexcept {
+    pendingStartValid_ = false; // report the '&', not the start of the run
+    const char* msg = r == RefResult::Undeclared ? "Undeclared entity reference"
+                                                 : "Malformed entity or character reference";
+    return emitError(out, TokenizerErrorCode::MalformedEntity, ErrorSeverity::Fatal,
+                     msg, static_cast<U32>(std::strlen(msg)));
+}
+
+// ZeroCopyText fast path: succeeds only if the whole run up to '<' (or EOF) sits in
+// the current window, is valid UTF-8, needs no CR normalization and is under the limit.
+// Chunked: a run reaching past the window (or maxTextRunBytes) is sliced up to there
+// as a Continued piece instead, without compacting the window.
+// Consumes nothing on failure so scanText() can fall back to copying.
+template<bool Normalize, bool Chunked, bool Expand>
+bool XMLTokenizer::trySliceTextAs(XMLToken& out) {
+    std::size_t len = 0;
+    const uint8_t* p = in_.peekSpan(len);
+    if (!p) return false;
+
+    // CR only stops the run when it has to be rewritten, '&' when it is expanded.
+    std::size_t end = textRunEnd<Normalize, Expand>(p, len);
+    bool more = false; // Chunked: the run goes on past this piece
+    if (end == len && !in_.exhausted()) {
+        if constexpr (Chunked) {
+            more = true;
+        } else {
+            // Run reaches the window end: compact/refill once so it starts at the cursor.
+            p = in_.peekSpan(len, len + 1);
+            if (!p) return false;
+            end = textRunEnd<Normalize, Expand>(p, len);
+            if (end == len && !in_.exhausted()) return false; // spans the buffer: copy it
+        }
+    }
+    if constexpr (Normalize || Expand) {
+        if (end < len && p[end] != '<') return false; // decoded by the copy path
+    }
+    if constexpr (Chunked) {
+        // A mapped file is one window; keep pieces within the limit all the same.
+        if (end > static_cast<std::size_t>(lims_.maxTextRunBytes)) {
+            end = lims_.maxTextRunBytes;
+            more = true;
+        }
+    }
+
+    // Invalid UTF-8 ends the run (the stream reports it as EOF on the next read);
+    // a sequence split by the piece end is left for the next piece.
+    const auto v = UTF8Handler::validate(p, end);
+    if (v.validBytes < end && v.status != UTF8Handler::DecodeStatus::NeedMore) more = false;
+    end = v.validBytes;
+    if (end == 0) return false;
+    if constexpr (!Chunked) {
+        if (end >= static_cast<std::size_t>(lims_.maxTextRunBytes)) return false;
+    }
+
+    in_.consumeSpan(end);
+    return makeInputSliceToken(out, p, static_cast<U32>(end), more ? XMLToken::Continued : 0);
+}
+
+// The option-dependent scanners are instantiated per configuration, so their
+// loops carry no option tests; this is the only place the options are read.
 bool XMLTokenizer::scanText(XMLToken& out) {
+    return opts_.expandInternalEntities() ? scanTextWith<true>(out) : scanTextWith<false>(out);
+}
+
+template<bool Expand>
+bool XMLTokenizer::scanTextWith(XMLToken& out) {
+    const bool normalize = opts_.normalizeLineEndings();
+    if (opts_.chunkedText()) {
+        if (opts_.zeroCopyText()) return normalize ? scanTextAs<true, true, true, Expand>(out) : scanTextAs<false, true, true, Expand>(out);
+        return normalize ? scanTextAs<true, false, true, Expand>(out) : scanTextAs<false, false, true, Expand>(out);
+    }
+    if (opts_.zeroCopyText()) return normalize ? scanTextAs<true, true, false, Expand>(out) : scanTextAs<false, true, false, Expand>(out);
+    return normalize ? scanTextAs<true, false, false, Expand>(out) : scanTextAs<false, false, false, Expand>(out);
+}
+
+template<bool Normalize, bool ZeroCopy, bool Chunked, bool Expand>
+bool XMLTokenizer::scanTextAs(XMLToken& out) {
+    if constexpr (Chunked) flags_.clr(TokenizerFlags::InTextRun);
     int32_t cp = peekCp();
     
     // If we see '<' immediately, transition to TagOpen without emitting
@@ -182,43 +623,77 @@ bool XMLTokenizer::scanText(XMLToken& out) {
     // Start accumulating text
     textArena_.buf.clear();
     markTokenStart();  // Capture position before consuming first byte
-    
+
+    if constexpr (ZeroCopy) {
+        if (trySliceTextAs<Normalize, Chunked, Expand>(out)) return true;  // Token points into the input window
+    }
+
+    // Copy path: bulk-append validated runs from the window; stop at '<' or EOF,
+    // rewrite CR/CRLF as LF when normalizing and decode references when expanding.
+    // Chunked: stop after textChunkBytes.
+    const std::size_t chunk = lims_.textChunkBytes;
     while (true) {
-        cp = peekCp();
-        if (cp == '<' || cp < 0) {
-            break;  // Stop at '<' or EOF, don't consume
-        }
-        
-        getCp();  // Consume the code point
-        
-        // Handle CRLF normalization (only in Content, not markup)
-        if (opts_.normalizeLineEndings() && cp == '\r') {
-            // Check for CRLF sequence
-            if (peekCp() == '\n') {
-                getCp();  // Consume the LF too
-            }
-            // Emit single LF for both CR and CRLF
-            textArena_.buf.push_back('\n');
-        } else {
-            // Encode Unicode code point back to UTF-8 bytes
-            uint8_t utf8Bytes[4];  // Max UTF-8 sequence length
-            auto encResult = UTF8Handler::encode(static_cast<uint32_t>(cp), utf8Bytes, 4);
-            
-            if (encResult.status != UTF8Handler::EncodeStatus::Ok) {
-                // This should never happen for valid code points from BufferedInputStream
-                return emitError(out, TokenizerErrorCode::InvalidUTF8,
-                               ErrorSeverity::Fatal, "Failed to encode code point", 25);
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekCodePointSpan(len);
+        if (!p) break;  // EOF
+
+        const std::size_t runEnd = textRunEnd<Normalize, Expand>(p, len);
+        std::size_t stop = runEnd;
+        if constexpr (Chunked) {
+            // A full piece goes out once the run is known to go on.
+            const std::size_t have = textArena_.buf.size();
+            if (have >= chunk) {
+                if (p[0] == '<') break;
+                return makeTextToken(out, 0, static_cast<U32>(have), XMLToken::Continued);
             }
-            
-            // Append the UTF-8 bytes
-            for (uint8_t i = 0; i < encResult.width; ++i) {
-                textArena_.buf.push_back(static_cast<char>(utf8Bytes[i]));
+            stop = std::min(stop, chunk - have);
+        }
+
+        const auto v = UTF8Handler::validate(p, stop);
+        if (v.validBytes) {
+            textArena_.buf.insert(textArena_.buf.end(),
+                                  reinterpret_cast<const char*>(p),
+                                  reinterpret_cast<const char*>(p) + v.validBytes);
+            in_.consumeSpan(v.validBytes);
+        }
+
+        if (v.validBytes < stop) {
+            // Invalid sequence (treated as EOF) or one split by the window end.
+            // A split sequence at the cursor means EOF, since we asked for 4 bytes,
+            // unless the piece end split it: then the piece is full.
+            if (v.status != UTF8Handler::DecodeStatus::NeedMore) break;
+            if (v.validBytes == 0) {
+                if (Chunked && stop < runEnd) {
+                    return makeTextToken(out, 0, static_cast<U32>(textArena_.buf.size()), XMLToken::Continued);
+                }
+                break;
+            }
+        } else if (stop == runEnd && stop < len) {
+            if ((!Normalize && !Expand) || p[stop] == '<') break;  // Stop at '<', don't consume
+            if (Chunked && textArena_.buf.size() >= chunk) continue;  // the LF opens the next piece
+            if (Expand && p[stop] == '&') {
+                // A decoded character is never split: a piece that cannot take
+                // four more bytes goes out first.
+                if (Chunked && textArena_.buf.size() + 4 > chunk) {
+                    return makeTextToken(out, 0, static_cast<U32>(textArena_.buf.size()), XMLToken::Continued);
+                }
+                const RefResult r = expandReference([this](const char* d, U32 n) {
+                    textArena_.buf.insert(textArena_.buf.end(), d, d + n);
+                    return true;
+                });
+                if (r != RefResult::Ok) return emitReferenceError(out, r);
+            } else {
+                // CR: emit single LF for both CR and CRLF
+                in_.consumeSpan(1);
+                if (peekCp() == '\n') {
+                    getCp();  // Consume the LF too
+                }
+                textArena_.buf.push_back('\n');
             }
         }
-        
-        // Check limit using proper types (both as size_t)
-        if (textArena_.buf.size() >= static_cast<size_t>(lims_.maxTextRunBytes)) {
-            flags_.set(TokenizerFlags::Ended);
+
+        // Check limit using proper types (both as size_t); pieces are bounded already.
+        if (!Chunked && textArena_.buf.size() >= static_cast<size_t>(lims_.maxTextRunBytes)) {
             return emitError(out, TokenizerErrorCode::LimitExceeded,
                            ErrorSeverity::Fatal, "Text run exceeds limit", 22);
         }
@@ -230,6 +705,232 @@ bool XMLTokenizer::scanText(XMLToken& out) {
     return true;  // Token emitted
 }
 
+// ===== Comments, CDATA sections, PIs and DOCTYPE =====
+
+namespace {
+    // Per construct: the terminator and what to report.
+    struct MarkupSyntax {
+        XMLTokenType       type;
+        const char*        term;
+        std::size_t        termLen;
+        TokenizerErrorCode unterminated;
+        const char*        eofMsg;
+        const char*        limitMsg;
+    };
+    constexpr MarkupSyntax kComment = { XMLTokenType::Comment, "-->", 3, TokenizerErrorCode::UnterminatedComment,
+                                        "Unterminated comment", "Comment exceeds limit" };
+    constexpr MarkupSyntax kCData   = { XMLTokenType::CDATA, "]]>", 3, TokenizerErrorCode::UnterminatedCData,
+                                        "Unterminated CDATA section", "CDATA section exceeds limit" };
+    constexpr MarkupSyntax kPI      = { XMLTokenType::PI, "?>", 2, TokenizerErrorCode::UnterminatedPI,
+                                        "Unterminated processing instruction", "Processing instruction exceeds limit" };
+}
+
+bool XMLTokenizer::scanMarkup(XMLToken& out) {
+    return opts_.normalizeLineEndings() ? scanMarkupAs<true>(out) : scanMarkupAs<false>(out);
+}
+
+// The window is searched for the terminator without consuming anything; a body
+// that ends inside it (valid UTF-8, no CR to rewrite, within the limit) becomes
+// a slice of it, after at most one compaction/refill to bring the whole body in.
+// Otherwise the body is copied into TextArena window by window. With ChunkedText
+// a CDATA section is never held whole: the part of it in the window goes out as
+// a Continued slice, and copied pieces end after textChunkBytes; state_ stays
+// InCData between pieces. maxCommentBytes bounds comments and PIs,
+// maxCdataBytes unchunked CDATA sections (chunked: each piece).
+template<bool Normalize>
+bool XMLTokenizer::scanMarkupAs(XMLToken& out) {
+    const State st = state_;
+    const MarkupSyntax& m = (st == State::InComment) ? kComment : (st == State::InCData) ? kCData : kPI;
+    const bool        chunked = st == State::InCData && opts_.chunkedText();
+    const std::size_t limit   = (st == State::InCData) ? lims_.maxCdataBytes : lims_.maxCommentBytes;
+    const std::size_t chunk   = lims_.textChunkBytes;
+    const auto t0 = static_cast<uint8_t>(m.term[0]);
+    const auto t1 = static_cast<uint8_t>(m.term[1]);
+    const auto tn = static_cast<uint8_t>(m.term[m.termLen - 1]);
+
+    textArena_.buf.clear();
+    if (!pendingStartValid_) markTokenStart(); // a later piece of a chunked section
+    auto fail = [&](TokenizerErrorCode code, const char* msg) {
+        return emitError(out, code, ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    };
+
+    bool refilled = false;
+    for (;;) {
+        const std::size_t have = textArena_.buf.size();
+        if (!chunked && have > limit) return fail(TokenizerErrorCode::LimitExceeded, m.limitMsg);
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekCodePointSpan(len);
+        if (len < m.termLen) {
+            in_.peekSpan(len, m.termLen); // push input: the terminator may still come
+            return fail(m.unterminated, m.eofMsg);
+        }
+
+        // Nothing past the limit is searched (a mapped window may be the whole file).
+        const std::size_t n = std::min(len, (chunked ? limit : limit - have) + m.termLen);
+        std::size_t i = 0;
+        for (;;) {
+            i = markupStop<Normalize>(p, n, i, t0, t1);
+            if (i + m.termLen > n || (Normalize && p[i] == '\r') || p[i + m.termLen - 1] == tn) break;
+            // "]]" is data; "--" is not allowed in a comment.
+            if (st == State::InComment && opts_.strict()) {
+                in_.consumeSpan(i);
+                pendingStartValid_ = false; // report the "--"
+                return fail(TokenizerErrorCode::BadCommentDoubleDash, "'--' inside comment");
+            }
+            ++i;
+        }
+        const bool cr    = Normalize && i < n && p[i] == '\r';
+        const bool found = !cr && i + m.termLen <= n;
+        if (!chunked && have + i > limit) return fail(TokenizerErrorCode::LimitExceeded, m.limitMsg);
+
+        if (have == 0 && !cr) {
+            if (found && i <= limit) {
+                const auto v = UTF8Handler::validate(p, i);
+                if (v.validBytes < i) return fail(TokenizerErrorCode::InvalidUTF8, "Invalid UTF-8 sequence");
+                in_.consumeSpan(i + m.termLen);
+                state_ = State::Content;
+                return finishMarkup(out, m.type, reinterpret_cast<const char*>(p), i, true, 0);
+            }
+            if (chunked) {
+                // The part in the window (or at the limit) is a piece of its own.
+                const std::size_t end = std::min(i, limit);
+                const auto v = UTF8Handler::validate(p, end);
+                if (v.validBytes < end && v.status != UTF8Handler::DecodeStatus::NeedMore) {
+                    return fail(TokenizerErrorCode::InvalidUTF8, "Invalid UTF-8 sequence");
+                }
+                if (v.validBytes) {
+                    in_.consumeSpan(v.validBytes);
+                    return makeInputSliceToken(out, p, static_cast<U32>(v.validBytes), XMLToken::Continued, m.type);
+                }
+            } else if (!refilled && !in_.exhausted()) {
+                // Body reaches the window end: compact/refill once so it starts at the cursor.
+                refilled = true;
+                in_.peekSpan(len, len + 1);
+                continue;
+            }
+        }
+
+        // Copy path.
+        if (chunked && have >= chunk && !(found && i == 0)) {
+            return makeTextToken(out, 0, static_cast<U32>(have), XMLToken::Continued, m.type);
+        }
+        const std::size_t stop = chunked ? std::min(i, chunk - have) : i;
+        const auto v = UTF8Handler::validate(p, stop);
+        if (v.validBytes < stop) {
+            if (v.status != UTF8Handler::DecodeStatus::NeedMore) return fail(TokenizerErrorCode::InvalidUTF8, "Invalid UTF-8 sequence");
+            if (v.validBytes == 0 && stop == i) return fail(m.unterminated, m.eofMsg); // EOF inside a sequence
+        }
+        textArena_.buf.insert(textArena_.buf.end(), reinterpret_cast<const char*>(p),
+                              reinterpret_cast<const char*>(p) + v.validBytes);
+        in_.consumeSpan(v.validBytes);
+        if (chunked && v.validBytes < stop && stop < i) {
+            // The next character does not fit the piece.
+            return makeTextToken(out, 0, static_cast<U32>(textArena_.buf.size()), XMLToken::Continued, m.type);
+        }
+        if (v.validBytes < i) continue; // the window or the piece ends first
+
+        if (found) {
+            in_.consumeSpan(m.termLen);
+            state_ = State::Content;
+            return finishMarkup(out, m.type, textArena_.buf.data(), textArena_.buf.size(), false, 0);
+        }
+        if (cr) {
+            // CR: emit single LF for both CR and CRLF
+            in_.consumeSpan(1);
+            if (peekCp() == '\n') getCp();
+            textArena_.buf.push_back('\n');
+        }
+    }
+}
+
+// A PI body starts with its target: a Name, then whitespace or the end. Non-ASCII
+// bytes pass, as in tag names.
+bool XMLTokenizer::finishMarkup(XMLToken& out, XMLTokenType type, const char* data, std::size_t len,
+                                bool slice, U8 flags) {
+    flags_.clr(TokenizerFlags::InTextRun); // a chunked CDATA section ends here
+    if (type == XMLTokenType::PI) {
+        const auto* b = reinterpret_cast<const uint8_t*>(data);
+        std::size_t t = 0;
+        while (t < len && (b[t] >= 0x80 || (t == 0 ? CharClass::AsciiNameStart[b[t]] : CharClass::AsciiNameChar[b[t]]))) ++t;
+        if (t == 0 || (t < len && !CharClass::isXMLWhitespace(b[t]))) {
+            state_ = State::Resyncing; // consumed whole: resync() has nothing to skip
+            const char* msg = "Invalid processing instruction target";
+            return emitError(out, TokenizerErrorCode::InvalidCharInName, ErrorSeverity::Fatal,
+                             msg, static_cast<U32>(std::strlen(msg)));
+        }
+        if (t == 3 && std::memcmp(data, "xml", 3) == 0 && !opts_.reportXmlDecl()) {
+            pendingStartValid_ = false;
+            return false;
+        }
+    }
+    if (slice) return makeInputSliceToken(out, reinterpret_cast<const uint8_t*>(data), static_cast<U32>(len), flags, type);
+    return makeTextToken(out, 0, static_cast<U32>(len), flags, type);
+}
+
+// DOCTYPE declarations are rare and short, so there is no chunking: the body is a
+// slice of the window when it ends inside it (after one refill at most), else it
+// is copied, up to maxDoctypeBytes. The internal subset is kept as written, not
+// processed. The token holds what follows "<!DOCTYPE" and its whitespace.
+bool XMLTokenizer::scanDoctype(XMLToken& out) {
+    auto fail = [&](TokenizerErrorCode code, const char* msg) {
+        return emitError(out, code, ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    };
+    const int32_t ch = peekCp();
+    if (ch < 0 || !CharClass::isXMLWhitespace(static_cast<U32>(ch))) {
+        return fail(TokenizerErrorCode::InvalidCharAfterLT, "Expected whitespace after '<!DOCTYPE'");
+    }
+    skipXMLSpace();
+
+    textArena_.buf.clear();
+    DoctypeScan scan;
+    std::size_t from = 0; // bytes at the cursor scanned already
+    bool refilled = false;
+    for (;;) {
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekCodePointSpan(len);
+        if (!p) return fail(TokenizerErrorCode::UnexpectedEOF, "Unterminated DOCTYPE declaration");
+        const std::size_t end = scan.run(p, len, from);
+        from = len;
+
+        if (end < len) {
+            const bool copy = !textArena_.buf.empty() ||
+                              (opts_.normalizeLineEndings() && std::memchr(p, '\r', end));
+            if (textArena_.buf.size() + end > lims_.maxDoctypeBytes) {
+                return fail(TokenizerErrorCode::LimitExceeded, "DOCTYPE declaration exceeds limit");
+            }
+            if (UTF8Handler::validate(p, end).validBytes < end) {
+                return fail(TokenizerErrorCode::InvalidUTF8, "Invalid UTF-8 sequence");
+            }
+            in_.consumeSpan(end + 1);
+            state_ = State::Content;
+            if (!copy) return makeInputSliceToken(out, p, static_cast<U32>(end), 0, XMLTokenType::DOCTYPE);
+            textArena_.buf.insert(textArena_.buf.end(), reinterpret_cast<const char*>(p),
+                                  reinterpret_cast<const char*>(p) + end);
+            if (opts_.normalizeLineEndings()) normalizeNewlines(textArena_.buf);
+            return makeTextToken(out, 0, static_cast<U32>(textArena_.buf.size()), 0, XMLTokenType::DOCTYPE);
+        }
+
+        if (textArena_.buf.empty() && !refilled && !in_.exhausted()) {
+            refilled = true;
+            in_.peekSpan(len, len + 1);
+            continue;
+        }
+        // Copy what was scanned; a sequence split by the window end stays for the next one.
+        const auto v = UTF8Handler::validate(p, len);
+        if (v.validBytes < len && v.status != UTF8Handler::DecodeStatus::NeedMore) {
+            return fail(TokenizerErrorCode::InvalidUTF8, "Invalid UTF-8 sequence");
+        }
+        if (v.validBytes == 0) return fail(TokenizerErrorCode::UnexpectedEOF, "Unterminated DOCTYPE declaration");
+        textArena_.buf.insert(textArena_.buf.end(), reinterpret_cast<const char*>(p),
+                              reinterpret_cast<const char*>(p) + v.validBytes);
+        in_.consumeSpan(v.validBytes);
+        from = len - v.validBytes;
+        if (textArena_.buf.size() > lims_.maxDoctypeBytes) {
+            return fail(TokenizerErrorCode::LimitExceeded, "DOCTYPE declaration exceeds limit");
+        }
+    }
+}
+
 void XMLTokenizer::skipXMLSpace() {
     while (true) {
         int32_t ch = peekCp();
@@ -239,68 +940,30 @@ void XMLTokenizer::skipXMLSpace() {
     }
 }
 
-// Guarantees at least 'need' free bytes in current TagBuffer.
-// Grows buffer geometrically up to per-tag cap; reuses freelist if size matches.
+// Checks the current element may append 'need' more bytes. The arena itself grows
+// by chunks, so the only bound here is the per-element cap.
 bool XMLTokenizer::ensureCurrentTagCapacity(ByteLen need) {
     if (tagStack_.empty()) 
         return false; // no current tag buffer
 
-    TagFrame& frame = tagStack_.back();
-    if (need <= (frame.buf.cap - frame.buf.used)) {
-        return true; // already enough space
-    }
-
-    // Need to grow. Check against limits first.
-    if (need > lims_.maxPerTagBytes) {
-        flags_.set(TokenizerFlags::Ended);
+    const TagFrame& frame = tagStack_.back();
+    if (need > lims_.maxPerTagBytes - frame.buf.used) {
         return false; // would exceed per-tag limit
     }
+    return true;
+}
 
-    // Compute new capacity: double current or just enough, capped.
-    ByteLen newCap = frame.buf.cap ? frame.buf.cap * 2 : 256;
-    if (newCap < frame.buf.used + need) {
-        newCap = frame.buf.used + need;
-    }
-    if (newCap > lims_.maxPerTagBytes) {
-        newCap = lims_.maxPerTagBytes;
-    }
-
-    // Try to reuse a freelist buffer of the right size.
-    if (!tagBufFreelist_.empty() && freelistBlockSize_ == newCap) {
-        frame.buf.mem = std::move(tagBufFreelist_.back());
-        tagBufFreelist_.pop_back();
-        frame.buf.cap = newCap;
-        return true;
-    }
+// Appends 'len' bytes to the open arena slice (see TagArena::beginSlice()).
+// Returns false on limit or allocation failure.
+bool XMLTokenizer::appendToCurrentTagBuf(const char* data, U32 len) {
+    if (!ensureCurrentTagCapacity(len)) return false;
 
-    // Allocate a new buffer.
-    try {
-        std::unique_ptr<char[]> newMem(new char[newCap]);
-        if (frame.buf.mem) {
-            // Copy existing data to new buffer.
-            std::memcpy(newMem.get(), frame.buf.mem.get(), frame.buf.used);
-        }
-        frame.buf.mem = std::move(newMem);
-        frame.buf.cap = newCap;
-        return true;
-    } catch (const std::bad_alloc&) {
+    if (!tagArena_.append(data, len)) {
         flags_.set(TokenizerFlags::Ended);
         return false; // allocation failed
     }
-}
-// Writes 'len' bytes to current TagBuffer and returns starting offset on success.
-// Returns kBadOff on failure
-U32 XMLTokenizer::appendToCurrentTagBuf(const char* data, U32 len) {
-    if (tagStack_.empty()) 
-        return kBadOff; // no current tag buffer
-
-    TagFrame& frame = tagStack_.back();
-    if (!ensureCurrentTagCapacity(len)) return kBadOff;
-
-    const U32 off = frame.buf.used;
-    std::memcpy(frame.buf.mem.get() + off, data, len);
-    frame.buf.used += len;
-    return off;
+    tagStack_.back().buf.used += len;
+    return true;
 }
 
 // Emits the synthetic DocumentStart token (only once per stream).
@@ -318,6 +981,8 @@ bool XMLTokenizer::emitDocumentStart(XMLToken& out) noexcept {
     const SourcePosition pos = currentPosition();
     
     out.type       = XMLTokenType::DocumentStart;
+    out.flags      = 0;
+    out.nameId     = 0;
     out.data       = nullptr;
     out.length     = 0;
     out.byteOffset = pos.byteOffset;
@@ -332,16 +997,17 @@ bool XMLTokenizer::emitDocumentStart(XMLToken& out) noexcept {
     return true;
 }
 
-// Emits DocumentEnd or a fatal error if unclosed tags remain.
+// Emits DocumentEnd or a fatal error if unclosed tags remain (with RecoverErrors,
+// resync() closes them, then DocumentEnd follows).
 // Sets Ended flag to prevent further token emission attempts.
 bool XMLTokenizer::emitDocumentEnd(XMLToken& out) noexcept {
     if (flags_.test(TokenizerFlags::Ended)) {
         return false;  // Already ended
     }
     
-    // Fatal error: unclosed tags
-    if (!tagStack_.empty()) {
-        flags_.set(TokenizerFlags::Ended);
+    // Fatal error: unclosed tags (a fragment may end anywhere)
+    if (!tagStack_.empty() && !opts_.fragment()) {
+        resyncClose_ = tagStack_.size();
         const char* msg = "Unclosed tag at end of document";
         return emitError(out,
             TokenizerErrorCode::UnexpectedEOF,
@@ -355,6 +1021,8 @@ bool XMLTokenizer::emitDocumentEnd(XMLToken& out) noexcept {
     const SourcePosition pos = currentPosition();
     
     out.type       = XMLTokenType::DocumentEnd;
+    out.flags      = 0;
+    out.nameId     = 0;
     out.data       = nullptr;
     out.length     = 0;
     out.byteOffset = pos.byteOffset;
@@ -369,8 +1037,8 @@ bool XMLTokenizer::emitDocumentEnd(XMLToken& out) noexcept {
     return true;
 }
 
-// Allocate or reuse a TagBuffer for the current frame.
-// Always allocate full-size per-tag buffer, no growth is happening here.
+// Checks the current frame can take tag data. Nothing is allocated here: the
+// frame's region starts at the arena top and chunks are added on demand.
 bool XMLTokenizer::ensureCurrentTagBuffer() noexcept {
     if (tagStack_.empty())
         return false;
@@ -380,56 +1048,21 @@ bool XMLTokenizer::ensureCurrentTagBuffer() noexcept {
         flags_.set(TokenizerFlags::Ended);
         return false;
     }
-    
-    TagFrame& frame = tagStack_.back();
-    
-    // Already has buffer
-    if (frame.buf.mem) {
-        noteTagArena(frame.buf.cap);
-        return true;
-    }
-    
-    // Try freelist first
-    if (!tagBufFreelist_.empty()) {
-        frame.buf.mem = std::move(tagBufFreelist_.back());
-        tagBufFreelist_.pop_back();
-        frame.buf.cap = lims_.maxPerTagBytes;
-        frame.buf.used = 0;
-        noteTagArena(frame.buf.cap);
-        return true;
-    }
-    
-    // Allocate new buffer at full size
-    try {
-        frame.buf.mem.reset(new char[lims_.maxPerTagBytes]);
-        frame.buf.cap = lims_.maxPerTagBytes;
-        frame.buf.used = 0;
-        noteTagArena(frame.buf.cap);
-        return true;
-    } catch (const std::bad_alloc&) {
-        flags_.set(TokenizerFlags::Ended);
-        return false;
-    }
+    return true;
 }
 
 // Push a new TagFrame onto the stack.
 bool XMLTokenizer::pushTagFrame() {
     if (tagStack_.size() >= lims_.maxOpenDepth) {
-        flags_.set(TokenizerFlags::Ended);
-        // Optional: emit fatal depth error token
-        XMLToken dummy;
-        const char* msg = "Maximum tag nesting depth exceeded";
-        emitError(dummy, TokenizerErrorCode::LimitExceeded,
-                  ErrorSeverity::Fatal,
-                  msg,
-                  static_cast<U32>(std::strlen(msg)));
         return false;
     }
 
-    const SourcePosition pos = currentPosition();
+    // Element starts at its '<' when the caller marked it.
+    const SourcePosition pos = pendingStartValid_ ? pendingStart_ : currentPosition();
 
     tagStack_.emplace_back();
     TagFrame& frame = tagStack_.back();
+    frame.buf.base = tagArena_.mark(); // starts at the parent's high-water mark
     frame.startPos = pos;
     frame.ctx.startLine       = pos.line;
     frame.ctx.startColumn     = pos.column;
@@ -439,50 +1072,50 @@ bool XMLTokenizer::pushTagFrame() {
     stats_.maxOpenDepth = std::max(stats_.maxOpenDepth, static_cast<U32>(tagStack_.size()));
 #endif
 
-    // Buffer allocation deferred to ensureCurrentTagBuffer()
     return true;
 }
 
-// Pop the current TagFrame, recycling its buffer if possible.
+// Pop the current TagFrame and release its arena region.
 void XMLTokenizer::popTagFrame() noexcept {
     if (tagStack_.empty())
         return;
     
-    // Move frame out first, then pop
-    TagFrame frame = std::move(tagStack_.back());
+    const TagArena::Mark base = tagStack_.back().buf.base;
     tagStack_.pop_back();
-    
-    // Now work with local copy
-    constexpr ByteLen kFreelistMemoryBudget = 64u * 1024u * 1024u;
-    const size_t maxFreelistSize = std::max(
-        size_t{4},
-        static_cast<size_t>(kFreelistMemoryBudget / std::max<ByteLen>(1, lims_.maxPerTagBytes))
-    );
-    
-    if (frame.buf.mem &&
-        frame.buf.cap == lims_.maxPerTagBytes &&
-        tagBufFreelist_.size() < maxFreelistSize) {
-        tagBufFreelist_.push_back(std::move(frame.buf.mem));
+
+    if (deferTagRelease_) {
+        // Tokens earlier in the batch may still point here; later frames go above it.
+        if (!hasDeferredTags_ || base < deferredMark_) deferredMark_ = base;
+        hasDeferredTags_ = true;
+        return;
+    }
+    if (hasDeferredTags_ && !(deferredMark_ < base)) hasDeferredTags_ = false; // covered by this release
+    tagArena_.release(base);
+    reclaimDeferredTags();
+}
+
+// Frame bases grow with push order, so an open frame below deferredMark_ was pushed
+// before the deferred ones (its data ends at or below the mark) and one above it
+// was pushed after them.
+void XMLTokenizer::reclaimDeferredTags() noexcept {
+    if (!hasDeferredTags_) return;
+    if (tagStack_.empty() || tagStack_.back().buf.base < deferredMark_) {
+        tagArena_.release(deferredMark_);
+        hasDeferredTags_ = false;
     }
-    // frame destructor runs here (handles any non-cached buffer cleanup)
 }
 
-bool XMLTokenizer::makeTagToken(XMLToken& out, XMLTokenType type, U32 offset, U32 length) noexcept {
-    // Caller MUST ensure offset and length are valid:
-    //   - offset < frame.buf.used
-    //   - offset + length <= frame.buf.used
-    // Violating this contract results in undefined behavior (out-of-bounds read).
+bool XMLTokenizer::makeTagToken(XMLToken& out, XMLTokenType type, const char* data, U32 length, NameId id) noexcept {
+    // Caller MUST pass a finished slice of the current element's arena region;
+    // anything else is undefined behavior (dangling or out-of-bounds read).
     
     const SourcePosition where = pendingStartValid_ ? pendingStart_ : currentPosition();
     pendingStartValid_ = false;
     
-    const char* data = nullptr;
-    if (length != 0 && !tagStack_.empty() && tagStack_.back().buf.mem) {
-        data = tagStack_.back().buf.mem.get() + offset;
-    }
-    
     out.type       = type;
-    out.data       = data;
+    out.flags      = 0;
+    out.nameId     = id;
+    out.data       = (length != 0) ? data : nullptr;
     out.length     = length;
     out.byteOffset = where.byteOffset;
     out.line       = where.line;
@@ -513,28 +1146,913 @@ bool XMLTokenizer::validateEndTagMatch(const char* namePtr, U32 nameLen) noexcep
     if (nameLen == 0)
         return true;
     
-    // Buffer must exist to retrieve open tag name
-    if (!frame.buf.mem)
+    return std::memcmp(namePtr, ctx.name, nameLen) == 0;
+}
+
+// Reads an XML Name at the cursor straight from the input window into a new slice
+// of the current TagBuffer: ASCII bytes are classified by table, other code points are decoded.
+std::pair<const char*,U32> XMLTokenizer::readNameToCurrentTagBuffer() {
+    U32  total = 0;
+    bool first = true;
+    tagArena_.beginSlice();
+
+    while (true) {
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekCodePointSpan(len);
+        if (!p) break;  // EOF ends the name
+
+        std::size_t i = 0;
+        bool split = false; // sequence cut by the window end
+        while (i < len) {
+            const uint8_t b = p[i];
+            if (b < 0x80) {
+                if (!(first ? CharClass::AsciiNameStart[b] : CharClass::AsciiNameChar[b])) break;
+                ++i;
+            } else {
+                const auto r = UTF8Handler::decode(p + i, len - i);
+                if (r.status == UTF8Handler::DecodeStatus::NeedMore) { split = (i != 0); break; }
+                if (r.status != UTF8Handler::DecodeStatus::Ok) break;
+                if (!(first ? isNameStart(r.cp) : isNameChar(r.cp))) break;
+                i += r.width;
+            }
+            first = false;
+        }
+
+        if (i) {
+            if (total + i > lims_.maxNameBytes) return {nullptr, kBadOff};
+            if (!appendToCurrentTagBuf(reinterpret_cast<const char*>(p), static_cast<U32>(i))) {
+                return {nullptr, kBadOff};
+            }
+            total += static_cast<U32>(i);
+            in_.consumeSpan(i);
+        }
+        if (i < len && !split) break; // stopped on a non-name byte
+    }
+
+    if (total == 0) return {nullptr, 0};
+    return {tagArena_.sliceData(), total};
+}
+
+// StartTagName: '<' consumed, name start at the cursor.
+bool XMLTokenizer::parseStartTag(XMLToken& out) {
+    if (!pushTagFrame()) {
+        const char* msg = "Maximum tag nesting depth exceeded";
+        return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                         msg, static_cast<U32>(std::strlen(msg)));
+    }
+    if (!ensureCurrentTagBuffer()) {
+        popTagFrame();
+        const char* msg = "Per-tag buffer unavailable";
+        return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                         msg, static_cast<U32>(std::strlen(msg)));
+    }
+
+    const auto name = readNameToCurrentTagBuffer();
+    if (name.second == 0 || name.second == kBadOff) {
+        popTagFrame(); // no StartTag was returned for it
+        const bool limit = (name.second == kBadOff);
+        const char* msg  = limit ? "Element name exceeds limit" : "Invalid element name";
+        return emitError(out,
+                         limit ? TokenizerErrorCode::LimitExceeded : TokenizerErrorCode::InvalidCharInName,
+                         ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    }
+
+    TagContext& ctx = tagStack_.back().ctx;
+    ctx.name    = name.first;
+    ctx.nameLen = name.second;
+    ctx.nameId  = internIfEnabled(name.first, name.second);
+    state_ = State::InTag;
+    return makeTagToken(out, XMLTokenType::StartTag, name.first, name.second, ctx.nameId);
+}
+
+// EndTagName: "</" consumed. The name is read after the open element's data only
+// to compare it; the EndTag token reuses the start tag's copy of the name and its id.
+bool XMLTokenizer::parseEndTag(XMLToken& out) {
+    if (nestingDepth() == 0 && opts_.fragment()) {
+        // Closes an element opened before the slice: read its name as if it were
+        // a start tag, so the token and its lifetime are those of any EndTag.
+        return parseOuterEndTag(out);
+    }
+    resyncClose_ = 0; // elements resync() closes after an error here
+    if (nestingDepth() == 0) {
+        const char* msg = "End tag without matching start tag";
+        return emitError(out, TokenizerErrorCode::MismatchedEndTag, ErrorSeverity::Fatal,
+                         msg, static_cast<U32>(std::strlen(msg)));
+    }
+
+    TagFrame& frame = tagStack_.back();
+    const TagArena::Mark mark = tagArena_.mark();
+    const ByteLen used = frame.buf.used;
+    const auto name = readNameToCurrentTagBuffer();
+    const bool valid = name.second != 0 && name.second != kBadOff;
+    const bool match = valid && validateEndTagMatch(name.first, name.second);
+    if (valid && !match) resyncClose_ = closedByEndTag(name.first, name.second);
+    tagArena_.release(mark); // drop the scratch copy
+    frame.buf.used = used;
+
+    if (!match) {
+        const bool limit = (name.second == kBadOff);
+        const char* msg  = limit ? "Element name exceeds limit" : "End tag does not match open element";
+        return emitError(out,
+                         limit ? TokenizerErrorCode::LimitExceeded : TokenizerErrorCode::MismatchedEndTag,
+                         ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    }
+
+    skipXMLSpace();
+    const int32_t ch = peekCp();
+    if (ch != '>') {
+        resyncClose_ = 1; // the name matched
+        const char* msg = (ch < 0) ? "Unexpected EOF in end tag" : "Expected '>' in end tag";
+        return emitError(out,
+                         (ch < 0) ? TokenizerErrorCode::UnexpectedEOF : TokenizerErrorCode::UnterminatedTag,
+                         ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    }
+    getCp(); // '>'
+
+    // Frame is popped on the next nextToken() so the token's name stays valid.
+    state_ = State::Content;
+    flags_.set(TokenizerFlags::PendingPop);
+    return makeTagToken(out, XMLTokenType::EndTag, frame.ctx.name, frame.ctx.nameLen, frame.ctx.nameId);
+}
+
+// A frame is pushed for the outer element so its name lives in the tag arena like
+// any other, and the usual PendingPop releases it after the token.
+bool XMLTokenizer::parseOuterEndTag(XMLToken& out) {
+    if (!pushTagFrame()) {
+        const char* msg = "Per-tag buffer unavailable";
+        return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                         msg, static_cast<U32>(std::strlen(msg)));
+    }
+    if (!ensureCurrentTagBuffer()) {
+        popTagFrame();
+        const char* msg = "Per-tag buffer unavailable";
+        return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                         msg, static_cast<U32>(std::strlen(msg)));
+    }
+
+    const auto name = readNameToCurrentTagBuffer();
+    if (name.second == 0 || name.second == kBadOff) {
+        popTagFrame();
+        const bool limit = (name.second == kBadOff);
+        const char* msg  = limit ? "Element name exceeds limit" : "End tag does not match open element";
+        return emitError(out,
+                         limit ? TokenizerErrorCode::LimitExceeded : TokenizerErrorCode::MismatchedEndTag,
+                         ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    }
+
+    skipXMLSpace();
+    const int32_t ch = peekCp();
+    if (ch != '>') {
+        popTagFrame();
+        const char* msg = (ch < 0) ? "Unexpected EOF in end tag" : "Expected '>' in end tag";
+        return emitError(out,
+                         (ch < 0) ? TokenizerErrorCode::UnexpectedEOF : TokenizerErrorCode::UnterminatedTag,
+                         ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    }
+    getCp(); // '>'
+
+    TagContext& ctx = tagStack_.back().ctx;
+    ctx.name    = name.first;
+    ctx.nameLen = name.second;
+    ctx.nameId  = internIfEnabled(name.first, name.second);
+    state_ = State::Content;
+    flags_.set(TokenizerFlags::PendingPop);
+    return makeTagToken(out, XMLTokenType::EndTag, ctx.name, ctx.nameLen, ctx.nameId);
+}
+
+bool XMLTokenizer::parseAttributesBasic(XMLToken& out) {
+    TagFrame& frame = tagStack_.back();
+    TagContext& ctx = frame.ctx;
+
+    switch (state_) {
+        case State::InTag: {
+            skipXMLSpace();
+            const int32_t ch = peekCp();
+            if (ch == '>') {
+                getCp();
+                state_ = State::Content;
+                return false; // start tag complete; no token
+            }
+            if (ch == '/') {
+                markTokenStart();
+                getCp();
+                if (peekCp() != '>') {
+                    const char* msg = "Expected '>' after '/' in tag";
+                    return emitError(out, TokenizerErrorCode::UnterminatedTag, ErrorSeverity::Fatal,
+                                     msg, static_cast<U32>(std::strlen(msg)));
+                }
+                getCp();
+                ctx.sawSlashBeforeGT = true;
+                state_ = State::Content;
+                flags_.set(TokenizerFlags::PendingPop);
+                return makeTagToken(out, XMLTokenType::EmptyTag, ctx.name, ctx.nameLen, ctx.nameId);
+            }
+            if (ch < 0) {
+                const char* msg = "Unexpected EOF inside tag";
+                return emitError(out, TokenizerErrorCode::UnexpectedEOF, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            if (!isNameStart(static_cast<U32>(ch))) {
+                const char* msg = "Invalid character in tag";
+                return emitError(out, TokenizerErrorCode::InvalidCharInName, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            if (ctx.attrCount >= lims_.maxAttrsPerElement) {
+                const char* msg = "Too many attributes";
+                return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            state_ = State::AttrName;
+            [[fallthrough]];
+        }
+
+        case State::AttrName: {
+            markTokenStart();
+            const auto name = readNameToCurrentTagBuffer();
+            if (name.second == 0 || name.second == kBadOff) {
+                const char* msg = "Attribute name exceeds limit";
+                return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            ++ctx.attrCount;
+            state_ = State::AfterAttrName;
+            return makeTagToken(out, XMLTokenType::AttributeName, name.first, name.second,
+                                internIfEnabled(name.first, name.second));
+        }
+
+        case State::AfterAttrName: {
+            skipXMLSpace();
+            if (peekCp() != '=') {
+                const char* msg = "Expected '=' after attribute name";
+                return emitError(out, TokenizerErrorCode::ExpectedEqualsAfterAttrName, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            getCp();
+            state_ = State::BeforeAttrValue;
+            [[fallthrough]];
+        }
+
+        case State::BeforeAttrValue: {
+            skipXMLSpace();
+            const int32_t q = peekCp();
+            if (q != '"' && q != '\'') {
+                const char* msg = "Expected quote for attribute value";
+                return emitError(out, TokenizerErrorCode::ExpectedQuoteForAttrValue, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            getCp();
+            ctx.quote = static_cast<U8>(q);
+            state_ = State::AttrValueQuoted;
+            [[fallthrough]];
+        }
+
+        case State::AttrValueQuoted:
+            return readAttrValue(out);
+
+        default:
+            break;
+    }
+    return emitError(out, TokenizerErrorCode::None, ErrorSeverity::Fatal,
+                     "Unexpected tag state", 20);
+}
+
+// Copies the value run by run: the window is searched for the closing quote,
+// '<' (not allowed in values), CR (normalized like text) and '&' (expanded like
+// text), and each run is validated and appended with one copy.
+bool XMLTokenizer::readAttrValue(XMLToken& out) {
+    const bool normalize = opts_.normalizeLineEndings();
+    if (opts_.expandInternalEntities()) return normalize ? readAttrValueAs<true, true>(out) : readAttrValueAs<false, true>(out);
+    return normalize ? readAttrValueAs<true, false>(out) : readAttrValueAs<false, false>(out);
+}
+
+template<bool Normalize, bool Expand>
+bool XMLTokenizer::readAttrValueAs(XMLToken& out) {
+    TagContext& ctx = tagStack_.back().ctx;
+    markTokenStart(); // first value byte
+
+    const uint8_t quote = ctx.quote;
+    U32 total = 0;
+    tagArena_.beginSlice();
+
+    auto append = [&](const char* data, U32 len) -> bool {
+        if (total + len > lims_.maxAttrValueBytes) return false;
+        if (!appendToCurrentTagBuf(data, len)) return false;
+        total += len;
+        return true;
+    };
+
+    while (true) {
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekCodePointSpan(len);
+        if (!p) {
+            const char* msg = "Unexpected EOF in attribute value";
+            return emitError(out, TokenizerErrorCode::UnexpectedEOF, ErrorSeverity::Fatal,
+                             msg, static_cast<U32>(std::strlen(msg)));
+        }
+
+        std::size_t stop;
+        if constexpr (Normalize && Expand) stop = ByteScan::findFirstOf(p, len, quote, '<', '\r', '&');
+        else if constexpr (Normalize)      stop = ByteScan::findFirstOf(p, len, quote, '<', '\r');
+        else if constexpr (Expand)         stop = ByteScan::findFirstOf(p, len, quote, '<', '&');
+        else                               stop = ByteScan::findFirstOf(p, len, quote, '<');
+        const auto v = UTF8Handler::validate(p, stop);
+        if (v.validBytes) {
+            if (!append(reinterpret_cast<const char*>(p), static_cast<U32>(v.validBytes))) {
+                const char* msg = "Attribute value exceeds limit";
+                return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                                 msg, static_cast<U32>(std::strlen(msg)));
+            }
+            in_.consumeSpan(v.validBytes);
+        }
+
+        if (v.validBytes < stop) {
+            if (v.validBytes != 0 && v.status == UTF8Handler::DecodeStatus::NeedMore) continue; // split by window
+            const char* msg = "Invalid UTF-8 in attribute value";
+            return emitError(out, TokenizerErrorCode::InvalidUTF8, ErrorSeverity::Fatal,
+                             msg, static_cast<U32>(std::strlen(msg)));
+        }
+        if (stop == len) continue; // window exhausted; refill
+
+        const uint8_t b = p[stop];
+        if (Expand && b == '&') {
+            const RefResult r = expandReference(append);
+            if (r == RefResult::Ok) continue;
+            if (r != RefResult::Limit) return emitReferenceError(out, r);
+            const char* msg = "Attribute value exceeds limit";
+            return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                             msg, static_cast<U32>(std::strlen(msg)));
+        }
+        if (b == '<') { // left at the cursor: a recovering tokenizer reads a tag there
+            const char* msg = "'<' not allowed in attribute value";
+            return emitError(out, TokenizerErrorCode::InvalidCharInAttrValue, ErrorSeverity::Fatal,
+                             msg, static_cast<U32>(std::strlen(msg)));
+        }
+        in_.consumeSpan(1);
+        if (b == quote) break;
+        // CR: emit single LF for both CR and CRLF
+        if (peekCp() == '\n') getCp();
+        if (!append("\n", 1)) {
+            const char* msg = "Attribute value exceeds limit";
+            return emitError(out, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Fatal,
+                             msg, static_cast<U32>(std::strlen(msg)));
+        }
+    }
+
+    state_ = State::InTag;
+    return makeTagToken(out, XMLTokenType::AttributeValue, tagArena_.sliceData(), total);
+}
+
+// ===== Subtree skipping =====
+// A byte-level state machine run over whole windows: ByteScan jumps to the next
+// byte that matters in the current state ('<' in content; '>' or a quote in a
+// tag; the closing byte of a quote, comment, CDATA section or PI), and the window
+// is consumed in one step (one line/column update) before the next refill.
+
+bool XMLTokenizer::failSkip(TokenizerErrorCode code, const char* msg) noexcept {
+    pendingStartValid_ = false; // report where the scan stopped
+    flags_.set(TokenizerFlags::Ended); // the cursor is lost: fatal even with RecoverErrors
+    emitError(la_.tok, code, ErrorSeverity::Fatal, msg, static_cast<U32>(std::strlen(msg)));
+    la_.has = true;
+    return false;
+}
+
+bool XMLTokenizer::skipCurrentElement(bool checkNames) {
+    if (!flags_.test(TokenizerFlags::Started) || la_.has || state_ == State::Resyncing) return false;
+    if (in_.isPush() && !in_.finished()) return false; // the raw scan cannot be retried
+    if (flags_.test(TokenizerFlags::PendingPop)) {
+        flags_.clr(TokenizerFlags::PendingPop);
+        popTagFrame();
+    }
+    reclaimDeferredTags();
+    if (flags_.test(TokenizerFlags::Ended) || tagStack_.empty()) return false;
+
+    enum class Skip : U8 {
+        Content, // looking for '<'
+        Lt,      // the byte after '<'
+        Bang,    // after "<!": comment, CDATA or declaration
+        Tag,     // inside a start tag: '>' or a quote
+        Quoted,  // inside an attribute value: the closing 'end' quote
+        Name,    // checkNames: reading a tag name into skipNames_
+        Through  // up to an 'end' preceded by b1 b2 (0 = any): end tags, comments, CDATA, PIs
+    };
+    const char* const eofMsg = "Unexpected EOF in skipped element";
+
+    // Elements open in the subtree, not counting one whose start tag is being read.
+    U64  depth = 1;
+    Skip st = Skip::Content;
+    uint8_t end = 0, b1 = 0, b2 = 0;
+    if (state_ == State::InCData) { // inside a chunked CDATA section
+        st = Skip::Through;
+        end = '>';
+        b1 = b2 = ']';
+    } else if (state_ != State::Content) { // StartTag or AttributeName just returned
+        depth = 0;
+        st = Skip::Tag;
+    }
+    uint8_t prev1 = 0, prev2 = 0;  // the two bytes before the cursor (Tag: prev2 only)
+    bool closing = false;          // Through is finishing an end tag
+    bool endName = false;          // Name is an end tag name
+    std::size_t nameMark = 0;      // Name: where it starts in skipNames_
+    const char* opener = "";       // Bang: "--" or "[CDATA["
+    U8 opened = 0;                 // Bang: bytes of it matched so far
+
+    try {
+        if (checkNames) {
+            const TagContext& ctx = tagStack_.back().ctx;
+            skipNames_.assign(ctx.name, ctx.name + ctx.nameLen);
+            skipNameEnds_.assign(1, ctx.nameLen);
+        }
+
+        for (bool done = false; !done;) {
+            std::size_t len = 0;
+            const uint8_t* p = in_.peekSpan(len);
+            if (!p) return failSkip(TokenizerErrorCode::UnexpectedEOF, eofMsg);
+
+            std::size_t i = 0;
+            while (i < len && !done) {
+                switch (st) {
+                    case Skip::Content:
+                        i += ByteScan::findFirstOf(p + i, len - i, '<');
+                        if (i == len) continue;
+                        ++i;
+                        st = Skip::Lt;
+                        continue;
+
+                    case Skip::Lt: {
+                        const uint8_t c = p[i];
+                        end = '>';
+                        b1 = b2 = prev1 = prev2 = 0;
+                        st = Skip::Through;
+                        if (c == '/') {
+                            ++i;
+                            closing = true;
+                            if (checkNames) {
+                                st = Skip::Name;
+                                endName = true;
+                                nameMark = skipNames_.size();
+                            }
+                        } else if (c == '!') {
+                            ++i;
+                            opened = 0;
+                            st = Skip::Bang;
+                        } else if (c == '?') {
+                            ++i;
+                            b2 = '?';
+                        } else {
+                            st = Skip::Tag;
+                            if (checkNames) {
+                                if (!isNameStart(c)) {
+                                    return failSkip(TokenizerErrorCode::InvalidCharAfterLT, "Invalid character after '<'");
+                                }
+                                if (tagStack_.size() + depth > lims_.maxOpenDepth) {
+                                    return failSkip(TokenizerErrorCode::LimitExceeded, "Maximum tag nesting depth exceeded");
+                                }
+                                st = Skip::Name;
+                                endName = false;
+                                nameMark = skipNames_.size();
+                            }
+                        }
+                        continue;
+                    }
+
+                    case Skip::Bang: {
+                        // Match "--" or "[CDATA[" a byte at a time (the window may end
+                        // anywhere); anything else is a declaration up to the next '>'.
+                        const uint8_t c = p[i++];
+                        if (opened == 0) opener = (c == '-') ? "--" : "[CDATA[";
+                        if (c == static_cast<uint8_t>(opener[opened])) {
+                            if (opener[++opened] == '\0') {
+                                b1 = b2 = (c == '-') ? '-' : ']';
+                                st = Skip::Through;
+                            }
+                            continue;
+                        }
+                        st = (c == '>') ? Skip::Content : Skip::Through;
+                        continue;
+                    }
+
+                    case Skip::Name: {
+                        std::size_t j = i;
+                        while (j < len && p[j] != '>' && p[j] != '/' && !CharClass::isXMLWhitespace(p[j])) ++j;
+                        skipNames_.insert(skipNames_.end(), reinterpret_cast<const char*>(p + i),
+                                          reinterpret_cast<const char*>(p + j));
+                        i = j;
+                        if (i == len) continue;
+                        if (endName) {
+                            const std::size_t top = skipNameEnds_.size() > 1 ? skipNameEnds_[skipNameEnds_.size() - 2] : 0;
+                            const std::size_t open = skipNameEnds_.back() - top;
+                            if (skipNames_.size() - nameMark != open ||
+                                std::memcmp(skipNames_.data() + top, skipNames_.data() + nameMark, open) != 0) {
+                                return failSkip(TokenizerErrorCode::MismatchedEndTag, "End tag does not match open element");
+                            }
+                            skipNames_.resize(top);
+                            skipNameEnds_.pop_back();
+                            st = Skip::Through;
+                        } else {
+                            skipNameEnds_.push_back(static_cast<U32>(skipNames_.size()));
+                            st = Skip::Tag;
+                        }
+                        continue;
+                    }
+
+                    case Skip::Tag: {
+                        const std::size_t j = i + ByteScan::findFirstOf(p + i, len - i, '>', '"', '\'');
+                        if (j > i) prev2 = p[j - 1];
+                        i = j;
+                        if (i == len) continue;
+                        const uint8_t b = p[i++];
+                        if (b != '>') {
+                            end = b;
+                            st = Skip::Quoted;
+                            continue;
+                        }
+                        if (prev2 != '/') {
+                            ++depth;
+                        } else if (checkNames) {
+                            skipNameEnds_.pop_back();
+                            skipNames_.resize(skipNameEnds_.empty() ? 0 : skipNameEnds_.back());
+                        }
+                        prev2 = 0;
+                        st = Skip::Content;
+                        done = (depth == 0);
+                        continue;
+                    }
+
+                    case Skip::Quoted: {
+                        i += ByteScan::findFirstOf(p + i, len - i, end);
+                        if (i == len) continue;
+                        prev2 = p[i++];
+                        st = Skip::Tag;
+                        continue;
+                    }
+
+                    case Skip::Through: {
+                        const std::size_t j = i + ByteScan::findFirstOf(p + i, len - i, end);
+                        if (j >= i + 2)     { prev1 = p[j - 2]; prev2 = p[j - 1]; }
+                        else if (j == i + 1) { prev1 = prev2;    prev2 = p[i]; }
+                        i = j;
+                        if (i == len) continue;
+                        ++i;
+                        if ((b1 && prev1 != b1) || (b2 && prev2 != b2)) {
+                            prev1 = prev2;
+                            prev2 = end;
+                            continue;
+                        }
+                        st = Skip::Content;
+                        if (closing) {
+                            closing = false;
+                            done = (--depth == 0);
+                        }
+                        continue;
+                    }
+                }
+            }
+            in_.consumeSpan(i);
+        }
+    } catch (const std::bad_alloc&) {
+        return failSkip(TokenizerErrorCode::LimitExceeded, "Out of memory while skipping element");
+    }
+
+    popTagFrame();
+    state_ = State::Content;
+    flags_.clr(TokenizerFlags::InTextRun); // a chunked CDATA section was skipped too
+    return true;
+}
+
+// ===== Error recovery (RecoverErrors) =====
+// emitError() leaves state_ at Resyncing and resyncFrom_ at the state the error was
+// raised in. resync() skips what is left of the broken construct with ByteScan, as
+// skipCurrentElement() does, then repairs the element stack with synthetic tokens
+// so that what follows stays balanced:
+//   - a broken attribute gets an empty AttributeValue; the tag goes on after a bad
+//     quoted value or a missing '=' or quote, else it ends at the next '>' (an
+//     EmptyTag for "/>") or before the next '<', its element left open;
+//   - a comment, CDATA section or PI is skipped through its terminator (a chunked
+//     CDATA section gets an empty last piece);
+//   - text, and whatever follows a '<' that starts no tag, up to the next '<';
+//   - an end tag matching an open ancestor closes every element down to it (EndTag
+//     tokens, innermost first); one matching no open element is dropped;
+//   - at the end of input the open elements are closed the same way.
+
+bool XMLTokenizer::resync(XMLToken& out) {
+    const State from = resyncFrom_;
+    resyncFrom_ = State::Resyncing; // skipped (unless set again below)
+    switch (from) {
+        case State::Resyncing:
+            break; // closing elements
+
+        case State::AfterAttrName:
+        case State::BeforeAttrValue:
+        case State::AttrValueQuoted: {
+            bool inTag = true; // the tag can be read on
+            if (from == State::AttrValueQuoted) {
+                // Through the closing quote; a '<' (kept) or EOF first ends the tag.
+                const uint8_t quote = tagStack_.back().ctx.quote;
+                for (;;) {
+                    std::size_t len = 0;
+                    const uint8_t* p = in_.peekSpan(len);
+                    if (!p) break;
+                    const std::size_t i = ByteScan::findFirstOf(p, len, quote, '<');
+                    if (i == len) {
+                        in_.consumeSpan(len);
+                        continue;
+                    }
+                    in_.consumeSpan(i + (p[i] == quote));
+                    inTag = p[i] == quote;
+                    break;
+                }
+            } else if (from == State::BeforeAttrValue) {
+                // An unquoted value: up to whitespace, '>', "/>" or '<'.
+                for (int32_t ch; (ch = peekCp()) >= 0 && ch != '>' && ch != '<' &&
+                                 !CharClass::isXMLWhitespace(static_cast<U32>(ch));) {
+                    if (ch == '/') {
+                        std::size_t len = 0;
+                        const uint8_t* p = in_.peekSpan(len, 2);
+                        if (len >= 2 && p[1] == '>') break;
+                    }
+                    getCp();
+                }
+            }
+            const int32_t ch = peekCp();
+            inTag = inTag && ch >= 0 && (ch == '>' || ch == '/' || CharClass::isXMLWhitespace(static_cast<U32>(ch)) ||
+                                         isNameStart(static_cast<U32>(ch)));
+            if (inTag) {
+                state_ = State::InTag;
+            } else {
+                resyncFrom_ = State::InTag;
+            }
+            return makeTagToken(out, XMLTokenType::AttributeValue, nullptr, 0);
+        }
+
+        case State::InTag:
+        case State::AttrName:
+            // After the StartTag: the element stays open, or closes at "/>".
+            if (skipToTagEnd()) {
+                tagStack_.back().ctx.sawSlashBeforeGT = true;
+                state_ = State::Content;
+                flags_.set(TokenizerFlags::PendingPop);
+                const TagContext& ctx = tagStack_.back().ctx;
+                return makeTagToken(out, XMLTokenType::EmptyTag, ctx.name, ctx.nameLen, ctx.nameId);
+            }
+            break;
+
+        case State::StartTagName:
+        case State::EndTagName:
+        case State::AfterBang:
+            skipToTagEnd();
+            break;
+
+        case State::InComment:
+            skipPast(kComment.term, kComment.termLen);
+            break;
+        case State::PIContent:
+            skipPast(kPI.term, kPI.termLen);
+            break;
+        case State::InCData:
+            skipPast(kCData.term, kCData.termLen);
+            if (flags_.test(TokenizerFlags::InTextRun)) {
+                flags_.clr(TokenizerFlags::InTextRun);
+                return makeTextToken(out, 0, 0, 0, XMLTokenType::CDATA);
+            }
+            break;
+
+        default: // Content, TagOpen
+            skipToLt();
+            break;
+    }
+
+    if (resyncClose_ != 0 && !tagStack_.empty()) {
+        --resyncClose_;
+        flags_.set(TokenizerFlags::PendingPop);
+        const TagContext& ctx = tagStack_.back().ctx;
+        return makeTagToken(out, XMLTokenType::EndTag, ctx.name, ctx.nameLen, ctx.nameId);
+    }
+    resyncClose_ = 0;
+    state_ = State::Content;
+    return false;
+}
+
+bool XMLTokenizer::skipToTagEnd() {
+    uint8_t prev = 0;
+    for (;;) {
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekSpan(len);
+        if (!p) return false;
+        const std::size_t i = ByteScan::findFirstOf(p, len, '<', '>');
+        if (i == len) {
+            prev = p[len - 1];
+            in_.consumeSpan(len);
+            continue;
+        }
+        if (p[i] == '<') {
+            in_.consumeSpan(i);
+            return false;
+        }
+        const bool empty = (i ? p[i - 1] : prev) == '/';
+        in_.consumeSpan(i + 1);
+        return empty;
+    }
+}
+
+void XMLTokenizer::skipToLt() {
+    for (;;) {
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekSpan(len);
+        if (!p) return;
+        const std::size_t i = ByteScan::findFirstOf(p, len, '<');
+        in_.consumeSpan(i);
+        if (i < len) return;
+    }
+}
+
+// A terminator split by the window end is kept back: n - 1 bytes stay unconsumed
+// until the next window brings the rest.
+void XMLTokenizer::skipPast(const char* term, std::size_t n) {
+    const auto t0 = static_cast<uint8_t>(term[0]);
+    for (;;) {
+        std::size_t len = 0;
+        const uint8_t* p = in_.peekSpan(len, n);
+        if (len < n) {
+            in_.consumeSpan(len);
+            return;
+        }
+        for (std::size_t i = 0;; ++i) {
+            i += ByteScan::findFirstOf(p + i, len - i, t0);
+            if (i + n > len) break;
+            if (std::memcmp(p + i, term, n) == 0) {
+                in_.consumeSpan(i + n);
+                return;
+            }
+        }
+        in_.consumeSpan(len - (n - 1));
+    }
+}
+
+std::size_t XMLTokenizer::closedByEndTag(const char* name, U32 len) const noexcept {
+    for (std::size_t i = tagStack_.size(); i-- > 0;) {
+        const TagContext& ctx = tagStack_[i].ctx;
+        if (ctx.nameLen == len && std::memcmp(ctx.name, name, len) == 0) return tagStack_.size() - i;
+    }
+    return 0;
+}
+
+// ===== Checkpoints =====
+
+bool XMLTokenizer::checkpoint(TokenizerCheckpoint& out) const {
+    if (!flags_.test(TokenizerFlags::Started) || flags_.test(TokenizerFlags::Ended) || la_.has ||
+        state_ != State::Content || flags_.test(TokenizerFlags::InTextRun)) {
         return false;
-    
-    const char* startTagName = frame.buf.mem.get() + ctx.nameMark.offset;
-    return std::memcmp(namePtr, startTagName, nameLen) == 0;
+    }
+    // An element whose EndTag/EmptyTag was just returned is closed already.
+    const std::size_t depth = nestingDepth();
+    out.where = currentPosition();
+    out.state = state_;
+    out.flags = flags_.bits & ~TokenizerFlags::PendingPop;
+    out.open.clear();
+    out.open.reserve(depth);
+    for (std::size_t i = 0; i < depth; ++i) {
+        const TagContext& ctx = tagStack_[i].ctx;
+        out.open.emplace_back(ctx.name, ctx.nameLen);
+    }
+    return true;
+}
+
+// Each open element gets a frame holding only its name, as if its start tag had
+// no attributes; the frames start at the checkpoint position.
+bool XMLTokenizer::resume(const TokenizerCheckpoint& cp) {
+    reset();
+    if (cp.state != State::Content || cp.where.byteOffset != currentPosition().byteOffset ||
+        cp.open.size() > lims_.maxOpenDepth) {
+        return false;
+    }
+    for (const std::string& name : cp.open) {
+        if (name.empty() || name.size() > lims_.maxNameBytes || !pushTagFrame() || !ensureCurrentTagBuffer()) {
+            reset();
+            return false;
+        }
+        tagArena_.beginSlice();
+        if (!appendToCurrentTagBuf(name.data(), static_cast<U32>(name.size()))) {
+            reset();
+            return false;
+        }
+        TagContext& ctx = tagStack_.back().ctx;
+        ctx.name    = tagArena_.sliceData();
+        ctx.nameLen = static_cast<U32>(name.size());
+        ctx.nameId  = internIfEnabled(ctx.name, ctx.nameLen);
+    }
+    flags_.bits = (cp.flags & ~(TokenizerFlags::Ended | TokenizerFlags::PendingPop)) | TokenizerFlags::Started;
+    state_ = State::Content;
+    return true;
+}
+
+void XMLTokenizer::noteCheckpoint() noexcept {
+    try {
+        TokenizerCheckpoint cp;
+        if (checkpoint(cp)) index_->add(std::move(cp));
+    } catch (const std::bad_alloc&) {
+        // A missing entry only means a longer rescan later; keep tokenizing.
+    }
+}
+
+size_t XMLTokenizer::nextTokens(XMLToken* out, size_t cap) {
+    // Tokens of the previous batch are dead now; reclaim what they pinned.
+    reclaimDeferredTags();
+
+    size_t n = 0;
+    deferTagRelease_ = true;
+    while (n < cap && nextToken(out[n])) {
+        const XMLTokenType t = out[n++].type;
+        // Lifetime boundary: the next token would reuse this token's storage.
+        if ((t >= XMLTokenType::Text && t <= XMLTokenType::DOCTYPE) ||
+            t == XMLTokenType::Error || t == XMLTokenType::DocumentEnd) break;
+    }
+    deferTagRelease_ = false;
+    return n;
 }
 
 bool XMLTokenizer::nextToken(XMLToken& out) {
+#if defined(LXML_ENABLE_STATS)
+    timeThisCall_ = timingEvery_ != 0 && --timingCountdown_ == 0;
+    if (timeThisCall_) timingCountdown_ = timingEvery_;
+    if (!produceToken(out)) return false;
+    ++stats_.tokensEmitted;
+    ++stats_.tokensByType[static_cast<std::size_t>(out.type)];
+    if (out.type == XMLTokenType::Error) ++stats_.errorsEmitted;
+#else
+    if (!produceToken(out)) return false;
+#endif
+    if (index_ && index_->due(in_.getTotalBytesRead())) noteCheckpoint();
+    return true;
+}
+
+bool XMLTokenizer::produceToken(XMLToken& out) {
+    needInput_ = false;
     // === Guard 1: First call always emits DocumentStart ===
     if (!flags_.test(TokenizerFlags::Started)) {
         return emitDocumentStart(out);
     }
+
+    // An Error queued by skipCurrentElement().
+    if (la_.has) {
+        la_.has = false;
+        out = la_.tok;
+        return true;
+    }
     
+    // Deferred pop: the last EndTag/EmptyTag token has been consumed by now.
+    if (flags_.test(TokenizerFlags::PendingPop)) {
+        flags_.clr(TokenizerFlags::PendingPop);
+        popTagFrame();
+    }
+    if (!deferTagRelease_) reclaimDeferredTags();
+
     // === Guard 2: Already ended, no more tokens ===
     if (flags_.test(TokenizerFlags::Ended)) {
         return false;
     }
-    
+    return in_.isPush() ? scanPushToken(out) : scanToken(out);
+}
+
+// Push input: the token is scanned as usual, but if a read ran into the end of
+// the bytes fed so far it was cut short (a name, a text run, EOF in content), so
+// it is undone: cursor, state, flags and any frame or arena bytes it added go
+// back to the snapshot, and the same token is scanned again after feed().
+bool XMLTokenizer::scanPushToken(XMLToken& out) {
+    const State          state = state_;
+    const U32            flags = flags_.bits;
+    const std::size_t    depth = tagStack_.size();
+    const TagArena::Mark top   = tagArena_.mark();
+    const TagFrame       frame = depth ? tagStack_.back() : TagFrame{};
+    const SourcePosition pending = pendingStart_;
+    const bool           pendingValid = pendingStartValid_;
+    const State          resyncFrom = resyncFrom_;
+    const std::size_t    resyncClose = resyncClose_;
+    in_.setMark();
+
+    const bool got = scanToken(out);
+    if (!in_.starved()) return got;
+
+    in_.rewindToMark();
+    state_ = state;
+    flags_.bits = flags;
+    while (tagStack_.size() > depth) tagStack_.pop_back();
+    if (depth) tagStack_.back() = frame;
+    tagArena_.release(top);
+    pendingStart_ = pending;
+    pendingStartValid_ = pendingValid;
+    resyncFrom_ = resyncFrom;
+    resyncClose_ = resyncClose;
+    needInput_ = true;
+    return false;
+}
+
+bool XMLTokenizer::scanToken(XMLToken& out) {
     // === Main DFA Loop ===
     // Keep processing until we emit a token (return true) or reach end (return false)
     while (true) {
+#if defined(LXML_ENABLE_STATS)
+        const StateTimer timer(timeThisCall_ ? &stats_ : nullptr, state_);
+#endif
         switch (state_) {
             case State::Content: {
                 // Outside tags: either text content or start of a tag
@@ -548,6 +2066,7 @@ bool XMLTokenizer::nextToken(XMLToken& out) {
                 
                 // '<' → transition to TagOpen
                 if (ch == '<') {
+                    markTokenStart(); // tags report the position of their '<'
                     getCp();  // Consume '<'
                     state_ = State::TagOpen;
                     continue;  // Loop to handle TagOpen state
@@ -582,35 +2101,27 @@ bool XMLTokenizer::nextToken(XMLToken& out) {
                     // '</...' → end tag
                     getCp();  // Consume '/'
                     state_ = State::EndTagName;
-                    // TODO: implement parseEndTag()
-                    return emitError(out, TokenizerErrorCode::None,
-                                    ErrorSeverity::Fatal,
-                                    "End tags not yet implemented", 28);
+                    continue;
                 }
                 
                 if (ch == '!') {
                     // '<!...' → comment, CDATA, or DOCTYPE
-                    // Phase-1: not supported
-                    return emitError(out, TokenizerErrorCode::InvalidCharAfterLT,
-                                    ErrorSeverity::Fatal,
-                                    "Comments/CDATA/DOCTYPE not supported in Phase-1", 47);
+                    getCp();  // Consume '!'
+                    state_ = State::AfterBang;
+                    continue;
                 }
                 
                 if (ch == '?') {
-                    // '<?...' → processing instruction
-                    // Phase-1: not supported
-                    return emitError(out, TokenizerErrorCode::InvalidCharAfterLT,
-                                    ErrorSeverity::Fatal,
-                                    "Processing instructions not supported in Phase-1", 48);
+                    // '<?...' → processing instruction (target checked with the body)
+                    getCp();  // Consume '?'
+                    state_ = State::PIContent;
+                    continue;
                 }
                 
                 if (CharClass::isNameStart(static_cast<U32>(ch))) {
                     // '<Name...' → start tag
                     state_ = State::StartTagName;
-                    // TODO: implement parseStartTag()
-                    return emitError(out, TokenizerErrorCode::None,
-                                    ErrorSeverity::Fatal,
-                                    "Start tags not yet implemented", 30);
+                    continue;
                 }
                 
                 // Invalid character after '<'
@@ -620,31 +2131,72 @@ bool XMLTokenizer::nextToken(XMLToken& out) {
             }
             
             case State::StartTagName:
+                return parseStartTag(out);
+
             case State::EndTagName:
+                return parseEndTag(out);
+
             case State::InTag:
             case State::AttrName:
             case State::AfterAttrName:
             case State::BeforeAttrValue:
             case State::AttrValueQuoted:
-                // These states need parseStartTag, parseEndTag, parseAttributesBasic
-                // For now, emit error (shouldn't reach here yet)
-                return emitError(out, TokenizerErrorCode::None,
-                                ErrorSeverity::Fatal,
-                                "Tag parsing not yet implemented", 31);
+                if (parseAttributesBasic(out)) {
+                    return true;  // AttributeName/AttributeValue/EmptyTag or Error
+                }
+                continue;  // '>' consumed; back to Content
             
-            case State::AfterBang:
+            case State::AfterBang: {
+                // Only as many bytes are asked for as the opener needs, so pushed
+                // input is not waited on needlessly.
+                std::size_t len = 0;
+                const uint8_t* p = in_.peekSpan(len, 2);
+                if (p && len >= 2 && p[0] == '-' && p[1] == '-') {
+                    in_.consumeSpan(2);
+                    state_ = State::InComment;
+                    continue;
+                }
+                if (p && (p[0] == '[' || p[0] == 'D')) {
+                    p = in_.peekSpan(len, 7);
+                    if (len >= 7 && std::memcmp(p, "[CDATA[", 7) == 0) {
+                        in_.consumeSpan(7);
+                        state_ = State::InCData;
+                        continue;
+                    }
+                    if (len >= 7 && std::memcmp(p, "DOCTYPE", 7) == 0) {
+                        in_.consumeSpan(7);
+                        return scanDoctype(out);
+                    }
+                }
+                return emitError(out, TokenizerErrorCode::InvalidCharAfterLT,
+                                ErrorSeverity::Fatal,
+                                "Invalid markup after '<!'", 25);
+            }
+
+            case State::InComment:
+            case State::InCData:
+            case State::PIContent:
+                if (scanMarkup(out)) {
+                    return true;  // Comment/CDATA/PI (or a CDATA piece) or Error
+                }
+                continue;  // XML declaration dropped; back to Content
+
+            case State::Resyncing:
+                if (resync(out)) {
+                    return true;  // a repair token
+                }
+                continue;  // back to Content
+
+            // The markup scanners search for whole terminators, so the
+            // byte-at-a-time states are never entered.
             case State::CommentStart1:
             case State::CommentStart2:
-            case State::InComment:
             case State::CommentEnd1:
             case State::CommentEnd2:
             case State::CDataStart:
-            case State::InCData:
             case State::CDataEnd1:
             case State::CDataEnd2:
             case State::PITarget:
-            case State::PIContent:
-            case State::Resyncing:
                 // Phase-1: these should never be reached
                 return emitError(out, TokenizerErrorCode::None,
                                 ErrorSeverity::Fatal,
@@ -656,4 +2208,144 @@ bool XMLTokenizer::nextToken(XMLToken& out) {
     return false;
 }
 
-} // namespace LXMLFormatter
\ No newline at end of file
+
+TokenizerStats XMLTokenizer::stats() const noexcept {
+    TokenizerStats s = stats_;
+    s.bytesConsumed = in_.getTotalBytesRead() - in_.baseOffset();
+    const BufferedInputStream::IOStats& io = in_.ioStats();
+    s.inputRefills    = io.refills;
+    s.inputBytesRead  = io.bytesRead;
+    s.inputBytesMoved = io.bytesMoved;
+    s.tagChunkReuses  = tagArena_.chunkReuses();
+    s.tagChunkAllocs  = tagArena_.chunkAllocs();
+    s.maxTextArena    = static_cast<ByteLen>(std::min<std::size_t>(textArena_.buf.capacity(),
+                                                                    std::numeric_limits<ByteLen>::max()));
+    s.maxTagArena     = tagArena_.peakReserved();
+    s.timingEvery     = timingEvery_;
+    return s;
+}
+
+// ===== TokenizerStats dumps =====
+
+const char* TokenizerStats::tokenTypeName(std::size_t i) noexcept {
+    return i < kTokenTypes ? kTokenTypeNames[i] : "?";
+}
+
+const char* TokenizerStats::stateName(std::size_t i) noexcept {
+    return i < kStates ? kStateNames[i] : "?";
+}
+
+const char* TokenizerStats::tickUnit() noexcept {
+#if defined(LXML_STATS_TSC)
+    return "tsc";
+#else
+    return "ns";
+#endif
+}
+
+void TokenizerStats::writeJson(std::ostream& os) const {
+    os << "{\"enabled\":" << (enabled ? "true" : "false")
+       << ",\"bytesConsumed\":" << bytesConsumed
+       << ",\"input\":{\"refills\":" << inputRefills
+       << ",\"bytesRead\":" << inputBytesRead
+       << ",\"bytesMoved\":" << inputBytesMoved << '}'
+       << ",\"tagArena\":{\"chunkReuses\":" << tagChunkReuses
+       << ",\"chunkAllocs\":" << tagChunkAllocs
+       << ",\"peakBytes\":" << maxTagArena << '}'
+       << ",\"textArenaPeakBytes\":" << maxTextArena
+       << ",\"tokens\":{\"total\":" << tokensEmitted;
+    for (std::size_t i = 0; i < kTokenTypes; ++i) {
+        os << ",\"" << kTokenTypeNames[i] << "\":" << tokensByType[i];
+    }
+    os << "},\"errors\":" << errorsEmitted
+       << ",\"maxOpenDepth\":" << maxOpenDepth
+       << ",\"stateTiming\":{\"every\":" << timingEvery
+       << ",\"unit\":\"" << tickUnit() << "\",\"states\":{";
+    bool first = true;
+    for (std::size_t i = 0; i < kStates; ++i) {
+        if (!stateSamples[i]) continue;
+        os << (first ? "" : ",") << '"' << kStateNames[i] << "\":{\"ticks\":" << stateTicks[i]
+           << ",\"samples\":" << stateSamples[i] << '}';
+        first = false;
+    }
+    os << "}}}";
+}
+
+void TokenizerStats::writePrometheus(std::ostream& os, const char* prefix) const {
+    auto metric = [&](const char* name, const char* type, const char* help) {
+        os << "# HELP " << prefix << '_' << name << ' ' << help << '\n'
+           << "# TYPE " << prefix << '_' << name << ' ' << type << '\n';
+    };
+    auto value = [&](const char* name, U64 v) {
+        os << prefix << '_' << name << ' ' << v << '\n';
+    };
+
+    metric("stats_enabled", "gauge", "1 if token and state counters were compiled in (LXML_ENABLE_STATS).");
+    value("stats_enabled", enabled ? 1 : 0);
+    metric("bytes_consumed_total", "counter", "Input bytes tokenized.");
+    value("bytes_consumed_total", bytesConsumed);
+    metric("input_refills_total", "counter", "Input window refills.");
+    value("input_refills_total", inputRefills);
+    metric("input_bytes_read_total", "counter", "Bytes copied into the input window.");
+    value("input_bytes_read_total", inputBytesRead);
+    metric("input_bytes_moved_total", "counter", "Unread bytes moved while compacting the input window.");
+    value("input_bytes_moved_total", inputBytesMoved);
+    metric("tag_chunk_reuses_total", "counter", "Tag arena chunks served from the freelist.");
+    value("tag_chunk_reuses_total", tagChunkReuses);
+    metric("tag_chunk_allocs_total", "counter", "Tag arena chunks allocated.");
+    value("tag_chunk_allocs_total", tagChunkAllocs);
+    metric("tag_arena_peak_bytes", "gauge", "Most bytes held in tag arena chunks.");
+    value("tag_arena_peak_bytes", maxTagArena);
+    metric("text_arena_peak_bytes", "gauge", "Text arena capacity high-water mark.");
+    value("text_arena_peak_bytes", maxTextArena);
+    metric("max_open_depth", "gauge", "Deepest element nesting seen.");
+    value("max_open_depth", maxOpenDepth);
+    metric("errors_total", "counter", "Error tokens emitted.");
+    value("errors_total", errorsEmitted);
+
+    metric("tokens_total", "counter", "Tokens emitted, by type.");
+    for (std::size_t i = 0; i < kTokenTypes; ++i) {
+        os << prefix << "_tokens_total{type=\"" << kTokenTypeNames[i] << "\"} " << tokensByType[i] << '\n';
+    }
+    metric("state_ticks_total", "counter", "Sampled time spent per DFA state (see the unit label).");
+    for (std::size_t i = 0; i < kStates; ++i) {
+        if (!stateSamples[i]) continue;
+        os << prefix << "_state_ticks_total{state=\"" << kStateNames[i] << "\",unit=\"" << tickUnit() << "\"} "
+           << stateTicks[i] << '\n';
+    }
+    metric("state_samples_total", "counter", "Timed visits per DFA state.");
+    for (std::size_t i = 0; i < kStates; ++i) {
+        if (!stateSamples[i]) continue;
+        os << prefix << "_state_samples_total{state=\"" << kStateNames[i] << "\"} " << stateSamples[i] << '\n';
+    }
+}
+
+// ===== TokenizerCheckpoint I/O =====
+
+void TokenizerCheckpoint::write(std::ostream& os) const {
+    os << where.byteOffset << ' ' << where.line << ' ' << where.column << ' '
+       << static_cast<unsigned>(state) << ' ' << flags << ' ' << open.size();
+    for (const std::string& name : open) os << ' ' << name;
+    os << '\n';
+}
+
+bool TokenizerCheckpoint::read(std::istream& is) {
+    std::string line;
+    if (!std::getline(is, line)) return false;
+    std::istringstream ls(line);
+    unsigned st = 0;
+    std::size_t depth = 0;
+    if (!(ls >> where.byteOffset >> where.line >> where.column >> st >> flags >> depth) ||
+        st >= TokenizerStats::kStates || depth > std::numeric_limits<U16>::max()) {
+        return false;
+    }
+    state = static_cast<State>(st);
+    open.assign(depth, std::string());
+    for (std::string& name : open) {
+        if (!(ls >> name)) return false;
+    }
+    ls >> std::ws;
+    return ls.eof();
+}
+
+} // namespace LXMLFormatter
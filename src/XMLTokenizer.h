@@ -3,19 +3,28 @@
 
 #include "BufferedInputStream.h"
 #include "XMLTokenizerTypes.h"
+#include "NameTable.h"
 #include <vector>
 #include <string>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 
 namespace LXMLFormatter {
 
+class CheckpointIndex;
+
 class XMLTokenizer {
 public:
-    // Construct with input stream, options, and limits.
+    // Construct with input stream, options, and limits. Every buffer the tokenizer
+    // owns (text, tag arena and stack, errors and their messages, skip scratch) is
+    // allocated from 'memory' (nullptr = std::pmr::get_default_resource()), which
+    // must outlive the tokenizer or the next setMemoryResource(). The NameTable is
+    // not: interned ids outlive documents. Nothing is allocated here.
     explicit XMLTokenizer(BufferedInputStream& in,
                           TokenizerOptions opts = {},
-                          TokenizerLimits lims = {}) noexcept;
+                          TokenizerLimits lims = {},
+                          std::pmr::memory_resource* memory = nullptr) noexcept;
 
     // Not copyable/movable (references & internal buffers).
     XMLTokenizer(const XMLTokenizer&)            = delete;
@@ -23,28 +32,128 @@ public:
     XMLTokenizer(XMLTokenizer&&)                 = delete;
     XMLTokenizer& operator=(XMLTokenizer&&)      = delete;
 
-    // Produce the next token; returns false after DocumentEnd or fatal error.
+    // Produce the next token; returns false after DocumentEnd or fatal error
+    // (with TokenizerOptions::RecoverErrors most errors are not fatal).
     bool nextToken(XMLToken& out);
 
+    // Fill out[0..cap) with consecutive tokens; returns the count (0 once ended).
+    // A batch stops early after a Text, Error or DocumentEnd token.
+    // Per-batch contract: every token in the batch stays valid until the next
+    // nextToken()/nextTokens() call, including EndTag/EmptyTag and the tag tokens
+    // of elements that closed inside the batch. A Text token is always last, since
+    // the next token reuses its storage.
+    size_t nextTokens(XMLToken* out, size_t cap);
+
     // Accessors.
     const TokenizerOptions& options() const noexcept { return opts_; }
     const TokenizerLimits&  limits()  const noexcept { return lims_; }
+    const BufferedInputStream& input() const noexcept { return in_; }
     State                   state()   const noexcept { return state_; }
 
-    // Simple error API (Phase 1: queue all errors; caller may clear).
-    const std::vector<TokenizerError>& errors() const noexcept { return errors_; }
-    void clearErrors() noexcept { errors_.clear(); }
+    // Counter snapshot (see TokenizerStats for which fields need LXML_ENABLE_STATS).
+    TokenizerStats stats() const noexcept;
+
+    // Time the DFA states on every 'every'-th nextToken() call (0 = off, the
+    // default). Has no effect unless built with LXML_ENABLE_STATS.
+    void setStateTiming(U32 every) noexcept {
+        timingEvery_ = every;
+        timingCountdown_ = every;
+    }
+
+    // Push input (BufferedInputStream::CreatePush): true when the last nextToken()
+    // or nextTokens() call stopped because the bytes fed so far end inside a token.
+    // Nothing of that token is kept or reported (no Error for the missing bytes);
+    // feed() more, or finish(), and call again. skipCurrentElement() waits for
+    // finish() (it returns false before).
+    bool needMoreInput() const noexcept { return needInput_; }
+
+    // Error API: every error is queued, up to limits.maxErrors; later ones are only
+    // counted (not logged either). clearErrors() drops the queue and the messages
+    // (also those of Error tokens already returned); the count goes on.
+    const std::pmr::vector<TokenizerError>& errors() const noexcept { return errors_; }
+    void clearErrors() noexcept {
+        errors_.clear();
+        errorArena_.clear();
+    }
+    // Errors since the last reset(), queued or not.
+    U64 errorCount() const noexcept { return errorCount_; }
+    // The error of the last Error token, queued or not (its message may point
+    // into the queue's storage: valid until clearErrors() or reset()).
+    const TokenizerError& lastError() const noexcept { return lastError_; }
+
+    // The stderr line every error gets unless TokenizerOptions::QuietErrors is set.
+    static void logError(const TokenizerError& e) noexcept;
 
     // Current source position (byte/line/column) as seen at last read.
     SourcePosition currentPosition() const noexcept;
 
     // Current nesting depth (number of open elements).
-    size_t nestingDepth() const noexcept { return tagStack_.size(); }
+    // An element whose EndTag/EmptyTag was just emitted no longer counts.
+    size_t nestingDepth() const noexcept {
+        return tagStack_.size() - (flags_.test(TokenizerFlags::PendingPop) ? 1u : 0u);
+    }
+
+    // Fast-forward past the rest of the innermost open element (the one counted by
+    // nestingDepth(), normally the element whose StartTag was just returned; pending
+    // AttributeName/AttributeValue/EmptyTag tokens are skipped too) through its end
+    // tag. The bytes are scanned raw: no tokens, no copies into the arenas, no
+    // attribute parsing or UTF-8 validation; nested comments, CDATA sections and PIs
+    // are stepped over. The element gets no EndTag token; the next nextToken() returns
+    // whatever follows it.
+    // checkNames: also require every end tag inside to match its start tag (and
+    // apply limits.maxOpenDepth); otherwise only the nesting depth is counted.
+    // Returns false if no element is open or the tokenizer has ended. On EOF or a
+    // failed check it also returns false and the next nextToken() returns the Error,
+    // which ends the stream even with RecoverErrors. Also false while resyncing
+    // after a recovered error.
+    bool skipCurrentElement(bool checkNames = false);
+
+    // Checkpoint/resume. checkpoint() captures the state between tokens in content
+    // (after Text, EndTag or EmptyTag); false inside a start tag (after StartTag or
+    // an attribute token), after a Continued Text piece, with an Error pending, or
+    // once ended. resume() resets the tokenizer and continues a document from 'cp'.
+    // The input's cursor must be at cp.where.byteOffset (see
+    // BufferedInputStream::setPosition); no DocumentStart is returned, and the open
+    // elements close with end tags as usual.
+    bool checkpoint(TokenizerCheckpoint& out) const;
+    bool resume(const TokenizerCheckpoint& cp);
+
+    // Add a checkpoint to 'index' at the first token boundary in content after
+    // every index->everyBytes() of input (nullptr stops). 'index' must outlive
+    // the tokenizer or the next call.
+    void recordCheckpoints(CheckpointIndex* index) noexcept { index_ = index; }
 
     // Reset tokenizer to initial state (keeps same stream, options, and limits).
+    // Interned names survive, so their ids stay the same for the next document.
+    // Buffers keep their capacity for the next document.
     void reset() noexcept;
 
-    // Error helper
+    // Memory resource hooks. releaseMemory() is reset() plus handing every buffer
+    // back, so the resource holds nothing of the tokenizer's afterwards (memoryInUse()
+    // is 0) and a per-document arena can be released or rewound. setMemoryResource()
+    // does that, then allocates from 'memory' (nullptr = the default resource).
+    void releaseMemory() noexcept;
+    void setMemoryResource(std::pmr::memory_resource* memory) noexcept;
+    std::pmr::memory_resource* memoryResource() const noexcept { return memory_.target(); }
+    std::size_t memoryInUse() const noexcept { return memory_.inUse(); }
+
+    // Name interning (TokenizerOptions::InternNames). Interning names up front gives
+    // known ids to switch on; they are never reassigned for this tokenizer.
+    const NameTable& names() const noexcept { return names_; }
+    NameId internName(const char* s, U32 len) noexcept { return names_.intern(s, len); }
+    // Forgets the interned names (reset() keeps them); ids restart at 1. With
+    // 'freeMemory' the table's heap memory goes too.
+    void clearNames(bool freeMemory = false) noexcept {
+        if (freeMemory) {
+            names_.release();
+        } else {
+            names_.clear();
+        }
+    }
+
+    // Error helper. With RecoverErrors a Fatal error is recorded as Recoverable
+    // and the tokenizer resyncs instead of ending. Past limits.maxErrors the token
+    // points at 'msg' itself, which must then outlive it (a literal).
     bool emitError(XMLToken& out,
                    TokenizerErrorCode code,
                    ErrorSeverity sev,
@@ -56,93 +165,168 @@ private:
     BufferedInputStream& in_;
     TokenizerOptions     opts_;
     TokenizerLimits      lims_;
-    TokenizerStats       stats_;    // disabled unless LXML_ENABLE_STATS
+    TokenizerStats       stats_;    // hot-path counters; only updated with LXML_ENABLE_STATS
+    U32                  timingEvery_ = 0;
+    U32                  timingCountdown_ = 0;
+    bool                 timeThisCall_ = false; // sample the states of the current nextToken()
+    CheckpointIndex*     index_ = nullptr;      // recordCheckpoints()
     TokenizerFlags       flags_;
     State                state_ = State::Content;
 
-    // --- TagFrame: One stable buffer per open element ---
+    // --- TagFrame: one TagArena region per open element ---
     struct TagFrame {
-        TagBuffer buf;                    // Stable storage for this element's data
-        TagContext ctx;                   // Name offsets, attr count, position info
+        TagBuffer buf;                    // This element's region of tagArena_
+        TagContext ctx;                   // Name slice, attr count, position info
         SourcePosition startPos;          // Where this element started (for errors)
-        
-        TagFrame() {
-            buf.mem = nullptr;
-            buf.cap = 0;
-            buf.used = 0;
-#if defined(LXML_DEBUG_SLICES)
-            buf.generation = 1;
-#endif
-        }
     };
 
+    // Allocation target of every container below (not names_).
+    ResourceSlot memory_;
+
     // LIFO stack: tagStack_.back() = currently parsing element
-    std::vector<TagFrame> tagStack_;
+    std::pmr::vector<TagFrame> tagStack_;
+
+    // Stack-shaped storage for all open elements' names and attributes
+    TagArena tagArena_;
+
+    // Interned element/attribute names (bounded by lims_.maxInternedNames)
+    NameTable names_;
+
+    // Inside nextTokens(), closed elements keep their arena bytes until the batch is
+    // handed back; deferredMark_ is the lowest base left unreleased.
+    bool           deferTagRelease_ = false;
+    bool           hasDeferredTags_ = false;
+    TagArena::Mark deferredMark_{};
     
     // Separate arena for text content (ephemeral between tokens)
     TextArena textArena_;
     
-    // Single-slot lookahead buffer (future feature)
+    // Single-slot lookahead: an Error queued by skipCurrentElement()
     LookaheadSlot la_;
 
+    // skipCurrentElement(checkNames) scratch: names of the elements open in the
+    // skipped subtree, back to back; skipNameEnds_[i] is the end of name i.
+    std::pmr::vector<char> skipNames_;
+    std::pmr::vector<U32>  skipNameEnds_;
+
     // Errors accumulated during parsing
-    std::vector<TokenizerError> errors_;
+    std::pmr::vector<TokenizerError> errors_;
     
     // Error message arena (stable storage for TokenizerError.msg)
-    std::vector<char> errorArena_;
+    std::pmr::vector<char> errorArena_;
+    U64                    errorCount_ = 0;
+    TokenizerError         lastError_{};
+
+    // RecoverErrors: the state the last error was raised in (what to skip; Resyncing
+    // once skipped) and how many open elements resync() still closes.
+    State       resyncFrom_  = State::Content;
+    std::size_t resyncClose_ = 0;
+
+    // needMoreInput(): the last call ran out of pushed input
+    bool needInput_ = false;
 
-    // freelist for TagBuffer reuse (minimize allocations)
-    // Invariant: all entries are exactly freelistBlockSize_ bytes
-    std::vector<std::unique_ptr<char[]>> tagBufFreelist_;
-    ByteLen freelistBlockSize_ = 0;  // Track freelist buffer size for invalidation
-    
     // Token start position tracking
     SourcePosition pendingStart_{};  // Captured at start of each token
     bool pendingStartValid_ = false; // true iff markTokenStart() captured a start
     
     // Constants
-    static constexpr U32 kBadOff = 0xFFFFFFFFu;  // Sentinel for failed append operations
+    static constexpr U32 kBadOff = 0xFFFFFFFFu;  // Sentinel length for failed name reads
+
+    // The DFA behind nextToken(), which adds the per-call stats around it.
+    // produceToken() settles the previous token (deferred pop, queued Error) and
+    // runs scanToken(), the state machine proper; push input goes through
+    // scanPushToken(), which undoes a token the fed bytes end inside.
+    bool produceToken(XMLToken& out);
+    bool scanToken(XMLToken& out);
+    bool scanPushToken(XMLToken& out);
 
     // --- Phase-1 helpers (happy-path minimal XML) ---
     bool emitDocumentStart(XMLToken& out) noexcept;
     bool emitDocumentEnd(XMLToken& out) noexcept;
 
     // Content: gather text until '<' or EOF; coalesce based on options.
+    // Dispatches once per token to the scanTextAs<> built for the options.
     bool scanText(XMLToken& out);
+    template<bool Expand> bool scanTextWith(XMLToken& out);
+    template<bool Normalize, bool ZeroCopy, bool Chunked, bool Expand> bool scanTextAs(XMLToken& out);
+
+    // ExpandInternalEntities: decodes the reference at the cursor ('&') and passes
+    // its UTF-8 to append(const char*, U32), which returns false at a limit.
+    enum class RefResult : U8 { Ok, Malformed, Undeclared, Limit };
+    template<class Append> RefResult expandReference(Append&& append);
+    // Error token for Malformed / Undeclared, reported at the '&'.
+    bool emitReferenceError(XMLToken& out, RefResult r) noexcept;
 
     // Decide start vs end tag after '<' (no comments/PI/doctype in Phase 1).
     bool scanTagOrError(XMLToken& out);
 
+    // Comment, CDATA section or PI (InComment / InCData / PIContent), the opener
+    // consumed: one token through the terminator, or the next piece of a chunked
+    // CDATA section. False (no token) only for an XML declaration dropped because
+    // ReportXmlDecl is off.
+    bool scanMarkup(XMLToken& out);
+    template<bool Normalize> bool scanMarkupAs(XMLToken& out);
+    // Emits the body (PI target checked; XML declaration dropped as above).
+    bool finishMarkup(XMLToken& out, XMLTokenType type, const char* data, std::size_t len,
+                      bool slice, U8 flags);
+
+    // DOCTYPE after "<!DOCTYPE": its whitespace, then the rest through the closing '>'.
+    bool scanDoctype(XMLToken& out);
+
     // Parse a start tag: <Name (Attr="Value")* [/]?>
     bool parseStartTag(XMLToken& out);
 
     // Parse an end tag: </n>
     bool parseEndTag(XMLToken& out);
 
-    // Basic attributes: name="value" (double-quoted only in Phase 1).
-    // Stateful: each call emits one AttributeName or AttributeValue token.
+    // Fragment mode: end tag of an element opened before the input slice.
+    bool parseOuterEndTag(XMLToken& out);
+
+    // RecoverErrors: State::Resyncing, entered by emitError(). Skips what is left
+    // of the broken construct (see the definition), then emits the repair tokens
+    // (an empty AttributeValue, an EmptyTag, EndTags of elements closed by a
+    // mismatched end tag or the end of input) one per call, then returns to
+    // Content. False when back in Content with no token.
+    bool resync(XMLToken& out);
+    // Inside a tag: up to a '<' (kept) or through a '>'; true if it was "/>".
+    bool skipToTagEnd();
+    // Content: up to the next '<'.
+    void skipToLt();
+    // Through the next 'term' of 'n' bytes, or to EOF.
+    void skipPast(const char* term, std::size_t n);
+    // Open elements a mismatched end tag closes: down to the nearest one of that
+    // name (0 if none is open).
+    std::size_t closedByEndTag(const char* name, U32 len) const noexcept;
+
+    // Basic attributes: name="value" or name='value'.
+    // Stateful: each call emits one AttributeName, AttributeValue or EmptyTag token;
+    // returns false (no token) after consuming the closing '>' of a start tag.
     bool parseAttributesBasic(XMLToken& out);
 
+    // AttrValueQuoted: copy the value up to the closing quote into the TagBuffer.
+    bool readAttrValue(XMLToken& out);
+    template<bool Normalize, bool Expand> bool readAttrValueAs(XMLToken& out);
+
     // --- TagFrame stack management ---
-    // Push new frame when starting an element; allocates TagBuffer if needed.
-    // Returns false if tagStack_.size() >= lims_.maxOpenDepth (DoS protection).
+    // Push new frame when starting an element; its data starts at the arena top.
+    // Returns false if tagStack_.size() >= lims_.maxOpenDepth (DoS protection);
+    // the caller reports the error.
     bool pushTagFrame();
     
-    // Pop frame when element closes; may add buffer to freelist.
+    // Pop frame when element closes; releases its arena region (LIFO), or defers
+    // the release while a batch is being filled.
     void popTagFrame() noexcept;
+
+    // Release arena bytes of elements closed during an earlier batch once no
+    // open element sits above them.
+    void reclaimDeferredTags() noexcept;
     
     // Get current (top) tag frame; nullptr if stack empty.
     TagFrame* currentTagFrame() noexcept {
         return tagStack_.empty() ? nullptr : &tagStack_.back();
     }
     
-    // Allocate or reuse a TagBuffer for the current frame.
-    // Always allocate full-size per-tag buffer, no growth is happening here.
-    inline void noteTagArena(ByteLen cap) {
-        #if defined(LXML_ENABLE_STATS)
-            stats_.maxTagArena = std::max(stats_.maxTagArena, cap);
-        #endif
-    }
+    // Check the current frame can take tag data (chunks are allocated on first append).
     bool ensureCurrentTagBuffer() noexcept;
 
     // --- Low-level building blocks ---
@@ -152,25 +336,46 @@ private:
         pendingStartValid_ = true;
     }
 
-    // Read XML Name into current TagBuffer; returns (off,len) or 0-len on failure.
-    std::pair<U32,U32> readNameToCurrentTagBuffer();
+    // Read XML Name into a new slice of the current TagBuffer; returns (data,len).
+    // len == 0: no name at the cursor; len == kBadOff: a limit was hit.
+    std::pair<const char*,U32> readNameToCurrentTagBuffer();
 
-    // Append raw bytes to current TagBuffer; returns starting offset or kBadOff on failure.
-    U32 appendToCurrentTagBuf(const char* data, U32 len);
+    // Append raw bytes to the open slice of the current TagBuffer; false on failure.
+    bool appendToCurrentTagBuf(const char* data, U32 len);
 
     // Append single byte to current TagBuffer.
-    U32 appendToCurrentTagBuf(char ch) { return appendToCurrentTagBuf(&ch, 1); }
+    bool appendToCurrentTagBuf(char ch) { return appendToCurrentTagBuf(&ch, 1); }
 
-    // Ensure current TagBuffer has at least 'need' free bytes.
+    // Check the current element may append 'need' more bytes (maxPerTagBytes).
     bool ensureCurrentTagCapacity(ByteLen need);
 
     // Emit token pointing into TextArena (valid until next nextToken()).
-    // Uses pendingStart_ for position info.
-    bool makeTextToken(XMLToken& out, U32 off, U32 len) noexcept;
+    // Uses pendingStart_ for position info. Comments, CDATA and PIs use it too.
+    bool makeTextToken(XMLToken& out, U32 off, U32 len, U8 flags = 0,
+                       XMLTokenType type = XMLTokenType::Text) noexcept;
+
+    // Emit token pointing into the input window (ZeroCopyText text; markup bodies).
+    bool makeInputSliceToken(XMLToken& out, const uint8_t* p, U32 len, U8 flags = 0,
+                             XMLTokenType type = XMLTokenType::Text) noexcept;
+
+    // ZeroCopyText fast path for scanText(); consumes nothing when it declines.
+    template<bool Normalize, bool Chunked, bool Expand> bool trySliceTextAs(XMLToken& out);
 
     // Emit token pointing into current TagBuffer (valid until element close).
     // Uses pendingStart_ for position info.
-    bool makeTagToken(XMLToken& out, XMLTokenType t, U32 off, U32 len) noexcept;
+    bool makeTagToken(XMLToken& out, XMLTokenType t, const char* data, U32 len, NameId id = 0) noexcept;
+
+    // Interned id for a tag/attribute name; 0 when InternNames is off or the table is full.
+    // A name cut short by the end of pushed input is not interned (the token is retried).
+    NameId internIfEnabled(const char* data, U32 len) noexcept {
+        return opts_.internNames() && !in_.starved() ? names_.intern(data, len) : NameId{0};
+    }
+
+    // recordCheckpoints(): add a checkpoint to index_ if one can be taken here.
+    void noteCheckpoint() noexcept;
+
+    // skipCurrentElement(): queue a fatal Error for the next nextToken(); returns false.
+    bool failSkip(TokenizerErrorCode code, const char* msg) noexcept;
 
     // Validate end tag name matches current open element.
     bool validateEndTagMatch(const char* namePtr, U32 nameLen) noexcept;
@@ -196,21 +401,15 @@ inline void XMLTokenizer::reset() noexcept {
     flags_.bits = 0;
     errors_.clear();
     errorArena_.clear();
+    errorCount_ = 0;
+    lastError_ = TokenizerError{};
+    resyncFrom_ = State::Content;
+    resyncClose_ = 0;
     
-    // Clear tag stack and move buffers to freelist for reuse
-    for (auto& frame : tagStack_) {
-        if (frame.buf.mem && frame.buf.cap == lims_.maxPerTagBytes) {
-            tagBufFreelist_.push_back(std::move(frame.buf.mem));
-        }
-        // Otherwise buffer is discarded (size mismatch with current limits)
-    }
+    // Clear tag stack; the arena keeps its first chunk for reuse
     tagStack_.clear();
-    
-    // Only purge freelist if block size changed (performance optimization)
-    if (freelistBlockSize_ != lims_.maxPerTagBytes) {
-        tagBufFreelist_.clear();
-        freelistBlockSize_ = lims_.maxPerTagBytes;
-    }
+    tagArena_.clear();
+    hasDeferredTags_ = false;
     
     // Clear text arena
     textArena_.buf.clear();
@@ -220,6 +419,11 @@ inline void XMLTokenizer::reset() noexcept {
     
     // Clear lookahead
     la_.has = false;
+    needInput_ = false;
+
+    // Hot-path counters restart; the input/arena ones are cumulative.
+    stats_ = TokenizerStats{};
+    timingCountdown_ = timingEvery_;
     
     // Reset pending position
     pendingStart_ = SourcePosition{};
@@ -21,10 +21,12 @@
     * - TokenizerError: Stores error details with stable message storage.
     * - TokenizerOptions & TokenizerLimits: Configurable parsing options and resource limits.
     * - DFA State enum: Lexical states for the tokenizer's finite automaton.
-    * - Arena helpers: Structures for managing buffer segments and tag context.
+    * - Arena helpers: Structures for managing buffer segments and tag context; ResourceSlot
+    *   routes their allocations to a caller-chosen std::pmr::memory_resource.
     * - EntityScan: Describes the result of scanning an XML entity.
     * - TokenizerFlags: Bitmask flags for internal tokenizer state.
     * - TokenizerStats: Optional statistics collection (compile-time enabled).
+    * - TokenizerCheckpoint: Serializable tokenizer state for resuming mid-document.
     * - CharClass: Static helpers for XML character classification.
     *
     * All types and definitions are encapsulated within the LXMLFormatter namespace.
@@ -36,8 +38,13 @@
 #include <type_traits>
 #include <vector>
 #include <memory>
+#include <memory_resource>
 #include <array>
+#include <string>
 #include <string_view>
+#include <iosfwd>
+#include <cstring>
+#include <new>
 
 namespace LXMLFormatter {
 
@@ -52,6 +59,7 @@ using U64 = std::uint64_t;
 using ByteLen   = U32;   // lengths/counters bounded by caps (< 4 GiB)
 using ByteOff   = U64;   // absolute byte offset in stream (can be > 4 GiB)
 using CharCount = U64;   // optional (guarded by LXML_TRACK_CHAROFFSET)
+using NameId    = U16;   // interned name id (NameTable); 0 = not interned
 
 static_assert(sizeof(void*) == 8, "64-bit build required for tokenizer");
 
@@ -100,6 +108,8 @@ enum class TokenizerErrorCode : U16 {
     ExpectedEqualsAfterAttrName,
     ExpectedQuoteForAttrValue,
     DuplicateDocumentBoundary,
+    MismatchedEndTag,
+    InvalidCharInAttrValue,
 
     // Entities / encoding (0x40–0x4F)
     InvalidUTF8     = 0x40,
@@ -116,7 +126,7 @@ enum class TokenizerErrorCode : U16 {
 };
 enum class ErrorSeverity : U8 { Warning, Recoverable, Fatal };
 
-enum class ArenaId : U8 { None=0, Text=1, Tag=2, Error=3 };
+enum class ArenaId : U8 { None=0, Text=1, Tag=2, Error=3, Input=4 };
 
 // -------------------------------
 // Token (hot path, 32 bytes, 32B aligned)
@@ -125,6 +135,15 @@ enum class ArenaId : U8 { None=0, Text=1, Tag=2, Error=3 };
 // Lifetime: data points into tokenizer-owned storage.
 //  - Text/Comment/CDATA/PI/DOCTYPE/Error: valid until the next nextToken() call.
 //  - StartTag/AttributeName/AttributeValue/EmptyTag: valid until the current tag closes.
+// With TokenizerOptions::ZeroCopyText a Text token may instead point straight into
+// the BufferedInputStream window (flags & InputSlice); the lifetime is the same.
+// Comment/CDATA/PI/DOCTYPE hold the body only (no delimiters); they are input
+// slices whenever the body lies in one window, whatever ZeroCopyText says.
+// With TokenizerOptions::ChunkedText a long text run arrives as several Text tokens
+// (a CDATA section as several CDATA tokens); a piece with flags & Continued may be
+// followed by more of the same run.
+// With TokenizerOptions::InternNames, StartTag/EndTag/EmptyTag/AttributeName carry the
+// name's NameTable id in nameId (stable until the table is cleared); 0 otherwise.
 struct alignas(32) XMLToken {
     const char*   data = nullptr;           // slice start
     ByteOff       byteOffset = 0;           // token absolute start
@@ -132,16 +151,30 @@ struct alignas(32) XMLToken {
     U32           line = 1;                 // start line
     U32           column = 1;               // start column (characters)
     XMLTokenType  type = XMLTokenType::Text;// kind
+    U8            flags = 0;                // slice properties (bits below)
+    NameId        nameId = 0;               // interned name id; 0 = none
 
 #if defined(LXML_DEBUG_SLICES)
     ArenaId       arena = ArenaId::None;    // owning arena for debug
     U16           generation = 0;           // arena generation for UAF checks
-#else
-    U8            _pad[3] = {0,0,0};        // pad to 32 bytes in release
 #endif
+
+    // Flag bits
+    static constexpr U8 InputSlice = 1u << 0; // data aliases the input window (not a tokenizer arena)
+    static constexpr U8 Continued  = 1u << 1; // Text/CDATA: the run may go on in the next token
+    static constexpr U8 Recovered  = 1u << 2; // Error: the tokenizer resyncs and goes on (RecoverErrors)
+
+    inline bool isInputSlice() const noexcept { return (flags & InputSlice) != 0; }
+    inline bool isContinued() const noexcept  { return (flags & Continued) != 0; }
+    inline bool isRecovered() const noexcept  { return (flags & Recovered) != 0; }
 };
 static_assert(alignof(XMLToken) == 32, "XMLToken must be 32B aligned");
+#if defined(LXML_DEBUG_SLICES)
+// Debug slice tracking does not fit the 32-byte tail; accept a full cache line there.
+static_assert(sizeof(XMLToken)  == 64, "Debug XMLToken must be one cache line");
+#else
 static_assert(sizeof(XMLToken)  == 32, "XMLToken must remain 32 bytes");
+#endif
 static_assert(std::is_trivially_copyable<XMLToken>::value, "XMLToken must be trivially copyable");
 static_assert(std::is_trivially_copyable<TokenizerErrorCode>::value, "TokenizerError must be trivially copyable");
 static_assert(sizeof(XMLTokenType) == 1, "XMLTokenType must be uint8_t-sized");
@@ -172,8 +205,35 @@ struct TokenizerOptions {
     static constexpr U32 ExpandInternalEntities   = 1u << 3;
     static constexpr U32 ReportXmlDecl            = 1u << 4;
     static constexpr U32 ReportIntertagWhitespace = 1u << 5;
-
-    // Defaults: everything on
+    static constexpr U32 ZeroCopyText             = 1u << 6; // opt-in: Text may alias the input window
+    static constexpr U32 InternNames              = 1u << 7; // opt-in: tag/attribute names get NameTable ids
+    static constexpr U32 Fragment                 = 1u << 8; // input is a slice of a document (see below)
+    static constexpr U32 QuietErrors              = 1u << 9; // errors are queued but not logged to stderr
+    static constexpr U32 ChunkedText              = 1u << 10; // opt-in: long text runs split into Continued pieces
+    static constexpr U32 RecoverErrors            = 1u << 11; // opt-in: resync after an error instead of ending
+
+    // Fragment: the input starts at an element boundary somewhere inside a document.
+    // An end tag with no open element closes an element opened before the slice
+    // (its name is not checked; that is the caller's job), and EOF with elements
+    // still open is a normal DocumentEnd.
+
+    // ChunkedText: a text run is emitted in pieces instead of as one token, so no run
+    // is ever held whole. Copied pieces end after TokenizerLimits::textChunkBytes;
+    // ZeroCopyText pieces end at the input window's end (or maxTextRunBytes). A piece
+    // with XMLToken::Continued may be followed by more Text of the same run; a piece
+    // without it, or any other token, ends the run. maxTextRunBytes then bounds a
+    // piece rather than the run, so long runs are no longer an error. CDATA sections
+    // are split the same way (CDATA pieces, maxCdataBytes bounding each).
+
+    // RecoverErrors: an error is still reported (Error token, errors()), but the
+    // stream goes on. The Error token carries XMLToken::Recovered and the record
+    // ErrorSeverity::Recoverable; the tokenizer then skips to the next plausible
+    // boundary and repairs the element stack, so the tokens that follow stay
+    // balanced (every StartTag gets its EmptyTag or EndTag). Internal errors and
+    // allocation failures still end the stream.
+
+    // Defaults: everything on (except the opt-in ZeroCopyText, InternNames, ChunkedText
+    // and RecoverErrors modes)
     TokenizerOptions() noexcept
         : flags(CoalesceText | Strict | NormalizeLineEndings |
                 ExpandInternalEntities | ReportXmlDecl | ReportIntertagWhitespace) {}
@@ -185,6 +245,12 @@ struct TokenizerOptions {
     inline bool expandInternalEntities() const noexcept   { return (flags & ExpandInternalEntities) != 0; }
     inline bool reportXmlDecl() const noexcept            { return (flags & ReportXmlDecl) != 0; }
     inline bool reportIntertagWhitespace() const noexcept { return (flags & ReportIntertagWhitespace) != 0; }
+    inline bool zeroCopyText() const noexcept             { return (flags & ZeroCopyText) != 0; }
+    inline bool internNames() const noexcept              { return (flags & InternNames) != 0; }
+    inline bool fragment() const noexcept                 { return (flags & Fragment) != 0; }
+    inline bool quietErrors() const noexcept              { return (flags & QuietErrors) != 0; }
+    inline bool chunkedText() const noexcept              { return (flags & ChunkedText) != 0; }
+    inline bool recoverErrors() const noexcept            { return (flags & RecoverErrors) != 0; }
 };
 
 //-------------------------------
@@ -194,13 +260,16 @@ struct TokenizerLimits {
     ByteLen maxNameBytes        = 4u * 1024u;
     ByteLen maxAttrValueBytes   = 1u * 1024u * 1024u;
     ByteLen maxTextRunBytes     = 8u * 1024u * 1024u;
+    ByteLen textChunkBytes      = 64u * 1024u;        // ChunkedText: copied piece size (4..maxTextRunBytes)
     ByteLen maxCommentBytes     = 1u * 1024u * 1024u;
     ByteLen maxCdataBytes       = 8u * 1024u * 1024u;
     ByteLen maxDoctypeBytes     = 128u * 1024u;
     // DoS guards tied to tag arena
     U16     maxAttrsPerElement  = 1024;
-    ByteLen maxPerTagBytes      = 8u * 1024u * 1024u; // pre-reserved/fixed tag buffer
+    ByteLen maxPerTagBytes      = 8u * 1024u * 1024u; // cap on one element's name + attribute bytes
     U16     maxOpenDepth        = 1024;               // maximum nesting depth
+    U16     maxInternedNames    = 4096;               // NameTable size; later names get id 0
+    U32     maxErrors           = 1000;               // errors() entries kept; later ones are only counted
 };
 
 //-------------------------------
@@ -232,7 +301,7 @@ enum class State : U8 {
     AfterBang, CommentStart1, CommentStart2, InComment, CommentEnd1, CommentEnd2,  // Inside a comment
     CDataStart, InCData, CDataEnd1, CDataEnd2,                              // Inside a CDATA section
     PITarget, PIContent,                                                    // Inside a processing instruction
-    Resyncing                                                               // Inside a resyncing state
+    Resyncing                                                               // RecoverErrors: after an Error, skipping ahead
 };
 static_assert(sizeof(State) == 1, "State must be uint8_t-sized");
 
@@ -240,38 +309,197 @@ static_assert(sizeof(State) == 1, "State must be uint8_t-sized");
 // Arena-related helpers
 // Semantics tracker, separated from DFA
 // -------------------------------
+// Allocation hook. Every tokenizer-owned buffer allocates through one ResourceSlot,
+// which forwards to a replaceable std::pmr::memory_resource and counts the bytes
+// outstanding. The containers stay bound to the slot for life, so the target may
+// change once they hold nothing (XMLTokenizer::setMemoryResource()).
+class ResourceSlot final : public std::pmr::memory_resource {
+public:
+    explicit ResourceSlot(std::pmr::memory_resource* target = nullptr) noexcept { retarget(target); }
+
+    std::pmr::memory_resource* target() const noexcept { return target_; }
+    void retarget(std::pmr::memory_resource* target) noexcept {
+        target_ = target ? target : std::pmr::get_default_resource();
+    }
+    std::size_t inUse() const noexcept { return inUse_; }
+
+private:
+    std::pmr::memory_resource* target_ = nullptr;
+    std::size_t inUse_ = 0;
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        void* p = target_->allocate(bytes, align);
+        inUse_ += bytes;
+        return p;
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+        target_->deallocate(p, bytes, align);
+        inUse_ -= bytes;
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+};
+
 /* memory layout:
 Document parsing:
-├── TagBuffer (fixed, pointer-stable)
-│   ├── Tag: "element" [0..7]
-│   ├── Attr: "id" [8..10]  
-│   ├── Value: "123" [11..14]
-│   └── [All pointers remain valid until tag closes]
+├── TagArena (stack of chunks, LIFO)
+│   ├── <root>:  "root" "xmlns" "urn:x"       [frame 0: from base0]
+│   ├── <child>: "child" "id" "123"           [frame 1: from base1 = frame 0's high-water mark]
+│   └── [popTagFrame() releases back to the frame's base]
 │
 └── TextArena (growable)
     ├── "Some text" [emitted immediately]
     └── [Can clear/reuse after emission]
 
-    * Holds all data for a single tag (name + all attributes).
-    * Once allocated, the buffer address NEVER changes.
-    * It matters because multiple tokens will point into this buffer
-    * Note: All these tokens may be alive simultaneously in the parser, so the memory must remain stable
+    * Each open element appends its name and attributes at the arena top.
+    * Chunks never move or reallocate, so every finished slice keeps its address
+    * until its element closes; only the slice being built may be moved (no token points to it yet).
+    * Memory follows the bytes actually used by open elements, not depth * maxPerTagBytes.
 */
+class TagArena {
+public:
+    static constexpr ByteLen kFirstChunkBytes = 4u * 1024u;
+    static constexpr ByteLen kMaxChunkBytes   = 1u * 1024u * 1024u; // growth stops here (larger slices get an exact chunk)
+
+    explicit TagArena(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) noexcept
+        : chunks_(memory) {}
+
+    // Arena top: chunk index + bytes used in it.
+    struct Mark {
+        U32 chunk = 0;
+        ByteLen used = 0;
+        bool operator<(Mark o) const noexcept { return chunk < o.chunk || (chunk == o.chunk && used < o.used); }
+    };
+
+    Mark mark() const noexcept { return Mark{cur_, used_}; }
+
+    // Drop everything allocated after 'm' (LIFO). Keeps one spare chunk above the
+    // mark so a frame that straddles a chunk boundary does not reallocate per element.
+    void release(Mark m) noexcept {
+        cur_ = m.chunk;
+        used_ = m.used;
+        sliceStart_ = used_;
+        if (chunks_.size() > static_cast<size_t>(cur_) + 2) chunks_.resize(cur_ + 2);
+    }
+
+    // Start a new slice at the arena top.
+    void beginSlice() noexcept { sliceStart_ = used_; }
+
+    // Append to the open slice. If the chunk is full, the open slice moves to the
+    // next chunk so it stays contiguous. Returns false on allocation failure.
+    bool append(const char* data, ByteLen len) noexcept {
+        if (len > room() && !nextChunk(len)) return false;
+        std::memcpy(chunks_[cur_].mem.get() + used_, data, len);
+        used_ += len;
+        return true;
+    }
+
+    const char* sliceData() const noexcept {
+        return chunks_.empty() ? nullptr : chunks_[cur_].mem.get() + sliceStart_;
+    }
+    ByteLen sliceLen() const noexcept { return used_ - sliceStart_; }
+
+    // Total bytes held in chunks (for stats).
+    ByteLen reserved() const noexcept {
+        ByteLen n = 0;
+        for (const auto& c : chunks_) n += c.cap;
+        return n;
+    }
+
+    // Release everything and return to the first chunk (keeps it for reuse).
+    void clear() noexcept {
+        release(Mark{});
+        if (chunks_.size() > 1) chunks_.resize(1);
+    }
+
+    // clear(), and hand every chunk back to the memory resource.
+    void releaseMemory() noexcept {
+        release(Mark{});
+        decltype(chunks_)(chunks_.get_allocator()).swap(chunks_);
+    }
+
+    // Chunk freelist counters (for stats): nextChunk() calls served by a retained
+    // chunk vs. a fresh allocation, and the most bytes ever held in chunks.
+    U64     chunkReuses()   const noexcept { return chunkReuses_; }
+    U64     chunkAllocs()   const noexcept { return chunkAllocs_; }
+    ByteLen peakReserved()  const noexcept { return peakReserved_; }
+
+private:
+    struct ChunkFree {
+        std::pmr::memory_resource* memory; // value-initialized by unique_ptr
+        ByteLen cap;
+        void operator()(char* p) const noexcept { memory->deallocate(p, cap, 1); }
+    };
+    struct Chunk {
+        std::unique_ptr<char[], ChunkFree> mem;
+        ByteLen cap = 0;
+    };
+
+    std::pmr::vector<Chunk> chunks_;
+    U32     cur_ = 0;        // chunk holding the arena top
+    ByteLen used_ = 0;       // bytes used in chunks_[cur_]
+    ByteLen sliceStart_ = 0; // open slice start within chunks_[cur_]
+    U64     chunkReuses_ = 0;
+    U64     chunkAllocs_ = 0;
+    ByteLen peakReserved_ = 0;
+
+    ByteLen room() const noexcept { return chunks_.empty() ? 0 : chunks_[cur_].cap - used_; }
+
+    // Move the open slice to the next chunk with room for it plus 'more' bytes,
+    // reusing a retained chunk when it is big enough.
+    bool nextChunk(ByteLen more) noexcept {
+        const ByteLen keep = sliceLen();
+        const ByteLen need = keep + more;
+        const U32 next = chunks_.empty() ? 0 : cur_ + 1;
+
+        if (next >= chunks_.size() || chunks_[next].cap < need) {
+            ByteLen cap = chunks_.empty() ? kFirstChunkBytes
+                        : (chunks_[cur_].cap >= kMaxChunkBytes / 2 ? kMaxChunkBytes : chunks_[cur_].cap * 2);
+            if (cap < need) cap = need;
+            std::pmr::memory_resource* memory = chunks_.get_allocator().resource();
+            Chunk c;
+            try {
+                c.mem = std::unique_ptr<char[], ChunkFree>(static_cast<char*>(memory->allocate(cap, 1)),
+                                                           ChunkFree{memory, cap});
+            } catch (...) { return false; }
+            c.cap = cap;
+            if (next < chunks_.size()) {
+                chunks_[next] = std::move(c);
+            } else {
+                try { chunks_.push_back(std::move(c)); } catch (...) { return false; }
+            }
+            ++chunkAllocs_;
+            const ByteLen r = reserved();
+            if (r > peakReserved_) peakReserved_ = r;
+        } else {
+            ++chunkReuses_;
+        }
+
+        if (keep) std::memcpy(chunks_[next].mem.get(), chunks_[cur_].mem.get() + sliceStart_, keep);
+        cur_ = next;
+        sliceStart_ = 0;
+        used_ = keep;
+        return true;
+    }
+};
+
+// Per-element view of the TagArena.
 struct TagBuffer {
-    std::unique_ptr<char[]> mem{};   // capacity = limits.maxPerTagBytes
-    ByteLen cap = 0;                 // bytes
-    ByteLen used = 0;                // bytes used in current tag
+    TagArena::Mark base{};           // arena top when the element opened; restored on close
+    ByteLen used = 0;                // bytes appended by this element (<= limits.maxPerTagBytes)
 #if defined(LXML_DEBUG_SLICES)
     U16 generation = 1;
 #endif
 };
 
-// Text arena (ephemeral slices via std::vector<char>)
+// Text arena (ephemeral slices via std::pmr::vector<char>)
 // Accumulates text content between tags.
 // Can grow/reallocate because text is emitted immediately.
 // Once a Text token is returned, the tokenizer won't modify buf until the caller calls nextToken() again
 struct TextArena {
-    std::vector<char> buf;
+    explicit TextArena(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) noexcept
+        : buf(memory) {}
+
+    std::pmr::vector<char> buf;
 #if defined(LXML_DEBUG_SLICES)
     U16 generation = 1;
 #endif
@@ -280,12 +508,13 @@ struct TextArena {
 };
 
 // Slice helpers
-struct SegmentMark { U32 offset = 0; }; // offset within owning contiguous buffer
 struct TagContext {
-    SegmentMark nameMark{};            // start offset of tag name in tag buffer
+    const char* name = nullptr;        // tag name slice in the TagArena
     U32         nameLen = 0;           // bytes
+    NameId      nameId = 0;            // interned id of the tag name (InternNames)
     U16         attrCount = 0;         // number of attributes seen
     bool        sawSlashBeforeGT = false; // for EmptyTag detection
+    U8          quote = 0;             // delimiter of the attribute value being read (' or ")
     // token start pos (for precise errors)
     U32         startLine = 1;
     U32         startColumn = 1;
@@ -324,6 +553,8 @@ struct TokenizerFlags {
     static constexpr U32 Ended    = 1u << 1;
     static constexpr U32 InAttr   = 1u << 2;
     static constexpr U32 SawCR    = 1u << 3; // for CRLF normalization helpers
+    static constexpr U32 PendingPop = 1u << 4; // EndTag/EmptyTag emitted; pop its frame on next nextToken()
+    static constexpr U32 InTextRun  = 1u << 5; // a Continued Text/CDATA piece was emitted; the run is still open
     // helpers
     inline bool test(U32 m) const noexcept { return (bits & m) != 0; }
     inline void set (U32 m)       noexcept { bits |=  m; }
@@ -331,23 +562,77 @@ struct TokenizerFlags {
 };
 
 // -------------------------------
-// Stats [place holder for future use]
+// Stats
+// A snapshot from XMLTokenizer::stats(). Input, arena and byte counters live on
+// cold paths and are always filled in. Token counts, nesting depth and per-state
+// timing sit on the hot path and stay zero unless built with LXML_ENABLE_STATS
+// (make STATS=1); 'enabled' tells a reader which case it is looking at.
 // -------------------------------
-#if defined(LXML_ENABLE_STATS)
 struct TokenizerStats {
-    U64     bytesConsumed = 0;
-    U64     tokensEmitted = 0;
-    U64     errorsEmitted = 0;
-    ByteLen maxTextArena  = 0;
-    ByteLen maxTagArena   = 0;
-    U32     maxOpenDepth  = 0;
+#if defined(LXML_ENABLE_STATS)
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+    static constexpr std::size_t kTokenTypes = static_cast<std::size_t>(XMLTokenType::Error) + 1;
+    static constexpr std::size_t kStates     = static_cast<std::size_t>(State::Resyncing) + 1;
+
+    // Always collected.
+    U64     bytesConsumed   = 0; // input bytes tokenized so far
+    U64     inputRefills    = 0; // BufferedInputStream::IOStats, see there
+    U64     inputBytesRead  = 0;
+    U64     inputBytesMoved = 0;
+    U64     tagChunkReuses  = 0; // TagArena freelist hits
+    U64     tagChunkAllocs  = 0; // TagArena freelist misses
+    ByteLen maxTextArena    = 0; // text arena high-water (capacity, bytes)
+    ByteLen maxTagArena     = 0; // tag arena high-water (chunk bytes)
+
+    // LXML_ENABLE_STATS only; restart at XMLTokenizer::reset().
+    U64     tokensEmitted   = 0;
+    U64     tokensByType[kTokenTypes] = {}; // indexed by XMLTokenType
+    U64     errorsEmitted   = 0;
+    U32     maxOpenDepth    = 0;
+
+    // Sampled DFA time (XMLTokenizer::setStateTiming): ticks spent in each State on
+    // every Nth nextToken() call; TSC cycles on x86-64, nanoseconds elsewhere.
+    U32     timingEvery     = 0; // 0 = off
+    U64     stateTicks[kStates]   = {};
+    U64     stateSamples[kStates] = {}; // timed visits per State
+
+    static const char* tokenTypeName(std::size_t i) noexcept;
+    static const char* stateName(std::size_t i) noexcept;
+    static const char* tickUnit() noexcept; // "tsc" or "ns"
+
+    // One JSON object (no trailing newline).
+    void writeJson(std::ostream& os) const;
+    // Prometheus text exposition format; counters are named <prefix>_<field>_total.
+    void writePrometheus(std::ostream& os, const char* prefix = "lxml_tokenizer") const;
 };
+#if defined(LXML_ENABLE_STATS)
 #  define LXML_STAT_INC(field, val) ((field) += (val))
 #else
-struct TokenizerStats { };
 #  define LXML_STAT_INC(field, val) ((void)0)
 #endif
 
+// -------------------------------
+// Checkpoint
+// Tokenizer state at a token boundary in content (XMLTokenizer::checkpoint()):
+// enough to go on from 'where' with XMLTokenizer::resume() on input positioned
+// there, without reading the bytes before it. The open elements keep only their
+// names (for end tag matching), not their attributes.
+// -------------------------------
+struct TokenizerCheckpoint {
+    SourcePosition           where;                  // next unread byte, its line and column
+    State                    state = State::Content;
+    U32                      flags = 0;              // TokenizerFlags bits
+    std::vector<std::string> open;                   // open element names, outermost first
+
+    // One text line, "<byte> <line> <column> <state> <flags> <depth> <name>...\n"
+    // (names hold no whitespace). read() returns false on a malformed line.
+    void write(std::ostream& os) const;
+    bool read(std::istream& is);
+};
+
 // -------------------------------
 // Character classes (fast ASCII, stubs for Unicode)
 // (We keep them inline here to avoid extra compilation units.)
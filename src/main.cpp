@@ -7,11 +7,172 @@
 */
 
 #include "BufferedInputStream.h"
+#include "BufferedOutputStream.h"
 #include "XMLTokenizerTypes.h"
 #include "XMLTokenizer.h"
+#include "XMLFormatter.h"
+#include "ParallelFormatter.h"
+#include "PipelinedFormatter.h"
+#include "CheckpointIndex.h"
+#include <fstream>
 #include <iostream>
+#include <cstdlib>
+#include <unistd.h>
 
-int main() {
-    std::cout << "Large XML Formatter (ver 0.0.1)" << std::endl;
-    return 0;
-}
\ No newline at end of file
+using namespace LXMLFormatter;
+
+namespace {
+    constexpr size_t kStdinBufferSize = 4u * 1024u * 1024u;
+    constexpr U32    kStatsTimingEvery = 64; // --stats: time the DFA on every 64th token
+
+    void usage(const char* argv0) {
+        std::cerr << "Large XML Formatter (ver 0.0.1)\n"
+                  << "usage: " << argv0 << " [--indent=N] [--tabs] [--minify] [--direct] [--jobs=N] [--pipeline] [--recover] [--stats=json|prom] [--index=FILE] [input.xml|-] [output.xml|-]\n"
+                  << "  --minify   drop inter-tag whitespace instead of indenting\n"
+                  << "  --direct   write the output file with O_DIRECT (bypass the page cache)\n"
+                  << "  --jobs=N   format a file input on N threads (0 = all cores)\n"
+                  << "  --pipeline tokenize, format and write on separate threads\n"
+                  << "  --recover  report every error and format on past it (exit status 1 still; not with --jobs)\n"
+                  << "  --stats=F  print tokenizer counters to stderr as json or prom (single-threaded run)\n"
+                  << "  --index=F  write a checkpoint index (every 64MB of input) to F (single-threaded run)\n"
+                  << "  input defaults to stdin, output to stdout; gzip/zstd input is detected and decoded\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    FormatterOptions fopts;
+    std::string inPath = "-";
+    std::string outPath = "-";
+    bool direct = false;
+    int jobs = 1;
+    bool pipeline = false;
+    bool recover = false;
+    std::string statsFormat;
+    std::string indexPath;
+    int positional = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--indent=", 0) == 0) {
+            const int n = std::atoi(arg.c_str() + 9);
+            if (n < 0 || n > 16) { usage(argv[0]); return 2; }
+            fopts.indentWidth = static_cast<U8>(n);
+        } else if (arg == "--tabs") {
+            fopts.useTabs = true;
+        } else if (arg == "--minify") {
+            fopts.minify = true;
+        } else if (arg == "--direct") {
+            direct = true;
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            jobs = std::atoi(arg.c_str() + 7);
+            if (jobs < 0 || jobs > 256) { usage(argv[0]); return 2; }
+        } else if (arg == "--pipeline") {
+            pipeline = true;
+        } else if (arg == "--recover") {
+            recover = true;
+        } else if (arg.rfind("--stats=", 0) == 0) {
+            statsFormat = arg.substr(8);
+            if (statsFormat != "json" && statsFormat != "prom") { usage(argv[0]); return 2; }
+        } else if (arg.rfind("--index=", 0) == 0) {
+            indexPath = arg.substr(8);
+            if (indexPath.empty()) { usage(argv[0]); return 2; }
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg.size() > 1 && arg[0] == '-' && arg != "-") {
+            usage(argv[0]);
+            return 2;
+        } else if (positional == 0) {
+            inPath = arg; ++positional;
+        } else if (positional == 1) {
+            outPath = arg; ++positional;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    // Files are mapped; stdin (pipes) and compressed files (.gz/.zst, by magic
+    // bytes) go through the prefetching reader, which decodes on its own thread.
+    BufferedInputStream::StateError inErr = BufferedInputStream::StateError::None;
+    std::ifstream compressedFile;
+    std::unique_ptr<BufferedInputStream> in;
+    if (inPath == "-") {
+        in = BufferedInputStream::CreateDecompressed(std::cin, kStdinBufferSize, true, &inErr);
+    } else {
+        in = BufferedInputStream::CreateMapped(inPath, &inErr);
+        size_t len = 0;
+        const uint8_t* head = in ? in->mappedContent(len) : nullptr;
+        if (head && BufferedInputStream::detectCompression(head, len) != BufferedInputStream::Compression::None) {
+            in.reset();
+            compressedFile.open(inPath, std::ios::binary);
+            if (compressedFile) {
+                in = BufferedInputStream::CreateDecompressed(compressedFile, kStdinBufferSize, true, &inErr);
+            }
+        }
+    }
+    if (!in) {
+        if (inErr == BufferedInputStream::StateError::UnsupportedCompression) {
+            std::cerr << "xmlformatter: '" << inPath << "' is compressed in a format this build cannot read\n";
+        } else {
+            std::cerr << "xmlformatter: cannot open input '" << inPath << "'\n";
+        }
+        return 2;
+    }
+
+    BufferedOutputStream::StateError outErr = BufferedOutputStream::StateError::None;
+    std::unique_ptr<BufferedOutputStream> out = (outPath == "-")
+        ? BufferedOutputStream::CreateFd(STDOUT_FILENO, BufferedOutputStream::kDefaultBufferSize, &outErr)
+        : direct ? BufferedOutputStream::CreateFileDirect(outPath, BufferedOutputStream::kDefaultBufferSize, &outErr)
+                 : BufferedOutputStream::CreateFile(outPath, BufferedOutputStream::kDefaultBufferSize, &outErr);
+    if (!out) {
+        std::cerr << "xmlformatter: cannot open output '" << outPath << "'\n";
+        return 2;
+    }
+
+    // Text tokens are consumed before the next batch, so they may alias the input;
+    // long runs arrive in pieces, so no text run is ever held in memory whole.
+    // References are copied as written rather than decoded and escaped again.
+    TokenizerOptions topts;
+    topts.flags |= TokenizerOptions::ZeroCopyText | TokenizerOptions::ChunkedText;
+    topts.flags &= ~TokenizerOptions::ExpandInternalEntities;
+    if (recover) topts.flags |= TokenizerOptions::RecoverErrors;
+    bool ok;
+    if (jobs != 1 && in->isMapped() && !recover) {
+        ParallelOptions popts;
+        popts.threads = static_cast<unsigned>(jobs);
+        ParallelFormatter pf(*out, fopts, popts, topts);
+        ok = pf.run(*in);
+    } else if (pipeline) {
+        PipelinedFormatter pf(*out, fopts, PipelineOptions{}, topts);
+        ok = pf.run(*in);
+    } else {
+        XMLTokenizer tz(*in, topts);
+        if (!statsFormat.empty()) tz.setStateTiming(kStatsTimingEvery);
+        CheckpointIndex index;
+        if (!indexPath.empty()) tz.recordCheckpoints(&index);
+        XMLFormatter fmt(*out, fopts);
+        ok = fmt.run(tz);
+        if (!indexPath.empty() && !index.save(indexPath)) {
+            std::cerr << "xmlformatter: cannot write index '" << indexPath << "'\n";
+            return 2;
+        }
+        if (statsFormat == "json") {
+            tz.stats().writeJson(std::cerr);
+            std::cerr << '\n';
+        } else if (statsFormat == "prom") {
+            tz.stats().writePrometheus(std::cerr);
+        }
+    }
+    if (!ok && !out->good()) {
+        std::cerr << "xmlformatter: write failed\n";
+        return 2;
+    }
+    // Checked whatever 'ok' says: a bad gzip CRC or a cut-off trailer only shows
+    // up after the last XML byte, when the document has already parsed cleanly.
+    if (in->sourceFailed()) {
+        std::cerr << "xmlformatter: input is corrupt or truncated (compressed data or UTF-16/32 code units)\n";
+        return 2;
+    }
+    return ok ? 0 : 1; // on failure the tokenizer already reported the error(s) on stderr
+}
@@ -1,7 +1,10 @@
 #include "UnitTestFramework.h"
 #include "BufferedInputStream.h"
+#include "TokenizerTestUtil.h"
 #include <limits>
 
+using TestUtil::TempFile;
+
 TEST_CASE(Factory_Create_EdgeCases){
     using BIS = LXMLFormatter::BufferedInputStream;
     using S   = BIS::StateError;
@@ -298,4 +301,317 @@ TEST_CASE(MovedFromActsAsEOFEverywhere) {
     REQUIRE_EQ(out.size(), 0u);
 
     REQUIRE_EQ(moved.getChar(), '1');
-}
\ No newline at end of file
+}
+
+TEST_CASE(Mapped_ReadAsciiAndTrackLines) {
+    const TempFile file("ab\r\ncd\ne");
+    REQUIRE(file);
+    const std::string& path = file.path();
+    using S = LXMLFormatter::BufferedInputStream::StateError;
+    S err = S::OutOfMemory;
+    auto bis = LXMLFormatter::BufferedInputStream::CreateMapped(path, &err);
+    REQUIRE(bis);
+    REQUIRE(err == S::None);
+    REQUIRE(bis->isMapped());
+
+    REQUIRE_EQ(bis->getChar(), 'a');
+    REQUIRE_EQ(bis->peekChar(), 'b');
+    REQUIRE_EQ(bis->getChar(), 'b');
+    REQUIRE_EQ(bis->getChar(), '\r');
+    REQUIRE_EQ(bis->getChar(), '\n');
+    REQUIRE_EQ(bis->getCurrentLine(), 2u);
+    REQUIRE_EQ(bis->getCurrentColumn(), 1u);
+
+    std::string out;
+    bis->readWhile(out, [](int32_t ch) { return ch != '\n'; });
+    REQUIRE_EQ(out, "cd");
+    REQUIRE_EQ(bis->getChar(), '\n');
+    REQUIRE_EQ(bis->getChar(), 'e');
+    REQUIRE_EQ(bis->getCurrentLine(), 3u);
+    REQUIRE_EQ(bis->getCurrentColumn(), 2u);
+    REQUIRE_EQ(bis->getChar(), -1);
+    REQUIRE(bis->eof());
+    REQUIRE_EQ(bis->getTotalBytesRead(), 8u);
+}
+
+TEST_CASE(Mapped_BomSkippedAndMultibyte) {
+    const TempFile file(std::string("\xEF\xBB\xBF") + u8"π!");
+    REQUIRE(file);
+    const std::string& path = file.path();
+    auto bis = LXMLFormatter::BufferedInputStream::CreateMapped(path);
+    REQUIRE(bis);
+    REQUIRE(bis->getEncoding() == LXMLFormatter::BufferedInputStream::Encoding::UTF8);
+    REQUIRE_EQ(bis->getChar(), 0x03C0);
+    REQUIRE_EQ(bis->getChar(), '!');
+    REQUIRE_EQ(bis->getChar(), -1);
+    REQUIRE_EQ(bis->getTotalBytesRead(), 3u);
+}
+
+TEST_CASE(Mapped_EmptyFileIsValidEOF) {
+    const TempFile file("");
+    REQUIRE(file);
+    const std::string& path = file.path();
+    auto bis = LXMLFormatter::BufferedInputStream::CreateMapped(path);
+    REQUIRE(bis);
+    REQUIRE(bis->isValid());
+    REQUIRE_EQ(bis->peekChar(), -1);
+    REQUIRE_EQ(bis->getChar(), -1);
+    REQUIRE(bis->eof());
+}
+
+TEST_CASE(Mapped_MissingFileReportsOpenFailed) {
+    using S = LXMLFormatter::BufferedInputStream::StateError;
+    S err = S::None;
+    auto bis = LXMLFormatter::BufferedInputStream::CreateMapped("/nonexistent/lxml/none.xml", &err);
+    REQUIRE(!bis);
+    REQUIRE(err == S::OpenFailed);
+}
+
+TEST_CASE(Mapped_MoveTransfersMapping) {
+    const TempFile file("xyz");
+    REQUIRE(file);
+    const std::string& path = file.path();
+    auto p = LXMLFormatter::BufferedInputStream::CreateMapped(path);
+    REQUIRE(p);
+    REQUIRE_EQ(p->getChar(), 'x');
+
+    LXMLFormatter::BufferedInputStream b(std::move(*p));
+    REQUIRE(!p->isValid());
+    REQUIRE(!p->isMapped());
+    REQUIRE_EQ(p->getChar(), -1);
+
+    REQUIRE(b.isMapped());
+    REQUIRE_EQ(b.getChar(), 'y');
+    REQUIRE_EQ(b.getChar(), 'z');
+    REQUIRE_EQ(b.getChar(), -1);
+}
+
+TEST_CASE(Prefetched_MatchesSynchronousLineColumn) {
+    // Mixed content with CRLF, lone CR and multi-byte sequences; the 8-byte buffer
+    // forces many swaps, so CR/LF pairs and UTF-8 sequences straddle them.
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "ab\r\n";
+        text += u8"π€";
+        text += "\r";
+        text += u8"🌍x\n";
+    }
+    std::istringstream a(text), b(text);
+    auto syncBis = LXMLFormatter::BufferedInputStream::Create(a, 8);
+    auto pre     = LXMLFormatter::BufferedInputStream::CreatePrefetched(b, 8);
+    REQUIRE(syncBis);
+    REQUIRE(pre);
+    REQUIRE(pre->isPrefetched());
+
+    for (;;) {
+        const int32_t p1 = syncBis->peekChar();
+        REQUIRE_EQ(pre->peekChar(), p1);
+        const int32_t c1 = syncBis->getChar();
+        const int32_t c2 = pre->getChar();
+        REQUIRE_EQ(c2, c1);
+        REQUIRE_EQ(pre->getCurrentLine(), syncBis->getCurrentLine());
+        REQUIRE_EQ(pre->getCurrentColumn(), syncBis->getCurrentColumn());
+        REQUIRE_EQ(pre->getTotalBytesRead(), syncBis->getTotalBytesRead());
+        if (c1 < 0) break;
+    }
+    REQUIRE(pre->eof());
+}
+
+TEST_CASE(Prefetched_ReadWhileAcrossSwaps) {
+    std::string text(10000, 'x');
+    text += ",tail";
+    std::istringstream in(text);
+    auto bis = LXMLFormatter::BufferedInputStream::CreatePrefetched(in, 16);
+    REQUIRE(bis);
+
+    std::string out;
+    bis->readUntil(out, ',');
+    REQUIRE_EQ(out.size(), 10000u);
+    REQUIRE_EQ(bis->getChar(), ',');
+    REQUIRE_EQ(bis->getCurrentColumn(), 10002u);
+    out.clear();
+    bis->readWhile(out, [](int32_t) { return true; });
+    REQUIRE_EQ(out, "tail");
+    REQUIRE_EQ(bis->getChar(), -1);
+}
+
+TEST_CASE(Prefetched_MoveAndEarlyDestroy) {
+    std::string text(4096, 'q');
+    std::istringstream in(text);
+    auto p = LXMLFormatter::BufferedInputStream::CreatePrefetched(in, 32);
+    REQUIRE(p);
+    REQUIRE_EQ(p->getChar(), 'q');
+
+    LXMLFormatter::BufferedInputStream b(std::move(*p));
+    REQUIRE(!p->isPrefetched());
+    REQUIRE(b.isPrefetched());
+    for (int i = 0; i < 100; ++i) REQUIRE_EQ(b.getChar(), 'q');
+    // b goes out of scope with unread input: the reader must stop and join cleanly.
+}
+
+TEST_CASE(Prefetched_SizeValidationMatchesCreate) {
+    using S = LXMLFormatter::BufferedInputStream::StateError;
+    std::istringstream in("X");
+    S err = S::None;
+    REQUIRE(!LXMLFormatter::BufferedInputStream::CreatePrefetched(in, 0, &err));
+    REQUIRE(err == S::ZeroBufferSize);
+    REQUIRE(!LXMLFormatter::BufferedInputStream::CreatePrefetched(in, 3, &err));
+    REQUIRE(err == S::BufferTooSmall);
+}
+
+TEST_CASE(Span_PeekAndConsumeBulk) {
+    std::istringstream in("hello\nworld");
+    auto bis = LXMLFormatter::BufferedInputStream::Create(in, 64);
+    REQUIRE(bis);
+
+    std::size_t len = 0;
+    const uint8_t* p = bis->peekSpan(len);
+    REQUIRE(p != nullptr);
+    REQUIRE_EQ(len, 11u);
+    REQUIRE(std::memcmp(p, "hello\nworld", 11) == 0);
+
+    bis->consumeSpan(8); // "hello\nwo"
+    REQUIRE_EQ(bis->getCurrentLine(), 2u);
+    REQUIRE_EQ(bis->getCurrentColumn(), 3u);
+    REQUIRE_EQ(bis->getTotalBytesRead(), 8u);
+    REQUIRE_EQ(bis->getChar(), 'r');
+
+    p = bis->peekSpan(len);
+    REQUIRE_EQ(len, 2u);
+    bis->consumeSpan(100); // clamped
+    REQUIRE_EQ(bis->getCurrentColumn(), 6u);
+    p = bis->peekSpan(len);
+    REQUIRE(p == nullptr);
+    REQUIRE_EQ(len, 0u);
+    REQUIRE(bis->eof());
+}
+
+TEST_CASE(Span_ConsumeInvalidatesPeek) {
+    std::istringstream in("abc");
+    auto bis = LXMLFormatter::BufferedInputStream::Create(in, 16);
+    REQUIRE(bis);
+    REQUIRE_EQ(bis->peekChar(), 'a');
+    bis->consumeSpan(1);
+    REQUIRE_EQ(bis->peekChar(), 'b');
+    REQUIRE_EQ(bis->getChar(), 'b');
+}
+
+TEST_CASE(Span_MinBytesRefillsAcrossCompaction) {
+    std::istringstream in("abcdefgh");
+    auto bis = LXMLFormatter::BufferedInputStream::Create(in, 4);
+    REQUIRE(bis);
+    REQUIRE_EQ(bis->getChar(), 'a');
+    REQUIRE_EQ(bis->getChar(), 'b');
+    REQUIRE_EQ(bis->getChar(), 'c');
+
+    std::size_t len = 0;
+    const uint8_t* p = bis->peekSpan(len, 3); // only "d" left in the window
+    REQUIRE(p != nullptr);
+    REQUIRE_EQ(len, 4u);
+    REQUIRE(std::memcmp(p, "defg", 4) == 0);
+}
+
+TEST_CASE(Span_BulkPositionsMatchPerCharAdvance) {
+    // CR at the end of one span and LF at the start of the next must count once.
+    const std::string text = "a\r\nbb\rc\n\r\r\nddd\re\r";
+    for (std::size_t split = 0; split <= text.size(); ++split) {
+        std::istringstream a(text), b(text);
+        auto ref  = LXMLFormatter::BufferedInputStream::Create(a, 64);
+        auto bulk = LXMLFormatter::BufferedInputStream::Create(b, 64);
+        REQUIRE(ref);
+        REQUIRE(bulk);
+        while (ref->getChar() >= 0) {}
+
+        std::size_t len = 0;
+        bulk->peekSpan(len);
+        bulk->consumeSpan(split);
+        bulk->peekSpan(len);
+        bulk->consumeSpan(len);
+
+        REQUIRE_EQ(bulk->getCurrentLine(), ref->getCurrentLine());
+        REQUIRE_EQ(bulk->getCurrentColumn(), ref->getCurrentColumn());
+        REQUIRE_EQ(bulk->getTotalBytesRead(), ref->getTotalBytesRead());
+    }
+}
+
+TEST_CASE(Span_LongRangesMatchPerCharAdvance) {
+    // Long CR/LF-heavy text so the vectorized accounting path is exercised,
+    // consumed in uneven spans that split CRLF pairs.
+    std::string text;
+    for (int i = 0; i < 300; ++i) {
+        text += (i % 7 == 0) ? "\r" : (i % 5 == 0) ? "\n" : (i % 3 == 0) ? "\r\n" : "some text ";
+    }
+    for (std::size_t step : {1u, 15u, 16u, 17u, 31u, 32u, 33u, 100u}) {
+        std::istringstream a(text), b(text);
+        auto ref  = LXMLFormatter::BufferedInputStream::Create(a, 4096);
+        auto bulk = LXMLFormatter::BufferedInputStream::Create(b, 64);
+        REQUIRE(ref);
+        REQUIRE(bulk);
+        for (;;) {
+            std::size_t len = 0;
+            if (!bulk->peekSpan(len)) break;
+            const std::size_t take = std::min(step, len);
+            bulk->consumeSpan(take);
+            for (std::size_t i = 0; i < take; ++i) ref->getChar();
+            REQUIRE_EQ(bulk->getCurrentLine(), ref->getCurrentLine());
+            REQUIRE_EQ(bulk->getCurrentColumn(), ref->getCurrentColumn());
+        }
+        REQUIRE_EQ(ref->getChar(), -1);
+    }
+}
+
+TEST_CASE(ReadWhileMultibyteSplitAcrossRefill) {
+    // With a 4-byte buffer the 3-byte '€' straddles refills at several offsets.
+    const std::string text = std::string("ab") + u8"€" + "c" + u8"€€" + "d";
+    std::istringstream in(text);
+    auto bis = LXMLFormatter::BufferedInputStream::Create(in, 4);
+    REQUIRE(bis);
+    std::string out;
+    bis->readWhile(out, [](int32_t) { return true; });
+    REQUIRE_EQ(out, text);
+    REQUIRE_EQ(bis->getChar(), -1);
+}
+
+TEST_CASE(ReadWhileTruncatedSequenceAtEOFStops) {
+    std::string text = "ok";
+    text.push_back(static_cast<char>(0xE2)); // lead of a 3-byte sequence, then EOF
+    std::istringstream in(text);
+    auto bis = LXMLFormatter::BufferedInputStream::Create(in, 4);
+    REQUIRE(bis);
+    std::string out;
+    bis->readWhile(out, [](int32_t) { return true; });
+    REQUIRE_EQ(out, "ok");
+}
+
+TEST_CASE(ReadWhileAfterPeekDoesNotReplayPeek) {
+    std::istringstream in("abc,");
+    auto bis = LXMLFormatter::BufferedInputStream::Create(in, 16);
+    REQUIRE(bis);
+    REQUIRE_EQ(bis->peekChar(), 'a');
+    std::string out;
+    bis->readUntil(out, ',');
+    REQUIRE_EQ(out, "abc");
+    REQUIRE_EQ(bis->getChar(), ',');
+}
+
+TEST_CASE(ViewReadsBorrowedBytesWithAbsoluteOffsets) {
+    const std::string doc = "<r>\n<a>x</a>\n<b/></r>";
+    const size_t at = doc.find("<a>");
+    auto view = LXMLFormatter::BufferedInputStream::CreateView(
+        reinterpret_cast<const uint8_t*>(doc.data()) + at, 8, at);
+    REQUIRE(view);
+    REQUIRE(view->isMapped());
+    REQUIRE_EQ(view->baseOffset(), static_cast<uint64_t>(at));
+    size_t len = 0;
+    REQUIRE(view->mappedContent(len) == reinterpret_cast<const uint8_t*>(doc.data()) + at);
+    REQUIRE_EQ(len, 8u);
+
+    // Line/column restart at the view; byte offsets stay document offsets.
+    REQUIRE_EQ(view->getChar(), '<');
+    REQUIRE_EQ(view->getCurrentLine(), 1u);
+    REQUIRE_EQ(view->getCurrentColumn(), 2u);
+    std::string out;
+    view->readWhile(out, [](int32_t) { return true; });
+    REQUIRE_EQ(out, "a>x</a>");
+    REQUIRE_EQ(view->getChar(), -1);
+}
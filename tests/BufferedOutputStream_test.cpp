@@ -0,0 +1,147 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "BufferedOutputStream.h"
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace LXMLFormatter;
+
+TEST_CASE(BufferedOutputStream_ZeroBufferRejected) {
+    std::ostringstream os;
+    BufferedOutputStream::StateError err = BufferedOutputStream::StateError::None;
+    REQUIRE(!BufferedOutputStream::Create(os, 0, &err));
+    REQUIRE_EQ(static_cast<int>(err), static_cast<int>(BufferedOutputStream::StateError::ZeroBufferSize));
+}
+
+TEST_CASE(BufferedOutputStream_SmallAndLargeWritesKeepOrder) {
+    std::ostringstream os;
+    std::string expected;
+    {
+        auto out = BufferedOutputStream::Create(os, 16);
+        REQUIRE(out);
+        for (int i = 0; i < 50; ++i) {
+            const std::string s = std::to_string(i) + ",";
+            out->write(s.data(), s.size());
+            expected += s;
+            if (i % 10 == 0) {
+                const std::string big(40, static_cast<char>('a' + i / 10)); // > buffer: written through
+                out->write(big.data(), big.size());
+                expected += big;
+            }
+            out->put('|');
+            expected += '|';
+        }
+        REQUIRE_EQ(out->bytesWritten(), expected.size());
+    } // destructor flushes
+    REQUIRE_EQ(os.str(), expected);
+}
+
+TEST_CASE(BufferedOutputStream_FileSink) {
+    const std::string path = "/tmp/lxml_bos_test.txt";
+    {
+        auto out = BufferedOutputStream::CreateFile(path, 8);
+        REQUIRE(out);
+        out->write("hello, file sink", 16);
+        REQUIRE(out->flush());
+    }
+    std::ifstream f(path);
+    std::string s((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    REQUIRE_EQ(s, "hello, file sink");
+    std::remove(path.c_str());
+}
+
+namespace {
+    std::string readFile(const std::string& path) {
+        std::ifstream f(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    }
+}
+
+TEST_CASE(BufferedOutputStream_RefsInterleaveWithBufferedBytes) {
+    const std::string path = "/tmp/lxml_bos_refs.txt";
+    // Stable storage for the refs: they must outlive the flush.
+    std::vector<std::string> blocks;
+    for (int i = 0; i < 300; ++i) {
+        blocks.emplace_back(BufferedOutputStream::kMinRefBytes + static_cast<size_t>(i), static_cast<char>('A' + i % 26));
+    }
+    std::string expected;
+    {
+        auto out = BufferedOutputStream::CreateFile(path, 4096);
+        REQUIRE(out);
+        for (int i = 0; i < 300; ++i) {
+            // More refs than kMaxRefs and more ref bytes than the buffer: several writev() calls.
+            const std::string tag = "<" + std::to_string(i) + ">";
+            out->write(tag.data(), tag.size());
+            out->writeRef(blocks[i].data(), blocks[i].size());
+            if (i % 7 == 0) out->writeRef(blocks[i].data(), 3);  // small: copied
+            expected += tag + blocks[i] + (i % 7 == 0 ? blocks[i].substr(0, 3) : "");
+        }
+        REQUIRE_EQ(out->bytesWritten(), expected.size());
+        REQUIRE(out->flush());
+    }
+    REQUIRE(readFile(path) == expected);
+    std::remove(path.c_str());
+}
+
+TEST_CASE(BufferedOutputStream_RefsOnStreamSinkAreCopied) {
+    std::ostringstream os;
+    const std::string big(3000, 'x');
+    {
+        auto out = BufferedOutputStream::Create(os, 64);
+        REQUIRE(out);
+        out->write("a", 1);
+        out->writeRef(big.data(), big.size());
+        out->put('b');
+    }
+    REQUIRE(os.str() == "a" + big + "b");
+}
+
+TEST_CASE(BufferedOutputStream_StringSinkAppends) {
+    std::string sink = "pre:";
+    const std::string big(3000, 'y');
+    {
+        auto out = BufferedOutputStream::CreateString(sink, 64);
+        REQUIRE(out);
+        out->write("a", 1);
+        out->writeRef(big.data(), big.size());
+        out->put('b');
+        REQUIRE_EQ(out->bytesWritten(), 3002u);
+        REQUIRE(out->flush());
+        REQUIRE_EQ(sink.size(), 4u + 3002u);
+    }
+    REQUIRE(sink == "pre:a" + big + "b");
+}
+
+TEST_CASE(BufferedOutputStream_DirectFileUnalignedTail) {
+    const std::string path = "/tmp/lxml_bos_direct.txt";
+    std::string expected;
+    {
+        // 5000 rounds up to two blocks; the document is not a block multiple.
+        auto out = BufferedOutputStream::CreateFileDirect(path, 5000);
+        REQUIRE(out);
+        for (int i = 0; i < 4000; ++i) {
+            const std::string s = std::to_string(i) + (i % 3 ? "," : "\n");
+            out->write(s.data(), s.size());
+            expected += s;
+        }
+        const std::string big(20000, 'z');   // larger than the buffer: chunked through it
+        out->writeRef(big.data(), big.size());
+        expected += big;
+        out->write("end", 3);
+        expected += "end";
+        REQUIRE(out->flush());
+        REQUIRE(!out->isDirect());   // the unaligned tail ended direct mode
+    }
+    REQUIRE(readFile(path) == expected);
+    std::remove(path.c_str());
+}
+
+TEST_CASE(BufferedOutputStream_OpenFailure) {
+    BufferedOutputStream::StateError err = BufferedOutputStream::StateError::None;
+    REQUIRE(!BufferedOutputStream::CreateFile("/nonexistent-dir/x.xml", 64, &err));
+    REQUIRE_EQ(static_cast<int>(err), static_cast<int>(BufferedOutputStream::StateError::OpenFailed));
+}
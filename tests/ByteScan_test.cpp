@@ -0,0 +1,152 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "ByteScan.h"
+#include <algorithm>
+#include <vector>
+#include <random>
+
+using namespace LXMLFormatter;
+
+namespace {
+    // Random bytes biased towards CR/LF so every block carries breaks and CRLF pairs.
+    std::vector<uint8_t> randomLineBytes(std::mt19937& rng, std::size_t n) {
+        std::vector<uint8_t> v(n);
+        for (auto& b : v) {
+            const unsigned r = rng() % 8;
+            b = (r == 0) ? 0x0D : (r == 1) ? 0x0A : static_cast<uint8_t>('a' + rng() % 26);
+        }
+        return v;
+    }
+
+    bool sameScan(const ByteScan::LineScan& a, const ByteScan::LineScan& b) {
+        return a.lines == b.lines && a.lastBreak == b.lastBreak;
+    }
+}
+
+TEST_CASE(ByteScan_ScanLines_EmptyAndNoBreaks) {
+    const uint8_t text[] = "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnop";
+    const std::size_t n = sizeof(text) - 1;
+    auto r = ByteScan::scanLines(text, n, false);
+    REQUIRE_EQ(r.lines, 0u);
+    REQUIRE_EQ(r.lastBreak, n);
+
+    r = ByteScan::scanLines(text, 0, true);
+    REQUIRE_EQ(r.lines, 0u);
+    REQUIRE_EQ(r.lastBreak, 0u);
+}
+
+TEST_CASE(ByteScan_ScanLines_CRLFAcrossBlockAndCallBoundary) {
+    // LF at index 16 completes the CR at index 15 (SSE2 block boundary).
+    std::vector<uint8_t> v(48, 'x');
+    v[15] = 0x0D;
+    v[16] = 0x0A;
+    auto r = ByteScan::scanLines(v.data(), v.size(), false);
+    REQUIRE_EQ(r.lines, 1u);
+    REQUIRE_EQ(r.lastBreak, 16u);
+
+    // Leading LF completes a CR from the previous call.
+    v.assign(40, 'y');
+    v[0] = 0x0A;
+    r = ByteScan::scanLines(v.data(), v.size(), true);
+    REQUIRE_EQ(r.lines, 0u);
+    REQUIRE_EQ(r.lastBreak, 0u);
+    r = ByteScan::scanLines(v.data(), v.size(), false);
+    REQUIRE_EQ(r.lines, 1u);
+}
+
+TEST_CASE(ByteScan_ScanLines_VectorPathsMatchScalar) {
+    std::mt19937 rng(12345);
+    for (std::size_t n = 0; n < 300; ++n) {
+        const auto v = randomLineBytes(rng, n);
+        for (int prev = 0; prev < 2; ++prev) {
+            const auto ref = ByteScan::detail::scanLinesScalar(v.data(), n, prev != 0);
+            REQUIRE(sameScan(ByteScan::scanLines(v.data(), n, prev != 0), ref));
+#if defined(LXML_BYTESCAN_X86)
+            REQUIRE(sameScan(ByteScan::detail::scanLinesSSE2(v.data(), n, prev != 0), ref));
+            if (ByteScan::detail::kHasAVX2) {
+                REQUIRE(sameScan(ByteScan::detail::scanLinesAVX2(v.data(), n, prev != 0), ref));
+            }
+#endif
+        }
+    }
+}
+
+TEST_CASE(ByteScan_FindFirstOf_VectorPathsMatchScalar) {
+    std::mt19937 rng(777);
+    for (std::size_t n = 0; n < 200; ++n) {
+        std::vector<uint8_t> v(n);
+        for (auto& b : v) b = static_cast<uint8_t>('a' + rng() % 26);
+        // Plant at most one delimiter somewhere (or none).
+        const uint8_t delims[] = { '<', '&', '\r', '"' };
+        if (n && rng() % 4) v[rng() % n] = delims[rng() % 4];
+        const auto ref = ByteScan::detail::findFirstOfScalar<4>(v.data(), n, '<', '&', '\r', '"');
+        REQUIRE_EQ(ByteScan::findFirstOf(v.data(), n, '<', '&', '\r', '"'), ref);
+#if defined(LXML_BYTESCAN_X86)
+        REQUIRE_EQ(ByteScan::detail::findFirstOfSSE2<4>(v.data(), n, '<', '&', '\r', '"'), ref);
+        if (ByteScan::detail::kHasAVX2) {
+            REQUIRE_EQ(ByteScan::detail::findFirstOfAVX2<4>(v.data(), n, '<', '&', '\r', '"'), ref);
+        }
+#endif
+    }
+
+    // Earliest of several delimiters wins; none found returns n.
+    const uint8_t text[] = "0123456789abcdefghij\"klmnop<qrstuvwxyz";
+    const std::size_t n = sizeof(text) - 1;
+    REQUIRE_EQ(ByteScan::findFirstOf(text, n, '<', '"', '<', '<'), 20u);
+    REQUIRE_EQ(ByteScan::findFirstOf(text, n, '<', '<', '<', '<'), 27u);
+    REQUIRE_EQ(ByteScan::findFirstOf(text, n, '&', '&', '&', '&'), n);
+}
+
+TEST_CASE(ByteScan_FindFirstOf_FewerDelimitersIgnoreTheRest) {
+    // With K delimiters only a..(K-th) are compared; the unused slots must not match.
+    std::mt19937 rng(4242);
+    for (std::size_t n = 0; n < 200; ++n) {
+        std::vector<uint8_t> v(n);
+        for (auto& b : v) b = static_cast<uint8_t>('a' + rng() % 26);
+        const uint8_t delims[] = { '<', '&', '\r', '"' };
+        for (int k = 0; n && k < 3; ++k) v[rng() % n] = delims[rng() % 4];
+        auto first = [&](std::initializer_list<uint8_t> set) {
+            for (std::size_t i = 0; i < n; ++i)
+                for (uint8_t d : set) if (v[i] == d) return i;
+            return n;
+        };
+        REQUIRE_EQ(ByteScan::findFirstOf(v.data(), n, '<'), first({'<'}));
+        REQUIRE_EQ(ByteScan::findFirstOf(v.data(), n, '<', '\r'), first({'<', '\r'}));
+        REQUIRE_EQ(ByteScan::findFirstOf(v.data(), n, '"', '<', '\r'), first({'"', '<', '\r'}));
+        REQUIRE_EQ((ByteScan::findFirstOfN<1>(v.data(), n, '<', '&', '\r', '"')), first({'<'}));
+        REQUIRE_EQ((ByteScan::findFirstOfN<2>(v.data(), n, '<', '&', '\r', '"')), first({'<', '&'}));
+#if defined(LXML_BYTESCAN_X86)
+        REQUIRE_EQ((ByteScan::detail::findFirstOfSSE2<3>(v.data(), n, '<', '&', '\r', '"')), first({'<', '&', '\r'}));
+        if (ByteScan::detail::kHasAVX2) {
+            REQUIRE_EQ((ByteScan::detail::findFirstOfAVX2<1>(v.data(), n, '&', '<', '<', '<')), first({'&'}));
+        }
+#endif
+    }
+}
+
+TEST_CASE(ByteScan_NarrowAscii16_VectorPathsMatchScalar) {
+    std::mt19937 rng(4242);
+    for (std::size_t n = 0; n < 120; ++n) {
+        for (int be = 0; be < 2; ++be) {
+            // ASCII units, with at most one non-ASCII unit (high or low byte set) planted.
+            std::vector<uint8_t> src(2 * n);
+            for (std::size_t i = 0; i < n; ++i) {
+                src[2 * i + (be ? 1 : 0)] = static_cast<uint8_t>('a' + rng() % 26);
+                src[2 * i + (be ? 0 : 1)] = 0;
+            }
+            if (n && rng() % 3) src[2 * (rng() % n) + rng() % 2] = static_cast<uint8_t>(0x80 | rng());
+            std::vector<uint8_t> ref(n + 1), got(n + 1);
+            const std::size_t k = ByteScan::detail::narrowAscii16Scalar(src.data(), n, be != 0, ref.data());
+            REQUIRE_EQ(ByteScan::narrowAscii16(src.data(), n, be != 0, got.data()), k);
+            REQUIRE(std::equal(ref.begin(), ref.begin() + static_cast<std::ptrdiff_t>(k), got.begin()));
+#if defined(LXML_BYTESCAN_X86)
+            REQUIRE_EQ(ByteScan::detail::narrowAscii16SSE2(src.data(), n, be != 0, got.data()), k);
+            REQUIRE(std::equal(ref.begin(), ref.begin() + static_cast<std::ptrdiff_t>(k), got.begin()));
+            if (ByteScan::detail::kHasAVX2) {
+                REQUIRE_EQ(ByteScan::detail::narrowAscii16AVX2(src.data(), n, be != 0, got.data()), k);
+                REQUIRE(std::equal(ref.begin(), ref.begin() + static_cast<std::ptrdiff_t>(k), got.begin()));
+            }
+#endif
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "DecompressingStreamBuf.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+
+#if defined(LXML_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(LXML_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+using namespace LXMLFormatter;
+using Compression = BufferedInputStream::Compression;
+
+namespace {
+    std::string sampleText() {
+        std::string s = "<?xml?>\n<r>";
+        for (int i = 0; i < 5000; ++i) s += "<i n=\"" + std::to_string(i) + "\">caf\xC3\xA9</i>\n";
+        return s + "</r>\n";
+    }
+
+    // Everything the stream yields, read through readWhile().
+    std::string drain(BufferedInputStream& in) {
+        std::string out;
+        in.readWhile(out, [](int32_t) { return true; });
+        return out;
+    }
+
+#if defined(LXML_HAVE_ZLIB)
+    std::string gzip(const std::string& data) {
+        z_stream z{};
+        if (deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return {};
+        std::string out(deflateBound(&z, static_cast<uLong>(data.size())) + 32, '\0');
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        z.avail_in = static_cast<uInt>(data.size());
+        z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+        z.avail_out = static_cast<uInt>(out.size());
+        deflate(&z, Z_FINISH);
+        out.resize(z.total_out);
+        deflateEnd(&z);
+        return out;
+    }
+#endif
+}
+
+TEST_CASE(Decompress_DetectsMagicBytes) {
+    const uint8_t gz[]   = {0x1F, 0x8B, 0x08, 0x00};
+    const uint8_t zst[]  = {0x28, 0xB5, 0x2F, 0xFD};
+    const uint8_t xml[]  = {'<', 'a', '>', 0};
+    REQUIRE(BufferedInputStream::detectCompression(gz, 4) == Compression::Gzip);
+    REQUIRE(BufferedInputStream::detectCompression(zst, 4) == Compression::Zstd);
+    REQUIRE(BufferedInputStream::detectCompression(zst, 3) == Compression::None);
+    REQUIRE(BufferedInputStream::detectCompression(xml, 3) == Compression::None);
+    REQUIRE(BufferedInputStream::detectCompression(gz, 0) == Compression::None);
+}
+
+TEST_CASE(Decompress_PlainInputPassesThrough) {
+    const std::string text = sampleText();
+    for (bool prefetch : {false, true}) {
+        std::istringstream is(text);
+        auto in = BufferedInputStream::CreateDecompressed(is, 64, prefetch);
+        REQUIRE(in);
+        REQUIRE(in->getCompression() == Compression::None);
+        REQUIRE_EQ(drain(*in), text);
+        REQUIRE(!in->sourceFailed());
+    }
+    std::istringstream empty("");
+    auto in = BufferedInputStream::CreateDecompressed(empty, 64, false);
+    REQUIRE(in);
+    REQUIRE_EQ(in->getChar(), -1);
+}
+
+#if defined(LXML_HAVE_ZLIB)
+TEST_CASE(Decompress_GzipIntoSmallBuffers) {
+    const std::string text = sampleText();
+    const std::string gz = gzip(text);
+    REQUIRE(!gz.empty());
+    for (bool prefetch : {false, true}) {
+        for (size_t buf : {size_t(7), size_t(4096)}) {
+            std::istringstream is(gz);
+            auto in = BufferedInputStream::CreateDecompressed(is, buf, prefetch);
+            REQUIRE(in);
+            REQUIRE(in->getCompression() == Compression::Gzip);
+            REQUIRE_EQ(drain(*in), text);
+            REQUIRE(!in->sourceFailed());
+        }
+    }
+}
+
+TEST_CASE(Decompress_GzipConcatenatedMembers) {
+    const std::string a = "<r><a>one</a>";
+    const std::string b = "<b>two</b></r>";
+    std::istringstream is(gzip(a) + gzip(b));
+    auto in = BufferedInputStream::CreateDecompressed(is, 16, false);
+    REQUIRE(in);
+    REQUIRE_EQ(drain(*in), a + b);
+    REQUIRE(!in->sourceFailed());
+}
+
+TEST_CASE(Decompress_GzipTruncatedOrCorrupt) {
+    const std::string gz = gzip(sampleText());
+    std::istringstream truncated(gz.substr(0, gz.size() / 2));
+    auto in = BufferedInputStream::CreateDecompressed(truncated, 256, true);
+    REQUIRE(in);
+    drain(*in);
+    REQUIRE(in->sourceFailed());
+
+    std::string bad = gz;
+    for (size_t i = 20; i < 60; ++i) bad[i] = static_cast<char>(0xFF);
+    std::istringstream corrupt(bad);
+    auto in2 = BufferedInputStream::CreateDecompressed(corrupt, 256, false);
+    REQUIRE(in2);
+    drain(*in2);
+    REQUIRE(in2->sourceFailed());
+}
+
+TEST_CASE(Decompress_DamagedTrailerFailsAfterTheDocument) {
+    // The XML is whole, so the formatters succeed; only the gzip trailer is bad,
+    // which the stream finds after the last XML byte.
+    const std::string xml = "<r><a>one</a><b>two</b></r>\n";
+    const std::string gz = gzip(xml);
+    std::string badCrc = gz;
+    badCrc[gz.size() - 8] = static_cast<char>(badCrc[gz.size() - 8] ^ 1);
+    const std::string cutTrailer = gz.substr(0, gz.size() - 4);
+    for (const std::string& raw : {badCrc, cutTrailer}) {
+        for (bool pipelined : {false, true}) {
+            std::istringstream is(raw);
+            auto in = BufferedInputStream::CreateDecompressed(is, 16, true);
+            REQUIRE(in);
+            std::string out;
+            REQUIRE(TestUtil::format(*in, pipelined, out));
+            REQUIRE(out.find("two") != std::string::npos);
+            REQUIRE(in->sourceFailed());
+        }
+    }
+    std::istringstream good(gz);
+    auto in = BufferedInputStream::CreateDecompressed(good, 16, true);
+    std::string out;
+    REQUIRE(TestUtil::format(*in, true, out));
+    REQUIRE(!in->sourceFailed());
+}
+#endif
+
+#if defined(LXML_HAVE_ZSTD)
+TEST_CASE(Decompress_ZstdFrames) {
+    const std::string text = sampleText();
+    auto compress = [](const std::string& s) {
+        std::string out(ZSTD_compressBound(s.size()), '\0');
+        out.resize(ZSTD_compress(&out[0], out.size(), s.data(), s.size(), 3));
+        return out;
+    };
+    std::istringstream is(compress(text) + compress("<tail/>"));
+    auto in = BufferedInputStream::CreateDecompressed(is, 100, true);
+    REQUIRE(in);
+    REQUIRE(in->getCompression() == Compression::Zstd);
+    REQUIRE_EQ(drain(*in), text + "<tail/>");
+    REQUIRE(!in->sourceFailed());
+}
+#else
+TEST_CASE(Decompress_ZstdNotBuiltIsReported) {
+    std::istringstream is(std::string("\x28\xB5\x2F\xFD\x00\x00", 6));
+    BufferedInputStream::StateError err = BufferedInputStream::StateError::None;
+    REQUIRE(!BufferedInputStream::CreateDecompressed(is, 64, false, &err));
+    REQUIRE(err == BufferedInputStream::StateError::UnsupportedCompression);
+}
+#endif
@@ -0,0 +1,49 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "NameTable.h"
+#include <string>
+
+using namespace LXMLFormatter;
+
+TEST_CASE(NameTable_InternAndFind) {
+    NameTable t;
+    REQUIRE_EQ(t.find("a", 1), NameTable::kNone);
+
+    const NameId a  = t.intern("item", 4);
+    const NameId b  = t.intern("id", 2);
+    REQUIRE(a != NameTable::kNone);
+    REQUIRE(b != NameTable::kNone);
+    REQUIRE(a != b);
+    REQUIRE_EQ(t.intern("item", 4), a);
+    REQUIRE_EQ(t.find("id", 2), b);
+    REQUIRE_EQ(t.find("ite", 3), NameTable::kNone);
+    REQUIRE_EQ(t.name(a), std::string_view("item"));
+    REQUIRE_EQ(t.size(), 2u);
+}
+
+TEST_CASE(NameTable_IdsStableAcrossGrowth) {
+    NameTable t;
+    std::vector<NameId> ids;
+    for (int i = 0; i < 1000; ++i) {
+        const std::string n = "name" + std::to_string(i);
+        ids.push_back(t.intern(n.data(), static_cast<U32>(n.size())));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        const std::string n = "name" + std::to_string(i);
+        REQUIRE_EQ(t.find(n.data(), static_cast<U32>(n.size())), ids[i]);
+        REQUIRE_EQ(t.name(ids[i]), std::string_view(n));
+    }
+}
+
+TEST_CASE(NameTable_BoundedSize) {
+    NameTable t(2);
+    REQUIRE(t.intern("a", 1) != NameTable::kNone);
+    REQUIRE(t.intern("b", 1) != NameTable::kNone);
+    REQUIRE_EQ(t.intern("c", 1), NameTable::kNone);
+    REQUIRE(t.intern("a", 1) != NameTable::kNone); // existing names still resolve
+    REQUIRE_EQ(t.size(), 2u);
+
+    t.clear();
+    REQUIRE_EQ(t.find("a", 1), NameTable::kNone);
+    REQUIRE(t.intern("c", 1) != NameTable::kNone);
+}
@@ -0,0 +1,179 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "BufferedOutputStream.h"
+#include "XMLTokenizer.h"
+#include "XMLFormatter.h"
+#include "ParallelFormatter.h"
+#include "TokenizerTestUtil.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+using namespace LXMLFormatter;
+using TestUtil::TempFile;
+
+namespace {
+    struct Result {
+        std::string out;
+        bool ok = false;
+        std::size_t chunks = 0;
+        std::size_t fallbacks = 0;
+        TokenizerErrorCode error = TokenizerErrorCode::None;
+        U32 errorLine = 0;
+    };
+
+    Result sequential(const std::string& xml, FormatterOptions fopts) {
+        TempFile f(xml);
+        Result r;
+        auto in = BufferedInputStream::CreateMapped(f.path());
+        auto out = BufferedOutputStream::CreateString(r.out, 64);
+        if (!in || !out) return r;
+        XMLTokenizer tz(*in);
+        XMLFormatter fmt(*out, fopts);
+        r.ok = fmt.run(tz);
+        return r;
+    }
+
+    Result parallel(const std::string& xml, FormatterOptions fopts, std::size_t chunkBytes,
+                    unsigned threads = 3, TokenizerOptions topts = {}) {
+        TempFile f(xml);
+        Result r;
+        auto in = BufferedInputStream::CreateMapped(f.path());
+        auto out = BufferedOutputStream::CreateString(r.out, 64);
+        if (!in || !out) return r;
+        ParallelOptions popts;
+        popts.threads = threads;
+        popts.chunkBytes = chunkBytes;
+        popts.maxInFlight = 4;
+        ParallelFormatter pf(*out, fopts, popts, topts);
+        r.ok = pf.run(*in);
+        r.chunks = pf.chunks();
+        r.fallbacks = pf.fallbacks();
+        r.error = pf.lastError().code;
+        r.errorLine = pf.lastError().where.line;
+        return r;
+    }
+
+    std::string sampleDocument() {
+        std::string xml = "<catalog version='2'>\n";
+        for (int i = 0; i < 60; ++i) {
+            xml += "  <item id=\"" + std::to_string(i) + "\">\n";
+            xml += "    <name>Item " + std::to_string(i) + "</name>\n";
+            if (i % 3 == 0) xml += "    <tags><tag>a</tag><tag>b</tag></tags>\n";
+            if (i % 5 == 0) xml += "    <empty/>\n";
+            if (i % 7 == 0) xml += "    <deep><x><y><z>t</z></y></x></deep>\n";
+            xml += "  </item>\n";
+        }
+        xml += "</catalog>\n";
+        return xml;
+    }
+}
+
+TEST_CASE(ParallelFormatter_MatchesSequential) {
+    const std::string xml = sampleDocument();
+    FormatterOptions tabs;
+    tabs.useTabs = true;
+    FormatterOptions minify;
+    minify.minify = true;
+
+    for (const FormatterOptions& fopts : {FormatterOptions{}, tabs, minify}) {
+        const Result ref = sequential(xml, fopts);
+        REQUIRE(ref.ok);
+        for (std::size_t chunkBytes : {1u, 17u, 64u, 500u, 1u << 20}) {
+            for (unsigned threads : {1u, 3u}) {
+                const Result got = parallel(xml, fopts, chunkBytes, threads);
+                REQUIRE(got.ok);
+                REQUIRE_EQ(got.out, ref.out);
+                REQUIRE_EQ(got.fallbacks, 0u);
+            }
+        }
+    }
+    REQUIRE(parallel(xml, {}, 64).chunks > 10u);
+}
+
+TEST_CASE(ParallelFormatter_MixedContentFallsBack) {
+    // The boundaries before <b> and <i> sit in elements that hold text, which the
+    // chunks cannot know: those chunks are redone sequentially.
+    std::string xml = "<doc>\n";
+    for (int i = 0; i < 20; ++i) {
+        xml += "  <p>Some > text <b>bold</b>\n  <i>it</i> tail</p>\n";
+        xml += "  <q>\n    <r/>\n  </q>\n";
+    }
+    xml += "</doc>";
+
+    FormatterOptions minify;
+    minify.minify = true;
+    for (const FormatterOptions& fopts : {FormatterOptions{}, minify}) {
+        const Result ref = sequential(xml, fopts);
+        REQUIRE(ref.ok);
+        const Result got = parallel(xml, fopts, 16);
+        REQUIRE(got.ok);
+        REQUIRE_EQ(got.out, ref.out);
+        REQUIRE(got.fallbacks > 0u);
+    }
+}
+
+TEST_CASE(ParallelFormatter_ErrorsFail) {
+    std::string xml = sampleDocument();
+
+    std::string mismatched = xml;
+    mismatched.replace(mismatched.find("</name>", xml.size() / 2), 7, "</nope>");
+    REQUIRE(!sequential(mismatched, {}).ok);
+    REQUIRE(!parallel(mismatched, {}, 64).ok);
+
+    std::string unclosed = xml;
+    unclosed.resize(unclosed.rfind("</catalog>"));
+    REQUIRE(!parallel(unclosed, {}, 64).ok);
+
+    std::string stray = xml + "</extra>";
+    REQUIRE(!parallel(stray, {}, 64).ok);
+
+    std::string broken = xml;
+    broken.insert(broken.find("<item", xml.size() / 2) + 5, "=");
+    REQUIRE(!parallel(broken, {}, 64).ok);
+}
+
+TEST_CASE(ParallelFormatter_QuietErrorsStillReported) {
+    // Nothing reaches stderr, but lastError() says why run() failed.
+    const std::string xml = sampleDocument();
+    const TokenizerOptions quiet = TestUtil::quiet();
+    const U32 line = static_cast<U32>(std::count(xml.begin(), xml.begin() + xml.find("</name>", xml.size() / 2), '\n') + 1);
+
+    std::string mismatched = xml;
+    mismatched.replace(mismatched.find("</name>", xml.size() / 2), 7, "</nope>");
+    Result r = parallel(mismatched, {}, 64, 3, quiet);
+    REQUIRE(!r.ok);
+    REQUIRE(r.error == TokenizerErrorCode::MismatchedEndTag);
+    REQUIRE_EQ(r.errorLine, line);
+
+    std::string unclosed = xml;
+    unclosed.resize(unclosed.rfind("</catalog>"));
+    r = parallel(unclosed, {}, 64, 3, quiet);
+    REQUIRE(!r.ok);
+    REQUIRE(r.error == TokenizerErrorCode::UnexpectedEOF);
+
+    // Too small to split: the sequential fallback reports it too.
+    r = parallel("<a></b>", {}, 64, 3, quiet);
+    REQUIRE(!r.ok);
+    REQUIRE(r.error == TokenizerErrorCode::MismatchedEndTag);
+
+    r = parallel(xml, {}, 64, 3, quiet);
+    REQUIRE(r.ok);
+    REQUIRE(r.error == TokenizerErrorCode::None);
+}
+
+TEST_CASE(ParallelFormatter_StreamInputIsSequential) {
+    const std::string xml = "<a><b>t</b></a>";
+    std::string in = xml;
+    std::istringstream is(in);
+    auto bis = BufferedInputStream::Create(is, 64);
+    std::string out;
+    auto sink = BufferedOutputStream::CreateString(out, 64);
+    REQUIRE(bis);
+    REQUIRE(sink);
+    ParallelFormatter pf(*sink, {}, ParallelOptions{2, 4, 0});
+    REQUIRE(pf.run(*bis));
+    REQUIRE_EQ(pf.chunks(), 0u);
+    REQUIRE_EQ(out, "<a>\n  <b>t</b>\n</a>\n");
+}
@@ -0,0 +1,79 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "SPSCQueue.h"
+#include <chrono>
+#include <thread>
+
+using namespace LXMLFormatter;
+
+TEST_CASE(SPSCQueue_FullAndEmpty) {
+    SPSCQueue<int, 4> q;
+    int v = 0;
+    REQUIRE(!q.tryPop(v));
+    for (int i = 0; i < 4; ++i) REQUIRE(q.tryPush(int(i)));
+    REQUIRE(!q.tryPush(9));
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(q.tryPop(v));
+        REQUIRE_EQ(v, i);
+    }
+    REQUIRE(!q.tryPop(v));
+}
+
+TEST_CASE(SPSCQueue_CloseDrainsThenStops) {
+    SPSCQueue<int, 4> q;
+    REQUIRE(q.push(1));
+    REQUIRE(q.push(2));
+    q.close();
+    int v = 0;
+    REQUIRE(q.pop(v));
+    REQUIRE_EQ(v, 1);
+    REQUIRE(q.pop(v));
+    REQUIRE_EQ(v, 2);
+    REQUIRE(!q.pop(v));
+}
+
+TEST_CASE(SPSCQueue_TwoThreadsKeepOrder) {
+    SPSCQueue<unsigned, 8> q;
+    constexpr unsigned kCount = 100000;
+    std::thread producer([&q] {
+        for (unsigned i = 0; i < kCount; ++i) q.push(unsigned(i));
+        q.close();
+    });
+    unsigned expected = 0;
+    unsigned v = 0;
+    bool inOrder = true;
+    while (q.pop(v)) inOrder = inOrder && (v == expected++);
+    producer.join();
+    REQUIRE(inOrder);
+    REQUIRE_EQ(expected, kCount);
+}
+
+TEST_CASE(SPSCQueue_ParkedWaitersAreWoken) {
+    // A consumer on an empty queue parks; close() wakes it.
+    SPSCQueue<int, 4> q;
+    bool popped = true;
+    std::thread consumer([&] {
+        int v = 0;
+        popped = q.pop(v);
+    });
+    while (!q.hasWaiter()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    q.close();
+    consumer.join();
+    REQUIRE(!popped);
+    REQUIRE(!q.hasWaiter());
+
+    // A producer on a full queue parks; tryPop() wakes it.
+    SPSCQueue<int, 2> full;
+    REQUIRE(full.tryPush(1));
+    REQUIRE(full.tryPush(2));
+    bool pushed = false;
+    std::thread producer([&] { pushed = full.push(3); });
+    while (!full.hasWaiter()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    int v = 0;
+    REQUIRE(full.tryPop(v));
+    producer.join();
+    REQUIRE(pushed);
+    REQUIRE(full.tryPop(v));
+    REQUIRE(full.tryPop(v));
+    REQUIRE_EQ(v, 3);
+}
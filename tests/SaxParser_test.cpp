@@ -0,0 +1,238 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "SaxParser.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    // One line per event.
+    struct Recorder : SaxHandler {
+        std::string log;
+        void onStartDocument() { log += "doc\n"; }
+        void onStartElement(const SaxName& name, const SaxAttributes& attrs) {
+            log += "<" + std::string(name.text);
+            for (const SaxAttribute& a : attrs) log += " " + std::string(a.name.text) + "=" + std::string(a.value);
+            log += "\n";
+        }
+        void onEndElement(const SaxName& name) { log += "</" + std::string(name.text) + "\n"; }
+        void onText(std::string_view text, bool continued) {
+            log += "'" + std::string(text) + (continued ? "'+\n" : "'\n");
+        }
+        void onCData(std::string_view text, bool continued) {
+            log += "[" + std::string(text) + (continued ? "]+\n" : "]\n");
+        }
+        void onComment(std::string_view text) { log += "!" + std::string(text) + "\n"; }
+        void onProcessingInstruction(std::string_view target, std::string_view data) {
+            log += "?" + std::string(target) + "|" + std::string(data) + "\n";
+        }
+        void onDoctype(std::string_view text) { log += "D" + std::string(text) + "\n"; }
+        void onError(const TokenizerError& e) { log += "error " + std::to_string(static_cast<unsigned>(e.code)) + "\n"; }
+        void onEndDocument() { log += "end\n"; }
+    };
+
+    std::string record(const std::string& xml, size_t bufferSize = 1024, TokenizerOptions opts = quiet()) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, bufferSize);
+        XMLTokenizer tz(*in, opts);
+        Recorder r;
+        SaxParser<Recorder>(tz, r).run();
+        return r.log;
+    }
+}
+
+TEST_CASE(Sax_EventsInDocumentOrder) {
+    const std::string got = record("<r a=\"1\" b=\"two\"><e/><f x=\"y\"/>hi<g>t</g></r>");
+    REQUIRE_EQ(got, std::string("doc\n"
+                                "<r a=1 b=two\n"
+                                "<e\n</e\n"
+                                "<f x=y\n</f\n"
+                                "'hi'\n"
+                                "<g\n't'\n</g\n"
+                                "</r\n"
+                                "end\n"));
+    // A window smaller than a tag: same events.
+    REQUIRE_EQ(record("<r a=\"1\" b=\"two\"><e/><f x=\"y\"/>hi<g>t</g></r>", 4), got);
+}
+
+namespace {
+    // Keeps the attribute views of every open element and checks them at its end.
+    struct StableAttrs : SaxHandler {
+        struct Open {
+            std::string_view name;
+            std::vector<std::pair<std::string_view, std::string>> attrs; // view + copy
+        };
+        std::vector<Open> open;
+        size_t checked = 0;
+        bool   ok = true;
+
+        void onStartElement(const SaxName& name, const SaxAttributes& attrs) {
+            Open o{name.text, {}};
+            for (const SaxAttribute& a : attrs) o.attrs.emplace_back(a.value, std::string(a.value));
+            open.push_back(std::move(o));
+        }
+        void onEndElement(const SaxName& name) {
+            for (const Open& o : open) {
+                for (const auto& a : o.attrs) {
+                    ok = ok && a.first == a.second;
+                    ++checked;
+                }
+            }
+            ok = ok && open.back().name == name.text;
+            open.pop_back();
+        }
+    };
+}
+
+TEST_CASE(Sax_AttributesStayValidUntilTheElementCloses) {
+    std::string xml = "<root id=\"root-value\">";
+    for (int i = 0; i < 50; ++i) {
+        xml += "<item n=\"" + std::to_string(i) + "\" long=\"" + std::string(30, static_cast<char>('a' + i % 26)) +
+               "\"><leaf v=\"" + std::to_string(i * 7) + "\">text</leaf></item>";
+    }
+    xml += "</root>";
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 16); // many refills in between
+    XMLTokenizer tz(*in);
+    StableAttrs h;
+    SaxParser<StableAttrs> sax(tz, h);
+    REQUIRE(sax.run());
+    REQUIRE(h.ok);
+    REQUIRE(h.checked > 200u);
+    REQUIRE(h.open.empty());
+}
+
+namespace {
+    // bool callbacks: stops at the third element.
+    struct StopAtThird : SaxHandler {
+        int starts = 0;
+        int ends = 0;
+        bool onStartElement(const SaxName&, const SaxAttributes&) { return ++starts < 3; }
+        void onEndElement(const SaxName&) { ++ends; }
+    };
+}
+
+TEST_CASE(Sax_CallbackCanStop) {
+    const std::string xml = "<a><b/><c/><d/></a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    XMLTokenizer tz(*in);
+    StopAtThird h;
+    SaxParser<StopAtThird> sax(tz, h);
+    REQUIRE(!sax.run());
+    REQUIRE(sax.stopped());
+    REQUIRE(!sax.failed());
+    REQUIRE_EQ(h.starts, 3);
+    REQUIRE_EQ(h.ends, 1); // only </b>
+}
+
+TEST_CASE(Sax_ErrorsAndPartialStartTags) {
+    REQUIRE_EQ(record("<a><b></a>"), std::string("doc\n<a\n<b\nerror " +
+               std::to_string(static_cast<unsigned>(TokenizerErrorCode::MismatchedEndTag)) + "\n"));
+
+    // An unfinished start tag is not reported as an element.
+    for (const char* cut : {"<a><b x=\"1\"", "<a><b x=\"1", "<a><b x=", "<a><b "}) {
+        const std::string log = record(cut);
+        REQUIRE_EQ(log.substr(0, 7), std::string("doc\n<a\n"));
+        REQUIRE(log.find("<b") == std::string::npos);
+        REQUIRE(log.find("error") != std::string::npos);
+    }
+
+    const std::string xml = "<a></b>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    XMLTokenizer tz(*in, quiet());
+    SaxHandler none;
+    SaxParser<SaxHandler> sax(tz, none);
+    REQUIRE(!sax.run());
+    REQUIRE(sax.failed());
+    REQUIRE(!sax.stopped());
+}
+
+TEST_CASE(Sax_RecoveredErrors) {
+    TokenizerOptions recover = quiet();
+    recover.flags |= TokenizerOptions::RecoverErrors;
+    const std::string mismatch = "error " + std::to_string(static_cast<unsigned>(TokenizerErrorCode::MismatchedEndTag));
+    const std::string quote =
+        "error " + std::to_string(static_cast<unsigned>(TokenizerErrorCode::ExpectedQuoteForAttrValue));
+    // The error first, then the repaired element; the events stay balanced.
+    REQUIRE_EQ(record("<a><b x=1 y='2'>t</a><c/>", 1024, recover),
+               "doc\n<a\n" + quote + "\n<b x= y=2\n't'\n" + mismatch + "\n</b\n</a\n<c\n</c\nend\n");
+    REQUIRE_EQ(record("<a><b x=1 y='2'>t</a><c/>", 4, recover), record("<a><b x=1 y='2'>t</a><c/>", 1024, recover));
+
+    const std::string xml = "<a></b></a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    XMLTokenizer tz(*in, recover);
+    SaxHandler none;
+    SaxParser<SaxHandler> sax(tz, none);
+    REQUIRE(!sax.run());
+    REQUIRE(sax.failed());
+    REQUIRE(tz.state() == State::Content);
+    REQUIRE_EQ(tz.errorCount(), 1u);
+}
+
+namespace {
+    struct ById : SaxHandler {
+        NameId item = 0;
+        NameId key = 0;
+        std::vector<std::string> keys;
+        void onStartElement(const SaxName& name, const SaxAttributes& attrs) {
+            if (name.id != item) return;
+            const SaxAttribute* k = attrs.find(key);
+            REQUIRE(k != nullptr);
+            REQUIRE(k == attrs.find("key"));
+            keys.emplace_back(k->value);
+            REQUIRE(attrs.find("missing") == nullptr);
+            REQUIRE(attrs.find(NameId{0}) == nullptr);
+        }
+    };
+}
+
+TEST_CASE(Sax_InternedIds) {
+    const std::string xml = "<list><item a=\"x\" key=\"k1\"/><other key=\"no\"/><item key=\"k2\"></item></list>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    TokenizerOptions opts;
+    opts.flags |= TokenizerOptions::InternNames;
+    XMLTokenizer tz(*in, opts);
+    ById h;
+    h.item = tz.internName("item", 4);
+    h.key = tz.internName("key", 3);
+    REQUIRE(h.item != 0 && h.key != 0);
+    REQUIRE(SaxParser<ById>(tz, h).run());
+    REQUIRE(h.keys == std::vector<std::string>({"k1", "k2"}));
+}
+
+TEST_CASE(Sax_ChunkedTextPieces) {
+    TokenizerOptions opts = quiet();
+    opts.flags |= TokenizerOptions::ChunkedText;
+    const std::string xml = "<a>" + std::string(40, 'x') + "</a>";
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 1024);
+    TokenizerLimits lims;
+    lims.textChunkBytes = 16;
+    XMLTokenizer tz(*in, opts, lims);
+    Recorder r;
+    REQUIRE(SaxParser<Recorder>(tz, r).run());
+    REQUIRE_EQ(r.log, "doc\n<a\n'" + std::string(16, 'x') + "'+\n'" + std::string(16, 'x') + "'+\n'" +
+                      std::string(8, 'x') + "'\n</a\nend\n");
+}
+
+TEST_CASE(Sax_MarkupCallbacks) {
+    REQUIRE_EQ(record("<?xml version=\"1.0\"?><!DOCTYPE r><r><!-- c --><?go  far away?><?x?><![CDATA[<a>]]></r>"),
+               std::string("doc\n"
+                           "?xml|version=\"1.0\"\n"
+                           "Dr\n"
+                           "<r\n"
+                           "! c \n"
+                           "?go|far away\n"
+                           "?x|\n"
+                           "[<a>]\n"
+                           "</r\n"
+                           "end\n"));
+}
@@ -0,0 +1,222 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "TokenizerPool.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    std::vector<std::string> fresh(const std::string& doc, TokenizerOptions opts = {}) {
+        std::istringstream src(doc);
+        auto in = BufferedInputStream::Create(src, 64u << 10);
+        XMLTokenizer tz(*in, opts);
+        return drain(tz);
+    }
+
+    std::string document(int i) {
+        return "<msg id=\"" + std::to_string(i) + "\">\n  <body>hello " + std::to_string(i) + "</body>\n</msg>";
+    }
+}
+
+TEST_CASE(BufferedInputStream_RebindStartsOver) {
+    std::istringstream first("\xEF\xBB\xBFline1\nline2");
+    auto in = BufferedInputStream::Create(first, 4);
+    REQUIRE(in);
+    REQUIRE(in->getEncoding() == BufferedInputStream::Encoding::UTF8);
+    while (in->peekChar() != -1) in->getChar();
+    REQUIRE_EQ(in->getCurrentLine(), 2u);
+
+    std::istringstream second("ab\ncd");
+    BufferedInputStream::StateError err = BufferedInputStream::StateError::OutOfMemory;
+    REQUIRE(in->rebind(second, &err));
+    REQUIRE(err == BufferedInputStream::StateError::None);
+    REQUIRE(in->getEncoding() == BufferedInputStream::Encoding::UTF8_NO_BOM);
+    REQUIRE_EQ(in->getCurrentLine(), 1u);
+    REQUIRE_EQ(in->getCurrentColumn(), 1u);
+    REQUIRE_EQ(in->getTotalBytesRead(), 0u);
+    std::string got;
+    while (in->peekChar() != -1) got += static_cast<char>(in->getChar());
+    REQUIRE_EQ(got, std::string("ab\ncd"));
+    REQUIRE_EQ(in->getCurrentLine(), 2u);
+
+    // UTF-16 after UTF-8: transcoded again.
+    std::istringstream wide(std::string("\xFF\xFEh\0i\0", 6));
+    REQUIRE(in->rebind(wide));
+    REQUIRE(in->getEncoding() == BufferedInputStream::Encoding::UTF16_LE);
+    REQUIRE_EQ(in->getChar(), 'h');
+    REQUIRE_EQ(in->getChar(), 'i');
+    REQUIRE_EQ(in->peekChar(), -1);
+
+    // And back to plain bytes: the transcoder is gone.
+    std::istringstream plain("x");
+    REQUIRE(in->rebind(plain));
+    REQUIRE(in->getEncoding() == BufferedInputStream::Encoding::UTF8_NO_BOM);
+    REQUIRE_EQ(in->getChar(), 'x');
+    REQUIRE_EQ(in->peekChar(), -1);
+}
+
+TEST_CASE(BufferedInputStream_RebindRefusesMappedAndPrefetched) {
+    const std::string doc = "<a/>";
+    auto view = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(doc.data()), doc.size());
+    std::istringstream other("<b/>");
+    BufferedInputStream::StateError err = BufferedInputStream::StateError::None;
+    REQUIRE(!view->rebind(other, &err));
+    REQUIRE(err == BufferedInputStream::StateError::NotRebindable);
+    REQUIRE_EQ(view->getChar(), '<');
+    REQUIRE_EQ(view->getChar(), 'a'); // unchanged
+
+    std::istringstream src(doc);
+    auto pre = BufferedInputStream::CreatePrefetched(src, 16);
+    REQUIRE(pre);
+    REQUIRE(!pre->rebind(other, &err));
+    REQUIRE(err == BufferedInputStream::StateError::NotRebindable);
+}
+
+TEST_CASE(TokenizerPool_ReuseMatchesFreshPairs) {
+    TokenizerPoolConfig cfg;
+    cfg.bufferSize = 32; // several refills per document
+    cfg.options.flags |= TokenizerOptions::QuietErrors;
+    TokenizerPool pool(cfg);
+
+    for (int i = 0; i < 20; ++i) {
+        // Every third document is malformed; the next one must not see its state.
+        const std::string doc = (i % 3 == 2) ? "<a><b></a>" : document(i);
+        std::istringstream src(doc);
+        TokenizerPool::Lease lease = pool.acquire(src);
+        REQUIRE(lease);
+        REQUIRE(drain(lease.tokenizer()) == fresh(doc, cfg.options));
+        REQUIRE_EQ(lease.tokenizer().errors().empty(), i % 3 != 2);
+    }
+    REQUIRE_EQ(pool.creations(), 1u);
+    REQUIRE_EQ(pool.reuses(), 19u);
+    REQUIRE_EQ(pool.idle(), 1u);
+
+    // Stopping halfway is fine too.
+    {
+        std::istringstream src(document(1));
+        TokenizerPool::Lease lease = pool.acquire(src);
+        XMLToken t;
+        REQUIRE(lease.tokenizer().nextToken(t) && lease.tokenizer().nextToken(t));
+        REQUIRE_EQ(lease.tokenizer().nestingDepth(), 1u);
+    }
+    std::istringstream src(document(2));
+    TokenizerPool::Lease lease = pool.acquire(src);
+    REQUIRE_EQ(lease.tokenizer().nestingDepth(), 0u);
+    REQUIRE(drain(lease.tokenizer()) == fresh(document(2)));
+}
+
+TEST_CASE(TokenizerPool_IdleAndRetainedLimits) {
+    TokenizerPoolConfig cfg;
+    cfg.maxIdle = 2;
+    cfg.maxRetainedBytes = 4096;
+    cfg.options.flags |= TokenizerOptions::QuietErrors; // the large document is cut off
+    TokenizerPool pool(cfg);
+    {
+        std::istringstream a("<a/>"), b("<b/>"), c("<c/>");
+        TokenizerPool::Lease la = pool.acquire(a);
+        TokenizerPool::Lease lb = pool.acquire(b);
+        TokenizerPool::Lease lc = pool.acquire(c);
+        REQUIRE(la && lb && lc);
+        REQUIRE_EQ(pool.creations(), 3u);
+        TokenizerPool::Lease moved = std::move(lb);
+        REQUIRE(!lb);
+        REQUIRE(moved);
+    }
+    REQUIRE_EQ(pool.idle(), 2u); // the third pair was destroyed
+
+    // A large document: its tokenizer memory is given back, not kept idle.
+    std::string big = "<r>";
+    for (int i = 0; i < 500; ++i) big += "<e" + std::to_string(i) + " k=\"" + std::string(40, 'v') + "\">";
+    std::istringstream src(big);
+    XMLTokenizer* tz = nullptr;
+    {
+        TokenizerPool::Lease lease = pool.acquire(src);
+        tz = &lease.tokenizer();
+        drain(*tz);
+        REQUIRE(tz->memoryInUse() > cfg.maxRetainedBytes);
+    }
+    REQUIRE_EQ(tz->memoryInUse(), 0u); // still pooled, now empty
+
+    pool.clear();
+    REQUIRE_EQ(pool.idle(), 0u);
+    std::istringstream again("<a/>");
+    REQUIRE(pool.acquire(again));
+    REQUIRE_EQ(pool.creations(), 4u);
+}
+
+TEST_CASE(TokenizerPool_InternedNames) {
+    TokenizerPoolConfig cfg;
+    cfg.options.flags |= TokenizerOptions::InternNames;
+    cfg.limits.maxInternedNames = 16;
+    // Ids of the names of "<known a='1'/>".
+    const auto ids = [](TokenizerPool& pool) {
+        std::istringstream src("<known a='1'/>");
+        TokenizerPool::Lease lease = pool.acquire(src);
+        std::vector<NameId> out;
+        XMLToken t;
+        while (lease.tokenizer().nextToken(t)) {
+            if (t.type == XMLTokenType::StartTag || t.type == XMLTokenType::AttributeName) out.push_back(t.nameId);
+        }
+        return out;
+    };
+    std::string hostile = "<r>";
+    for (int i = 0; i < 40; ++i) hostile += "<n" + std::to_string(i) + "/>";
+    hostile += "</r>";
+
+    // Default: every lease starts with an empty table.
+    TokenizerPool pool(cfg);
+    {
+        std::istringstream src(hostile);
+        TokenizerPool::Lease lease = pool.acquire(src);
+        drain(lease.tokenizer());
+        REQUIRE_EQ(lease.tokenizer().names().size(), 16u);
+    }
+    REQUIRE(ids(pool) == std::vector<NameId>({1, 2}));
+    REQUIRE_EQ(pool.creations(), 1u);
+
+    // keepNames: ids stay, and so does a full table.
+    cfg.keepNames = true;
+    TokenizerPool keeping(cfg);
+    REQUIRE(ids(keeping) == std::vector<NameId>({1, 2}));
+    {
+        std::istringstream src(hostile);
+        TokenizerPool::Lease lease = keeping.acquire(src);
+        REQUIRE_EQ(lease.tokenizer().internName("known", 5), 1u);
+        drain(lease.tokenizer());
+    }
+    REQUIRE(ids(keeping) == std::vector<NameId>({1, 2}));
+
+    // The table counts toward maxRetainedBytes; over it, it is freed even so.
+    cfg.maxRetainedBytes = 0;
+    TokenizerPool tight(cfg);
+    XMLTokenizer* tz = nullptr;
+    {
+        std::istringstream src(hostile);
+        TokenizerPool::Lease lease = tight.acquire(src);
+        tz = &lease.tokenizer();
+        drain(*tz);
+    }
+    REQUIRE_EQ(tz->names().size(), 0u);
+    REQUIRE_EQ(tz->names().memoryBytes(), 0u);
+}
+
+TEST_CASE(TokenizerPool_ThreadLocal) {
+    TokenizerPool& pool = TokenizerPool::threadLocal();
+    REQUIRE(&pool == &TokenizerPool::threadLocal());
+    const std::size_t before = pool.creations() + pool.reuses();
+    for (int i = 0; i < 3; ++i) {
+        std::istringstream src(document(i));
+        auto lease = pool.acquire(src);
+        REQUIRE(drain(lease.tokenizer()) == fresh(document(i)));
+    }
+    REQUIRE_EQ(pool.creations() + pool.reuses(), before + 3);
+    REQUIRE(pool.idle() >= 1u);
+}
@@ -0,0 +1,185 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include <sstream>
+#include <string>
+
+using namespace LXMLFormatter;
+
+namespace {
+    size_t drain(XMLTokenizer& tz) {
+        XMLToken t;
+        size_t n = 0;
+        while (tz.nextToken(t)) ++n;
+        return n;
+    }
+
+    bool contains(const std::string& s, const std::string& needle) {
+        return s.find(needle) != std::string::npos;
+    }
+
+    // 'passes' times: 100 nested elements with 60-byte names (about 6 KB of open
+    // tag data, more than the first 4 KB arena chunk), then close them all.
+    std::string deepDocument(int passes) {
+        const std::string name(60, 'n');
+        std::string s = "<r>";
+        for (int p = 0; p < passes; ++p) {
+            for (int i = 0; i < 100; ++i) s += "<" + name + ">";
+            for (int i = 0; i < 100; ++i) s += "</" + name + ">";
+        }
+        return s + "</r>";
+    }
+}
+
+TEST_CASE(TokenizerStats_InputCountersAlwaysOn) {
+    const std::string xml = "<doc><a>some text here</a><b x=\"1\">more text</b></doc>";
+    std::istringstream is(xml);
+    auto in = BufferedInputStream::Create(is, 16);
+    REQUIRE(in);
+    XMLTokenizer tz(*in, TokenizerOptions{}, TokenizerLimits{});
+    drain(tz);
+
+    const TokenizerStats s = tz.stats();
+    REQUIRE_EQ(s.bytesConsumed, xml.size());
+    REQUIRE_EQ(s.inputBytesRead, xml.size());
+    REQUIRE(s.inputRefills > 0);
+    REQUIRE(s.inputBytesMoved > 0);   // tails left at the end of a 16-byte window
+    REQUIRE(s.maxTextArena > 0);
+    REQUIRE(s.tagChunkAllocs >= 1);
+}
+
+TEST_CASE(TokenizerStats_MappedViewNeverRefills) {
+    const std::string xml = "<doc><a>text</a></doc>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    drain(tz);
+    const TokenizerStats s = tz.stats();
+    REQUIRE_EQ(s.bytesConsumed, xml.size());
+    REQUIRE_EQ(s.inputRefills, 0u);
+    REQUIRE_EQ(s.inputBytesMoved, 0u);
+}
+
+TEST_CASE(TokenizerStats_TagArenaFreelist) {
+    const std::string xml = deepDocument(3);
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    drain(tz);
+    const TokenizerStats s = tz.stats();
+    REQUIRE_EQ(s.tagChunkAllocs, 2u);      // 4 KB first chunk, then one 8 KB chunk
+    REQUIRE(s.tagChunkReuses >= 2u);       // later passes find the second chunk retained
+    REQUIRE(s.maxTagArena >= 12u * 1024u);
+}
+
+TEST_CASE(TokenizerStats_DumpFormats) {
+    const std::string xml = "<doc><a>text</a></doc>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    drain(tz);
+    const TokenizerStats s = tz.stats();
+
+    std::ostringstream json;
+    s.writeJson(json);
+    const std::string j = json.str();
+    REQUIRE_EQ(j.front(), '{');
+    REQUIRE_EQ(j.back(), '}');
+    REQUIRE(contains(j, "\"bytesConsumed\":" + std::to_string(xml.size()) + ","));
+    REQUIRE(contains(j, "\"enabled\":" + std::string(TokenizerStats::enabled ? "true" : "false")));
+    REQUIRE(contains(j, "\"StartTag\":"));
+
+    std::ostringstream prom;
+    s.writePrometheus(prom);
+    const std::string p = prom.str();
+    REQUIRE(contains(p, "# TYPE lxml_tokenizer_bytes_consumed_total counter\n"));
+    REQUIRE(contains(p, "\nlxml_tokenizer_bytes_consumed_total " + std::to_string(xml.size()) + "\n"));
+    REQUIRE(contains(p, "lxml_tokenizer_tokens_total{type=\"Text\"} "));
+
+    std::ostringstream custom;
+    s.writePrometheus(custom, "xf");
+    REQUIRE(contains(custom.str(), "\nxf_input_refills_total 0\n"));
+}
+
+#if defined(LXML_ENABLE_STATS)
+TEST_CASE(TokenizerStats_TokenCountsAndDepth) {
+    const std::string xml = "<a><b k=\"v\">t</b><c/></a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    const size_t n = drain(tz);
+    const TokenizerStats s = tz.stats();
+    auto count = [&](XMLTokenType t) { return s.tokensByType[static_cast<size_t>(t)]; };
+    REQUIRE_EQ(s.tokensEmitted, n);
+    REQUIRE_EQ(count(XMLTokenType::StartTag), 3u);
+    REQUIRE_EQ(count(XMLTokenType::EndTag), 2u);
+    REQUIRE_EQ(count(XMLTokenType::EmptyTag), 1u);
+    REQUIRE_EQ(count(XMLTokenType::AttributeName), 1u);
+    REQUIRE_EQ(count(XMLTokenType::AttributeValue), 1u);
+    REQUIRE_EQ(count(XMLTokenType::Text), 1u);
+    REQUIRE_EQ(count(XMLTokenType::DocumentStart), 1u);
+    REQUIRE_EQ(count(XMLTokenType::DocumentEnd), 1u);
+    REQUIRE_EQ(s.errorsEmitted, 0u);
+    REQUIRE_EQ(s.maxOpenDepth, 2u);
+    REQUIRE_EQ(s.stateSamples[static_cast<size_t>(State::Content)], 0u); // timing is off by default
+}
+
+TEST_CASE(TokenizerStats_ErrorsAndReset) {
+    const std::string xml = "<a></b>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    TokenizerOptions opts;
+    opts.flags |= TokenizerOptions::QuietErrors;
+    XMLTokenizer tz(*in, opts);
+    drain(tz);
+    REQUIRE_EQ(tz.stats().errorsEmitted, 1u);
+    tz.reset();
+    REQUIRE_EQ(tz.stats().tokensEmitted, 0u);
+    REQUIRE_EQ(tz.stats().errorsEmitted, 0u);
+}
+
+TEST_CASE(TokenizerStats_SampledStateTiming) {
+    const std::string xml = deepDocument(1);
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    tz.setStateTiming(1);
+    drain(tz);
+    TokenizerStats s = tz.stats();
+    REQUIRE_EQ(s.timingEvery, 1u);
+    REQUIRE(s.stateSamples[static_cast<size_t>(State::Content)] > 0);
+    REQUIRE_EQ(s.stateSamples[static_cast<size_t>(State::StartTagName)], 101u);
+    REQUIRE_EQ(s.stateSamples[static_cast<size_t>(State::EndTagName)], 101u);
+
+    std::ostringstream json;
+    s.writeJson(json);
+    REQUIRE(contains(json.str(), "\"StartTagName\":{\"ticks\":"));
+
+    // Every 4th call: about a quarter of the tag-name visits.
+    in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    XMLTokenizer sampled(*in);
+    sampled.setStateTiming(4);
+    drain(sampled);
+    s = sampled.stats();
+    const U64 names = s.stateSamples[static_cast<size_t>(State::StartTagName)] +
+                      s.stateSamples[static_cast<size_t>(State::EndTagName)];
+    REQUIRE(names > 0 && names < 101u);
+}
+#else
+TEST_CASE(TokenizerStats_HotCountersOffByDefault) {
+    const std::string xml = "<a>t</a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    tz.setStateTiming(1);
+    drain(tz);
+    const TokenizerStats s = tz.stats();
+    REQUIRE(!TokenizerStats::enabled);
+    REQUIRE_EQ(s.tokensEmitted, 0u);
+    REQUIRE_EQ(s.stateSamples[static_cast<size_t>(State::Content)], 0u);
+    REQUIRE_EQ(s.bytesConsumed, xml.size());
+}
+#endif
@@ -0,0 +1,110 @@
+// Helpers shared by the tests.
+
+#ifndef LXMLFORMATTER_TOKENIZERTESTUTIL_H
+#define LXMLFORMATTER_TOKENIZERTESTUTIL_H
+
+#include "BufferedInputStream.h"
+#include "BufferedOutputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "XMLFormatter.h"
+#include "PipelinedFormatter.h"
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace TestUtil {
+    using namespace LXMLFormatter;
+
+    // Default options, errors not logged to stderr.
+    inline TokenizerOptions quiet(U32 extra = 0) {
+        TokenizerOptions o;
+        o.flags |= TokenizerOptions::QuietErrors | extra;
+        return o;
+    }
+
+    // A token with its bytes copied while they are still valid.
+    struct Tok {
+        XMLTokenType type;
+        std::string  text;
+        U64          offset    = 0;
+        bool         slice     = false;
+        bool         continued = false;
+    };
+
+    inline Tok copy(const XMLToken& t) {
+        return {t.type, t.data ? std::string(t.data, t.length) : std::string(), t.byteOffset, t.isInputSlice(),
+                t.isContinued()};
+    }
+
+    inline std::vector<Tok> collect(XMLTokenizer& tz) {
+        std::vector<Tok> out;
+        XMLToken t;
+        while (tz.nextToken(t)) out.push_back(copy(t));
+        return out;
+    }
+
+    // One line per token: type, byte offset, line:column, name id and bytes.
+    inline std::string describe(const XMLToken& t) {
+        std::string s = std::to_string(static_cast<unsigned>(t.type)) + " " + std::to_string(t.byteOffset) + " " +
+                        std::to_string(t.line) + ":" + std::to_string(t.column) + " " +
+                        std::to_string(t.nameId) + " ";
+        if (t.data) s.append(t.data, t.length);
+        return s;
+    }
+
+    // describe() lines of the rest of the document; DocumentStart is left out
+    // unless 'withDocumentStart' (a resumed run has none).
+    inline std::vector<std::string> drain(XMLTokenizer& tz, bool withDocumentStart = true) {
+        std::vector<std::string> out;
+        XMLToken t;
+        while (tz.nextToken(t)) {
+            if (withDocumentStart || t.type != XMLTokenType::DocumentStart) out.push_back(describe(t));
+        }
+        return out;
+    }
+
+    // Formats all of 'in' with default options, on this thread or through the
+    // pipeline; the output goes to 'out'. Returns what run() returned.
+    inline bool format(BufferedInputStream& in, bool pipelined, std::string& out) {
+        auto sink = BufferedOutputStream::CreateString(out, 64);
+        if (!sink) return false;
+        if (pipelined) {
+            PipelinedFormatter pf(*sink, FormatterOptions{}, PipelineOptions{}, quiet());
+            return pf.run(in);
+        }
+        XMLTokenizer tz(in, quiet());
+        XMLFormatter fmt(*sink, FormatterOptions{});
+        return fmt.run(tz);
+    }
+
+    // A fresh file under /tmp holding 'content'; deleted with the object. False
+    // (and an empty path) if it could not be created.
+    class TempFile {
+    public:
+        explicit TempFile(const std::string& content = std::string()) {
+            char path[] = "/tmp/lxml_test_XXXXXX";
+            const int fd = ::mkstemp(path);
+            if (fd < 0) return;
+            ::close(fd);
+            path_ = path;
+            std::ofstream f(path_, std::ios::binary);
+            f.write(content.data(), static_cast<std::streamsize>(content.size()));
+        }
+        ~TempFile() {
+            if (!path_.empty()) ::unlink(path_.c_str());
+        }
+        TempFile(const TempFile&)            = delete;
+        TempFile& operator=(const TempFile&) = delete;
+
+        explicit operator bool() const noexcept { return !path_.empty(); }
+        const std::string& path() const noexcept { return path_; }
+
+    private:
+        std::string path_;
+    };
+}
+
+#endif // LXMLFORMATTER_TOKENIZERTESTUTIL_H
@@ -0,0 +1,190 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "TranscodingStreamBuf.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+
+#if defined(LXML_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+using namespace LXMLFormatter;
+using TestUtil::TempFile;
+using Encoding = BufferedInputStream::Encoding;
+
+namespace {
+    // ASCII runs long enough for the vector path, plus 2-, 3- and 4-byte UTF-8
+    // (the last one a surrogate pair in UTF-16).
+    std::string sampleText() {
+        std::string s = "<?xml version=\"1.0\"?>\n<r>";
+        for (int i = 0; i < 400; ++i) {
+            s += "<i n=\"" + std::to_string(i) + "\">caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 plain ascii text</i>\r\n";
+        }
+        return s + "</r>\n";
+    }
+
+    // Re-encodes UTF-8 'text' as 'enc', with or without a BOM.
+    std::string encode(const std::string& text, Encoding enc, bool bom) {
+        const bool be = enc == Encoding::UTF16_BE || enc == Encoding::UTF32_BE;
+        const bool wide = enc == Encoding::UTF32_LE || enc == Encoding::UTF32_BE;
+        std::string out;
+        auto unit = [&](uint32_t u) {
+            const int bytes = wide ? 4 : 2;
+            for (int i = 0; i < bytes; ++i) {
+                const int shift = 8 * (be ? bytes - 1 - i : i);
+                out += static_cast<char>((u >> shift) & 0xFF);
+            }
+        };
+        if (bom) unit(0xFEFF);
+        const auto* p = reinterpret_cast<const uint8_t*>(text.data());
+        for (std::size_t i = 0; i < text.size();) {
+            const auto r = UTF8Handler::decode(p + i, text.size() - i);
+            i += r.width;
+            if (!wide && r.cp >= 0x10000) {
+                unit(0xD800 + ((r.cp - 0x10000) >> 10));
+                unit(0xDC00 + ((r.cp - 0x10000) & 0x3FF));
+            } else {
+                unit(r.cp);
+            }
+        }
+        return out;
+    }
+
+    std::string drain(BufferedInputStream& in) {
+        std::string out;
+        in.readWhile(out, [](int32_t) { return true; });
+        return out;
+    }
+
+    const Encoding kWide[] = { Encoding::UTF16_LE, Encoding::UTF16_BE, Encoding::UTF32_LE, Encoding::UTF32_BE };
+}
+
+TEST_CASE(Transcode_SniffsBomAndPattern) {
+    size_t bom = 0;
+    auto sniff = [&](std::initializer_list<uint8_t> b) {
+        const std::string s(b.begin(), b.end());
+        return BufferedInputStream::sniffEncoding(reinterpret_cast<const uint8_t*>(s.data()), s.size(), bom);
+    };
+    REQUIRE(sniff({0xEF, 0xBB, 0xBF, '<'}) == Encoding::UTF8);       REQUIRE_EQ(bom, 3u);
+    REQUIRE(sniff({0xFF, 0xFE, 0x00, 0x00}) == Encoding::UTF32_LE);  REQUIRE_EQ(bom, 4u);
+    REQUIRE(sniff({0x00, 0x00, 0xFE, 0xFF}) == Encoding::UTF32_BE);  REQUIRE_EQ(bom, 4u);
+    REQUIRE(sniff({0xFF, 0xFE, '<', 0x00}) == Encoding::UTF16_LE);   REQUIRE_EQ(bom, 2u);
+    REQUIRE(sniff({0xFE, 0xFF}) == Encoding::UTF16_BE);              REQUIRE_EQ(bom, 2u);
+    REQUIRE(sniff({'<', 0x00, '?', 0x00}) == Encoding::UTF16_LE);    REQUIRE_EQ(bom, 0u);
+    REQUIRE(sniff({0x00, '<', 0x00, 'r'}) == Encoding::UTF16_BE);
+    REQUIRE(sniff({'<', 0x00, 0x00, 0x00}) == Encoding::UTF32_LE);
+    REQUIRE(sniff({0x00, 0x00, 0x00, '<'}) == Encoding::UTF32_BE);
+    REQUIRE(sniff({'<', '?', 'x', 'm'}) == Encoding::UTF8_NO_BOM);
+    REQUIRE(sniff({'<'}) == Encoding::UTF8_NO_BOM);
+}
+
+TEST_CASE(Transcode_StreamsMatchUtf8) {
+    const std::string text = sampleText();
+    for (Encoding enc : kWide) {
+        for (bool bom : {true, false}) {
+            const std::string raw = encode(text, enc, bom);
+            for (size_t buf : {size_t(5), size_t(4096)}) {
+                std::istringstream a(raw);
+                auto in = BufferedInputStream::Create(a, buf);
+                REQUIRE(in);
+                REQUIRE(in->getEncoding() == enc);
+                REQUIRE_EQ(drain(*in), text);
+                REQUIRE(!in->sourceFailed());
+
+                std::istringstream b(raw);
+                auto pre = BufferedInputStream::CreatePrefetched(b, buf);
+                REQUIRE(pre);
+                REQUIRE_EQ(drain(*pre), text);
+            }
+        }
+    }
+}
+
+TEST_CASE(Transcode_MappedFileGoesThroughStream) {
+    const std::string text = sampleText();
+    for (Encoding enc : kWide) {
+        const TempFile file(encode(text, enc, true));
+        REQUIRE(file);
+        auto in = BufferedInputStream::CreateMapped(file.path());
+        REQUIRE(in);
+        REQUIRE(!in->isMapped());
+        REQUIRE(in->getEncoding() == enc);
+        REQUIRE_EQ(drain(*in), text);
+    }
+}
+
+TEST_CASE(Transcode_PositionsAreUtf8) {
+    // "<a>é</a>" in UTF-16LE: the closing tag starts at UTF-8 byte 5.
+    std::istringstream is(encode("<a>\xC3\xA9</a>", Encoding::UTF16_LE, true));
+    auto in = BufferedInputStream::Create(is, 64);
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    XMLToken t;
+    REQUIRE(tz.nextToken(t)); // DocumentStart
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::Text);
+    REQUIRE_EQ(std::string(t.data, t.length), "\xC3\xA9");
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+    REQUIRE_EQ(t.byteOffset, 5u);
+}
+
+TEST_CASE(Transcode_InvalidUnitsStopAndFail) {
+    auto check = [](const std::string& raw, const std::string& expectPrefix) {
+        std::istringstream is(raw);
+        auto in = BufferedInputStream::Create(is, 16);
+        REQUIRE(in);
+        REQUIRE_EQ(drain(*in), expectPrefix);
+        REQUIRE(in->sourceFailed());
+    };
+    // Lone low surrogate, high surrogate followed by ASCII, odd trailing byte.
+    check(encode("<a>", Encoding::UTF16_LE, true) + std::string("\x00\xDC", 2), "<a>");
+    check(encode("<a>", Encoding::UTF16_BE, true) + std::string("\xD8\x00\x00\x41", 4), "<a>");
+    check(encode("<a>", Encoding::UTF16_LE, true) + std::string("x"), "<a>");
+    // UTF-32 beyond U+10FFFF.
+    check(encode("<a>", Encoding::UTF32_LE, true) + std::string("\x00\x00\x11\x00", 4), "<a>");
+}
+
+TEST_CASE(Transcode_BadUnitAfterTheDocumentFails) {
+    // The root element is complete, so the formatters succeed; the stream still
+    // reports the lone high surrogate or odd byte that follows it.
+    const std::string doc = encode("<r><a>one</a></r>\n", Encoding::UTF16_LE, true);
+    for (const std::string& tail : {std::string("\x00\xD8", 2), std::string("x")}) {
+        for (bool pipelined : {false, true}) {
+            std::istringstream is(doc + tail);
+            auto in = BufferedInputStream::Create(is, 16);
+            REQUIRE(in);
+            std::string out;
+            REQUIRE(TestUtil::format(*in, pipelined, out));
+            REQUIRE(out.find("one") != std::string::npos);
+            REQUIRE(in->sourceFailed());
+        }
+    }
+}
+
+#if defined(LXML_HAVE_ZLIB)
+TEST_CASE(Transcode_CompressedUtf16) {
+    const std::string text = sampleText();
+    const std::string raw = encode(text, Encoding::UTF16_BE, true);
+    z_stream z{};
+    REQUIRE(deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string gz(deflateBound(&z, static_cast<uLong>(raw.size())) + 32, '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(raw.data()));
+    z.avail_in = static_cast<uInt>(raw.size());
+    z.next_out = reinterpret_cast<Bytef*>(&gz[0]);
+    z.avail_out = static_cast<uInt>(gz.size());
+    deflate(&z, Z_FINISH);
+    gz.resize(z.total_out);
+    deflateEnd(&z);
+
+    std::istringstream is(gz);
+    auto in = BufferedInputStream::CreateDecompressed(is, 1000, true);
+    REQUIRE(in);
+    REQUIRE(in->getCompression() == BufferedInputStream::Compression::Gzip);
+    REQUIRE(in->getEncoding() == Encoding::UTF16_BE);
+    REQUIRE_EQ(drain(*in), text);
+    REQUIRE(!in->sourceFailed());
+}
+#endif
@@ -1118,4 +1118,115 @@ TEST_CASE(UTF8_Encode_RoundTrip_Sweep) {
         REQUIRE_EQ(dr.status, UTF8Handler::DecodeStatus::Ok);
         REQUIRE_EQ(dr.cp, cp);
     }
-}
\ No newline at end of file
+}
+// ------------------------------
+// Bulk validation / ASCII runs
+// ------------------------------
+static UTF8Handler::ValidateResult referenceValidate(const uint8_t* p, std::size_t n) {
+    UTF8Handler::ValidateResult res;
+    std::size_t i = 0;
+    while (i < n) {
+        const auto r = UTF8Handler::decode(p + i, n - i);
+        if (r.status != S::Ok) {
+            res.validBytes = i;
+            res.status = r.status;
+            return res;
+        }
+        i += r.width;
+    }
+    res.validBytes = n;
+    res.status = S::Ok;
+    return res;
+}
+
+static void appendUtf8(std::vector<uint8_t>& v, uint32_t cp) {
+    uint8_t tmp[4];
+    const auto e = UTF8Handler::encode(cp, tmp);
+    v.insert(v.end(), tmp, tmp + e.width);
+}
+
+TEST_CASE(UTF8Handler_Validate_BasicStatuses) {
+    const uint8_t ok[] = {'a', 0xC3, 0xA9, 0xE2, 0x82, 0xAC, 0xF0, 0x9F, 0x8C, 0x8D};
+    auto r = UTF8Handler::validate(ok, sizeof(ok));
+    REQUIRE_EQ(r.status, S::Ok);
+    REQUIRE_EQ(r.validBytes, sizeof(ok));
+
+    // Truncated 3-byte sequence at the end -> NeedMore at its lead byte.
+    r = UTF8Handler::validate(ok, 5);
+    REQUIRE_EQ(r.status, S::NeedMore);
+    REQUIRE_EQ(r.validBytes, 3u);
+
+    const uint8_t overlong[] = {'x', 'y', 0xC0, 0xAF};
+    r = UTF8Handler::validate(overlong, sizeof(overlong));
+    REQUIRE_EQ(r.status, S::Invalid);
+    REQUIRE_EQ(r.validBytes, 2u);
+
+    const uint8_t surrogate[] = {'x', 0xED, 0xA0, 0x80};
+    r = UTF8Handler::validate(surrogate, sizeof(surrogate));
+    REQUIRE_EQ(r.status, S::Invalid);
+    REQUIRE_EQ(r.validBytes, 1u);
+
+    r = UTF8Handler::validate(ok, 0);
+    REQUIRE_EQ(r.status, S::Ok);
+    REQUIRE_EQ(r.validBytes, 0u);
+}
+
+TEST_CASE(UTF8Handler_Validate_ErrorsInLaterBlocksMatchReference) {
+    // Long mostly-ASCII buffers so the 32-byte block path runs; each known-bad
+    // pattern is placed at every offset, including across block boundaries.
+    const std::vector<std::vector<uint8_t>> bad = {
+        {0x80},                   // stray continuation
+        {0xC2, 'a'},              // too short
+        {0xC1, 0xBF},             // overlong 2-byte
+        {0xE0, 0x9F, 0xBF},       // overlong 3-byte
+        {0xED, 0xBF, 0xBF},       // surrogate
+        {0xF0, 0x8F, 0xBF, 0xBF}, // overlong 4-byte
+        {0xF4, 0x90, 0x80, 0x80}, // > U+10FFFF
+        {0xF5, 0x80, 0x80, 0x80}, // invalid lead
+        {0xE2, 0x82},             // truncated, then ASCII
+        {0xFF},
+    };
+    for (const auto& pattern : bad) {
+        for (std::size_t at = 0; at < 140; ++at) {
+            std::vector<uint8_t> v;
+            while (v.size() < at) {
+                if (v.size() % 11 == 5) appendUtf8(v, 0x20AC); else v.push_back('q');
+            }
+            v.insert(v.end(), pattern.begin(), pattern.end());
+            while (v.size() < 200) v.push_back('z');
+
+            const auto ref = referenceValidate(v.data(), v.size());
+            const auto got = UTF8Handler::validate(v.data(), v.size());
+            REQUIRE_EQ(got.status, ref.status);
+            REQUIRE_EQ(got.validBytes, ref.validBytes);
+        }
+    }
+}
+
+TEST_CASE(UTF8Handler_Validate_RandomMatchesReference) {
+    std::mt19937 rng(2024);
+    const uint32_t samples[] = {'a', '<', 0xE9, 0x3C0, 0x20AC, 0xFFFD, 0x1F30D, 0x10FFFF};
+    for (int iter = 0; iter < 400; ++iter) {
+        std::vector<uint8_t> v;
+        const std::size_t len = rng() % 300;
+        while (v.size() < len) appendUtf8(v, samples[rng() % 8]);
+        if (iter % 3 == 0 && !v.empty()) {
+            v[rng() % v.size()] = static_cast<uint8_t>(rng()); // random corruption
+        }
+        const auto ref = referenceValidate(v.data(), v.size());
+        const auto got = UTF8Handler::validate(v.data(), v.size());
+        REQUIRE_EQ(got.status, ref.status);
+        REQUIRE_EQ(got.validBytes, ref.validBytes);
+    }
+}
+
+TEST_CASE(UTF8Handler_AsciiPrefixLength) {
+    std::vector<uint8_t> v(100, 'a');
+    REQUIRE_EQ(UTF8Handler::asciiPrefixLength(v.data(), v.size()), 100u);
+    for (std::size_t at : {0u, 1u, 15u, 16u, 31u, 32u, 63u, 64u, 99u}) {
+        std::vector<uint8_t> w(v);
+        w[at] = 0xC3;
+        REQUIRE_EQ(UTF8Handler::asciiPrefixLength(w.data(), w.size()), at);
+    }
+    REQUIRE_EQ(UTF8Handler::asciiPrefixLength(v.data(), 0), 0u);
+}
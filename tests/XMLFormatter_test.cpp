@@ -0,0 +1,253 @@
+#define NO_UT_MAIN
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "BufferedOutputStream.h"
+#include "XMLTokenizer.h"
+#include "XMLFormatter.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+
+using namespace LXMLFormatter;
+using TestUtil::TempFile;
+
+namespace {
+    // Formats 'xml' and returns the output; 'ok' receives run()'s result.
+    std::string format(const std::string& xml, FormatterOptions fopts = {}, bool* ok = nullptr,
+                       size_t inBuf = 1024, size_t outBuf = 1024,
+                       TokenizerOptions topts = {}, TokenizerLimits lims = {}) {
+        std::istringstream in(xml);
+        std::ostringstream os;
+        auto bis = BufferedInputStream::Create(in, inBuf);
+        auto out = BufferedOutputStream::Create(os, outBuf);
+        if (!bis || !out) return {};
+        XMLTokenizer tz(*bis, topts, lims);
+        XMLFormatter fmt(*out, fopts);
+        const bool r = fmt.run(tz);
+        if (ok) *ok = r;
+        out->flush();
+        return os.str();
+    }
+
+    // Same, but through a mapped temp file (minify takes the pass-through path).
+    std::string formatMapped(const std::string& xml, FormatterOptions fopts = {}, bool* ok = nullptr,
+                             TokenizerOptions topts = {}, TokenizerLimits lims = {}) {
+        const TempFile file(xml);
+        if (!file) return {};
+        std::ostringstream os;
+        {
+            auto bis = BufferedInputStream::CreateMapped(file.path());
+            auto out = BufferedOutputStream::Create(os, 64);
+            if (bis && out) {
+                XMLTokenizer tz(*bis, topts, lims);
+                XMLFormatter fmt(*out, fopts);
+                const bool r = fmt.run(tz);
+                if (ok) *ok = r;
+            }
+        }
+        return os.str();
+    }
+}
+
+TEST_CASE(XMLFormatter_IndentsNestedElements) {
+    bool ok = false;
+    const std::string got = format("<a><b><c/></b>\n   <d x='1' y=\"2\">t</d></a>", {}, &ok);
+    REQUIRE(ok);
+    REQUIRE_EQ(got,
+        "<a>\n"
+        "  <b>\n"
+        "    <c/>\n"
+        "  </b>\n"
+        "  <d x=\"1\" y=\"2\">t</d>\n"
+        "</a>\n");
+}
+
+TEST_CASE(XMLFormatter_TabsAndWidth) {
+    FormatterOptions tabs;
+    tabs.useTabs = true;
+    REQUIRE_EQ(format("<a><b/></a>", tabs), "<a>\n\t<b/>\n</a>\n");
+
+    FormatterOptions four;
+    four.indentWidth = 4;
+    REQUIRE_EQ(format("<a><b/></a>", four), "<a>\n    <b/>\n</a>\n");
+}
+
+TEST_CASE(XMLFormatter_MixedContentInline) {
+    REQUIRE_EQ(format("<p>one <b>two</b> <i>three</i></p>"),
+               "<p>one <b>two</b> <i>three</i></p>\n");
+    REQUIRE_EQ(format("<a><e></e></a>"), "<a>\n  <e></e>\n</a>\n");
+}
+
+TEST_CASE(XMLFormatter_QuoteInSingleQuotedValue) {
+    REQUIRE_EQ(format("<a v='say \"hi\"'/>"), "<a v=\"say &quot;hi&quot;\"/>\n");
+}
+
+TEST_CASE(XMLFormatter_DeepDocumentSmallBuffers) {
+    // Indentation deeper than the precomputed levels and an output buffer
+    // smaller than one indent.
+    const int depth = 100;
+    std::string xml, expected;
+    for (int i = 0; i < depth; ++i) {
+        xml += "<n>";
+        expected += std::string(i ? 1 : 0, '\n') + std::string(static_cast<size_t>(i) * 2, ' ') + "<n>";
+    }
+    expected += "</n>";
+    for (int i = depth - 1; i > 0; --i) {
+        xml += "</n>";
+        expected += "\n" + std::string(static_cast<size_t>(i - 1) * 2, ' ') + "</n>";
+    }
+    xml += "</n>";
+    expected += "\n";
+    bool ok = false;
+    REQUIRE_EQ(format(xml, {}, &ok, 16, 16), expected);
+    REQUIRE(ok);
+}
+
+TEST_CASE(XMLFormatter_ErrorStops) {
+    bool ok = true;
+    format("<a><b></a>", {}, &ok);
+    REQUIRE(!ok);
+}
+
+TEST_CASE(XMLFormatter_RecoveredErrors) {
+    TokenizerOptions recover;
+    recover.flags |= TokenizerOptions::QuietErrors | TokenizerOptions::RecoverErrors;
+    bool ok = true;
+    // Formatted on past the errors, still well-formed; run() reports them.
+    REQUIRE_EQ(format("<a><b x=1 y='2'></a><c>t</c>", {}, &ok, 1024, 1024, recover),
+               "<a>\n  <b x=\"\" y=\"2\"></b>\n</a>\n<c>t</c>\n");
+    REQUIRE(!ok);
+
+    // Minify of mapped input does not copy the broken source through.
+    FormatterOptions m;
+    m.minify = true;
+    ok = true;
+    REQUIRE_EQ(formatMapped("<a>\n <b></c>\n</a>", m, &ok, recover), "<a><b></b></a>");
+    REQUIRE(!ok);
+}
+
+TEST_CASE(XMLFormatter_MinifyStream) {
+    FormatterOptions m;
+    m.minify = true;
+    bool ok = false;
+    REQUIRE_EQ(format("\n<a>\n  <b x='1'> </b>\n  <p>one <i>two</i> </p>\n</a>\n", m, &ok),
+               "<a><b x=\"1\"></b><p>one <i>two</i> </p></a>");
+    REQUIRE(ok);
+}
+
+TEST_CASE(XMLFormatter_MinifyPassThroughKeepsSpelling) {
+    FormatterOptions m;
+    m.minify = true;
+    bool ok = false;
+    // Kept spans are copied as written: quotes and in-tag spacing survive.
+    const std::string xml =
+        "\n<a  k='v'>\n\t<b/>\n  <p>one <i>two</i> </p>\n  <c\n   x = \"1\" ></c >\n</a>\n\n";
+    REQUIRE_EQ(formatMapped(xml, m, &ok),
+               "<a  k='v'><b/><p>one <i>two</i> </p><c\n   x = \"1\" ></c ></a>");
+    REQUIRE(ok);
+
+    // Nothing droppable: output is the input, byte for byte.
+    const std::string tight = "<r><x a=\"1\">t</x><y/></r>";
+    REQUIRE_EQ(formatMapped(tight, m, &ok), tight);
+    REQUIRE(ok);
+
+    // Line ends are normalized as the tokenizer reports them, so a file and a
+    // pipe minify alike (<r> has text, so its whitespace is kept).
+    const std::string crlf = "<r a=\"x\r\ny\">x\r\ny\rz<!--c\r\nd--><b/>\r\n<c>\r</c>\r\n</r>\r\n";
+    const std::string lf = "<r a=\"x\ny\">x\ny\nz<!--c\nd--><b/>\n<c>\n</c>\n</r>";
+    REQUIRE_EQ(formatMapped(crlf, m, &ok), lf);
+    REQUIRE(ok);
+    REQUIRE_EQ(format(crlf, m, &ok), lf);
+    TokenizerOptions raw;
+    raw.flags &= ~TokenizerOptions::NormalizeLineEndings;
+    REQUIRE_EQ(formatMapped(crlf, m, &ok, raw), crlf.substr(0, crlf.size() - 2));
+}
+
+TEST_CASE(XMLFormatter_MinifyPassThroughErrorStops) {
+    FormatterOptions m;
+    m.minify = true;
+    bool ok = true;
+    formatMapped("<a>\n <b></a>", m, &ok);
+    REQUIRE(!ok);
+}
+
+TEST_CASE(XMLFormatter_ChunkedTextSameOutput) {
+    // Long whitespace runs around text, at depth 0 and inside elements: each run is
+    // kept or dropped whole, however it was cut into pieces.
+    const std::string pad(50, ' ');
+    const std::string docs[] = {
+        "<a>" + pad + "<b>" + pad + "x" + pad + "</b>" + pad + "\n\t" + pad + "<c/>" + pad + "</a>" + pad,
+        pad + "<r><p>" + std::string(300, 'y') + "</p>\r\n" + pad + "\r\n<q>\n" + pad + "</q></r>\n",
+        "<r>" + pad + "caf\xC3\xA9" + pad + "<i>" + pad + "</i>" + pad + "</r>",
+    };
+    TokenizerOptions plain;
+    TokenizerLimits tiny;
+    tiny.textChunkBytes = 4;
+    for (bool zeroCopy : {false, true}) {
+        TokenizerOptions chunked;
+        chunked.flags |= TokenizerOptions::ChunkedText;
+        if (zeroCopy) chunked.flags |= TokenizerOptions::ZeroCopyText;
+        for (const std::string& xml : docs) {
+            for (bool minify : {false, true}) {
+                FormatterOptions f;
+                f.minify = minify;
+                bool ok = false;
+                const std::string expect = format(xml, f, &ok, 1024, 1024, plain);
+                REQUIRE(ok);
+                REQUIRE_EQ(format(xml, f, &ok, 16, 1024, chunked, tiny), expect);
+                REQUIRE(ok);
+                REQUIRE_EQ(formatMapped(xml, f, &ok, chunked, tiny), formatMapped(xml, f, nullptr, plain));
+                REQUIRE(ok);
+            }
+        }
+    }
+}
+
+TEST_CASE(XMLFormatter_References) {
+    const std::string xml = "<a v=\"x &amp; &#34;y&#x22;\">1 &lt; 2 &#x26; ]]&gt; &#233; <b>&amp;amp;</b></a>";
+    TokenizerOptions raw;
+    raw.flags &= ~TokenizerOptions::ExpandInternalEntities;
+    bool ok = false;
+    // Passed through as written...
+    REQUIRE_EQ(format(xml, {}, &ok, 1024, 1024, raw), xml + "\n");
+    REQUIRE(ok);
+    // ...or decoded by the tokenizer and escaped again.
+    REQUIRE_EQ(format(xml, {}, &ok), std::string("<a v=\"x &amp; &quot;y&quot;\">1 &lt; 2 &amp; ]]&gt; \xC3\xA9 "
+                                                 "<b>&amp;amp;</b></a>\n"));
+    REQUIRE(ok);
+    TokenizerOptions zeroCopy;
+    zeroCopy.flags |= TokenizerOptions::ZeroCopyText | TokenizerOptions::ChunkedText;
+    REQUIRE_EQ(format(xml, {}, &ok, 16, 1024, zeroCopy), format(xml));
+}
+
+TEST_CASE(XMLFormatter_Markup) {
+    const std::string xml =
+        "<?xml version=\"1.0\"?>\n<!DOCTYPE r [\n<!ENTITY e \"x\">\n]>\n<!-- top -->\n"
+        "<r><?pi data?>\n  <a><![CDATA[<b> & ]]></a><!--c--><b>t<!--in-->u</b><c><![CDATA[" +
+        std::string(100, 'z') + "]]></c></r>\n";
+    bool ok = false;
+    const std::string expect =
+        "<?xml version=\"1.0\"?>\n<!DOCTYPE r [\n<!ENTITY e \"x\">\n]>\n<!-- top -->\n"
+        "<r>\n  <?pi data?>\n  <a><![CDATA[<b> & ]]></a>\n  <!--c-->\n  <b>t<!--in-->u</b>\n  <c><![CDATA[" +
+        std::string(100, 'z') + "]]></c>\n</r>\n";
+    REQUIRE_EQ(format(xml, {}, &ok), expect);
+    REQUIRE(ok);
+
+    // A CDATA section in pieces, or copied across small windows: same output.
+    TokenizerOptions chunked;
+    chunked.flags |= TokenizerOptions::ChunkedText;
+    TokenizerLimits tiny;
+    tiny.textChunkBytes = 8;
+    REQUIRE_EQ(format(xml, {}, &ok, 16, 1024, chunked, tiny), expect);
+    REQUIRE(ok);
+    REQUIRE_EQ(formatMapped(xml, {}, &ok, chunked, tiny), expect);
+    REQUIRE(ok);
+
+    FormatterOptions m;
+    m.minify = true;
+    const std::string minified = format(xml, m, &ok);
+    REQUIRE(ok);
+    REQUIRE_EQ(formatMapped(xml, m, &ok), minified);
+    REQUIRE_EQ(format(xml, m, &ok, 16, 1024, chunked, tiny), minified);
+    REQUIRE(minified.find("<a><![CDATA[<b> & ]]></a><!--c--><b>") != std::string::npos);
+}
@@ -304,4 +304,57 @@ TEST_CASE(XMLToken_MoveActsLikeCopyForPOD) {
     REQUIRE_EQ(moved.arena, expected.arena);
     REQUIRE_EQ(moved.generation, expected.generation);
 #endif
-}
\ No newline at end of file
+}
+
+// ------------------------------
+// TagArena tests
+// ------------------------------
+TEST_CASE(TagArena_SlicesStableAndReleasedLIFO) {
+    using LXMLFormatter::TagArena;
+    TagArena a;
+    REQUIRE_EQ(a.sliceData(), nullptr);
+
+    const TagArena::Mark outer = a.mark();
+    a.beginSlice();
+    REQUIRE(a.append("root", 4));
+    const char* root = a.sliceData();
+
+    // Fill past the first chunk with many small slices; all stay where they were written.
+    const TagArena::Mark inner = a.mark();
+    std::string big(TagArena::kFirstChunkBytes, 'x');
+    a.beginSlice();
+    REQUIRE(a.append(big.data(), 100));
+    REQUIRE(a.append(big.data(), static_cast<LXMLFormatter::ByteLen>(big.size())));
+    REQUIRE_EQ(a.sliceLen(), big.size() + 100);
+    REQUIRE(std::memcmp(root, "root", 4) == 0);
+    REQUIRE(a.reserved() > TagArena::kFirstChunkBytes);
+
+    // Releasing the inner frame reuses the space right after "root".
+    a.release(inner);
+    a.beginSlice();
+    REQUIRE(a.append("leaf", 4));
+    REQUIRE_EQ(a.sliceData(), root + 4);
+
+    a.release(outer);
+    a.beginSlice();
+    REQUIRE(a.append("next", 4));
+    REQUIRE_EQ(a.sliceData(), root);
+}
+
+TEST_CASE(TagArena_OpenSliceMovesWhole) {
+    using LXMLFormatter::TagArena;
+    TagArena a;
+    std::string fill(TagArena::kFirstChunkBytes - 3, 'f');
+    a.beginSlice();
+    REQUIRE(a.append(fill.data(), static_cast<LXMLFormatter::ByteLen>(fill.size())));
+
+    // "abcdef" does not fit in the 3 bytes left: the slice moves as one piece.
+    a.beginSlice();
+    REQUIRE(a.append("ab", 2));
+    REQUIRE(a.append("cdef", 4));
+    REQUIRE_EQ(a.sliceLen(), 6u);
+    REQUIRE(std::memcmp(a.sliceData(), "abcdef", 6) == 0);
+
+    a.clear();
+    REQUIRE_EQ(a.reserved(), TagArena::kFirstChunkBytes);
+}
@@ -0,0 +1,209 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "CheckpointIndex.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    std::string document() {
+        std::string s = "<root a=\"1\">\n";
+        for (int i = 0; i < 40; ++i) {
+            s += "  <group id=\"" + std::to_string(i) + "\">\r\n";
+            s += "    <item>text " + std::to_string(i) + " caf\xC3\xA9</item><e/>\n";
+            s += "  </group>\n";
+        }
+        return s + "</root>\n";
+    }
+
+    std::unique_ptr<BufferedInputStream> viewAt(const std::string& doc, const TokenizerCheckpoint& cp) {
+        const size_t off = static_cast<size_t>(cp.where.byteOffset);
+        auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(doc.data()) + off,
+                                                  doc.size() - off, off);
+        if (in && !in->setPosition(cp.where.byteOffset, cp.where.line, cp.where.column)) in.reset();
+        return in;
+    }
+}
+
+TEST_CASE(Checkpoint_LineRoundTrip) {
+    TokenizerCheckpoint cp;
+    cp.where.byteOffset = 123456789012ull;
+    cp.where.line = 42;
+    cp.where.column = 7;
+    cp.flags = TokenizerFlags::Started;
+    cp.open = {"root", "a:b", "\xC3\xA9l\xC3\xA9ment"};
+
+    std::ostringstream os;
+    cp.write(os);
+    REQUIRE_EQ(os.str(), std::string("123456789012 42 7 0 1 3 root a:b \xC3\xA9l\xC3\xA9ment\n"));
+
+    std::istringstream is(os.str());
+    TokenizerCheckpoint back;
+    REQUIRE(back.read(is));
+    REQUIRE_EQ(back.where.byteOffset, cp.where.byteOffset);
+    REQUIRE_EQ(back.where.line, 42u);
+    REQUIRE_EQ(back.where.column, 7u);
+    REQUIRE(back.state == State::Content);
+    REQUIRE_EQ(back.flags, cp.flags);
+    REQUIRE(back.open == cp.open);
+
+    // Too few names, trailing junk, bad state.
+    for (const char* bad : {"1 1 1 0 1 2 a\n", "1 1 1 0 1 1 a b\n", "1 1 1 99 1 0\n", "x\n"}) {
+        std::istringstream b(bad);
+        REQUIRE(!back.read(b));
+    }
+}
+
+TEST_CASE(Checkpoint_OnlyBetweenContentTokens) {
+    const std::string xml = "<a><b k=\"v\">t</b><c/></a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    TokenizerCheckpoint cp;
+    REQUIRE(!tz.checkpoint(cp)); // nothing read yet
+
+    XMLToken t;
+    REQUIRE(tz.nextToken(t)); // DocumentStart
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE(!tz.checkpoint(cp)); // '>' not read yet
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::AttributeName);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::AttributeValue);
+    REQUIRE(!tz.checkpoint(cp));
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::Text);
+    REQUIRE(tz.checkpoint(cp));
+    REQUIRE_EQ(cp.where.byteOffset, 13u); // at "</b>"
+    REQUIRE_EQ(cp.open.size(), 2u);
+
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+    REQUIRE(tz.checkpoint(cp));
+    REQUIRE_EQ(cp.where.byteOffset, 17u);
+    REQUIRE_EQ(cp.open.size(), 1u); // b is closed
+    REQUIRE_EQ(cp.open[0], std::string("a"));
+
+    while (tz.nextToken(t)) {}
+    REQUIRE(!tz.checkpoint(cp));
+}
+
+TEST_CASE(Checkpoint_ResumeMatchesFullRun) {
+    const std::string xml = document();
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    CheckpointIndex index(256);
+    XMLTokenizer tz(*in);
+    tz.recordCheckpoints(&index);
+    const std::vector<std::string> full = drain(tz, false);
+    REQUIRE(index.size() >= 8u);
+
+    for (const TokenizerCheckpoint& cp : index.entries()) {
+        // Tokens of the full run from the checkpoint on.
+        std::vector<std::string> expect;
+        for (const std::string& line : full) {
+            if (std::stoull(line.substr(line.find(' ') + 1)) >= cp.where.byteOffset) expect.push_back(line);
+        }
+
+        auto view = viewAt(xml, cp);
+        REQUIRE(view);
+        XMLTokenizer resumed(*view);
+        REQUIRE(resumed.resume(cp));
+        REQUIRE(drain(resumed, false) == expect);
+
+        // A stream positioned at the checkpoint (as if seeked), small window.
+        std::istringstream rest(xml.substr(static_cast<size_t>(cp.where.byteOffset)));
+        auto stream = BufferedInputStream::Create(rest, 16);
+        REQUIRE(stream);
+        REQUIRE(stream->setPosition(cp.where.byteOffset, cp.where.line, cp.where.column));
+        XMLTokenizer fromStream(*stream);
+        REQUIRE(fromStream.resume(cp));
+        REQUIRE(drain(fromStream, false) == expect);
+    }
+}
+
+TEST_CASE(Checkpoint_ResumeChecksPositionAndEndTags) {
+    TokenizerCheckpoint cp;
+    cp.where.byteOffset = 100;
+    cp.flags = TokenizerFlags::Started;
+    cp.open = {"a", "b"};
+
+    const std::string ok = "</b></a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(ok.data()), ok.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in, quiet());
+    REQUIRE(!tz.resume(cp)); // cursor is at 0, not 100
+    REQUIRE(in->setPosition(100, 1, 1));
+    REQUIRE(tz.resume(cp));
+    REQUIRE_EQ(tz.nestingDepth(), 2u);
+    XMLToken t;
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+    REQUIRE_EQ(std::string(t.data, t.length), std::string("b"));
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::DocumentEnd);
+    REQUIRE(!in->setPosition(0, 1, 1)); // input already consumed
+
+    const std::string bad = "</a>";
+    auto in2 = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(bad.data()), bad.size(), 100);
+    REQUIRE(in2);
+    XMLTokenizer tz2(*in2, quiet());
+    REQUIRE(tz2.resume(cp));
+    REQUIRE(tz2.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::Error);
+    REQUIRE(tz2.errors()[0].code == TokenizerErrorCode::MismatchedEndTag);
+
+    // Deeper than the limits allow.
+    TokenizerLimits lims;
+    lims.maxOpenDepth = 1;
+    auto in3 = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(ok.data()), ok.size(), 100);
+    XMLTokenizer tz3(*in3, quiet(), lims);
+    REQUIRE(!tz3.resume(cp));
+}
+
+TEST_CASE(CheckpointIndex_SaveLoadFind) {
+    const std::string xml = document();
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    CheckpointIndex index(512);
+    XMLTokenizer tz(*in);
+    tz.recordCheckpoints(&index);
+    drain(tz, false);
+    REQUIRE(index.size() >= 4u);
+    for (size_t i = 1; i < index.size(); ++i) {
+        REQUIRE(index.entries()[i].where.byteOffset >= index.entries()[i - 1].where.byteOffset + 512);
+    }
+
+    const TokenizerCheckpoint& second = index.entries()[1];
+    REQUIRE(index.findBefore(0) == nullptr);
+    REQUIRE(index.findBefore(second.where.byteOffset) == &second);
+    REQUIRE(index.findBefore(second.where.byteOffset + 1) == &second);
+    REQUIRE(index.findBefore(~0ull) == &index.entries().back());
+
+    const TempFile file;
+    REQUIRE(file);
+    const char* path = file.path().c_str();
+    REQUIRE(index.save(path));
+    CheckpointIndex loaded;
+    REQUIRE(loaded.load(path));
+    REQUIRE_EQ(loaded.everyBytes(), 512u);
+    REQUIRE_EQ(loaded.size(), index.size());
+    for (size_t i = 0; i < index.size(); ++i) {
+        REQUIRE_EQ(loaded.entries()[i].where.byteOffset, index.entries()[i].where.byteOffset);
+        REQUIRE(loaded.entries()[i].open == index.entries()[i].open);
+    }
+    std::remove(path);
+    REQUIRE(!loaded.load(path));
+    REQUIRE(loaded.empty());
+
+    // Wrong header, offsets out of order.
+    std::istringstream wrong("lxml-other 1 512\n");
+    REQUIRE(!loaded.read(wrong));
+    std::istringstream order("lxml-checkpoints 1 512\n900 1 1 0 1 0\n100 1 1 0 1 0\n");
+    REQUIRE(!loaded.read(order));
+    REQUIRE(loaded.empty());
+}
@@ -0,0 +1,203 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+
+namespace {
+    TokenizerOptions chunked(bool zeroCopy = false) {
+        TokenizerOptions o;
+        o.flags |= TokenizerOptions::ChunkedText | TokenizerOptions::QuietErrors;
+        if (zeroCopy) o.flags |= TokenizerOptions::ZeroCopyText;
+        return o;
+    }
+
+    struct Piece {
+        std::string bytes;
+        U8          flags;
+        ByteOff     byteOffset;
+    };
+
+    // Text pieces of the first run (up to the next non-Text token) and that token's type.
+    std::vector<Piece> firstRun(XMLTokenizer& tz, XMLTokenType& after) {
+        std::vector<Piece> run;
+        XMLToken t;
+        while (tz.nextToken(t)) {
+            if (t.type == XMLTokenType::Text) {
+                run.push_back({std::string(t.data, t.length), t.flags, t.byteOffset});
+            } else if (!run.empty()) {
+                after = t.type;
+                return run;
+            }
+        }
+        after = XMLTokenType::DocumentEnd;
+        return run;
+    }
+
+    std::string joined(const std::vector<Piece>& run) {
+        std::string s;
+        for (const Piece& p : run) s += p.bytes;
+        return s;
+    }
+
+    // Mixed widths (1-4 bytes) and CR/CRLF line ends; 'normalized' is the LF form.
+    std::string body(std::string* normalized) {
+        std::string raw;
+        std::string norm;
+        for (int i = 0; i < 60; ++i) {
+            const std::string word = "w" + std::to_string(i) + " caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80";
+            raw += word;
+            norm += word;
+            raw += (i % 3 == 0) ? "\r\n" : (i % 3 == 1) ? "\r" : "\n";
+            norm += "\n";
+        }
+        if (normalized) *normalized = norm;
+        return raw;
+    }
+}
+
+TEST_CASE(ChunkedText_CopiedPiecesAreBounded) {
+    std::string expect;
+    const std::string xml = "<a>" + body(&expect) + "</a>";
+    for (size_t buf : {7u, 16u, 1024u}) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, buf);
+        REQUIRE(in);
+        TokenizerLimits lims;
+        lims.textChunkBytes = 8;
+        XMLTokenizer tz(*in, chunked(), lims);
+        XMLTokenType after = XMLTokenType::Text;
+        const std::vector<Piece> run = firstRun(tz, after);
+        REQUIRE_EQ(after, XMLTokenType::EndTag);
+        REQUIRE_EQ(joined(run), expect);
+        REQUIRE(run.size() > expect.size() / 8);
+        REQUIRE_EQ(run.front().byteOffset, 3u);
+        for (size_t i = 0; i < run.size(); ++i) {
+            const bool last = i + 1 == run.size();
+            REQUIRE(run[i].bytes.size() <= 8u);
+            REQUIRE(!run[i].bytes.empty());
+            REQUIRE_EQ((run[i].flags & XMLToken::Continued) != 0, !last);
+            REQUIRE_EQ(run[i].flags & XMLToken::InputSlice, 0);
+            if (!last) REQUIRE(run[i].bytes.size() >= 5u); // cut short only to end on a character
+            if (i) REQUIRE(run[i].byteOffset > run[i - 1].byteOffset);
+        }
+    }
+}
+
+TEST_CASE(ChunkedText_LongRunIsNotAnError) {
+    const std::string xml = "<a>" + std::string(1000, 'x') + "</a>";
+    TokenizerLimits lims;
+    lims.maxTextRunBytes = 64;
+    lims.textChunkBytes = 1u << 20; // clamped to maxTextRunBytes
+
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    XMLTokenizer tz(*in, chunked(), lims);
+    XMLTokenType after = XMLTokenType::Text;
+    const std::vector<Piece> run = firstRun(tz, after);
+    REQUIRE_EQ(after, XMLTokenType::EndTag);
+    REQUIRE_EQ(run.size(), 16u);
+    REQUIRE_EQ(run[0].bytes.size(), 64u);
+    REQUIRE_EQ(joined(run), std::string(1000, 'x'));
+    REQUIRE(tz.errors().empty());
+
+    // Without the option the same run is still over the limit.
+    TokenizerOptions whole;
+    whole.flags |= TokenizerOptions::QuietErrors;
+    std::istringstream src(xml);
+    auto in2 = BufferedInputStream::Create(src, 16);
+    XMLTokenizer tz2(*in2, whole, lims);
+    XMLToken t;
+    while (tz2.nextToken(t)) {}
+    REQUIRE(!tz2.errors().empty());
+    REQUIRE(tz2.errors()[0].code == TokenizerErrorCode::LimitExceeded);
+}
+
+TEST_CASE(ChunkedText_ZeroCopySlicesTheWindow) {
+    const std::string text = body(nullptr);
+    // No CR: every piece can alias the window.
+    std::string plain;
+    for (char c : text) plain += (c == '\r') ? '\n' : c;
+    const std::string xml = "<a>" + plain + "</a><b/>";
+
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 16);
+    REQUIRE(in);
+    TokenizerLimits window;
+    window.textChunkBytes = 16; // pieces copied around a split character stay small too
+    XMLTokenizer tz(*in, chunked(true), window);
+    XMLTokenType after = XMLTokenType::Text;
+    const std::vector<Piece> run = firstRun(tz, after);
+    REQUIRE_EQ(after, XMLTokenType::EndTag);
+    REQUIRE_EQ(joined(run), plain);
+    REQUIRE(run.size() > plain.size() / 16);
+    for (const Piece& p : run) {
+        REQUIRE(p.bytes.size() <= 16u);
+        REQUIRE((p.flags & XMLToken::InputSlice) != 0);
+    }
+    REQUIRE_EQ(run.front().flags & XMLToken::Continued, XMLToken::Continued);
+
+    // One window holding everything (a mapping): pieces stop at maxTextRunBytes.
+    TokenizerLimits lims;
+    lims.maxTextRunBytes = 32;
+    auto view = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    XMLTokenizer tz2(*view, chunked(true), lims);
+    const std::vector<Piece> run2 = firstRun(tz2, after);
+    REQUIRE_EQ(after, XMLTokenType::EndTag);
+    REQUIRE_EQ(joined(run2), plain);
+    for (size_t i = 0; i < run2.size(); ++i) {
+        REQUIRE(run2[i].bytes.size() <= 32u);
+        REQUIRE((run2[i].flags & XMLToken::InputSlice) != 0);
+        REQUIRE_EQ((run2[i].flags & XMLToken::Continued) != 0, i + 1 != run2.size());
+    }
+
+    // With CRs the copy path takes over and still normalizes.
+    const std::string crXml = "<a>" + text + "</a>";
+    std::istringstream crSrc(crXml);
+    auto crIn = BufferedInputStream::Create(crSrc, 16);
+    TokenizerLimits small;
+    small.textChunkBytes = 8;
+    XMLTokenizer tz3(*crIn, chunked(true), small);
+    std::string norm;
+    body(&norm);
+    REQUIRE_EQ(joined(firstRun(tz3, after)), norm);
+    REQUIRE_EQ(after, XMLTokenType::EndTag);
+}
+
+TEST_CASE(ChunkedText_ShortRunsAreOnePiece) {
+    const std::string xml = "<r><a>one</a>\n<b>two</b></r>";
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 1024);
+    XMLTokenizer tz(*in, chunked());
+    XMLToken t;
+    int texts = 0;
+    while (tz.nextToken(t)) {
+        if (t.type != XMLTokenType::Text) continue;
+        ++texts;
+        REQUIRE(!t.isContinued());
+    }
+    REQUIRE_EQ(texts, 3);
+}
+
+TEST_CASE(ChunkedText_NoCheckpointInsideARun) {
+    const std::string xml = "<a>" + std::string(100, 'x') + "</a>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    TokenizerLimits lims;
+    lims.textChunkBytes = 40;
+    XMLTokenizer tz(*in, chunked(), lims);
+    XMLToken t;
+    TokenizerCheckpoint cp;
+    REQUIRE(tz.nextToken(t) && tz.nextToken(t)); // DocumentStart, <a>
+    REQUIRE(tz.nextToken(t)); REQUIRE(t.isContinued());
+    REQUIRE(!tz.checkpoint(cp));
+    REQUIRE(tz.nextToken(t)); REQUIRE(t.isContinued());
+    REQUIRE(tz.nextToken(t)); REQUIRE(!t.isContinued());
+    REQUIRE_EQ(t.length, 20u);
+    REQUIRE(tz.checkpoint(cp));
+    REQUIRE_EQ(cp.where.byteOffset, 103u);
+}
@@ -0,0 +1,144 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    // Text and attribute values of 'xml', each run joined; errors as "!code line:col".
+    std::vector<std::string> values(const std::string& xml, TokenizerOptions opts, size_t bufferSize = 1024,
+                                    TokenizerLimits lims = {}) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, bufferSize);
+        XMLTokenizer tz(*in, opts, lims);
+        std::vector<std::string> out;
+        bool joining = false;
+        XMLToken t;
+        while (tz.nextToken(t)) {
+            if (t.type == XMLTokenType::Text || t.type == XMLTokenType::AttributeValue) {
+                if (joining) out.back().append(t.data, t.length);
+                else out.emplace_back(t.data, t.length);
+                joining = t.isContinued();
+            } else if (t.type == XMLTokenType::Error) {
+                const TokenizerError& e = tz.errors().back();
+                out.push_back("!" + std::to_string(static_cast<unsigned>(e.code)) + " " +
+                              std::to_string(e.where.line) + ":" + std::to_string(e.where.column));
+            }
+        }
+        return out;
+    }
+
+    std::string malformed(size_t line, size_t column) {
+        return "!" + std::to_string(static_cast<unsigned>(TokenizerErrorCode::MalformedEntity)) + " " +
+               std::to_string(line) + ":" + std::to_string(column);
+    }
+}
+
+TEST_CASE(Entities_ExpandedInTextAndValues) {
+    const std::string xml = "<a v=\"1 &amp; 2 &lt;&gt;\" w='&quot;&apos;&#x27;'>x &amp; y &#65;&#x42;&#0067; "
+                            "&#x20AC;&#x1F600;&#xE9;&#10;z</a>";
+    const std::vector<std::string> expect = {"1 & 2 <>", "\"''", "x & y ABC \xE2\x82\xAC\xF0\x9F\x98\x80\xC3\xA9\nz"};
+    for (U32 extra : {0u, TokenizerOptions::ZeroCopyText, TokenizerOptions::ChunkedText,
+                      TokenizerOptions::ZeroCopyText | TokenizerOptions::ChunkedText}) {
+        REQUIRE(values(xml, quiet(extra)) == expect);
+        REQUIRE(values(xml, quiet(extra), 16) == expect); // references cut by the window end
+        TokenizerOptions raw = quiet(extra);
+        raw.flags &= ~(TokenizerOptions::NormalizeLineEndings);
+        REQUIRE(values(xml, raw, 16) == expect);
+    }
+}
+
+TEST_CASE(Entities_ZeroCopyUnlessDecoded) {
+    const std::string xml = "<a><b>plain text</b><c>a &amp; b</c></a>";
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 1024);
+    XMLTokenizer tz(*in, quiet(TokenizerOptions::ZeroCopyText));
+    std::vector<bool> slices;
+    XMLToken t;
+    while (tz.nextToken(t)) {
+        if (t.type == XMLTokenType::Text) slices.push_back(t.isInputSlice());
+    }
+    REQUIRE(slices == std::vector<bool>({true, false}));
+}
+
+TEST_CASE(Entities_PassThroughWhenOff) {
+    TokenizerOptions raw = quiet(TokenizerOptions::ZeroCopyText);
+    raw.flags &= ~TokenizerOptions::ExpandInternalEntities;
+    REQUIRE(values("<a v=\"&lt;&#1;\">&amp;&nbsp;& x</a>", raw) ==
+            std::vector<std::string>({"&lt;&#1;", "&amp;&nbsp;& x"}));
+}
+
+TEST_CASE(Entities_MalformedAndUndeclared) {
+    // Strict: an error at the '&'.
+    for (const char* ref : {"&nbsp;", "&#0;", "&#xD800;", "&#x110000;", "&#99999999999;", "&#12a;", "&#X41;",
+                            "&#;", "&;", "& x;", "&amp", "&1a;"}) {
+        const std::string xml = "<a>ok " + std::string(ref) + " tail</a>";
+        REQUIRE(values(xml, quiet()) == std::vector<std::string>({malformed(1, 7)}));
+        REQUIRE(values("<a\n v='" + std::string(ref) + "'/>", quiet()) ==
+                std::vector<std::string>({malformed(2, 5)}));
+    }
+    const std::string longRef = "&#" + std::string(40, '0') + "65;";
+    REQUIRE(values("<a>" + longRef + "</a>", quiet()) == std::vector<std::string>({malformed(1, 4)}));
+    REQUIRE(values("<a>&#" + std::string(20, '0') + "65;</a>", quiet()) == std::vector<std::string>({"A"}));
+
+    // Otherwise they are kept as written.
+    TokenizerOptions lax = quiet();
+    lax.flags &= ~TokenizerOptions::Strict;
+    REQUIRE(values("<a v='&nbsp;&#0;&amp;'>&copy; & &#x41;&#xD800;&</a>", lax) ==
+            std::vector<std::string>({"&nbsp;&#0;&", "&copy; & A&#xD800;&"}));
+}
+
+TEST_CASE(Entities_ChunkedPiecesKeepCharacters) {
+    std::string xml = "<a>";
+    std::string expect;
+    for (int i = 0; i < 40; ++i) {
+        xml += "ab&#x1F600;&amp;";
+        expect += "ab\xF0\x9F\x98\x80&";
+    }
+    xml += "</a>";
+    TokenizerLimits lims;
+    lims.textChunkBytes = 8;
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 32);
+    XMLTokenizer tz(*in, quiet(TokenizerOptions::ChunkedText), lims);
+    std::string got;
+    XMLToken t;
+    while (tz.nextToken(t)) {
+        if (t.type != XMLTokenType::Text) continue;
+        REQUIRE(t.length <= 8u);
+        // Each piece is whole UTF-8.
+        REQUIRE_EQ(UTF8Handler::validate(reinterpret_cast<const uint8_t*>(t.data), t.length).validBytes,
+                   static_cast<std::size_t>(t.length));
+        got.append(t.data, t.length);
+    }
+    REQUIRE(tz.errors().empty());
+    REQUIRE_EQ(got, expect);
+}
+
+TEST_CASE(Entities_PushedByteByByte) {
+    const std::string xml = "<a v=\"&#x3C;&amp;\">&lt;p&gt; &#233;&nbsp;</a>";
+    auto in = BufferedInputStream::CreatePush(8);
+    XMLTokenizer tz(*in, quiet());
+    std::vector<std::string> got;
+    XMLToken t;
+    for (size_t i = 0; i <= xml.size(); ++i) {
+        if (i == xml.size()) in->finish();
+        else REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(xml.data()) + i, 1));
+        while (tz.nextToken(t)) {
+            if (t.type == XMLTokenType::Text || t.type == XMLTokenType::AttributeValue) got.emplace_back(t.data, t.length);
+        }
+    }
+    // The undeclared &nbsp; ends it, once the whole reference is there.
+    REQUIRE(got == std::vector<std::string>({"<&"}));
+    REQUIRE_EQ(tz.errors().size(), 1u);
+    REQUIRE(tz.errors()[0].code == TokenizerErrorCode::MalformedEntity);
+    REQUIRE_EQ(tz.errors()[0].where.column, 36u);
+}
@@ -0,0 +1,206 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    std::vector<Tok> tokenize(const std::string& xml, size_t bufferSize = 1u << 16, TokenizerOptions opts = quiet(),
+                              TokenizerLimits lims = {}) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, bufferSize);
+        XMLTokenizer tz(*in, opts, lims);
+        return collect(tz);
+    }
+
+    // The markup tokens only, pieces of a chunked section joined.
+    std::string markup(const std::vector<Tok>& toks) {
+        std::string s;
+        bool open = false;
+        for (const Tok& t : toks) {
+            if (t.type < XMLTokenType::Comment || t.type > XMLTokenType::DOCTYPE) continue;
+            if (!open) s += std::to_string(static_cast<unsigned>(t.type)) + "@" + std::to_string(t.offset) + "[";
+            s += t.text;
+            open = t.continued;
+            if (!open) s += "]";
+        }
+        return s;
+    }
+
+    TokenizerErrorCode firstError(const std::string& xml, TokenizerOptions opts = quiet(), TokenizerLimits lims = {},
+                                  size_t bufferSize = 1u << 16) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, bufferSize);
+        XMLTokenizer tz(*in, opts, lims);
+        collect(tz);
+        return tz.errors().empty() ? TokenizerErrorCode::None : tz.errors()[0].code;
+    }
+
+    const std::string kDoc =
+        "<?xml version=\"1.0\"?>\n"
+        "<!DOCTYPE r SYSTEM \"r.dtd\" [\n  <!ENTITY e \"a>b]\">\n  <!-- ]> ' -->\n  <?p ]>?>\n]>\n"
+        "<r><!-- one - two --><![CDATA[<x>&amp;]]]]><?go fast?><![CDATA[]]></r>";
+}
+
+TEST_CASE(Markup_TokensAreSlices) {
+    const std::vector<Tok> toks = tokenize(kDoc);
+    REQUIRE_EQ(markup(toks), std::string(
+        "7@0[xml version=\"1.0\"]"
+        "9@22[r SYSTEM \"r.dtd\" [\n  <!ENTITY e \"a>b]\">\n  <!-- ]> ' -->\n  <?p ]>?>\n]]"
+        "6@105[ one - two ]"
+        "8@123[<x>&amp;]]]"
+        "7@145[go fast]"
+        "8@156[]"));
+    for (const Tok& t : toks) {
+        if (t.type >= XMLTokenType::Comment && t.type <= XMLTokenType::DOCTYPE) REQUIRE(t.slice);
+    }
+    // Same tokens when every construct spans several windows (copied then).
+    REQUIRE_EQ(markup(tokenize(kDoc, 16)), markup(toks));
+
+    // Without ReportXmlDecl the declaration is dropped; other PIs are not.
+    TokenizerOptions noDecl = quiet();
+    noDecl.flags &= ~TokenizerOptions::ReportXmlDecl;
+    const std::string m = markup(tokenize(kDoc, 1u << 16, noDecl));
+    REQUIRE(m.find("xml version") == std::string::npos);
+    REQUIRE(m.find("7@145[go fast]") != std::string::npos);
+}
+
+TEST_CASE(Markup_LineEndings) {
+    const std::string xml = "<!DOCTYPE r [\r\n]><r><!--a\r\nb\rc--><![CDATA[\r\n]]><?p x\ry?></r>";
+    REQUIRE_EQ(markup(tokenize(xml)), std::string("9@0[r [\n]]6@20[a\nb\nc]8@33[\n]7@47[p x\ny]"));
+    REQUIRE_EQ(markup(tokenize(xml, 16)), markup(tokenize(xml)));
+    TokenizerOptions raw = quiet();
+    raw.flags &= ~TokenizerOptions::NormalizeLineEndings;
+    const std::vector<Tok> toks = tokenize(xml, 1u << 16, raw);
+    REQUIRE_EQ(markup(toks), std::string("9@0[r [\r\n]]6@20[a\r\nb\rc]8@33[\r\n]7@47[p x\ry]"));
+    for (const Tok& t : toks) {
+        if (t.type >= XMLTokenType::Comment && t.type <= XMLTokenType::DOCTYPE) REQUIRE(t.slice);
+    }
+}
+
+TEST_CASE(Markup_Errors) {
+    REQUIRE(firstError("<r><!-- x -") == TokenizerErrorCode::UnterminatedComment);
+    REQUIRE(firstError("<r><![CDATA[x]]") == TokenizerErrorCode::UnterminatedCData);
+    REQUIRE(firstError("<?pi x ?") == TokenizerErrorCode::UnterminatedPI);
+    REQUIRE(firstError("<!DOCTYPE r [<!-- > -->") == TokenizerErrorCode::UnexpectedEOF);
+    REQUIRE(firstError("<!DOCTYPEr>") == TokenizerErrorCode::InvalidCharAfterLT);
+    REQUIRE(firstError("<r><!ELEMENT r ANY></r>") == TokenizerErrorCode::InvalidCharAfterLT);
+    REQUIRE(firstError("<r><![CDAT[x]]></r>") == TokenizerErrorCode::InvalidCharAfterLT);
+    REQUIRE(firstError("<? x?><r/>") == TokenizerErrorCode::InvalidCharInName);
+    REQUIRE(firstError("<?a=b?><r/>") == TokenizerErrorCode::InvalidCharInName);
+    REQUIRE(firstError("<r><![CDATA[\xC3]]></r>") == TokenizerErrorCode::InvalidUTF8);
+
+    // "--" inside a comment: an error with Strict, data without.
+    REQUIRE(firstError("<r><!-- a -- b --></r>") == TokenizerErrorCode::BadCommentDoubleDash);
+    REQUIRE(firstError("<r><!-- a ---></r>") == TokenizerErrorCode::BadCommentDoubleDash);
+    TokenizerOptions lax = quiet();
+    lax.flags &= ~TokenizerOptions::Strict;
+    REQUIRE_EQ(markup(tokenize("<r><!-- a -- b --></r>", 1u << 16, lax)), std::string("6@3[ a -- b ]"));
+
+    // Limits, whether the body is sliced or copied.
+    TokenizerLimits lims;
+    lims.maxCommentBytes = 8;
+    lims.maxCdataBytes   = 8;
+    lims.maxDoctypeBytes = 8;
+    for (size_t buf : {size_t(16), size_t(1u << 16)}) {
+        REQUIRE(firstError("<r><!--12345678--></r>", quiet(), lims, buf) == TokenizerErrorCode::None);
+        REQUIRE(firstError("<r><!--123456789--></r>", quiet(), lims, buf) == TokenizerErrorCode::LimitExceeded);
+        REQUIRE(firstError("<r><?p 12345678?></r>", quiet(), lims, buf) == TokenizerErrorCode::LimitExceeded);
+        REQUIRE(firstError("<r><![CDATA[12345678]]></r>", quiet(), lims, buf) == TokenizerErrorCode::None);
+        REQUIRE(firstError("<r><![CDATA[123456789" + std::string(100, 'x'), quiet(), lims, buf) ==
+                TokenizerErrorCode::LimitExceeded);
+        REQUIRE(firstError("<!DOCTYPE root [  ]><r/>", quiet(), lims, buf) == TokenizerErrorCode::LimitExceeded);
+    }
+}
+
+TEST_CASE(Markup_ChunkedCData) {
+    std::string body;
+    for (int i = 0; i < 400; ++i) body += "line " + std::to_string(i) + " <b>]]</b> caf\xC3\xA9\r\n";
+    const std::string xml = "<r><![CDATA[" + body + "]]><!--after--></r>";
+    std::string expect = body;
+    for (size_t p; (p = expect.find("\r\n")) != std::string::npos;) expect.replace(p, 2, "\n");
+
+    const std::vector<Tok> whole = tokenize(xml);
+    REQUIRE_EQ(markup(whole), "8@3[" + expect + "]6@" + std::to_string(xml.size() - 16) + "[after]");
+
+    TokenizerLimits lims;
+    lims.textChunkBytes = 100;
+    for (U32 normalize : {0u, TokenizerOptions::NormalizeLineEndings}) {
+        TokenizerOptions chunked = quiet(TokenizerOptions::ChunkedText);
+        chunked.flags = (chunked.flags & ~TokenizerOptions::NormalizeLineEndings) | normalize;
+        for (size_t buf : {size_t(64), size_t(4096)}) {
+            const std::vector<Tok> toks = tokenize(xml, buf, chunked, lims);
+            size_t pieces = 0;
+            std::string joined;
+            for (const Tok& t : toks) {
+                if (t.type != XMLTokenType::CDATA) continue;
+                ++pieces;
+                joined += t.text;
+                REQUIRE(t.text.size() <= std::max<size_t>(buf, 100));
+            }
+            REQUIRE(pieces >= 3);
+            REQUIRE_EQ(joined, normalize ? expect : body);
+            REQUIRE_EQ(markup(toks), markup(tokenize(xml, 1u << 16, chunked)));
+        }
+    }
+
+    // One window (a view): maxCdataBytes bounds each piece instead of the section.
+    lims.maxCdataBytes = 1000;
+    auto view = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    TokenizerOptions raw = quiet(TokenizerOptions::ChunkedText);
+    raw.flags &= ~TokenizerOptions::NormalizeLineEndings;
+    XMLTokenizer tz(*view, raw, lims);
+    const std::vector<Tok> toks = collect(tz);
+    size_t pieces = 0;
+    for (const Tok& t : toks) {
+        if (t.type != XMLTokenType::CDATA) continue;
+        ++pieces;
+        REQUIRE(t.slice);
+        REQUIRE(t.text.size() <= 1000u);
+    }
+    REQUIRE(pieces >= (body.size() + 999) / 1000);
+    REQUIRE(tz.errors().empty());
+}
+
+TEST_CASE(Markup_SkipInsideChunkedCData) {
+    const std::string xml = "<r><a><![CDATA[" + std::string(200, 'x') + "</a>]]></a><b/></r>";
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 64);
+    XMLTokenizer tz(*in, quiet(TokenizerOptions::ChunkedText));
+    XMLToken t;
+    while (tz.nextToken(t) && t.type != XMLTokenType::CDATA) {}
+    REQUIRE(t.isContinued());
+    REQUIRE(tz.skipCurrentElement(true));
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE_EQ(std::string(t.data, t.length), std::string("b"));
+}
+
+TEST_CASE(Markup_PushedByteByByte) {
+    for (U32 extra : {0u, TokenizerOptions::ChunkedText}) {
+        const std::string expect = markup(tokenize(kDoc, 1u << 16, quiet(extra)));
+        auto in = BufferedInputStream::CreatePush(16);
+        XMLTokenizer tz(*in, quiet(extra));
+        std::vector<Tok> got;
+        XMLToken t;
+        for (size_t pos = 0;;) {
+            while (tz.nextToken(t)) got.push_back(copy(t));
+            if (!tz.needMoreInput()) break;
+            if (pos == kDoc.size()) {
+                in->finish();
+            } else {
+                REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(kDoc.data()) + pos++, 1));
+            }
+        }
+        REQUIRE(tz.errors().empty());
+        REQUIRE_EQ(markup(got), expect);
+    }
+}
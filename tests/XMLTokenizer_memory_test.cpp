@@ -0,0 +1,152 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    // Counts what goes through it; allocates from the default resource.
+    class CountingResource final : public std::pmr::memory_resource {
+    public:
+        std::size_t outstanding = 0;
+        std::size_t allocations = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t align) override {
+            ++allocations;
+            outstanding += bytes;
+            return std::pmr::get_default_resource()->allocate(bytes, align);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+            outstanding -= bytes;
+            std::pmr::get_default_resource()->deallocate(p, bytes, align);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+    };
+
+
+    std::string document(int n) {
+        std::string s = "<root xmlns=\"urn:x\">";
+        for (int i = 0; i < n; ++i) {
+            s += "<item id=\"" + std::to_string(i) + "\" name=\"n" + std::to_string(i) + "\">text " +
+                 std::to_string(i) + "</item>";
+        }
+        return s + "</root>";
+    }
+
+
+    std::unique_ptr<BufferedInputStream> view(const std::string& doc) {
+        return BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(doc.data()), doc.size());
+    }
+}
+
+TEST_CASE(Memory_AllBuffersUseTheResource) {
+    const std::string doc = document(50) + "<oops";
+    CountingResource counting;
+    {
+        auto in = view(doc);
+        XMLTokenizer tz(*in, quiet(), {}, &counting);
+        REQUIRE(tz.memoryResource() == &counting);
+        REQUIRE_EQ(counting.allocations, 0u); // the constructor allocates nothing
+        drain(tz);
+        REQUIRE(!tz.errors().empty());         // errors and their messages too
+        REQUIRE(counting.allocations > 0u);
+        REQUIRE_EQ(tz.memoryInUse(), counting.outstanding);
+
+        tz.releaseMemory();
+        REQUIRE_EQ(tz.memoryInUse(), 0u);
+        REQUIRE_EQ(counting.outstanding, 0u);
+        REQUIRE(tz.errors().empty());
+    }
+    REQUIRE_EQ(counting.outstanding, 0u);
+
+    // Destruction alone returns everything as well.
+    {
+        auto in = view(doc);
+        XMLTokenizer tz(*in, quiet(), {}, &counting);
+        drain(tz);
+        REQUIRE(counting.outstanding > 0u);
+    }
+    REQUIRE_EQ(counting.outstanding, 0u);
+}
+
+TEST_CASE(Memory_MonotonicArenaPerDocument) {
+    const std::string doc = document(20);
+    auto ref = view(doc);
+    XMLTokenizer plain(*ref);
+    REQUIRE(plain.memoryResource() == std::pmr::get_default_resource());
+    const std::vector<std::string> expect = drain(plain);
+
+    // A fixed buffer with no upstream: any allocation outside it would throw.
+    alignas(std::max_align_t) static unsigned char storage[256 * 1024];
+    std::pmr::monotonic_buffer_resource arena(storage, sizeof(storage), std::pmr::null_memory_resource());
+    for (int i = 0; i < 50; ++i) {
+        {
+            auto in = view(doc);
+            XMLTokenizer tz(*in, {}, {}, &arena);
+            REQUIRE(drain(tz) == expect);
+        }
+        arena.release(); // the whole document's memory at once
+    }
+}
+
+TEST_CASE(Memory_SwitchResourceBetweenDocuments) {
+    // Two documents back to back in one stream; reset() between them.
+    const std::string first = document(10);
+    const std::string second = "<other a=\"1\">x</other>";
+    const std::string both = first + second;
+    CountingResource a;
+    CountingResource b;
+    auto in = view(both);
+    XMLTokenizer tz(*in, {}, {}, &a);
+
+    XMLToken t;
+    int depth = 0;
+    while (tz.nextToken(t)) {
+        if (t.type == XMLTokenType::StartTag) ++depth;
+        if (t.type == XMLTokenType::EndTag && --depth == 0) break;
+    }
+    REQUIRE(a.outstanding > 0u);
+
+    tz.setMemoryResource(&b);
+    REQUIRE_EQ(a.outstanding, 0u);
+    REQUIRE(tz.memoryResource() == &b);
+    const std::vector<std::string> rest = drain(tz);
+    REQUIRE(!rest.empty());
+    REQUIRE_EQ(rest.front().substr(0, 3), std::string("10 ")); // DocumentStart of the second document
+    REQUIRE(b.allocations > 0u);
+    REQUIRE_EQ(a.outstanding, 0u);
+    REQUIRE_EQ(tz.memoryInUse(), b.outstanding);
+
+    tz.setMemoryResource(nullptr);
+    REQUIRE(tz.memoryResource() == std::pmr::get_default_resource());
+    REQUIRE_EQ(b.outstanding, 0u);
+}
+
+TEST_CASE(Memory_TagArenaReleasesChunks) {
+    CountingResource counting;
+    TagArena arena(&counting);
+    arena.beginSlice();
+    const std::string big(TagArena::kFirstChunkBytes * 3, 'x');
+    REQUIRE(arena.append(big.data(), static_cast<ByteLen>(big.size())));
+    REQUIRE(counting.outstanding >= big.size());
+    arena.clear();
+    REQUIRE(counting.outstanding > 0u); // clear() keeps the first chunk
+    arena.releaseMemory();
+    REQUIRE_EQ(counting.outstanding, 0u);
+    REQUIRE_EQ(arena.reserved(), 0u);
+
+    // Allocation failure is reported, not thrown.
+    TagArena none(std::pmr::null_memory_resource());
+    none.beginSlice();
+    REQUIRE(!none.append("abc", 3));
+}
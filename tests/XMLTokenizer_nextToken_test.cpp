@@ -415,4 +415,126 @@ TEST_CASE(XMLTokenizer_CurrentPosition_TracksCorrectly) {
     REQUIRE_EQ(pos.line, 1u);
     REQUIRE_EQ(pos.column, 1u);
     REQUIRE_EQ(pos.byteOffset, 0u);
-}
\ No newline at end of file
+}
+// ---- ZeroCopyText mode ----
+
+static TokenizerOptions zeroCopyOptions() {
+    TokenizerOptions opts;
+    opts.flags |= TokenizerOptions::ZeroCopyText;
+    return opts;
+}
+
+TEST_CASE(XMLTokenizer_ZeroCopyText_SlicesInputWindow) {
+    std::istringstream in(u8"héllo wörld<");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+
+    XMLTokenizer tokenizer(*bis, zeroCopyOptions());
+    XMLToken tok;
+    tokenizer.nextToken(tok); // DocumentStart
+
+    REQUIRE(tokenizer.nextToken(tok));
+    REQUIRE_EQ(tok.type, XMLTokenType::Text);
+    REQUIRE(tok.isInputSlice());
+    REQUIRE_EQ(std::string(tok.data, tok.length), std::string(u8"héllo wörld"));
+    REQUIRE_EQ(tok.byteOffset, 0u);
+    REQUIRE_EQ(bis->peekChar(), '<');
+}
+
+TEST_CASE(XMLTokenizer_ZeroCopyText_TextToEOF) {
+    std::istringstream in("tail text");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+
+    XMLTokenizer tokenizer(*bis, zeroCopyOptions());
+    XMLToken tok;
+    tokenizer.nextToken(tok); // DocumentStart
+
+    REQUIRE(tokenizer.nextToken(tok));
+    REQUIRE(tok.isInputSlice());
+    REQUIRE_EQ(std::string(tok.data, tok.length), "tail text");
+    REQUIRE(tokenizer.nextToken(tok));
+    REQUIRE_EQ(tok.type, XMLTokenType::DocumentEnd);
+    REQUIRE(!tok.isInputSlice());
+}
+
+TEST_CASE(XMLTokenizer_ZeroCopyText_CRFallsBackToArena) {
+    std::istringstream in("a\r\nb<");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+
+    XMLTokenizer tokenizer(*bis, zeroCopyOptions());
+    XMLToken tok;
+    tokenizer.nextToken(tok); // DocumentStart
+
+    REQUIRE(tokenizer.nextToken(tok));
+    REQUIRE(!tok.isInputSlice());
+    REQUIRE_EQ(std::string(tok.data, tok.length), "a\nb");
+}
+
+TEST_CASE(XMLTokenizer_ZeroCopyText_RunLongerThanBuffer) {
+    // Run cannot fit a 16-byte window: copied, byte-identical to the default mode.
+    const std::string text = std::string(u8"αβγ ") + std::string(40, 'x') + u8"€" + "<";
+    std::istringstream in(text);
+    auto bis = BufferedInputStream::Create(in, 16);
+    REQUIRE(bis);
+
+    XMLTokenizer tokenizer(*bis, zeroCopyOptions());
+    XMLToken tok;
+    tokenizer.nextToken(tok); // DocumentStart
+
+    REQUIRE(tokenizer.nextToken(tok));
+    REQUIRE(!tok.isInputSlice());
+    REQUIRE_EQ(std::string(tok.data, tok.length), text.substr(0, text.size() - 1));
+}
+
+TEST_CASE(XMLTokenizer_Text_MultibyteAcrossTinyBuffer) {
+    const std::string utf8Text = u8"Hello 世界 🌍 end";
+    for (size_t bufSize : {4u, 5u, 7u}) {
+        std::istringstream in(utf8Text);
+        auto bis = BufferedInputStream::Create(in, bufSize);
+        REQUIRE(bis);
+
+        XMLTokenizer tokenizer(*bis);
+        XMLToken tok;
+        tokenizer.nextToken(tok); // DocumentStart
+        REQUIRE(tokenizer.nextToken(tok));
+        REQUIRE_EQ(tok.type, XMLTokenType::Text);
+        REQUIRE_EQ(std::string(tok.data, tok.length), utf8Text);
+    }
+}
+
+TEST_CASE(XMLTokenizer_OptionInstantiations_AgreeWithOptions) {
+    // Every (NormalizeLineEndings, ZeroCopyText) pair runs its own scanner build.
+    const std::string xml = "<a k=\"x\r\ny\rz\">p\r\nq\rr</a>";
+    for (bool normalize : {true, false}) {
+        for (bool zeroCopy : {true, false}) {
+            for (size_t bufSize : {size_t(8), size_t(1024)}) {
+                std::istringstream in(xml);
+                auto bis = BufferedInputStream::Create(in, bufSize);
+                REQUIRE(bis);
+                TokenizerOptions opts;
+                if (!normalize) opts.flags &= ~TokenizerOptions::NormalizeLineEndings;
+                if (zeroCopy) opts.flags |= TokenizerOptions::ZeroCopyText;
+                XMLTokenizer tokenizer(*bis, opts);
+
+                XMLToken tok;
+                std::string value, text;
+                bool sliced = false;
+                while (tokenizer.nextToken(tok)) {
+                    REQUIRE(tok.type != XMLTokenType::Error);
+                    if (tok.type == XMLTokenType::AttributeValue) value.assign(tok.data, tok.length);
+                    if (tok.type == XMLTokenType::Text) {
+                        text.assign(tok.data, tok.length);
+                        sliced = tok.isInputSlice();
+                    }
+                }
+                REQUIRE_EQ(value, normalize ? "x\ny\nz" : "x\r\ny\rz");
+                REQUIRE_EQ(text, normalize ? "p\nq\nr" : "p\r\nq\rr");
+                // Raw CRs need no rewrite, so the run can alias the window.
+                if (!zeroCopy || normalize) REQUIRE(!sliced);
+                else if (bufSize == 1024)   REQUIRE(sliced);
+            }
+        }
+    }
+}
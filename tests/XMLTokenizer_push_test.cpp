@@ -0,0 +1,234 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "SaxParser.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    std::vector<std::string> pulled(const std::string& xml, TokenizerOptions opts) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, 1u << 16);
+        XMLTokenizer tz(*in, opts);
+        return drain(tz);
+    }
+
+    // Feeds 'xml' in pieces of the given sizes (cycled), draining tokens in between.
+    std::vector<std::string> pushed(const std::string& xml, TokenizerOptions opts, const std::vector<size_t>& sizes,
+                                    size_t capacity = 16) {
+        auto in = BufferedInputStream::CreatePush(capacity);
+        XMLTokenizer tz(*in, opts);
+        std::vector<std::string> out;
+        XMLToken t;
+        size_t pos = 0;
+        size_t k = 0;
+        for (;;) {
+            while (tz.nextToken(t)) out.push_back(describe(t));
+            if (!tz.needMoreInput()) break;
+            if (pos == xml.size()) {
+                in->finish();
+                continue;
+            }
+            const size_t n = std::min(sizes[k++ % sizes.size()], xml.size() - pos);
+            REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(xml.data()) + pos, n));
+            pos += n;
+        }
+        return out;
+    }
+
+    std::string document() {
+        std::string s = "\xEF\xBB\xBF<root xmlns=\"urn:x\" a='1'>\r\n";
+        for (int i = 0; i < 12; ++i) {
+            s += "  <item id=\"" + std::to_string(i) + "\" name=\"caf\xC3\xA9 \xE2\x82\xAC\">text " +
+                 std::to_string(i) + " \xF0\x9F\x98\x80\r\nline</item>\n  <empty k=\"v\" />\n";
+        }
+        return s + "</root>\n";
+    }
+}
+
+TEST_CASE(Push_SameTokensAsPull) {
+    const std::string xml = document();
+    for (U32 extra : {0u, TokenizerOptions::ZeroCopyText, TokenizerOptions::NormalizeLineEndings,
+                      TokenizerOptions::InternNames | TokenizerOptions::ZeroCopyText}) {
+        const std::vector<std::string> expect = pulled(xml, quiet(extra));
+        REQUIRE(expect.size() > 50u);
+        REQUIRE(pushed(xml, quiet(extra), {1}) == expect);
+        REQUIRE(pushed(xml, quiet(extra), {3, 7, 2, 64, 5}) == expect);
+        REQUIRE(pushed(xml, quiet(extra), {xml.size()}) == expect);
+    }
+}
+
+TEST_CASE(Push_ErrorsOnlyAfterFinish) {
+    auto in = BufferedInputStream::CreatePush();
+    XMLTokenizer tz(*in, quiet());
+    XMLToken t;
+    const std::string part = "<a x=\"1";
+    REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(part.data()), part.size()));
+    std::vector<XMLTokenType> types;
+    while (tz.nextToken(t)) types.push_back(t.type);
+    REQUIRE(tz.needMoreInput());
+    REQUIRE(tz.errors().empty());
+    REQUIRE(types == std::vector<XMLTokenType>({XMLTokenType::DocumentStart, XMLTokenType::StartTag,
+                                                XMLTokenType::AttributeName}));
+    REQUIRE_EQ(tz.nextTokens(&t, 1), 0u);
+    REQUIRE(tz.needMoreInput());
+
+    // The value resumes where it started.
+    const std::string more = "23\"><b/>";
+    REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(more.data()), more.size()));
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::AttributeValue);
+    REQUIRE_EQ(std::string(t.data, t.length), std::string("123"));
+    REQUIRE_EQ(t.byteOffset, 6u);
+    while (tz.nextToken(t)) {}
+    REQUIRE(tz.needMoreInput()); // "<a>" is still open: it may go on
+
+    in->finish();
+    REQUIRE(!in->feed(reinterpret_cast<const uint8_t*>("x"), 1));
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::Error);
+    REQUIRE(!tz.needMoreInput());
+    REQUIRE(tz.errors()[0].code == TokenizerErrorCode::UnexpectedEOF);
+}
+
+TEST_CASE(Push_PeekSpanStarvesOnShortWindow) {
+    auto in = BufferedInputStream::CreatePush(16);
+    REQUIRE(in->feed(reinterpret_cast<const uint8_t*>("ab\xC3"), 3));
+    std::size_t len = 0;
+    // Plain peekSpan(): fewer bytes than asked for is starved.
+    REQUIRE(in->peekSpan(len, 4) != nullptr);
+    REQUIRE_EQ(len, 3u);
+    REQUIRE(in->starved());
+    // A whole code point at the cursor is enough for peekCodePointSpan()...
+    REQUIRE(in->peekCodePointSpan(len) != nullptr);
+    REQUIRE(!in->starved());
+    // ...but not a cut-off sequence.
+    in->consumeSpan(2);
+    REQUIRE(in->peekCodePointSpan(len) != nullptr);
+    REQUIRE_EQ(len, 1u);
+    REQUIRE(in->starved());
+}
+
+TEST_CASE(Push_StreamBasics) {
+    auto in = BufferedInputStream::CreatePush(4);
+    REQUIRE(in && in->isPush());
+    REQUIRE_EQ(in->peekChar(), -1);
+    REQUIRE(in->starved());
+
+    // A BOM split over feeds is recognised and skipped.
+    REQUIRE(in->feed(reinterpret_cast<const uint8_t*>("\xEF"), 1));
+    REQUIRE_EQ(in->peekChar(), -1); // held back: might be a BOM
+    REQUIRE(in->feed(reinterpret_cast<const uint8_t*>("\xBB\xBF" "ab"), 4));
+    REQUIRE(in->getEncoding() == BufferedInputStream::Encoding::UTF8);
+    REQUIRE_EQ(in->getTotalBytesRead(), 0u);
+
+    in->setMark();
+    REQUIRE_EQ(in->getChar(), 'a');
+    REQUIRE_EQ(in->getChar(), 'b');
+    REQUIRE_EQ(in->getChar(), -1);
+    REQUIRE(in->starved());
+    // Growing past the initial capacity keeps the marked bytes.
+    const std::string rest = "\ncdefghijklmnop";
+    REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(rest.data()), rest.size()));
+    REQUIRE(!in->starved());
+    in->rewindToMark();
+    REQUIRE_EQ(in->getTotalBytesRead(), 0u);
+    std::string got;
+    while (in->peekChar() >= 0) got += static_cast<char>(in->getChar());
+    REQUIRE_EQ(got, "ab" + rest);
+    REQUIRE_EQ(in->getCurrentLine(), 2u);
+    REQUIRE(in->starved());
+    REQUIRE(!in->exhausted());
+
+    in->finish();
+    REQUIRE(in->exhausted());
+    REQUIRE_EQ(in->peekChar(), -1);
+    REQUIRE(!in->starved());
+
+    // Too short for a BOM, then the end.
+    auto small = BufferedInputStream::CreatePush(4);
+    REQUIRE(small->feed(reinterpret_cast<const uint8_t*>("\xEF\xBB"), 2));
+    small->finish();
+    REQUIRE(small->getEncoding() == BufferedInputStream::Encoding::UTF8_NO_BOM);
+    std::istringstream other("<a/>");
+    BufferedInputStream::StateError err = BufferedInputStream::StateError::None;
+    REQUIRE(!small->rebind(other, &err));
+    REQUIRE(err == BufferedInputStream::StateError::NotRebindable);
+
+    std::istringstream src("<a/>");
+    auto pull = BufferedInputStream::Create(src, 16);
+    REQUIRE(!pull->feed(reinterpret_cast<const uint8_t*>("x"), 1));
+}
+
+namespace {
+    struct Count : SaxHandler {
+        int elements = 0;
+        std::string values; // the 'n' attributes
+        std::string text;
+        void onStartElement(const SaxName&, const SaxAttributes& attrs) {
+            ++elements;
+            if (const SaxAttribute* n = attrs.find("n")) values.append(n->value);
+        }
+        void onText(std::string_view t, bool) { text.append(t); }
+    };
+
+    struct Upload {
+        std::unique_ptr<BufferedInputStream> in;
+        std::unique_ptr<XMLTokenizer>        tz;
+        Count                                handler;
+        std::unique_ptr<SaxParser<Count>>    sax;
+        std::string                          doc;
+        size_t                               pos = 0;
+    };
+}
+
+TEST_CASE(Push_ManyDocumentsOnOneThread) {
+    // Round-robin over 64 "connections", a few bytes from each per turn.
+    std::vector<Upload> uploads(64);
+    for (size_t i = 0; i < uploads.size(); ++i) {
+        Upload& u = uploads[i];
+        u.doc = "<list>";
+        for (size_t j = 0; j <= i % 7; ++j) u.doc += "<e n=\"" + std::to_string(j) + "\">v" + std::to_string(i) + "</e>";
+        u.doc += "</list>";
+        u.in = BufferedInputStream::CreatePush(8);
+        u.tz = std::make_unique<XMLTokenizer>(*u.in, quiet(TokenizerOptions::ChunkedText | TokenizerOptions::ZeroCopyText));
+        u.sax = std::make_unique<SaxParser<Count>>(*u.tz, u.handler);
+    }
+    size_t open = uploads.size();
+    for (size_t turn = 0; open; ++turn) {
+        for (size_t i = 0; i < uploads.size(); ++i) {
+            Upload& u = uploads[i];
+            if (u.pos > u.doc.size()) continue;
+            if (u.pos == u.doc.size()) {
+                u.in->finish();
+                ++u.pos;
+                --open;
+            } else {
+                const size_t n = std::min<size_t>(1 + (i + turn) % 5, u.doc.size() - u.pos);
+                REQUIRE(u.in->feed(reinterpret_cast<const uint8_t*>(u.doc.data()) + u.pos, n));
+                u.pos += n;
+            }
+            REQUIRE(u.sax->run());
+            REQUIRE_EQ(u.tz->needMoreInput(), u.pos <= u.doc.size());
+        }
+    }
+    for (size_t i = 0; i < uploads.size(); ++i) {
+        const Upload& u = uploads[i];
+        REQUIRE_EQ(u.handler.elements, static_cast<int>(i % 7) + 2);
+        std::string values, text;
+        for (size_t j = 0; j <= i % 7; ++j) {
+            values += std::to_string(j);
+            text += "v" + std::to_string(i);
+        }
+        REQUIRE_EQ(u.handler.values, values);
+        REQUIRE_EQ(u.handler.text, text);
+    }
+}
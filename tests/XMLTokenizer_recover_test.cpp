@@ -0,0 +1,247 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    TokenizerOptions recovering(U32 extra = 0) { return quiet(TokenizerOptions::RecoverErrors | extra); }
+
+    // One short string per token: "<a" StartTag, "</a" EndTag, "/>" EmptyTag,
+    // "@x" AttributeName, "=v" AttributeValue, "'t" Text, "[c" CDATA (+ if
+    // Continued), "!" comment, "?" PI, "E<code>" a recovered Error, "F<code>" a fatal one.
+    std::string describe(const XMLToken& t, const XMLTokenizer& tz) {
+        const std::string d = t.data ? std::string(t.data, t.length) : std::string();
+        switch (t.type) {
+            case XMLTokenType::StartTag:       return "<" + d;
+            case XMLTokenType::EndTag:         return "</" + d;
+            case XMLTokenType::EmptyTag:       return "/>";
+            case XMLTokenType::AttributeName:  return "@" + d;
+            case XMLTokenType::AttributeValue: return "=" + d;
+            case XMLTokenType::Text:           return "'" + d;
+            case XMLTokenType::CDATA:          return "[" + d + (t.isContinued() ? "+" : "");
+            case XMLTokenType::Comment:        return "!" + d;
+            case XMLTokenType::PI:             return "?" + d;
+            case XMLTokenType::Error:
+                return (t.isRecovered() ? "E" : "F") +
+                       std::to_string(static_cast<unsigned>(tz.lastError().code));
+            default:                           return "";
+        }
+    }
+
+    std::string tokens(XMLTokenizer& tz) {
+        std::string s;
+        XMLToken t;
+        while (tz.nextToken(t)) {
+            if (t.type == XMLTokenType::DocumentStart || t.type == XMLTokenType::DocumentEnd) continue;
+            s += describe(t, tz) + " ";
+        }
+        return s;
+    }
+
+    std::string tokenize(const std::string& xml, TokenizerOptions opts = recovering(), size_t bufferSize = 1u << 16,
+                         TokenizerLimits lims = {}) {
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, bufferSize);
+        XMLTokenizer tz(*in, opts, lims);
+        return tokens(tz);
+    }
+
+    std::string code(TokenizerErrorCode c) { return std::to_string(static_cast<unsigned>(c)); }
+
+    // Every StartTag is closed by an EmptyTag or an EndTag of the same name.
+    bool balanced(const std::string& toks) {
+        std::vector<std::string> open;
+        std::istringstream is(toks);
+        for (std::string t; is >> t;) {
+            if (t.rfind("</", 0) == 0) {
+                if (open.empty() || open.back() != t.substr(2)) return false;
+                open.pop_back();
+            } else if (t == "/>") {
+                if (open.empty()) return false;
+                open.pop_back();
+            } else if (t[0] == '<') {
+                open.push_back(t.substr(1));
+            }
+        }
+        return open.empty();
+    }
+}
+
+TEST_CASE(Recover_EndTags) {
+    const std::string mismatch = code(TokenizerErrorCode::MismatchedEndTag);
+    // Matching an ancestor: the elements in between are closed first.
+    REQUIRE_EQ(tokenize("<a><b><c></b><d/></a>"),
+               "<a <b <c E" + mismatch + " </c </b <d /> </a ");
+    // Matching nothing open: dropped.
+    REQUIRE_EQ(tokenize("<a><b></x></b></a>"), "<a <b E" + mismatch + " </b </a ");
+    REQUIRE_EQ(tokenize("<a></a></a>t<b/>"), "<a </a E" + mismatch + " 't <b /> ");
+    // A broken end tag still closes its element.
+    REQUIRE_EQ(tokenize("<a><b></b x></a>"),
+               "<a <b E" + code(TokenizerErrorCode::UnterminatedTag) + " </b </a ");
+
+    // Without the option the first error ends the stream.
+    TokenizerOptions strict;
+    strict.flags |= TokenizerOptions::QuietErrors;
+    REQUIRE_EQ(tokenize("<a><b><c></b><d/></a>", strict), "<a <b <c F" + mismatch + " ");
+}
+
+TEST_CASE(Recover_StartTags) {
+    // Every broken attribute still gets a value; the tag goes on where it can.
+    REQUIRE_EQ(tokenize("<a x=\"1\" y=2 z=\"3\" w v='&bad;'><b/></a>"),
+               "<a @x =1 @y E" + code(TokenizerErrorCode::ExpectedQuoteForAttrValue) + " = @z =3 @w E" +
+               code(TokenizerErrorCode::ExpectedEqualsAfterAttrName) + " = @v E" +
+               code(TokenizerErrorCode::MalformedEntity) + " = <b /> </a ");
+    // '<' in a value ends the tag there; the element stays open.
+    REQUIRE_EQ(tokenize("<r><a x=\"1<b/></r>"),
+               "<r <a @x E" + code(TokenizerErrorCode::InvalidCharInAttrValue) + " = <b /> E" +
+               code(TokenizerErrorCode::MismatchedEndTag) + " </a </r ");
+    // Garbage up to "/>": an EmptyTag.
+    REQUIRE_EQ(tokenize("<r><a x=\"1\" !!/><b></b></r>"),
+               "<r <a @x =1 E" + code(TokenizerErrorCode::InvalidCharInName) + " /> <b </b </r ");
+    // Garbage up to '>': the element stays open.
+    REQUIRE_EQ(tokenize("<r><a % k='v'>t</a></r>"),
+               "<r <a E" + code(TokenizerErrorCode::InvalidCharInName) + " 't </a </r ");
+    REQUIRE_EQ(tokenize("<r>1 < 2<b/></r>"),
+               "<r '1  E" + code(TokenizerErrorCode::InvalidCharAfterLT) + " <b /> </r ");
+
+    // Too deep: the extra start tags are dropped, and their end tags with them.
+    TokenizerLimits lims;
+    lims.maxOpenDepth = 2;
+    const std::string toks = tokenize("<a><b><c><d/></c>x</b></a>", recovering(), 1u << 16, lims);
+    REQUIRE(balanced(toks));
+    REQUIRE(toks.find("'x") != std::string::npos);
+}
+
+TEST_CASE(Recover_MarkupAndText) {
+    // Skipped through the terminator.
+    REQUIRE_EQ(tokenize("<r><!-- a -- b -->t<? x?>u<!BOGUS r>v</r>"),
+               "<r E" + code(TokenizerErrorCode::BadCommentDoubleDash) + " 't E" +
+               code(TokenizerErrorCode::InvalidCharInName) + " 'u E" + code(TokenizerErrorCode::InvalidCharAfterLT) +
+               " 'v </r ");
+    // Text: up to the next tag.
+    TokenizerLimits lims;
+    lims.maxTextRunBytes = 8;
+    REQUIRE_EQ(tokenize("<r>0123456789abcdef<b/>ok</r>", recovering(), 4, lims),
+               "<r E" + code(TokenizerErrorCode::LimitExceeded) + " <b /> 'ok </r ");
+}
+
+TEST_CASE(Recover_EndOfInputClosesElements) {
+    const std::string eof = code(TokenizerErrorCode::UnexpectedEOF);
+    REQUIRE_EQ(tokenize("<a><b>text"), "<a <b 'text E" + eof + " </b </a ");
+    REQUIRE_EQ(tokenize("<a><b x=\"1"), "<a <b @x E" + eof + " = E" + eof + " </b </a ");
+    REQUIRE_EQ(tokenize("<a><!-- x"), "<a E" + code(TokenizerErrorCode::UnterminatedComment) + " E" + eof + " </a ");
+}
+
+TEST_CASE(Recover_ChunkedCDataIsClosed) {
+    // The section breaks after some pieces were out: an empty last piece follows.
+    const std::string xml = "<r><![CDATA[" + std::string(100, 'x') + "\xFF" + std::string(50, 'y') + "]]><b/></r>";
+    const std::string toks = tokenize(xml, recovering(TokenizerOptions::ChunkedText), 32);
+    const std::size_t err = toks.find("E" + code(TokenizerErrorCode::InvalidUTF8));
+    REQUIRE(err != std::string::npos);
+    REQUIRE(toks.rfind("+ ", err) != std::string::npos);
+    REQUIRE_EQ(toks.substr(err), "E" + code(TokenizerErrorCode::InvalidUTF8) + " [ <b /> </r ");
+}
+
+TEST_CASE(Recover_ErrorsAreBounded) {
+    // Returns memoryInUse() after a document with 2 * 'n' errors.
+    const auto run = [](int n) {
+        std::string xml = "<r>";
+        for (int i = 0; i < n; ++i) xml += "</x><y a=1/>";
+        xml += "</r>";
+        std::istringstream src(xml);
+        auto in = BufferedInputStream::Create(src, 256);
+        TokenizerLimits lims;
+        lims.maxErrors = 10;
+        XMLTokenizer tz(*in, recovering(), lims);
+        XMLToken t;
+        size_t errors = 0, empties = 0;
+        while (tz.nextToken(t)) {
+            if (t.type == XMLTokenType::Error) {
+                ++errors;
+                REQUIRE(t.isRecovered());
+                REQUIRE_EQ(std::string(t.data, t.length), std::string(tz.lastError().msg));
+            }
+            empties += t.type == XMLTokenType::EmptyTag;
+        }
+        REQUIRE_EQ(errors, 2u * n);
+        REQUIRE_EQ(empties, size_t(n));
+        REQUIRE_EQ(tz.errorCount(), 2u * n);
+        REQUIRE_EQ(tz.errors().size(), 10u);
+        REQUIRE_EQ(tz.errors()[1].msg, std::string("Expected quote for attribute value"));
+        REQUIRE(tz.errors()[0].sev == ErrorSeverity::Recoverable);
+        return tz.memoryInUse();
+    };
+    REQUIRE_EQ(run(2000), run(20));
+
+    // The queued messages move with their storage.
+    std::istringstream src("");
+    auto in = BufferedInputStream::Create(src, 256);
+    XMLTokenizer grow(*in, recovering());
+    std::string longMsg(300, 'm');
+    XMLToken e;
+    for (int i = 0; i < 20; ++i) grow.emitError(e, TokenizerErrorCode::LimitExceeded, ErrorSeverity::Warning,
+                                                 longMsg.c_str(), static_cast<U32>(longMsg.size()));
+    REQUIRE_EQ(grow.errors().size(), 20u);
+    for (const TokenizerError& err : grow.errors()) REQUIRE_EQ(err.msg, longMsg);
+    grow.clearErrors();
+    REQUIRE_EQ(grow.errorCount(), 20u);
+    grow.reset();
+    REQUIRE_EQ(grow.errorCount(), 0u);
+}
+
+TEST_CASE(Recover_PushedByteByByte) {
+    const std::string xml = "<r a=1><x></y><!-- -- -->t<b c='<'/><![CDATA[z]]>&bad;</r></r><q";
+    // Pieces split at window ends differ, so no chunking here.
+    const std::string expect = tokenize(xml, recovering());
+    auto in = BufferedInputStream::CreatePush(8);
+    XMLTokenizer tz(*in, recovering());
+    std::string got;
+    XMLToken t;
+    for (size_t pos = 0;;) {
+        while (tz.nextToken(t)) {
+            if (t.type != XMLTokenType::DocumentStart && t.type != XMLTokenType::DocumentEnd) got += describe(t, tz) + " ";
+        }
+        if (!tz.needMoreInput()) break;
+        if (pos == xml.size()) {
+            in->finish();
+        } else {
+            REQUIRE(in->feed(reinterpret_cast<const uint8_t*>(xml.data()) + pos++, 1));
+        }
+    }
+    REQUIRE_EQ(got, expect);
+    REQUIRE(balanced(got));
+    REQUIRE(tz.errors().size() >= 6u);
+}
+
+TEST_CASE(Recover_SkipStaysFatal) {
+    const std::string xml = "<r><a><b>";
+    std::istringstream src(xml);
+    auto in = BufferedInputStream::Create(src, 64);
+    XMLTokenizer tz(*in, recovering());
+    XMLToken t;
+    while (tz.nextToken(t) && !(t.type == XMLTokenType::StartTag && t.length == 1 && t.data[0] == 'a')) {}
+    REQUIRE(!tz.skipCurrentElement());
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::Error);
+    REQUIRE(!t.isRecovered());
+    REQUIRE(!tz.nextToken(t));
+    REQUIRE(tz.errors()[0].sev == ErrorSeverity::Fatal);
+
+    // No skipping while a resync is pending.
+    std::istringstream src2("<r><a></b>x</a></r>");
+    auto in2 = BufferedInputStream::Create(src2, 64);
+    XMLTokenizer tz2(*in2, recovering());
+    while (tz2.nextToken(t) && t.type != XMLTokenType::Error) {}
+    REQUIRE_EQ(tz2.state(), State::Resyncing);
+    REQUIRE(!tz2.skipCurrentElement());
+    REQUIRE_EQ(tokens(tz2), std::string("'x </a </r "));
+}
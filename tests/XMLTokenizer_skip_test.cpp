@@ -0,0 +1,165 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include "TokenizerTestUtil.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+using namespace TestUtil;
+
+namespace {
+    // Tokenizes 'xml'; every StartTag named 'skip' is skipped right away.
+    std::vector<Tok> tokenizeSkipping(const std::string& xml, const std::string& skip,
+                                      size_t bufSize = 1024, bool checkNames = false) {
+        std::istringstream in(xml);
+        auto bis = BufferedInputStream::Create(in, bufSize);
+        std::vector<Tok> out;
+        if (!bis) return out;
+        XMLTokenizer tz(*bis, quiet());
+        XMLToken t;
+        while (tz.nextToken(t)) {
+            out.push_back(copy(t));
+            if (t.type == XMLTokenType::StartTag && out.back().text == skip) {
+                if (!tz.skipCurrentElement(checkNames)) out.push_back({XMLTokenType::Comment, "skip failed"});
+            }
+        }
+        return out;
+    }
+
+    std::string render(const std::vector<Tok>& v) {
+        std::string s;
+        for (const auto& t : v) {
+            switch (t.type) {
+                case XMLTokenType::StartTag:      s += "<" + t.text + ">"; break;
+                case XMLTokenType::EndTag:        s += "</" + t.text + ">"; break;
+                case XMLTokenType::EmptyTag:      s += "<" + t.text + "/>"; break;
+                case XMLTokenType::AttributeName: s += "@" + t.text; break;
+                case XMLTokenType::Text:          s += t.text; break;
+                case XMLTokenType::Error:         s += "!error"; break;
+                case XMLTokenType::Comment:       s += "!" + t.text; break;
+                default: break;
+            }
+        }
+        return s;
+    }
+}
+
+TEST_CASE(XMLTokenizer_Skip_SubtreeAndContinue) {
+    const std::string xml =
+        "<doc><Header id=\"1\">h</Header>"
+        "<Body><a x='1>2' y=\"/>\"><b/><c>t<!-- </Body> --><![CDATA[</Body>]]><?pi </Body>?></c></a></Body>"
+        "<Summary>s</Summary></doc>";
+    for (size_t buf : {size_t(4), size_t(7), size_t(1024)}) {
+        for (bool check : {false, true}) {
+            const auto v = tokenizeSkipping(xml, "Body", buf, check);
+            REQUIRE_EQ(render(v), "<doc><Header>@idh</Header><Body><Summary>s</Summary></doc>");
+        }
+    }
+}
+
+TEST_CASE(XMLTokenizer_Skip_FromInsideStartTag) {
+    // After an AttributeName the rest of the start tag (and an EmptyTag) is skipped.
+    std::istringstream in("<r><e a=\"1\" b=\"2\"/><f a=\"1\">x</f>tail</r>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+    REQUIRE(tz.nextToken(t)); // DocumentStart
+    REQUIRE(tz.nextToken(t)); // <r>
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::AttributeName);
+    REQUIRE(tz.skipCurrentElement());
+    REQUIRE_EQ(tz.nestingDepth(), 1u);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE_EQ(std::string(t.data, t.length), "f");
+    REQUIRE(tz.skipCurrentElement(true));
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::Text);
+    REQUIRE_EQ(std::string(t.data, t.length), "tail");
+    REQUIRE_EQ(t.byteOffset, 33u);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::DocumentEnd);
+}
+
+TEST_CASE(XMLTokenizer_Skip_AfterEndTagSkipsParent) {
+    // The element whose EndTag was returned is closed: the parent is skipped.
+    std::istringstream in("<r><p><a>1</a><b>2</b></p><q/></r>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+    std::string s;
+    while (tz.nextToken(t)) {
+        if (t.type == XMLTokenType::StartTag) s += std::string(t.data, t.length);
+        if (t.type == XMLTokenType::EndTag && std::string(t.data, t.length) == "a") {
+            REQUIRE(tz.skipCurrentElement(true));
+            s += "|";
+        }
+    }
+    REQUIRE_EQ(s, "rpa|q");
+}
+
+TEST_CASE(XMLTokenizer_Skip_NothingOpen) {
+    std::istringstream in("<r/>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+    REQUIRE(!tz.skipCurrentElement()); // not started
+    REQUIRE(tz.nextToken(t));
+    REQUIRE(!tz.skipCurrentElement()); // DocumentStart: nothing open
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE(tz.skipCurrentElement());  // empty element: just the "/>"
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::DocumentEnd);
+    REQUIRE(!tz.nextToken(t));
+    REQUIRE(!tz.skipCurrentElement());
+}
+
+TEST_CASE(XMLTokenizer_Skip_ErrorsComeFromNextToken) {
+    // EOF inside the skipped subtree.
+    auto v = tokenizeSkipping("<r><s><a>text", "s");
+    REQUIRE_EQ(render(v), "<r><s>!skip failed!error");
+
+    // Mismatched end tag: only noticed when names are checked.
+    const std::string bad = "<r><s><a></b></s></r>";
+    REQUIRE_EQ(render(tokenizeSkipping(bad, "s", 1024, false)), "<r><s></r>");
+    REQUIRE_EQ(render(tokenizeSkipping(bad, "s", 1024, true)), "<r><s>!skip failed!error");
+    REQUIRE_EQ(render(tokenizeSkipping("<r><s><a></a></s></r>", "s", 1024, true)), "<r><s></r>");
+}
+
+TEST_CASE(XMLTokenizer_Skip_CheckedDepthLimit) {
+    TokenizerLimits lims;
+    lims.maxOpenDepth = 4;
+    std::istringstream in("<r><s><a><b><c><d/></c></b></a></s></r>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    TokenizerOptions opts = quiet();
+    XMLTokenizer tz(*bis, opts, lims);
+    XMLToken t;
+    REQUIRE(tz.nextToken(t));
+    REQUIRE(tz.nextToken(t));
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(std::string(t.data, t.length), "s");
+    REQUIRE(!tz.skipCurrentElement(true));
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::Error);
+    REQUIRE_EQ(tz.errors().back().code, TokenizerErrorCode::LimitExceeded);
+    REQUIRE(!tz.nextToken(t));
+}
+
+TEST_CASE(XMLTokenizer_Skip_MappedInput) {
+    std::string xml = "<r><big>";
+    for (int i = 0; i < 5000; ++i) xml += "<i n=\"" + std::to_string(i) + "\">x &amp; y</i>\n";
+    xml += "</big><keep>k</keep></r>";
+    auto in = BufferedInputStream::CreateView(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    REQUIRE(in);
+    XMLTokenizer tz(*in);
+    XMLToken t;
+    std::string s;
+    while (tz.nextToken(t)) {
+        if (t.type == XMLTokenType::StartTag && std::string(t.data, t.length) == "big") REQUIRE(tz.skipCurrentElement(true));
+        if (t.type == XMLTokenType::StartTag || t.type == XMLTokenType::Text) s += std::string(t.data, t.length) + ",";
+    }
+    REQUIRE_EQ(s, "r,big,keep,k,");
+    REQUIRE(tz.errors().empty());
+}
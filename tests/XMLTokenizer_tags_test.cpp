@@ -0,0 +1,333 @@
+#define NO_UT_MAIN
+
+#include "UnitTestFramework.h"
+#include "BufferedInputStream.h"
+#include "XMLTokenizerTypes.h"
+#include "XMLTokenizer.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace LXMLFormatter;
+
+namespace {
+    struct Tok {
+        XMLTokenType type;
+        std::string  text;
+    };
+
+    // Drains the tokenizer, copying each slice while it is still valid.
+    std::vector<Tok> tokenize(const std::string& xml, size_t bufSize = 1024,
+                              TokenizerOptions opts = {}, TokenizerLimits lims = {}) {
+        std::istringstream in(xml);
+        auto bis = BufferedInputStream::Create(in, bufSize);
+        std::vector<Tok> out;
+        if (!bis) return out;
+        XMLTokenizer tz(*bis, opts, lims);
+        XMLToken t;
+        while (tz.nextToken(t)) {
+            out.push_back({t.type, t.data ? std::string(t.data, t.length) : std::string()});
+        }
+        return out;
+    }
+
+    bool lastIsError(const std::vector<Tok>& v) {
+        return !v.empty() && v.back().type == XMLTokenType::Error;
+    }
+}
+
+TEST_CASE(XMLTokenizer_Tags_NestedElementsAndText) {
+    auto v = tokenize("<a><b>hi</b>tail</a>");
+    REQUIRE_EQ(v.size(), 8u);
+    REQUIRE_EQ(v[0].type, XMLTokenType::DocumentStart);
+    REQUIRE_EQ(v[1].type, XMLTokenType::StartTag);  REQUIRE_EQ(v[1].text, "a");
+    REQUIRE_EQ(v[2].type, XMLTokenType::StartTag);  REQUIRE_EQ(v[2].text, "b");
+    REQUIRE_EQ(v[3].type, XMLTokenType::Text);      REQUIRE_EQ(v[3].text, "hi");
+    REQUIRE_EQ(v[4].type, XMLTokenType::EndTag);    REQUIRE_EQ(v[4].text, "b");
+    REQUIRE_EQ(v[5].type, XMLTokenType::Text);      REQUIRE_EQ(v[5].text, "tail");
+    REQUIRE_EQ(v[6].type, XMLTokenType::EndTag);    REQUIRE_EQ(v[6].text, "a");
+    REQUIRE_EQ(v[7].type, XMLTokenType::DocumentEnd);
+}
+
+TEST_CASE(XMLTokenizer_Tags_AttributesBothQuotes) {
+    auto v = tokenize("<item id=\"42\" name = 'x \"y\"' empty=\"\">t</item >");
+    REQUIRE_EQ(v.size(), 11u);
+    REQUIRE_EQ(v[1].type, XMLTokenType::StartTag);       REQUIRE_EQ(v[1].text, "item");
+    REQUIRE_EQ(v[2].type, XMLTokenType::AttributeName);  REQUIRE_EQ(v[2].text, "id");
+    REQUIRE_EQ(v[3].type, XMLTokenType::AttributeValue); REQUIRE_EQ(v[3].text, "42");
+    REQUIRE_EQ(v[4].type, XMLTokenType::AttributeName);  REQUIRE_EQ(v[4].text, "name");
+    REQUIRE_EQ(v[5].type, XMLTokenType::AttributeValue); REQUIRE_EQ(v[5].text, "x \"y\"");
+    REQUIRE_EQ(v[6].type, XMLTokenType::AttributeName);  REQUIRE_EQ(v[6].text, "empty");
+    REQUIRE_EQ(v[7].type, XMLTokenType::AttributeValue); REQUIRE_EQ(v[7].text, "");
+    REQUIRE_EQ(v[8].type, XMLTokenType::Text);           REQUIRE_EQ(v[8].text, "t");
+    REQUIRE_EQ(v[9].type, XMLTokenType::EndTag);         REQUIRE_EQ(v[9].text, "item");
+    REQUIRE_EQ(v[10].type, XMLTokenType::DocumentEnd);
+}
+
+TEST_CASE(XMLTokenizer_Tags_EmptyTagAndDepth) {
+    std::istringstream in("<root><leaf k=\"v\"/></root>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+
+    REQUIRE(tz.nextToken(t)); // DocumentStart
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE_EQ(tz.nestingDepth(), 1u);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE_EQ(tz.nestingDepth(), 2u);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::AttributeName);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::AttributeValue);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EmptyTag);
+    REQUIRE_EQ(std::string(t.data, t.length), "leaf");
+    REQUIRE_EQ(tz.nestingDepth(), 1u);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+    REQUIRE_EQ(std::string(t.data, t.length), "root");
+    REQUIRE_EQ(tz.nestingDepth(), 0u);
+    REQUIRE(tz.nextToken(t)); REQUIRE_EQ(t.type, XMLTokenType::DocumentEnd);
+}
+
+TEST_CASE(XMLTokenizer_Tags_TagDataStableUntilClose) {
+    std::istringstream in("<el a=\"1\" b=\"2\">x</el>");
+    auto bis = BufferedInputStream::Create(in, 8);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t, start, attrA;
+
+    tz.nextToken(t);                        // DocumentStart
+    REQUIRE(tz.nextToken(start));           // StartTag
+    tz.nextToken(t);                        // a
+    REQUIRE(tz.nextToken(attrA));           // "1"
+    tz.nextToken(t);                        // b
+    tz.nextToken(t);                        // "2"
+    tz.nextToken(t);                        // Text
+    REQUIRE_EQ(std::string(start.data, start.length), "el");
+    REQUIRE_EQ(std::string(attrA.data, attrA.length), "1");
+}
+
+TEST_CASE(XMLTokenizer_Tags_ValuesSpanTinyBuffer) {
+    const std::string value = std::string(u8"ünïcødé ") + std::string(100, 'v') + u8"€";
+    const std::string name  = std::string(u8"näme") + std::string(30, 'n');
+    auto v = tokenize("<" + name + " attr=\"" + value + "\"></" + name + ">", 4);
+    REQUIRE_EQ(v.size(), 6u);
+    REQUIRE_EQ(v[1].text, name);
+    REQUIRE_EQ(v[2].text, "attr");
+    REQUIRE_EQ(v[3].text, value);
+    REQUIRE_EQ(v[4].type, XMLTokenType::EndTag);
+    REQUIRE_EQ(v[5].type, XMLTokenType::DocumentEnd);
+}
+
+TEST_CASE(XMLTokenizer_Tags_AttrValueCRLFNormalized) {
+    auto v = tokenize("<a v=\"1\r\n2\r3\"/>");
+    REQUIRE_EQ(v.size(), 6u);
+    REQUIRE_EQ(v[3].type, XMLTokenType::AttributeValue);
+    REQUIRE_EQ(v[3].text, "1\n2\n3");
+    REQUIRE_EQ(v[4].type, XMLTokenType::EmptyTag);
+}
+
+TEST_CASE(XMLTokenizer_Tags_StartTagPositionIsLessThan) {
+    std::istringstream in("ab\n  <x/>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+    tz.nextToken(t); // DocumentStart
+    tz.nextToken(t); // Text
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::StartTag);
+    REQUIRE_EQ(t.byteOffset, 5u);
+    REQUIRE_EQ(t.line, 2u);
+    REQUIRE_EQ(t.column, 3u);
+}
+
+TEST_CASE(XMLTokenizer_Tags_ZeroCopyTextBetweenTags) {
+    TokenizerOptions opts;
+    opts.flags |= TokenizerOptions::ZeroCopyText;
+    std::istringstream in("<p>plain text</p>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis, opts);
+    XMLToken t;
+    tz.nextToken(t); // DocumentStart
+    tz.nextToken(t); // StartTag
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::Text);
+    REQUIRE(t.isInputSlice());
+    REQUIRE_EQ(std::string(t.data, t.length), "plain text");
+    REQUIRE(tz.nextToken(t));
+    REQUIRE_EQ(t.type, XMLTokenType::EndTag);
+}
+
+TEST_CASE(XMLTokenizer_Tags_Errors) {
+    struct Case { const char* xml; TokenizerErrorCode code; };
+    const Case cases[] = {
+        { "<a></b>",          TokenizerErrorCode::MismatchedEndTag },
+        { "</a>",             TokenizerErrorCode::MismatchedEndTag },
+        { "<a>",              TokenizerErrorCode::UnexpectedEOF },
+        { "<a x>",            TokenizerErrorCode::ExpectedEqualsAfterAttrName },
+        { "<a x=1>",          TokenizerErrorCode::ExpectedQuoteForAttrValue },
+        { "<a x=\"<\">",      TokenizerErrorCode::InvalidCharInAttrValue },
+        { "<a x=\"1",          TokenizerErrorCode::UnexpectedEOF },
+        { "<a /x>",           TokenizerErrorCode::UnterminatedTag },
+        { "<a></a",           TokenizerErrorCode::UnexpectedEOF },
+        { "<a !>",            TokenizerErrorCode::InvalidCharInName },
+    };
+    for (const auto& c : cases) {
+        std::istringstream in(c.xml);
+        auto bis = BufferedInputStream::Create(in, 1024);
+        REQUIRE(bis);
+        XMLTokenizer tz(*bis);
+        XMLToken t;
+        while (tz.nextToken(t)) {}
+        REQUIRE(!tz.errors().empty());
+        REQUIRE_EQ(tz.errors().back().code, c.code);
+    }
+}
+
+TEST_CASE(XMLTokenizer_Tags_Limits) {
+    TokenizerLimits lims;
+    lims.maxOpenDepth = 2;
+    REQUIRE(lastIsError(tokenize("<a><b><c/></b></a>", 1024, {}, lims)));
+    REQUIRE(!lastIsError(tokenize("<a><b/></a>", 1024, {}, lims)));
+
+    lims = TokenizerLimits{};
+    lims.maxAttrsPerElement = 1;
+    REQUIRE(lastIsError(tokenize("<a x=\"1\" y=\"2\"/>", 1024, {}, lims)));
+
+    lims = TokenizerLimits{};
+    lims.maxAttrValueBytes = 4;
+    REQUIRE(lastIsError(tokenize("<a x=\"12345\"/>", 1024, {}, lims)));
+    REQUIRE(!lastIsError(tokenize("<a x=\"1234\"/>", 1024, {}, lims)));
+
+    lims = TokenizerLimits{};
+    lims.maxNameBytes = 3;
+    REQUIRE(lastIsError(tokenize("<abcd/>", 1024, {}, lims)));
+}
+
+TEST_CASE(XMLTokenizer_Tags_DeepNestingKeepsAncestorSlices) {
+    // 200 levels with 64-byte values spill over several arena chunks.
+    const int depth = 200;
+    const std::string value(64, 'v');
+    std::string xml;
+    for (int i = 0; i < depth; ++i) xml += "<e" + std::to_string(i) + " a=\"" + value + "\">";
+    for (int i = depth - 1; i >= 0; --i) xml += "</e" + std::to_string(i) + ">";
+
+    std::istringstream in(xml);
+    auto bis = BufferedInputStream::Create(in, 64);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+    std::vector<XMLToken> starts, values;
+
+    tz.nextToken(t); // DocumentStart
+    while (tz.nextToken(t) && t.type != XMLTokenType::EndTag) {
+        if (t.type == XMLTokenType::StartTag)       starts.push_back(t);
+        if (t.type == XMLTokenType::AttributeValue) values.push_back(t);
+    }
+    REQUIRE_EQ(starts.size(), static_cast<size_t>(depth));
+    REQUIRE_EQ(values.size(), static_cast<size_t>(depth));
+    for (int i = 0; i < depth; ++i) {
+        REQUIRE_EQ(std::string(starts[i].data, starts[i].length), "e" + std::to_string(i));
+        REQUIRE_EQ(std::string(values[i].data, values[i].length), value);
+    }
+
+    int ends = 1;
+    while (tz.nextToken(t)) {
+        if (t.type == XMLTokenType::EndTag) ++ends;
+    }
+    REQUIRE_EQ(ends, depth);
+    REQUIRE_EQ(t.type, XMLTokenType::DocumentEnd);
+    REQUIRE(tz.errors().empty());
+}
+
+TEST_CASE(XMLTokenizer_Tags_InternedNameIds) {
+    TokenizerOptions opts;
+    opts.flags |= TokenizerOptions::InternNames;
+    std::istringstream in("<r><x id=\"1\"/><x id=\"2\"></x><y/></r>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis, opts);
+    const NameId x = tz.internName("x", 1); // pre-registered id for dispatch
+
+    XMLToken t;
+    std::vector<XMLToken> v;
+    while (tz.nextToken(t)) v.push_back(t);
+    REQUIRE_EQ(v.size(), 14u);
+
+    const NameId r = v[1].nameId;
+    REQUIRE(r != 0);
+    REQUIRE_EQ(v[2].nameId, x);                 // StartTag x
+    const NameId id = v[3].nameId;              // AttributeName id
+    REQUIRE(id != 0 && id != x && id != r);
+    REQUIRE_EQ(v[4].nameId, 0u);                // AttributeValue
+    REQUIRE_EQ(v[5].nameId, x);                 // EmptyTag x
+    REQUIRE_EQ(v[7].nameId, id);                // second id attribute
+    REQUIRE_EQ(v[9].nameId, x);                 // EndTag x
+    REQUIRE(v[10].nameId != 0 && v[10].nameId != x); // y
+    REQUIRE_EQ(v[12].nameId, r);                // EndTag r
+    REQUIRE_EQ(tz.names().name(id), std::string_view("id"));
+}
+
+TEST_CASE(XMLTokenizer_Tags_NameIdsOffByDefault) {
+    std::istringstream in("<r a=\"1\"/>");
+    auto bis = BufferedInputStream::Create(in, 1024);
+    REQUIRE(bis);
+    XMLTokenizer tz(*bis);
+    XMLToken t;
+    while (tz.nextToken(t)) REQUIRE_EQ(t.nameId, 0u);
+    REQUIRE_EQ(tz.names().size(), 0u);
+}
+
+TEST_CASE(XMLTokenizer_Batch_MatchesSingleTokens) {
+    std::string xml = "<root a=\"1\">";
+    for (int i = 0; i < 300; ++i) {
+        xml += "<item id=\"" + std::to_string(i) + "\"><v k='x'/></item>";
+        if (i % 7 == 0) xml += "text" + std::to_string(i);
+    }
+    xml += "</root>";
+
+    const auto ref = tokenize(xml, 64);
+    REQUIRE(!lastIsError(ref));
+
+    for (size_t cap : {1u, 3u, 16u, 256u}) {
+        std::istringstream in(xml);
+        auto bis = BufferedInputStream::Create(in, 64);
+        REQUIRE(bis);
+        XMLTokenizer tz(*bis);
+        std::vector<XMLToken> batch(cap);
+        size_t seen = 0;
+        while (size_t n = tz.nextTokens(batch.data(), cap)) {
+            REQUIRE(n <= cap);
+            // Every slice in the batch must still be intact after the call returns.
+            for (size_t i = 0; i < n; ++i) {
+                const XMLToken& t = batch[i];
+                REQUIRE(seen < ref.size());
+                REQUIRE_EQ(t.type, ref[seen].type);
+                REQUIRE_EQ(t.data ? std::string(t.data, t.length) : std::string(), ref[seen].text);
+                if (t.type == XMLTokenType::Text) REQUIRE_EQ(i, n - 1);
+                ++seen;
+            }
+        }
+        REQUIRE_EQ(seen, ref.size());
+        REQUIRE_EQ(tz.nextTokens(batch.data(), cap), 0u);
+    }
+}
+
+TEST_CASE(XMLTokenizer_Tags_FragmentClosesOuterElements) {
+    // A slice from the middle of a document: end tags of elements opened before
+    // the slice are tokens, not errors, and EOF with open elements is fine.
+    TokenizerOptions opts;
+    opts.flags |= TokenizerOptions::Fragment | TokenizerOptions::QuietErrors;
+    const auto toks = tokenize("<a>x</a></p><b>", 1024, opts);
+    REQUIRE(!lastIsError(toks));
+    std::vector<XMLTokenType> types;
+    for (const Tok& t : toks) types.push_back(t.type);
+    const std::vector<XMLTokenType> want = {
+        XMLTokenType::DocumentStart, XMLTokenType::StartTag, XMLTokenType::Text, XMLTokenType::EndTag,
+        XMLTokenType::EndTag, XMLTokenType::StartTag, XMLTokenType::DocumentEnd };
+    REQUIRE(types == want);
+    REQUIRE_EQ(toks[4].text, "p");
+
+    // Without the flag the same bytes are malformed.
+    REQUIRE(lastIsError(tokenize("<a>x</a></p><b>")));
+}